@@ -244,16 +244,28 @@ usage(void)
   fprintf(stderr, "                 - 1 One scan per component (default)\n");
   fprintf(stderr, "                 - 2 Optimize between one scan for all components and one scan for 1st component\n");
   fprintf(stderr, "                     plus one scan for remaining components\n");
+  fprintf(stderr, "  -scan-cost N   How progressive scan optimization sizes the candidate scans\n");
+  fprintf(stderr, "                 - 0 Encode each candidate (default)\n");
+  fprintf(stderr, "                 - 1 Estimate from symbol statistics (faster)\n");
+  fprintf(stderr, "                 - 2 Estimate from every 4th iMCU row (fastest)\n");
   fprintf(stderr, "  -notrellis     Disable trellis optimization\n");
   fprintf(stderr, "  -trellis-dc    Enable trellis optimization of DC coefficients (default)\n");
   fprintf(stderr, "  -notrellis-dc  Disable trellis optimization of DC coefficients\n");
   fprintf(stderr, "  -trellis-speed N  Trellis speed level 0-10 (0=thorough, 7=default, 10=fast)\n");
+  fprintf(stderr, "  -trellis-loops N  Number of trellis loops per component (default 1)\n");
+  fprintf(stderr, "  -trellis-loop-epsilon E  Stop the trellis loops once the estimated size\n");
+  fprintf(stderr, "                 changes by less than fraction E (default 0=never)\n");
+  fprintf(stderr, "  -threads N     Use up to N threads for trellis and scan optimization, and\n");
+  fprintf(stderr, "                 for restart intervals with -baseline (default 1; output\n");
+  fprintf(stderr, "                 is identical for any N)\n");
   fprintf(stderr, "  -tune-psnr     Tune trellis optimization for PSNR\n");
   fprintf(stderr, "  -tune-hvs-psnr Tune trellis optimization for PSNR-HVS (default)\n");
   fprintf(stderr, "  -tune-ssim     Tune trellis optimization for SSIM\n");
   fprintf(stderr, "  -tune-ms-ssim  Tune trellis optimization for MS-SSIM\n");
   fprintf(stderr, "Switches for advanced users:\n");
   fprintf(stderr, "  -noovershoot   Disable black-on-white deringing via overshoot\n");
+  fprintf(stderr, "  -buffer-symbols  Write progressive scans from the symbols recorded while\n");
+  fprintf(stderr, "                 optimizing Huffman tables (faster, uses more memory)\n");
   fprintf(stderr, "  -nojfif        Do not write JFIF (reduces size by 18 bytes but breaks standards; no known problems in Web browsers)\n");
   fprintf(stderr, "  -precision N   Create JPEG file with N-bit data precision\n");
 #ifdef C_LOSSLESS_SUPPORTED
@@ -382,6 +394,10 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
       exit(EXIT_FAILURE);
 #endif
 
+    } else if (keymatch(arg, "buffer-symbols", 2)) {
+      /* Record Huffman symbols while optimizing. */
+      jpeg_c_set_bool_param(cinfo, JBOOLEAN_BUFFER_SYMBOLS, TRUE);
+
     } else if (keymatch(arg, "baseline", 1)) {
       /* Force baseline-compatible output (8-bit quantizer values). */
       force_baseline = TRUE;
@@ -625,6 +641,16 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
        * default sampling factors.
        */
 
+    } else if (keymatch(arg, "scan-cost", 6)) {
+      /* Select how candidate scans are sized. */
+      int val;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &val) != 1 || val < 0 || val > 2)
+        usage();
+      jpeg_c_set_int_param(cinfo, JINT_SCAN_COST_MODE, val);
+
     } else if (keymatch(arg, "scans", 2)) {
       /* Set scan script. */
 #ifdef C_MULTISCAN_FILES_SUPPORTED
@@ -653,6 +679,16 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
     } else if (keymatch(arg, "strict", 2)) {
       strict = TRUE;
 
+    } else if (keymatch(arg, "threads", 2)) {
+      /* set maximum number of threads */
+      int val;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &val) != 1 || val < 1)
+        usage();
+      jpeg_c_set_int_param(cinfo, JINT_NUM_THREADS, val);
+
     } else if (keymatch(arg, "targa", 1)) {
       /* Input file is Targa format. */
       is_targa = TRUE;
@@ -676,6 +712,22 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
       /* enable DC trellis quantization */
       jpeg_c_set_bool_param(cinfo, JBOOLEAN_TRELLIS_QUANT_DC, TRUE);
 
+    } else if (keymatch(arg, "trellis-loop-epsilon", 14)) {
+      /* stop trellis loops early once they no longer pay off */
+      if (++argn >= argc) {
+        fprintf(stderr, "%s: missing argument for trellis-loop-epsilon\n", progname);
+        usage();
+      }
+      jpeg_c_set_float_param(cinfo, JFLOAT_TRELLIS_LOOP_EPSILON, atof(argv[argn]));
+
+    } else if (keymatch(arg, "trellis-loops", 13)) {
+      /* set number of trellis loops */
+      if (++argn >= argc) {
+        fprintf(stderr, "%s: missing argument for trellis-loops\n", progname);
+        usage();
+      }
+      jpeg_c_set_int_param(cinfo, JINT_TRELLIS_NUM_LOOPS, atoi(argv[argn]));
+
     } else if (keymatch(arg, "trellis-speed", 13)) {
       /* set trellis speed level (0=thorough, 10=fast) */
       if (++argn >= argc) {
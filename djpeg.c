@@ -172,6 +172,8 @@ usage(void)
   fprintf(stderr, "  -crop WxH+X+Y  Decompress only a rectangular subregion of the image\n");
   fprintf(stderr, "                 [requires PBMPLUS (PPM/PGM), GIF, or Targa output format]\n");
   fprintf(stderr, "  -strict        Treat all warnings as fatal\n");
+  fprintf(stderr, "  -threads N     Use up to N threads for entropy decoding (default 1;\n");
+  fprintf(stderr, "                 effective with -memsrc; output is identical for any N)\n");
   fprintf(stderr, "  -verbose  or  -debug   Emit debug output\n");
   fprintf(stderr, "  -version       Print version information and exit\n");
   exit(EXIT_FAILURE);
@@ -430,6 +432,16 @@ parse_switches(j_decompress_ptr cinfo, int argc, char **argv,
     } else if (keymatch(arg, "strict", 2)) {
       strict = TRUE;
 
+    } else if (keymatch(arg, "threads", 2)) {
+      /* set maximum number of threads */
+      int val;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%d", &val) != 1 || val < 1)
+        usage();
+      jpeg_d_set_int_param(cinfo, JINT_NUM_THREADS, val);
+
     } else if (keymatch(arg, "targa", 1)) {
       /* Targa output format. */
       requested_fmt = FMT_TARGA;
@@ -475,6 +475,28 @@ public final class TJ {
   public static final int CS_YCCK = 4;
 
 
+  /**
+   * The number of tuning presets
+   */
+  public static final int NUMTUNE = 4;
+  /**
+   * Tune the quantization tables and trellis quantization for PSNR
+   */
+  public static final int TUNE_PSNR = 0;
+  /**
+   * Tune the quantization tables and trellis quantization for PSNR-HVS
+   */
+  public static final int TUNE_HVSPSNR = 1;
+  /**
+   * Tune the quantization tables and trellis quantization for SSIM
+   */
+  public static final int TUNE_SSIM = 2;
+  /**
+   * Tune the quantization tables and trellis quantization for MS-SSIM
+   */
+  public static final int TUNE_MSSSIM = 3;
+
+
   /**
    * Error handling behavior
    *
@@ -928,6 +950,136 @@ public final class TJ {
    * </ul>
    */
   public static final int PARAM_MAXPIXELS = 24;
+  /**
+   * Trellis quantization [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> <i>[default]</i> Quantize DCT coefficients by
+   * rounding.
+   * <li> <code>1</code> Use trellis quantization, which chooses the quantized
+   * values that minimize a rate-distortion cost.  This produces smaller JPEG
+   * images at the expense of compression speed.  Trellis quantization
+   * implies {@link #PARAM_OPTIMIZE}.
+   * </ul>
+   */
+  public static final int PARAM_TRELLIS = 25;
+  /**
+   * Trellis quantization of DC coefficients [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> Quantize DC coefficients by rounding.
+   * <li> <code>1</code> <i>[default]</i> Include DC coefficients in trellis
+   * quantization.  This has no effect unless {@link #PARAM_TRELLIS} is set.
+   * </ul>
+   */
+  public static final int PARAM_TRELLISDC = 26;
+  /**
+   * Trellis quantization speed level [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> to <code>10</code> The trellis search is pruned more
+   * aggressively for higher levels and for larger images.  <code>0</code>
+   * disables pruning. <i>[default: <code>7</code>]</i>
+   * </ul>
+   */
+  public static final int PARAM_TRELLISSPEED = 27;
+  /**
+   * Number of trellis quantization passes [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> number of times trellis quantization is repeated in order to refine
+   * the Huffman tables on which its rate estimates are based <i>[default:
+   * <code>1</code>]</i>
+   * </ul>
+   */
+  public static final int PARAM_TRELLISLOOPS = 28;
+  /**
+   * Progressive scan optimization [progressive lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> <i>[default]</i> Use the standard progressive scan
+   * script.
+   * <li> <code>1</code> Try several candidate scan scripts and use the one
+   * that produces the smallest JPEG image.  This has no effect unless
+   * {@link #PARAM_PROGRESSIVE} is set.
+   * </ul>
+   */
+  public static final int PARAM_OPTIMIZESCANS = 29;
+  /**
+   * DC scan optimization mode [progressive lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> <i>[default]</i> Encode the DC coefficients of all
+   * components in one scan.
+   * <li> <code>1</code> Encode the DC coefficients of each component in a
+   * separate scan.
+   * <li> <code>2</code> Choose between one DC scan for all components and one
+   * DC scan for the first component plus one for the remaining components.
+   * </ul>
+   *
+   * <p>This parameter has no effect unless {@link #PARAM_OPTIMIZESCANS} is
+   * set.
+   */
+  public static final int PARAM_DCSCANOPT = 30;
+  /**
+   * Overshoot deringing [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>0</code> <i>[default]</i> Compress the source image as-is.
+   * <li> <code>1</code> Reduce ringing artifacts around black text on a white
+   * background by allowing the DCT to overshoot the valid sample range.
+   * </ul>
+   */
+  public static final int PARAM_OVERSHOOT = 31;
+  /**
+   * Quality metric for which the quantization tables and trellis quantization
+   * are tuned [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>-1</code> <i>[default]</i> Use the default quantization tables
+   * and trellis quantization parameters.
+   * <li> one of the {@link #TUNE_PSNR tuning presets}
+   * </ul>
+   */
+  public static final int PARAM_TUNE = 32;
+  /**
+   * Base quantization table [lossy compression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> <code>-1</code> <i>[default]</i> Use the quantization tables selected
+   * by {@link #PARAM_TUNE}.
+   * <li> <code>0</code> to <code>8</code> Use the specified built-in
+   * quantization table set (see the description of the
+   * <code>-quant-table</code> option in usage.txt.)
+   * </ul>
+   */
+  public static final int PARAM_QUANTTABLE = 33;
+  /**
+   * Number of threads [lossy compression and decompression only]
+   *
+   * <p><b>Value</b>
+   * <ul>
+   * <li> maximum number of threads used for trellis quantization, for
+   * progressive scan optimization, and for encoding the restart intervals of
+   * baseline JPEG images, or for entropy decoding of single-scan Huffman-coded
+   * sequential JPEG images
+   * <i>[default: <code>1</code>]</i>
+   * </ul>
+   * <p>
+   * The JPEG or packed-pixel image is the same regardless of the number of
+   * threads.  Concurrent decompression does not occur if
+   * {@link #PARAM_MAXMEMORY} is set.
+   */
+  public static final int PARAM_THREADS = 34;
 
 
   /**
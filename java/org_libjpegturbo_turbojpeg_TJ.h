@@ -63,6 +63,16 @@ extern "C" {
 #define org_libjpegturbo_turbojpeg_TJ_CS_CMYK 3L
 #undef org_libjpegturbo_turbojpeg_TJ_CS_YCCK
 #define org_libjpegturbo_turbojpeg_TJ_CS_YCCK 4L
+#undef org_libjpegturbo_turbojpeg_TJ_NUMTUNE
+#define org_libjpegturbo_turbojpeg_TJ_NUMTUNE 4L
+#undef org_libjpegturbo_turbojpeg_TJ_TUNE_PSNR
+#define org_libjpegturbo_turbojpeg_TJ_TUNE_PSNR 0L
+#undef org_libjpegturbo_turbojpeg_TJ_TUNE_HVSPSNR
+#define org_libjpegturbo_turbojpeg_TJ_TUNE_HVSPSNR 1L
+#undef org_libjpegturbo_turbojpeg_TJ_TUNE_SSIM
+#define org_libjpegturbo_turbojpeg_TJ_TUNE_SSIM 2L
+#undef org_libjpegturbo_turbojpeg_TJ_TUNE_MSSSIM
+#define org_libjpegturbo_turbojpeg_TJ_TUNE_MSSSIM 3L
 #undef org_libjpegturbo_turbojpeg_TJ_PARAM_STOPONWARNING
 #define org_libjpegturbo_turbojpeg_TJ_PARAM_STOPONWARNING 0L
 #undef org_libjpegturbo_turbojpeg_TJ_PARAM_BOTTOMUP
@@ -111,6 +121,26 @@ extern "C" {
 #define org_libjpegturbo_turbojpeg_TJ_PARAM_MAXMEMORY 23L
 #undef org_libjpegturbo_turbojpeg_TJ_PARAM_MAXPIXELS
 #define org_libjpegturbo_turbojpeg_TJ_PARAM_MAXPIXELS 24L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLIS
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLIS 25L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLISDC
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLISDC 26L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLISSPEED
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLISSPEED 27L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLISLOOPS
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_TRELLISLOOPS 28L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_OPTIMIZESCANS
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_OPTIMIZESCANS 29L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_DCSCANOPT
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_DCSCANOPT 30L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_OVERSHOOT
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_OVERSHOOT 31L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_TUNE
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_TUNE 32L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_QUANTTABLE
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_QUANTTABLE 33L
+#undef org_libjpegturbo_turbojpeg_TJ_PARAM_THREADS
+#define org_libjpegturbo_turbojpeg_TJ_PARAM_THREADS 34L
 #undef org_libjpegturbo_turbojpeg_TJ_FLAG_BOTTOMUP
 #define org_libjpegturbo_turbojpeg_TJ_FLAG_BOTTOMUP 2L
 #undef org_libjpegturbo_turbojpeg_TJ_FLAG_FASTUPSAMPLE
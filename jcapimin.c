@@ -107,6 +107,7 @@ jpeg_CreateCompress(j_compress_ptr cinfo, int version, size_t structsize)
   #if BITS_IN_JSAMPLE == 8
   cinfo->master->compress_profile = JCP_MAX_COMPRESSION;
   #endif
+  cinfo->master->num_threads = 1;
 }
 
 
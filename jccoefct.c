@@ -19,6 +19,7 @@
 #include "jpeglib.h"
 #include "jsamplecomp.h"
 #include "jchuff.h"
+#include "jthread.h"
 
 /* We use a full-image coefficient buffer when doing Huffman optimization,
  * and also for writing multiple-scan JPEG files.  In all cases, the DCT
@@ -34,6 +35,19 @@
 #endif
 
 
+/* Trellis quantization of the AC coefficients of one block row, used for
+ * multi-threaded trellis quantization.
+ */
+
+typedef struct {
+  JBLOCKROW coef_row;           /* quantized coefficients (output) */
+  JBLOCKROW src_row;            /* unquantized coefficients */
+  JDIMENSION num_blocks;
+  const trellis_rates *rates;
+  int qtblno;
+} trellis_row_job;
+
+
 /* Private buffer controller object */
 
 typedef struct {
@@ -58,6 +72,26 @@ typedef struct {
   /* when using trellis quantization, need to keep a copy of all unquantized coefficients */
   jvirt_barray_ptr whole_image_uq[MAX_COMPONENTS];
 
+  /* workspace for trellis quantization */
+  trellis_context *trellis_ctx;
+  trellis_rates *trellis_rates; /* Huffman code lengths for each component
+                                   in the scan (Huffman coding only) */
+
+  /* when using multiple threads for trellis quantization, the AC coefficients
+   * of all block rows in the scan are quantized at the start of each trellis
+   * pass, and only the DC chain is left for the per-iMCU-row processing */
+  trellis_row_job *trellis_rows; /* workspace for the AC quantization */
+  trellis_context **trellis_band_ctx; /* workspace for each band of rows */
+  int num_trellis_bands;
+  boolean trellis_ac_done;      /* TRUE if the AC coefs have been quantized */
+
+  /* when using multiple threads for the first pass, the input data of a batch
+   * of iMCU rows is buffered, and the rows are DCT'd concurrently */
+  _JSAMPARRAY dct_batch[MAX_COMPONENTS]; /* buffered input data */
+  struct jpeg_forward_dct **dct_fdct; /* FDCT controller for each row */
+  int dct_batch_rows;           /* max. # of iMCU rows in a batch (0=unused) */
+  int dct_batch_count;          /* # of iMCU rows in the current batch */
+
 } my_coef_controller;
 
 typedef my_coef_controller *my_coef_ptr;
@@ -107,6 +141,12 @@ METHODDEF(void)
 start_pass_coef(j_compress_ptr cinfo, J_BUF_MODE pass_mode)
 {
   my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+#if BITS_IN_JSAMPLE == 8
+  int i;
+  c_derived_tbl dctbl_data, actbl_data;
+  c_derived_tbl *dctbl = &dctbl_data, *actbl = &actbl_data;
+  jpeg_component_info *compptr;
+#endif
 
   coef->iMCU_row_num = 0;
   start_iMCU_row(cinfo);
@@ -122,6 +162,17 @@ start_pass_coef(j_compress_ptr cinfo, J_BUF_MODE pass_mode)
     if (coef->whole_image[0] == NULL)
       ERREXIT(cinfo, JERR_BAD_BUFFER_MODE);
     coef->pub._compress_data = compress_first_pass;
+    coef->dct_batch_count = 0;
+    if (coef->dct_batch_rows > 0) {
+      struct jpeg_forward_dct *fdct = cinfo->fdct;
+      int row;
+
+      for (row = 0; row < coef->dct_batch_rows; row++) {
+        cinfo->fdct = coef->dct_fdct[row];
+        (*cinfo->fdct->start_pass) (cinfo);
+      }
+      cinfo->fdct = fdct;
+    }
     break;
   case JBUF_CRANK_DEST:
     if (coef->whole_image[0] == NULL)
@@ -134,6 +185,17 @@ start_pass_coef(j_compress_ptr cinfo, J_BUF_MODE pass_mode)
     if (coef->whole_image[0] == NULL)
       ERREXIT(cinfo, JERR_BAD_BUFFER_MODE);
     coef->pub.compress_data = compress_trellis_pass;
+    jstart_trellis_context(cinfo, coef->trellis_ctx);
+    for (i = 0; i < coef->num_trellis_bands; i++)
+      jstart_trellis_context(cinfo, coef->trellis_band_ctx[i]);
+    if (!cinfo->arith_code) {
+      for (i = 0; i < cinfo->comps_in_scan; i++) {
+        compptr = cinfo->cur_comp_info[i];
+        jpeg_make_c_derived_tbl(cinfo, TRUE, compptr->dc_tbl_no, &dctbl);
+        jpeg_make_c_derived_tbl(cinfo, FALSE, compptr->ac_tbl_no, &actbl);
+        jpeg_make_trellis_rates(dctbl, actbl, &coef->trellis_rates[i]);
+      }
+    }
     break;
 #endif
       
@@ -189,7 +251,7 @@ compress_data(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
         for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
           if (coef->iMCU_row_num < last_iMCU_row ||
               yoffset + yindex < compptr->last_row_height) {
-            (*cinfo->fdct->_forward_DCT) (cinfo, compptr,
+            (*cinfo->fdct->_forward_DCT) (cinfo, cinfo->fdct, compptr,
                                           input_buf[compptr->component_index],
                                           coef->MCU_buffer[blkn],
                                           ypos, xpos, (JDIMENSION)blockcnt,
@@ -239,54 +301,28 @@ compress_data(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
 #ifdef FULL_COEF_BUFFER_SUPPORTED
 
 /*
- * Process some data in the first pass of a multi-pass case.
- * We process the equivalent of one fully interleaved MCU row ("iMCU" row)
- * per call, ie, v_samp_factor block rows for each component in the image.
- * This amount of data is read from the source buffer, DCT'd and quantized,
- * and saved into the virtual arrays.  We also generate suitable dummy blocks
- * as needed at the right and lower edges.  (The dummy blocks are constructed
- * in the virtual arrays, which have been padded appropriately.)  This makes
- * it possible for subsequent passes not to worry about real vs. dummy blocks.
- *
- * We must also emit the data to the entropy encoder.  This is conveniently
- * done by calling compress_output() after we've loaded the current strip
- * of the virtual arrays.
- *
- * NB: input_buf contains a plane for each component in image.  All
- * components are DCT'd and loaded into the virtual arrays in this pass.
- * However, it may be that only a subset of the components are emitted to
- * the entropy encoder during this first pass; be careful about looking
- * at the scan-dependent variables (MCU dimensions, etc).
+ * DCT and quantize one iMCU row of input data into the virtual arrays, using
+ * the forward DCT controller fdct, and generate the dummy blocks at the right
+ * and lower edges.  buffer[ci] and buffer_dst[ci] point to the first block row
+ * of the iMCU row in the virtual arrays of component ci.
  */
 
-METHODDEF(boolean)
-compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
+LOCAL(void)
+forward_DCT_iMCU_row(j_compress_ptr cinfo, struct jpeg_forward_dct *fdct,
+                     JDIMENSION iMCU_row_num, _JSAMPIMAGE input_buf,
+                     JBLOCKARRAY *buffer, JBLOCKARRAY *buffer_dst)
 {
-  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
   JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
   JDIMENSION blocks_across, MCUs_across, MCUindex;
   int bi, ci, h_samp_factor, block_row, block_rows, ndummy;
   JCOEF lastDC;
   jpeg_component_info *compptr;
-  JBLOCKARRAY buffer;
   JBLOCKROW thisblockrow, lastblockrow;
-  JBLOCKARRAY buffer_dst;
 
   for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
        ci++, compptr++) {
-    /* Align the virtual buffer for this component. */
-    buffer = (*cinfo->mem->access_virt_barray)
-      ((j_common_ptr)cinfo, coef->whole_image[ci],
-       coef->iMCU_row_num * compptr->v_samp_factor,
-       (JDIMENSION)compptr->v_samp_factor, TRUE);
-    
-    buffer_dst = (*cinfo->mem->access_virt_barray)
-      ((j_common_ptr) cinfo, coef->whole_image_uq[ci],
-       coef->iMCU_row_num * compptr->v_samp_factor,
-       (JDIMENSION)compptr->v_samp_factor, TRUE);
-    
     /* Count non-dummy DCT block rows in this iMCU row. */
-    if (coef->iMCU_row_num < last_iMCU_row)
+    if (iMCU_row_num < last_iMCU_row)
       block_rows = compptr->v_samp_factor;
     else {
       /* NB: can't use last_row_height here, since may not be set! */
@@ -303,12 +339,11 @@ compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
      * on forward_DCT processes a complete horizontal row of DCT blocks.
      */
     for (block_row = 0; block_row < block_rows; block_row++) {
-      thisblockrow = buffer[block_row];
-      (*cinfo->fdct->_forward_DCT) (cinfo, compptr,
-                                    input_buf[ci], thisblockrow,
-                                    (JDIMENSION)(block_row * DCTSIZE),
-                                    (JDIMENSION)0, blocks_across,
-                                    buffer_dst[block_row]);
+      thisblockrow = buffer[ci][block_row];
+      (*fdct->_forward_DCT) (cinfo, fdct, compptr, input_buf[ci],
+                             thisblockrow, (JDIMENSION)(block_row * DCTSIZE),
+                             (JDIMENSION)0, blocks_across,
+                             buffer_dst[ci][block_row]);
       if (ndummy > 0) {
         /* Create dummy blocks at the right edge of the image. */
         thisblockrow += blocks_across; /* => first dummy block */
@@ -324,13 +359,13 @@ compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
      * of the dummy blocks to match the last real block's DC value.
      * This squeezes a few more bytes out of the resulting file...
      */
-    if (coef->iMCU_row_num == last_iMCU_row) {
+    if (iMCU_row_num == last_iMCU_row) {
       blocks_across += ndummy;  /* include lower right corner */
       MCUs_across = blocks_across / h_samp_factor;
       for (block_row = block_rows; block_row < compptr->v_samp_factor;
            block_row++) {
-        thisblockrow = buffer[block_row];
-        lastblockrow = buffer[block_row - 1];
+        thisblockrow = buffer[ci][block_row];
+        lastblockrow = buffer[ci][block_row - 1];
         jzero_far((void *)thisblockrow,
                   (size_t)(blocks_across * sizeof(JBLOCK)));
         for (MCUindex = 0; MCUindex < MCUs_across; MCUindex++) {
@@ -344,6 +379,174 @@ compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
       }
     }
   }
+}
+
+
+/* The thread pool is created when it is first needed and kept for the rest of
+ * the image, so that the threads are not recreated for each pass.
+ * jpeg_abort() destroys it.
+ */
+
+LOCAL(jthread_pool *)
+get_thread_pool(j_compress_ptr cinfo)
+{
+  if (cinfo->master->thread_pool == NULL)
+    cinfo->master->thread_pool =
+      jthread_pool_create(cinfo->master->num_threads);
+  return cinfo->master->thread_pool;
+}
+
+
+/*
+ * Multi-threaded first pass.
+ *
+ * The DCT of an iMCU row does not depend on any other iMCU row.  Thus, when
+ * more than one thread is allowed and the first pass only gathers statistics,
+ * compress_first_pass() copies each iMCU row of input data into a batch
+ * buffer, and once the batch is full (or the image is complete), the rows of
+ * the batch are DCT'd concurrently, each with its own forward DCT controller
+ * (the controllers keep their work areas in the controller object.)  The rows
+ * are then passed to the entropy encoder serially, in the same order as in
+ * single-threaded mode, so the output is the same.
+ */
+
+#define DCT_BATCH_ROWS_PER_THREAD  4
+
+typedef struct {
+  j_compress_ptr cinfo;
+  JDIMENSION start_row;         /* iMCU row # of the first row of the batch */
+  JBLOCKARRAY buffer[MAX_COMPONENTS];
+  JBLOCKARRAY buffer_dst[MAX_COMPONENTS];
+} dct_batch_work;
+
+
+METHODDEF(void)
+forward_DCT_batch_row(void *arg, int row)
+{
+  dct_batch_work *work = (dct_batch_work *)arg;
+  j_compress_ptr cinfo = work->cinfo;
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  _JSAMPARRAY input_buf[MAX_COMPONENTS];
+  JBLOCKARRAY buffer[MAX_COMPONENTS], buffer_dst[MAX_COMPONENTS];
+  int ci, v_samp_factor;
+
+  for (ci = 0; ci < cinfo->num_components; ci++) {
+    v_samp_factor = cinfo->comp_info[ci].v_samp_factor;
+    input_buf[ci] = coef->dct_batch[ci] + row * v_samp_factor * DCTSIZE;
+    buffer[ci] = work->buffer[ci] + row * v_samp_factor;
+    buffer_dst[ci] = work->buffer_dst[ci] + row * v_samp_factor;
+  }
+  forward_DCT_iMCU_row(cinfo, coef->dct_fdct[row],
+                       work->start_row + (JDIMENSION)row, input_buf, buffer,
+                       buffer_dst);
+}
+
+
+/* DCT the batched iMCU rows, and pass them to the entropy encoder. */
+
+LOCAL(void)
+flush_dct_batch(j_compress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  jthread_pool *pool = get_thread_pool(cinfo);
+  dct_batch_work work;
+  int ci, row;
+  jpeg_component_info *compptr;
+
+  work.cinfo = cinfo;
+  work.start_row = coef->iMCU_row_num;
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    work.buffer[ci] = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image[ci],
+       work.start_row * compptr->v_samp_factor,
+       (JDIMENSION)(coef->dct_batch_count * compptr->v_samp_factor), TRUE);
+    work.buffer_dst[ci] = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image_uq[ci],
+       work.start_row * compptr->v_samp_factor,
+       (JDIMENSION)(coef->dct_batch_count * compptr->v_samp_factor), TRUE);
+  }
+
+  if (pool != NULL)
+    jthread_pool_run(pool, forward_DCT_batch_row, &work,
+                     coef->dct_batch_count);
+  else {
+    for (row = 0; row < coef->dct_batch_count; row++)
+      forward_DCT_batch_row(&work, row);
+  }
+
+  /* compress_output() increments iMCU_row_num.  The entropy encoder only
+   * gathers statistics, so it cannot suspend.
+   */
+  for (row = 0; row < coef->dct_batch_count; row++) {
+    if (!compress_output(cinfo, NULL))
+      ERREXIT(cinfo, JERR_CANT_SUSPEND);
+  }
+  coef->dct_batch_count = 0;
+}
+
+
+/*
+ * Process some data in the first pass of a multi-pass case.
+ * We process the equivalent of one fully interleaved MCU row ("iMCU" row)
+ * per call, ie, v_samp_factor block rows for each component in the image.
+ * This amount of data is read from the source buffer, DCT'd and quantized,
+ * and saved into the virtual arrays.  We also generate suitable dummy blocks
+ * as needed at the right and lower edges.  (The dummy blocks are constructed
+ * in the virtual arrays, which have been padded appropriately.)  This makes
+ * it possible for subsequent passes not to worry about real vs. dummy blocks.
+ *
+ * We must also emit the data to the entropy encoder.  This is conveniently
+ * done by calling compress_output() after we've loaded the current strip
+ * of the virtual arrays.
+ *
+ * NB: input_buf contains a plane for each component in image.  All
+ * components are DCT'd and loaded into the virtual arrays in this pass.
+ * However, it may be that only a subset of the components are emitted to
+ * the entropy encoder during this first pass; be careful about looking
+ * at the scan-dependent variables (MCU dimensions, etc).
+ */
+
+METHODDEF(boolean)
+compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  int ci;
+  jpeg_component_info *compptr;
+  JBLOCKARRAY buffer[MAX_COMPONENTS];
+  JBLOCKARRAY buffer_dst[MAX_COMPONENTS];
+
+  if (coef->dct_batch_rows > 0) {
+    /* Add the input rows to the batch (see above.) */
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+         ci++, compptr++) {
+      _jcopy_sample_rows(input_buf[ci], 0, coef->dct_batch[ci],
+                         coef->dct_batch_count * compptr->v_samp_factor *
+                         DCTSIZE, compptr->v_samp_factor * DCTSIZE,
+                         compptr->width_in_blocks * DCTSIZE);
+    }
+    coef->dct_batch_count++;
+    if (coef->dct_batch_count == coef->dct_batch_rows ||
+        coef->iMCU_row_num + coef->dct_batch_count == cinfo->total_iMCU_rows)
+      flush_dct_batch(cinfo);
+    return TRUE;
+  }
+
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    /* Align the virtual buffer for this component. */
+    buffer[ci] = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image[ci],
+       coef->iMCU_row_num * compptr->v_samp_factor,
+       (JDIMENSION)compptr->v_samp_factor, TRUE);
+    
+    buffer_dst[ci] = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr) cinfo, coef->whole_image_uq[ci],
+       coef->iMCU_row_num * compptr->v_samp_factor,
+       (JDIMENSION)compptr->v_samp_factor, TRUE);
+  }
+  forward_DCT_iMCU_row(cinfo, cinfo->fdct, coef->iMCU_row_num, input_buf,
+                       buffer, buffer_dst);
   /* NB: compress_output will increment iMCU_row_num if successful.
    * A suspension return will result in redoing all the work above next time.
    */
@@ -353,6 +556,103 @@ compress_first_pass(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
 }
 
 #if BITS_IN_JSAMPLE == 8
+
+/*
+ * Multi-threaded trellis quantization.
+ *
+ * The AC coefficients of a block row can be trellis-quantized independently
+ * of all other block rows.  Thus, when more than one thread is allowed, the
+ * AC coefficients of every block row in the scan are quantized up front, by
+ * splitting the block rows into bands that are processed on a thread pool.
+ * The DC chain and the quantization table statistics are then resolved
+ * serially, one iMCU row at a time, by compress_trellis_pass(), in the same
+ * order as in single-threaded mode.  The output is therefore identical
+ * regardless of the number of threads.
+ */
+
+#define TRELLIS_BANDS_PER_THREAD  4
+
+typedef struct {
+  j_compress_ptr cinfo;
+  trellis_row_job *rows;
+  int num_rows;
+  int num_bands;
+  trellis_context **band_ctx;
+} trellis_ac_work;
+
+
+METHODDEF(void)
+trellis_ac_band(void *arg, int band)
+{
+  trellis_ac_work *work = (trellis_ac_work *)arg;
+  int row = (int)((long)band * work->num_rows / work->num_bands);
+  int end_row = (int)((long)(band + 1) * work->num_rows / work->num_bands);
+  trellis_row_job *job;
+
+  for (; row < end_row; row++) {
+    job = &work->rows[row];
+    quantize_trellis_ac(work->cinfo, work->band_ctx[band], job->rates,
+                        job->coef_row, job->src_row, job->num_blocks,
+                        job->qtblno);
+  }
+}
+
+
+/* Quantize the AC coefficients of all block rows in the current scan.
+ * Returns FALSE if this was not done and compress_trellis_pass() must do the
+ * whole job.
+ */
+
+LOCAL(boolean)
+trellis_ac_all_rows(j_compress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  trellis_ac_work work;
+  jthread_pool *pool;
+  int ci, block_row;
+  jpeg_component_info *compptr;
+  JBLOCKARRAY buffer, buffer_dst;
+
+  if (coef->trellis_rows == NULL || cinfo->arith_code)
+    return FALSE;
+
+  work.cinfo = cinfo;
+  work.rows = coef->trellis_rows;
+  work.band_ctx = coef->trellis_band_ctx;
+  work.num_rows = 0;
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+
+    buffer = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image[compptr->component_index],
+       0, compptr->height_in_blocks, TRUE);
+    buffer_dst = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image_uq[compptr->component_index],
+       0, compptr->height_in_blocks, TRUE);
+
+    for (block_row = 0; block_row < (int)compptr->height_in_blocks;
+         block_row++) {
+      trellis_row_job *job = &work.rows[work.num_rows++];
+
+      job->coef_row = buffer[block_row];
+      job->src_row = buffer_dst[block_row];
+      job->num_blocks = compptr->width_in_blocks;
+      job->rates = &coef->trellis_rates[ci];
+      job->qtblno = compptr->quant_tbl_no;
+    }
+  }
+
+  work.num_bands = MIN(work.num_rows, coef->num_trellis_bands);
+  if (work.num_bands < 2)
+    return FALSE;
+  pool = get_thread_pool(cinfo);
+  if (pool == NULL)
+    return FALSE;
+  jthread_pool_run(pool, trellis_ac_band, &work, work.num_bands);
+  return TRUE;
+}
+
+
 METHODDEF(boolean)
 compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
 {
@@ -366,12 +666,10 @@ compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
   JBLOCKROW thisblockrow, lastblockrow;
   JBLOCKARRAY buffer_dst;
 
+  if (coef->iMCU_row_num == 0)
+    coef->trellis_ac_done = trellis_ac_all_rows(cinfo);
+
   for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
-    c_derived_tbl dctbl_data;
-    c_derived_tbl *dctbl = &dctbl_data;
-    c_derived_tbl actbl_data;
-    c_derived_tbl *actbl = &actbl_data;
-    
 #ifdef C_ARITH_CODING_SUPPORTED
     arith_rates arith_r_data;
     arith_rates *arith_r = &arith_r_data;
@@ -382,12 +680,7 @@ compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
 #ifdef C_ARITH_CODING_SUPPORTED
     if (cinfo->arith_code)
       jget_arith_rates(cinfo, compptr->dc_tbl_no, compptr->ac_tbl_no, arith_r);
-    else
 #endif
-    {
-      jpeg_make_c_derived_tbl(cinfo, TRUE, compptr->dc_tbl_no, &dctbl);
-      jpeg_make_c_derived_tbl(cinfo, FALSE, compptr->ac_tbl_no, &actbl);
-    }
 
     /* Align the virtual buffer for this component. */
     buffer = (*cinfo->mem->access_virt_barray)
@@ -425,17 +718,25 @@ compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
       lastblockrow = (block_row > 0) ? buffer[block_row-1] : NULL;
 #ifdef C_ARITH_CODING_SUPPORTED
       if (cinfo->arith_code)
-        quantize_trellis_arith(cinfo, arith_r, thisblockrow,
+        quantize_trellis_arith(cinfo, coef->trellis_ctx, arith_r, thisblockrow,
                                buffer_dst[block_row], blocks_across,
-                               cinfo->quant_tbl_ptrs[compptr->quant_tbl_no],
+                               compptr->quant_tbl_no,
                                cinfo->master->norm_src[compptr->quant_tbl_no],
                                cinfo->master->norm_coef[compptr->quant_tbl_no],
                                &lastDC, lastblockrow, buffer_dst[block_row-1]);
       else
 #endif
-        quantize_trellis(cinfo, dctbl, actbl, thisblockrow,
-                         buffer_dst[block_row], blocks_across,
-                         cinfo->quant_tbl_ptrs[compptr->quant_tbl_no],
+      if (coef->trellis_ac_done)
+        quantize_trellis_dc(cinfo, coef->trellis_ctx, &coef->trellis_rates[ci],
+                            thisblockrow, buffer_dst[block_row], blocks_across,
+                            compptr->quant_tbl_no,
+                            cinfo->master->norm_src[compptr->quant_tbl_no],
+                            cinfo->master->norm_coef[compptr->quant_tbl_no],
+                            &lastDC, lastblockrow, buffer_dst[block_row-1]);
+      else
+        quantize_trellis(cinfo, coef->trellis_ctx, &coef->trellis_rates[ci],
+                         thisblockrow, buffer_dst[block_row], blocks_across,
+                         compptr->quant_tbl_no,
                          cinfo->master->norm_src[compptr->quant_tbl_no],
                          cinfo->master->norm_coef[compptr->quant_tbl_no],
                          &lastDC, lastblockrow, buffer_dst[block_row-1]);
@@ -476,6 +777,16 @@ compress_trellis_pass (j_compress_ptr cinfo, JSAMPIMAGE input_buf)
     }
   }
 
+  /* jcmaster.c reports the totals once the trellis passes are done */
+  if (coef->iMCU_row_num == last_iMCU_row && !cinfo->arith_code) {
+    jget_trellis_stats(coef->trellis_ctx, &cinfo->master->trellis_num_blocks,
+                       &cinfo->master->trellis_num_bypassed);
+    for (ci = 0; ci < coef->num_trellis_bands; ci++)
+      jget_trellis_stats(coef->trellis_band_ctx[ci],
+                         &cinfo->master->trellis_num_blocks,
+                         &cinfo->master->trellis_num_bypassed);
+  }
+
   /* NB: compress_output will increment iMCU_row_num if successful.
    * A suspension return will result in redoing all the work above next time.
    */
@@ -506,6 +817,16 @@ compress_output(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
   JBLOCKROW buffer_ptr;
   jpeg_component_info *compptr;
 
+  /* When jcmaster.c estimates the size of a candidate scan from a sample of
+   * the image, feed only every n-th iMCU row to the entropy encoder.
+   */
+  if (cinfo->master->scan_sample_interval > 1 &&
+      coef->iMCU_row_num % cinfo->master->scan_sample_interval != 0) {
+    coef->iMCU_row_num++;
+    start_iMCU_row(cinfo);
+    return TRUE;
+  }
+
   /* Align the virtual buffers for the components used in this scan.
    * NB: during first pass, this is safe only because the buffers will
    * already be aligned properly, so jmemmgr.c won't need to do any I/O.
@@ -552,6 +873,74 @@ compress_output(j_compress_ptr cinfo, _JSAMPIMAGE input_buf)
   return TRUE;
 }
 
+
+/*
+ * Feed num_MCUs MCUs of the current scan, starting with MCU number start_MCU
+ * (in raster order), to the entropy encoder.  This does the same as (part of)
+ * a JBUF_CRANK_DEST pass, but it keeps its position in local variables, so it
+ * can run concurrently for several scans or parts of a scan on private copies
+ * of the compression object.  In that case, the virtual arrays must be fully
+ * resident in memory (see jinit_c_coef_controller()), so that accessing them
+ * does no I/O.  The callers encode into memory destinations, which cannot
+ * suspend.
+ */
+
+METHODDEF(void)
+encode_scan(j_compress_ptr cinfo, JDIMENSION start_MCU, JDIMENSION num_MCUs)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  JDIMENSION MCU_num, MCU_row_num, MCU_col_num, iMCU_row_num;
+  JDIMENSION buffer_iMCU_row = 0;
+  int blkn, ci, xindex, yindex, yoffset;
+  boolean have_buffer = FALSE;
+  JDIMENSION start_col;
+  JBLOCKARRAY buffer[MAX_COMPS_IN_SCAN];
+  JBLOCKROW MCU_buffer[C_MAX_BLOCKS_IN_MCU];
+  JBLOCKROW buffer_ptr;
+  jpeg_component_info *compptr;
+
+  for (MCU_num = start_MCU; MCU_num < start_MCU + num_MCUs; MCU_num++) {
+    MCU_row_num = MCU_num / cinfo->MCUs_per_row;
+    MCU_col_num = MCU_num % cinfo->MCUs_per_row;
+    /* In a noninterleaved scan, an iMCU row has v_samp_factor MCU rows (see
+     * start_iMCU_row().)
+     */
+    if (cinfo->comps_in_scan > 1) {
+      iMCU_row_num = MCU_row_num;
+      yoffset = 0;
+    } else {
+      iMCU_row_num = MCU_row_num / cinfo->cur_comp_info[0]->v_samp_factor;
+      yoffset = (int)(MCU_row_num % cinfo->cur_comp_info[0]->v_samp_factor);
+    }
+
+    if (!have_buffer || iMCU_row_num != buffer_iMCU_row) {
+      for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+        compptr = cinfo->cur_comp_info[ci];
+        buffer[ci] = (*cinfo->mem->access_virt_barray)
+          ((j_common_ptr)cinfo, coef->whole_image[compptr->component_index],
+           iMCU_row_num * compptr->v_samp_factor,
+           (JDIMENSION)compptr->v_samp_factor, FALSE);
+      }
+      buffer_iMCU_row = iMCU_row_num;
+      have_buffer = TRUE;
+    }
+
+    blkn = 0;
+    for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+      compptr = cinfo->cur_comp_info[ci];
+      start_col = MCU_col_num * compptr->MCU_width;
+      for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
+        buffer_ptr = buffer[ci][yindex + yoffset] + start_col;
+        for (xindex = 0; xindex < compptr->MCU_width; xindex++) {
+          MCU_buffer[blkn++] = buffer_ptr++;
+        }
+      }
+    }
+    if (!(*cinfo->entropy->encode_mcu) (cinfo, MCU_buffer))
+      ERREXIT(cinfo, JERR_CANT_SUSPEND);
+  }
+}
+
 #endif /* FULL_COEF_BUFFER_SUPPORTED */
 
 
@@ -581,16 +970,90 @@ _jinit_c_coef_controller(j_compress_ptr cinfo, boolean need_full_buffer)
     /* padded to a multiple of samp_factor DCT blocks in each direction. */
     int ci;
     jpeg_component_info *compptr;
+    JDIMENSION maxaccess, max_blocks = 0;
+    boolean threaded_trellis = FALSE, threaded_scans;
+    long total_block_rows = 0;
+    int dct_batch_rows = 0;
+
+#if BITS_IN_JSAMPLE == 8
+    /* Multi-threaded trellis quantization needs access to all block rows of
+     * a component at once.
+     */
+    threaded_trellis = cinfo->master->trellis_quant &&
+                       cinfo->master->num_threads > 1;
+#endif
+    /* So do the concurrent trial encodes of candidate scans and the
+     * concurrent encodes of restart stripes in jcmaster.c, which must be able
+     * to read the arrays without any I/O.
+     */
+    threaded_scans = (cinfo->master->optimize_scans ||
+                      cinfo->restart_interval != 0 ||
+                      cinfo->restart_in_rows != 0) &&
+                     cinfo->master->num_threads > 1;
+
+    /* The first pass can be multi-threaded if it only gathers statistics
+     * (see compress_first_pass().)  The batches of iMCU rows must stay in
+     * memory while they are DCT'd.
+     */
+    if (cinfo->master->num_threads > 1 && !cinfo->arith_code &&
+        (cinfo->optimize_coding || cinfo->master->trellis_quant))
+      dct_batch_rows = cinfo->master->num_threads * DCT_BATCH_ROWS_PER_THREAD;
+
+    /* Neither a batch of iMCU rows nor a concurrently encoded scan can be
+     * resumed after a suspension, so those are only used with the library's
+     * own destination managers, which never suspend.  Other destinations get
+     * the serial code paths.
+     */
+    if (cinfo->dest != cinfo->master->nonsuspending_dest) {
+      threaded_scans = FALSE;
+      dct_batch_rows = 0;
+    }
+
+    /* The memory manager keeps as many block rows in memory as are accessed
+     * at once, regardless of max_memory_to_use.  If the arrays do not fit in
+     * that limit, use the serial code paths, which access one iMCU row at a
+     * time.
+     */
+    if ((threaded_trellis || threaded_scans || dct_batch_rows > 0) &&
+        cinfo->mem->max_memory_to_use != 0) {
+      size_t array_size = 0;
+
+      for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+           ci++, compptr++)
+        array_size += 2 * sizeof(JBLOCK) *
+                      (size_t)jround_up((long)compptr->width_in_blocks,
+                                        (long)compptr->h_samp_factor) *
+                      (size_t)jround_up((long)compptr->height_in_blocks,
+                                        (long)compptr->v_samp_factor);
+      if (array_size > (size_t)cinfo->mem->max_memory_to_use) {
+        threaded_trellis = threaded_scans = FALSE;
+        dct_batch_rows = 0;
+      }
+    }
+    cinfo->master->resident_coefs = threaded_scans;
 
     for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
          ci++, compptr++) {
+      max_blocks = MAX(max_blocks, compptr->width_in_blocks);
+      maxaccess = (JDIMENSION)compptr->v_samp_factor;
+      if (dct_batch_rows > 0)
+        maxaccess = (JDIMENSION)
+          MIN((long)dct_batch_rows * compptr->v_samp_factor,
+              jround_up((long) compptr->height_in_blocks,
+                        (long) compptr->v_samp_factor));
+      if (threaded_trellis || threaded_scans)
+        maxaccess = (JDIMENSION)jround_up((long) compptr->height_in_blocks,
+                                          (long) compptr->v_samp_factor);
+      if (threaded_trellis)
+        total_block_rows += compptr->height_in_blocks;
+
       coef->whole_image[ci] = (*cinfo->mem->request_virt_barray)
         ((j_common_ptr) cinfo, JPOOL_IMAGE, FALSE,
          (JDIMENSION)jround_up((long) compptr->width_in_blocks,
                                 (long) compptr->h_samp_factor),
          (JDIMENSION)jround_up((long) compptr->height_in_blocks,
                                 (long) compptr->v_samp_factor),
-         (JDIMENSION)compptr->v_samp_factor);
+         maxaccess);
       
       coef->whole_image_uq[ci] = (*cinfo->mem->request_virt_barray)
         ((j_common_ptr) cinfo, JPOOL_IMAGE, FALSE,
@@ -598,8 +1061,54 @@ _jinit_c_coef_controller(j_compress_ptr cinfo, boolean need_full_buffer)
                                 (long) compptr->h_samp_factor),
          (JDIMENSION)jround_up((long) compptr->height_in_blocks,
                                 (long) compptr->v_samp_factor),
-         (JDIMENSION)compptr->v_samp_factor);
+         maxaccess);
+    }
+
+#if BITS_IN_JSAMPLE == 8
+    if (cinfo->master->trellis_quant) {
+      coef->trellis_ctx = jinit_trellis_context(cinfo, max_blocks, TRUE);
+      coef->trellis_rates = (trellis_rates *)
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    MAX_COMPS_IN_SCAN * sizeof(trellis_rates));
     }
+    if (threaded_trellis) {
+      coef->trellis_rows = (trellis_row_job *)
+        (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    total_block_rows * sizeof(trellis_row_job));
+      coef->num_trellis_bands =
+        cinfo->master->num_threads * TRELLIS_BANDS_PER_THREAD;
+      coef->trellis_band_ctx = (trellis_context **)
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    coef->num_trellis_bands *
+                                    sizeof(trellis_context *));
+      for (ci = 0; ci < coef->num_trellis_bands; ci++)
+        coef->trellis_band_ctx[ci] =
+          jinit_trellis_context(cinfo, max_blocks, FALSE);
+    }
+#endif
+    if (dct_batch_rows > 0) {
+      struct jpeg_forward_dct *fdct = cinfo->fdct;
+      int row;
+
+      for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+           ci++, compptr++) {
+        coef->dct_batch[ci] = (_JSAMPARRAY)(*cinfo->mem->alloc_sarray)
+          ((j_common_ptr)cinfo, JPOOL_IMAGE,
+           compptr->width_in_blocks * DCTSIZE,
+           (JDIMENSION)(dct_batch_rows * compptr->v_samp_factor * DCTSIZE));
+      }
+      coef->dct_fdct = (struct jpeg_forward_dct **)
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    dct_batch_rows *
+                                    sizeof(struct jpeg_forward_dct *));
+      for (row = 0; row < dct_batch_rows; row++) {
+        _jinit_forward_dct(cinfo);
+        coef->dct_fdct[row] = cinfo->fdct;
+      }
+      cinfo->fdct = fdct;
+      coef->dct_batch_rows = dct_batch_rows;
+    }
+    coef->pub.encode_scan = encode_scan;
 #else
     ERREXIT(cinfo, JERR_BAD_BUFFER_MODE);
 #endif
@@ -608,6 +1117,8 @@ _jinit_c_coef_controller(j_compress_ptr cinfo, boolean need_full_buffer)
     JBLOCKROW buffer;
     int i;
 
+    cinfo->master->resident_coefs = FALSE;
+
     buffer = (JBLOCKROW)
       (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
                                   C_MAX_BLOCKS_IN_MCU * sizeof(JBLOCK));
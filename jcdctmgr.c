@@ -87,6 +87,11 @@ typedef void (*float_convsamp_method_ptr) (_JSAMPARRAY sample_data,
 
 typedef void (*quantize_method_ptr) (JCOEFPTR coef_block, DCTELEM *divisors,
                                      DCTELEM *workspace);
+typedef void (*forward_DCT_row_method_ptr) (_JSAMPARRAY sample_data,
+                                            JDIMENSION start_col,
+                                            JDIMENSION num_blocks,
+                                            JBLOCKROW coef_blocks,
+                                            DCTELEM *divisors, JBLOCKROW dst);
 typedef void (*float_quantize_method_ptr) (JCOEFPTR coef_block,
                                            FAST_FLOAT *divisors,
                                            FAST_FLOAT *workspace);
@@ -102,6 +107,11 @@ typedef struct {
   preprocess_method_ptr preprocess;
   quantize_method_ptr quantize;
 
+  /* Optional routine that performs convsamp, DCT, and quantization for a
+   * whole row of blocks in one call (NULL if not available.)
+   */
+  forward_DCT_row_method_ptr dct_row;
+
   /* The actual post-DCT divisors --- not identical to the quant table
    * entries, because of scaling (especially for an unnormalized DCT).
    * Each table is given in normal array order.
@@ -117,6 +127,12 @@ typedef struct {
   float_convsamp_method_ptr float_convsamp;
   float_preprocess_method_ptr float_preprocess;
   float_quantize_method_ptr float_quantize;
+  /* Optional variants that process two adjacent blocks per call (NULL if not
+   * available.)  These use a workspace of 2 * DCTSIZE2 elements.
+   */
+  float_DCT_method_ptr float_dct_x2;
+  float_convsamp_method_ptr float_convsamp_x2;
+  float_quantize_method_ptr float_quantize_x2;
   FAST_FLOAT *float_divisors[NUM_QUANT_TBLS];
   FAST_FLOAT *float_workspace;
 #endif
@@ -319,8 +335,10 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
 #if BITS_IN_JSAMPLE == 8
 #ifdef WITH_SIMD
         if (!compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]) &&
-            fdct->quantize == jsimd_quantize)
+            fdct->quantize == jsimd_quantize) {
           fdct->quantize = quantize;
+          fdct->dct_row = NULL;
+        }
 #else
         compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]);
 #endif
@@ -734,14 +752,14 @@ quantize(JCOEFPTR coef_block, DCTELEM *divisors, DCTELEM *workspace)
  */
 
 METHODDEF(void)
-forward_DCT(j_compress_ptr cinfo, jpeg_component_info *compptr,
-            _JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
-            JDIMENSION start_row, JDIMENSION start_col, JDIMENSION num_blocks,
-            JBLOCKROW dst)
+forward_DCT(j_compress_ptr cinfo, struct jpeg_forward_dct *controller,
+            jpeg_component_info *compptr, _JSAMPARRAY sample_data,
+            JBLOCKROW coef_blocks, JDIMENSION start_row, JDIMENSION start_col,
+            JDIMENSION num_blocks, JBLOCKROW dst)
 /* This version is used for integer DCT implementations. */
 {
   /* This routine is heavily used, so it's worth coding it tightly. */
-  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  my_fdct_ptr fdct = (my_fdct_ptr)controller;
   DCTELEM *divisors = fdct->divisors[compptr->quant_tbl_no];
   JQUANT_TBL *qtbl = cinfo->quant_tbl_ptrs[compptr->quant_tbl_no];
   DCTELEM *workspace;
@@ -757,6 +775,12 @@ forward_DCT(j_compress_ptr cinfo, jpeg_component_info *compptr,
 
   sample_data += start_row;     /* fold in the vertical offset once */
 
+  if (fdct->dct_row != NULL) {
+    (*fdct->dct_row) (sample_data, start_col, num_blocks, coef_blocks,
+                      divisors, dst);
+    return;
+  }
+
   for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
     /* Load data into workspace, applying unsigned->signed conversion */
     (*do_convsamp) (sample_data, start_col, workspace);
@@ -872,18 +896,18 @@ quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
 
 
 METHODDEF(void)
-forward_DCT_float(j_compress_ptr cinfo, jpeg_component_info *compptr,
-                  _JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
-                  JDIMENSION start_row, JDIMENSION start_col,
-                  JDIMENSION num_blocks, JBLOCKROW dst)
+forward_DCT_float(j_compress_ptr cinfo, struct jpeg_forward_dct *controller,
+                  jpeg_component_info *compptr, _JSAMPARRAY sample_data,
+                  JBLOCKROW coef_blocks, JDIMENSION start_row,
+                  JDIMENSION start_col, JDIMENSION num_blocks, JBLOCKROW dst)
 /* This version is used for floating-point DCT implementations. */
 {
   /* This routine is heavily used, so it's worth coding it tightly. */
-  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  my_fdct_ptr fdct = (my_fdct_ptr)controller;
   FAST_FLOAT *divisors = fdct->float_divisors[compptr->quant_tbl_no];
   JQUANT_TBL *qtbl = cinfo->quant_tbl_ptrs[compptr->quant_tbl_no];
   FAST_FLOAT *workspace;
-  JDIMENSION bi;
+  JDIMENSION bi, nblocks, k;
   float v;
   int x;
   const int max_coef_bits = cinfo->data_precision + 2;
@@ -893,20 +917,39 @@ forward_DCT_float(j_compress_ptr cinfo, jpeg_component_info *compptr,
   float_convsamp_method_ptr do_convsamp = fdct->float_convsamp;
   float_preprocess_method_ptr do_preprocess = fdct->float_preprocess;
   float_quantize_method_ptr do_quantize = fdct->float_quantize;
+  float_DCT_method_ptr do_dct_x2 = fdct->float_dct_x2;
   workspace = fdct->float_workspace;
 
   sample_data += start_row;     /* fold in the vertical offset once */
 
-  for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
-    /* Load data into workspace, applying unsigned->signed conversion */
-    (*do_convsamp) (sample_data, start_col, workspace);
+  for (bi = 0; bi < num_blocks;
+       bi += nblocks, start_col += nblocks * DCTSIZE) {
+    if (do_dct_x2 != NULL && bi + 1 < num_blocks) {
+      /* Two adjacent blocks at a time: the second block occupies
+       * workspace[DCTSIZE2 .. 2 * DCTSIZE2 - 1] and coef_blocks[bi + 1].
+       */
+      nblocks = 2;
+      (*fdct->float_convsamp_x2) (sample_data, start_col, workspace);
 
-    if (do_preprocess) {
-      (*do_preprocess) (workspace, qtbl);
-    }
+      if (do_preprocess) {
+        (*do_preprocess) (workspace, qtbl);
+        (*do_preprocess) (workspace + DCTSIZE2, qtbl);
+      }
 
-    /* Perform the DCT */
-    (*do_dct) (workspace);
+      (*do_dct_x2) (workspace);
+    } else {
+      nblocks = 1;
+
+      /* Load data into workspace, applying unsigned->signed conversion */
+      (*do_convsamp) (sample_data, start_col, workspace);
+
+      if (do_preprocess) {
+        (*do_preprocess) (workspace, qtbl);
+      }
+
+      /* Perform the DCT */
+      (*do_dct) (workspace);
+    }
 
     /* Save unquantized transform coefficients for later trellis quantization */
     /* Currently save as integer values. Could save float values but would require */
@@ -919,28 +962,35 @@ forward_DCT_float(j_compress_ptr cinfo, jpeg_component_info *compptr,
         1.0, 0.785694958, 0.541196100, 0.275899379
       };
 
-      for (i = 0; i < DCTSIZE2; i++) {
-        v = workspace[i];
-        v /= aanscalefactor[i%8];
-        v /= aanscalefactor[i/8];
-        x = (v >= 0.0) ? (int)(v + 0.5) : (int)(v - 0.5);
-        dst[bi][i] = x;
+      for (k = 0; k < nblocks; k++) {
+        for (i = 0; i < DCTSIZE2; i++) {
+          v = workspace[k * DCTSIZE2 + i];
+          v /= aanscalefactor[i%8];
+          v /= aanscalefactor[i/8];
+          x = (v >= 0.0) ? (int)(v + 0.5) : (int)(v - 0.5);
+          dst[bi + k][i] = x;
+        }
       }
     }
 
     /* Quantize/descale the coefficients, and store into coef_blocks[] */
-    (*do_quantize) (coef_blocks[bi], divisors, workspace);
-    
+    if (nblocks == 2)
+      (*fdct->float_quantize_x2) (coef_blocks[bi], divisors, workspace);
+    else
+      (*do_quantize) (coef_blocks[bi], divisors, workspace);
+
     if (do_preprocess) {
       int i;
       int maxval = (1 << max_coef_bits) - 1;
-      for (i = 0; i < 64; i++) {
-        if (coef_blocks[bi][i] < -maxval)
-          coef_blocks[bi][i] = -maxval;
-        if (coef_blocks[bi][i] > maxval)
-          coef_blocks[bi][i] = maxval;
-  }
-}
+      for (k = bi; k < bi + nblocks; k++) {
+        for (i = 0; i < 64; i++) {
+          if (coef_blocks[k][i] < -maxval)
+            coef_blocks[k][i] = -maxval;
+          if (coef_blocks[k][i] > maxval)
+            coef_blocks[k][i] = maxval;
+        }
+      }
+    }
   }
 }
 
@@ -1124,20 +1174,6 @@ compute_block_lambda(j_compress_ptr cinfo, float lambda_base, float norm)
   return lambda;
 }
 
-/*
- * Compute Huffman coding cost for a DC coefficient difference.
- *
- * DC coefficients use differential coding, so we encode the difference
- * from the previous block's DC. The cost is: category_bits + huffman_code_length
- * where category_bits = JPEG_NBITS(|dc_delta|).
- */
-LOCAL(int)
-compute_dc_huffman_bits(int dc_delta, const c_derived_tbl *dctbl)
-{
-  int nbits = JPEG_NBITS(abs(dc_delta));
-  return nbits + dctbl->ehufsi[nbits];
-}
-
 /*
  * Compute Huffman coding cost for an AC coefficient.
  *
@@ -1209,8 +1245,9 @@ compute_distortion(int reconstructed, int original, float lambda, float weight)
  *     fn zrl_bits(&self) -> Option<f32>;  // None if not supported
  * }
  *
- * HUFFMAN IMPLEMENTATION (compute_dc_huffman_bits, compute_ac_huffman_bits):
- * - Stateless: just table lookups based on category
+ * HUFFMAN IMPLEMENTATION (trellis_rates, see jpeg_make_trellis_rates):
+ * - Stateless: just table lookups based on category, precomputed once per
+ *   pass so that the inner loops need neither calls nor branches
  * - dc_bits: ehufsi[nbits] + nbits
  * - ac_bits: ehufsi[16*run + nbits] + nbits (+ ZRL codes if run >= 16)
  * - eob_bits: ehufsi[0]
@@ -1456,18 +1493,18 @@ typedef struct {
  *   Ss, Se             - Scan range (start/end positions in zig-zag order)
  *   accumulated_cost   - Cost to reach each position with non-zero coeff
  *   accumulated_zero_dist - Distortion if zeros from Ss to each position
- *   actbl              - AC Huffman table (for EOB code cost)
+ *   rates              - Huffman code lengths (for EOB code cost)
  *   result             - Output: optimal EOB position and costs
  */
 LOCAL(void)
 find_block_eob_position(JBLOCKROW coef_blocks, int bi, int Ss, int Se,
                         const float *accumulated_cost,
                         const float *accumulated_zero_dist,
-                        const c_derived_tbl *actbl,
+                        const trellis_rates *rates,
                         EOBSearchResult *result)
 {
   int i;
-  float eob_cost = actbl->ehufsi[0];  /* Cost of EOB marker (symbol 0x00) */
+  float eob_cost = rates->eob_bits[0];  /* Cost of EOB marker (symbol 0x00) */
 
   /* Initialize with all-zeros case: no coefficients, just distortion */
   result->last_coeff_idx = Ss - 1;
@@ -1503,33 +1540,229 @@ find_block_eob_position(JBLOCKROW coef_blocks, int bi, int Ss, int Se,
   result->has_eob = (result->last_coeff_idx < Se) + (result->last_coeff_idx == Ss - 1);
 }
 
+#if BITS_IN_JSAMPLE == 8
+
+/*
+ * Trellis quantization workspace.
+ *
+ * The per-block arrays used by the cross-block EOB optimization and by the DC
+ * trellis are allocated once per image from the image pool, sized for the
+ * widest component, and the distortion weights of each quantization table are
+ * computed once at the start of each trellis pass.  Each thread that runs
+ * trellis quantization needs its own workspace.
+ */
+struct trellis_context {
+  JDIMENSION max_blocks;        /* capacity of the per-block arrays */
+
+  /* Distortion weights, indexed by quantization table number */
+  float lambda_base[NUM_QUANT_TBLS];
+  float lambda_tbl[NUM_QUANT_TBLS][DCTSIZE2];
+
+  /* Cross-block EOB optimization (NULL if disabled) */
+  float *accumulated_zero_block_cost;
+  float *accumulated_block_cost;
+  int *block_run_start;
+  int *requires_eob;
+
+  /* DC trellis (NULL if disabled) */
+  float *accumulated_dc_cost[DC_TRELLIS_MAX_CANDIDATES];
+  int *dc_cost_backtrack[DC_TRELLIS_MAX_CANDIDATES];
+  JCOEF *dc_candidate[DC_TRELLIS_MAX_CANDIDATES];
+  int *dc_context[DC_TRELLIS_MAX_CANDIDATES];
+
+  /* Statistics for the current pass */
+  long num_blocks;              /* # of blocks whose AC coefs were quantized */
+  long num_bypassed;            /* # of those that needed no trellis search */
+};
+
+/*
+ * Initialize the per-coefficient distortion weights for the given
+ * quantization table, and return the lambda_base scaling factor.
+ */
+LOCAL(float)
+init_trellis_lambda(j_compress_ptr cinfo, const JQUANT_TBL *qtbl,
+                    float *lambda_tbl)
+{
+  int i;
+  int mode = 1;
+  float norm = 0.0;
+  float lambda_base;
+
+  /* Compute initial norm from quantization table for lambda_base */
+  for (i = 1; i < DCTSIZE2; i++) {
+    norm += qtbl->quantval[i] * qtbl->quantval[i];
+  }
+  norm /= 63.0;
+
+  /* Initialize lambda weighting table */
+  lambda_base = init_lambda_table(mode, norm, qtbl, lambda_tbl);
+  if (mode != 1)
+    memcpy(lambda_tbl, (cinfo->master->use_lambda_weight_tbl) ?
+                       jpeg_lambda_weights_csf_luma :
+                       jpeg_lambda_weights_flat,
+           DCTSIZE2 * sizeof(float));
+
+  return lambda_base;
+}
+
+/*
+ * Allocate a trellis quantization workspace for rows of up to max_blocks
+ * blocks.  need_dc is FALSE if the workspace will only be used by
+ * quantize_trellis_ac().
+ */
+GLOBAL(trellis_context *)
+jinit_trellis_context(j_compress_ptr cinfo, JDIMENSION max_blocks,
+                      boolean need_dc)
+{
+  trellis_context *ctx;
+  int i;
+
+  ctx = (trellis_context *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                sizeof(trellis_context));
+  memset(ctx, 0, sizeof(trellis_context));
+  ctx->max_blocks = max_blocks;
+
+  if (cinfo->master->trellis_eob_opt) {
+    ctx->accumulated_zero_block_cost = (float *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  (max_blocks + 1) * sizeof(float));
+    ctx->accumulated_block_cost = (float *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  (max_blocks + 1) * sizeof(float));
+    ctx->block_run_start = (int *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  max_blocks * sizeof(int));
+    ctx->requires_eob = (int *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  (max_blocks + 1) * sizeof(int));
+  }
+
+  if (need_dc && cinfo->master->trellis_quant_dc) {
+    for (i = 0; i < DC_TRELLIS_MAX_CANDIDATES; i++) {
+      ctx->accumulated_dc_cost[i] = (float *)
+        (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    max_blocks * sizeof(float));
+      ctx->dc_cost_backtrack[i] = (int *)
+        (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    max_blocks * sizeof(int));
+      ctx->dc_candidate[i] = (JCOEF *)
+        (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    max_blocks * sizeof(JCOEF));
+#ifdef C_ARITH_CODING_SUPPORTED
+      if (cinfo->arith_code)
+        ctx->dc_context[i] = (int *)
+          (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                      max_blocks * sizeof(int));
+#endif
+    }
+  }
+
+  return ctx;
+}
+
+/*
+ * Prepare a trellis quantization workspace for a new pass.  The quantization
+ * tables may have been changed by the previous pass (see trellis_q_opt), so
+ * the distortion weights are recomputed here.
+ */
+GLOBAL(void)
+jstart_trellis_context(j_compress_ptr cinfo, trellis_context *ctx)
+{
+  int qtblno;
+
+  for (qtblno = 0; qtblno < NUM_QUANT_TBLS; qtblno++) {
+    if (cinfo->quant_tbl_ptrs[qtblno] != NULL)
+      ctx->lambda_base[qtblno] =
+        init_trellis_lambda(cinfo, cinfo->quant_tbl_ptrs[qtblno],
+                            ctx->lambda_tbl[qtblno]);
+  }
+  ctx->num_blocks = 0;
+  ctx->num_bypassed = 0;
+}
+
+/*
+ * Add the statistics gathered by a trellis quantization workspace during the
+ * current pass to *num_blocks and *num_bypassed.
+ */
+GLOBAL(void)
+jget_trellis_stats(trellis_context *ctx, long *num_blocks, long *num_bypassed)
+{
+  *num_blocks += ctx->num_blocks;
+  *num_bypassed += ctx->num_bypassed;
+}
+
+/*
+ * Build the trellis rate tables for a component from its derived Huffman
+ * tables.  This is done once per pass.  The AC entries include the cost of
+ * any ZRL codes, and combinations that the Huffman table cannot code get a
+ * cost of COST_INFINITY, so that no path through them is ever chosen.
+ */
+GLOBAL(void)
+jpeg_make_trellis_rates(const c_derived_tbl *dctbl,
+                        const c_derived_tbl *actbl, trellis_rates *rates)
+{
+  int zero_run, nbits, bits;
+
+  for (zero_run = 0; zero_run < DCTSIZE2; zero_run++) {
+    rates->ac_bits[zero_run][0] = COST_INFINITY;
+    for (nbits = 1; nbits < 16; nbits++) {
+      bits = compute_ac_huffman_bits(zero_run, nbits, actbl);
+      rates->ac_bits[zero_run][nbits] = (bits < 0) ? COST_INFINITY :
+                                        (float)bits;
+    }
+  }
+
+  for (nbits = 0; nbits < 16; nbits++) {
+    rates->dc_bits[nbits] = (float)(dctbl->ehufsi[nbits] + nbits);
+    rates->eob_bits[nbits] = (float)(actbl->ehufsi[16 * nbits] + nbits);
+  }
+}
+
 /*
  * Trellis quantization for Huffman-coded JPEG.
  *
- * This function performs rate-distortion optimal quantization using
- * dynamic programming (trellis optimization). It finds the coefficient
- * values that minimize distortion for a given bit budget.
+ * This performs rate-distortion optimal quantization using dynamic
+ * programming (trellis optimization).  It finds the coefficient values that
+ * minimize distortion for a given bit budget.
  *
  * The trellis explores multiple quantization candidates for each coefficient
  * and finds the globally optimal path through them using the Viterbi algorithm.
  *
+ * The work is split in two parts.  quantize_trellis_ac() handles the AC
+ * coefficients (Ss..Se) of a row of blocks.  It depends only on that row, so
+ * it may be run for several block rows at once.  quantize_trellis_dc() handles
+ * everything that links the block rows of a component together (the DC
+ * prediction chain, the vertical DC context and the statistics used to
+ * optimize the quantization tables), and it must be called for each block row
+ * in image order, after quantize_trellis_ac() has been called for that row.
+ * quantize_trellis() does both for one block row.
+ *
  * Parameters:
- *   dctbl, actbl  - DC and AC Huffman tables (for rate estimation)
+ *   ctx           - Workspace (see jinit_trellis_context())
+ *   rates         - Huffman code lengths (see jpeg_make_trellis_rates())
  *   coef_blocks   - Output: quantized coefficients
  *   src           - Input: DCT coefficients (scaled by 8)
  *   num_blocks    - Number of 8x8 blocks to process
- *   qtbl          - Quantization table
+ *   qtblno        - Quantization table number
  *   norm_src/coef - Normalization factors for distortion calculation
  *   last_dc_val   - Previous DC value (for differential coding)
  *   coef_blocks_above, src_above - For DC prediction across rows
  */
-#if BITS_IN_JSAMPLE == 8
+
+/*
+ * Trellis quantization of the AC coefficients of a row of blocks.
+ *
+ * This neither reads nor writes the DC coefficients or any state shared with
+ * other block rows, so it is safe to call from a worker thread, provided that
+ * each thread uses its own workspace.
+ */
 GLOBAL(void)
-quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actbl, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
-                 JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
-                 JBLOCKROW coef_blocks_above, JBLOCKROW src_above)
+quantize_trellis_ac(j_compress_ptr cinfo, trellis_context *ctx,
+                    const trellis_rates *rates, JBLOCKROW coef_blocks,
+                    JBLOCKROW src, JDIMENSION num_blocks, int qtblno)
 {
-  int i, j, k, l;
+  int i, j, k;
   float accumulated_zero_dist[DCTSIZE2];
   float accumulated_cost[DCTSIZE2];
   int run_start[DCTSIZE2];
@@ -1538,31 +1771,25 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
   int last_coeff_idx; /* position of last nonzero coefficient */
   const int max_coef_bits = cinfo->data_precision + 2;
   const int max_coef_value = (1 << max_coef_bits) - 1;  /* e.g., 1023 for 8-bit */
-  float norm = 0.0;
-  float lambda_base;
+  float norm;
+  const JQUANT_TBL *qtbl = cinfo->quant_tbl_ptrs[qtblno];
+  const float lambda_base = ctx->lambda_base[qtblno];
+  const float *lambda_tbl = ctx->lambda_tbl[qtblno];
   float lambda;
-  float lambda_dc;
-  const float *lambda_tbl = (cinfo->master->use_lambda_weight_tbl) ?
-                            jpeg_lambda_weights_csf_luma :
-                            jpeg_lambda_weights_flat;
   int Ss, Se;
-  float *accumulated_zero_block_cost = NULL;
-  float *accumulated_block_cost = NULL;
-  int *block_run_start = NULL;
-  int *requires_eob = NULL;
+  float *accumulated_zero_block_cost = ctx->accumulated_zero_block_cost;
+  float *accumulated_block_cost = ctx->accumulated_block_cost;
+  int *block_run_start = ctx->block_run_start;
+  int *requires_eob = ctx->requires_eob;
   int has_eob;
+  int nonzero_count;
   float cost_all_zeros;
   float best_cost_skip;
   float cost;
   int zero_run;
-  int run_bits;
-  int rate;
-  float *accumulated_dc_cost[DC_TRELLIS_MAX_CANDIDATES];
-  int *dc_cost_backtrack[DC_TRELLIS_MAX_CANDIDATES];
-  JCOEF *dc_candidate[DC_TRELLIS_MAX_CANDIDATES];
-  int mode = 1;
-  float lambda_table[DCTSIZE2];
-  const int dc_trellis_candidates = get_num_dc_trellis_candidates(qtbl->quantval[0]);
+#ifdef WITH_SIMD
+  const int simd_search = jsimd_can_trellis_ac_search();
+#endif
   
   Ss = cinfo->Ss;
   Se = cinfo->Se;
@@ -1570,47 +1797,12 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
     Ss = 1;
   if (Se < Ss)
     return;
+  ctx->num_blocks += num_blocks;
   if (cinfo->master->trellis_eob_opt) {
-    accumulated_zero_block_cost = (float *)malloc((num_blocks + 1) * sizeof(float));
-    accumulated_block_cost = (float *)malloc((num_blocks + 1) * sizeof(float));
-    block_run_start = (int *)malloc(num_blocks * sizeof(int));
-    requires_eob = (int *)malloc((num_blocks + 1) * sizeof(int));
-    if (!accumulated_zero_block_cost ||
-        !accumulated_block_cost ||
-        !block_run_start ||
-        !requires_eob) {
-      ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-    }
-
     accumulated_zero_block_cost[0] = 0;
     accumulated_block_cost[0] = 0;
     requires_eob[0] = 0;
   }
-  
-  if (cinfo->master->trellis_quant_dc) {
-    for (i = 0; i < dc_trellis_candidates; i++) {
-      accumulated_dc_cost[i] = (float *)malloc(num_blocks * sizeof(float));
-      dc_cost_backtrack[i] = (int *)malloc(num_blocks * sizeof(int));
-      dc_candidate[i] = (JCOEF *)malloc(num_blocks * sizeof(JCOEF));
-      if (!accumulated_dc_cost[i] ||
-          !dc_cost_backtrack[i] ||
-          !dc_candidate[i]) {
-        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-      }
-    }
-  }
-  
-  /* Compute initial norm from quantization table for lambda_base */
-  norm = 0.0;
-  for (i = 1; i < DCTSIZE2; i++) {
-    norm += qtbl->quantval[i] * qtbl->quantval[i];
-  }
-  norm /= 63.0;
-
-  /* Initialize lambda weighting table */
-  lambda_base = init_lambda_table(mode, norm, qtbl, lambda_table);
-  if (mode == 1)
-    lambda_tbl = lambda_table;
 
   for (bi = 0; bi < num_blocks; bi++) {
     /* Compute block's AC energy for adaptive lambda */
@@ -1618,266 +1810,227 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
 
     /* Compute rate-distortion tradeoff parameter */
     lambda = compute_block_lambda(cinfo, lambda_base, norm);
-    lambda_dc = lambda * lambda_tbl[0];
     
     accumulated_zero_dist[Ss-1] = 0.0;
     accumulated_cost[Ss-1] = 0.0;
 
-    /* ===== DC Coefficient Processing =====
-     * The DC coefficient requires special handling because it uses
-     * differential coding (DPCM) across blocks.
+    /* Count the coefficients that do not round to zero.  This determines the
+     * block complexity for the speed optimization below.
      */
-    if (cinfo->master->trellis_quant_dc) {
-      /* Extract sign using arithmetic right shift (2's complement):
-       * positive values → 0, negative values → -1 (all 1s) */
-      int sign = src[bi][0] >> 31;
-      int x = abs(src[bi][0]);
-      int q = 8 * qtbl->quantval[0];
-      int qval;
-      float dc_candidate_dist;
-
-      qval = (x + q/2) / q; /* quantized value (round nearest) */
-      for (k = 0; k < dc_trellis_candidates; k++) {
-        int delta;
-        int dc_delta;
-
-        dc_candidate[k][bi] = qval - dc_trellis_candidates/2 + k;
-        /* Clamp to valid coefficient range */
-        if (dc_candidate[k][bi] > max_coef_value)
-          dc_candidate[k][bi] = max_coef_value;
-        if (dc_candidate[k][bi] < -max_coef_value)
-          dc_candidate[k][bi] = -max_coef_value;
-
-        delta = dc_candidate[k][bi] * q - x;
-        dc_candidate_dist = delta * delta * lambda_dc;
-        /* Apply sign: if sign=-1 (negative), multiply by -1; if sign=0, keep positive */
-        dc_candidate[k][bi] *= 1 + 2*sign;
-
-        /* Take into account DC differences */
-        if (coef_blocks_above && src_above && cinfo->master->trellis_delta_dc_weight > 0.0) {
-          int dc_above_orig;
-          int dc_above_recon;
-          int dc_orig;
-          int dc_recon;
-          float vertical_dist;
-          
-          dc_above_orig = src_above[bi][0];
-          dc_above_recon = coef_blocks_above[bi][0] * q;
-          dc_orig = src[bi][0];
-          dc_recon = dc_candidate[k][bi] * q;
-          /* delta is difference of vertical gradients */
-          delta = (dc_above_orig - dc_orig) - (dc_above_recon - dc_recon);
-          vertical_dist = delta * delta * lambda_dc;
-          dc_candidate_dist +=  cinfo->master->trellis_delta_dc_weight * (vertical_dist - dc_candidate_dist);
-        }
-        
-        if (bi == 0) {
-          dc_delta = dc_candidate[k][bi] - *last_dc_val;
-          cost = compute_dc_huffman_bits(dc_delta, dctbl) + dc_candidate_dist;
-          accumulated_dc_cost[k][0] = cost;
-          dc_cost_backtrack[k][0] = -1;
-        } else {
-          for (l = 0; l < dc_trellis_candidates; l++) {
-            dc_delta = dc_candidate[k][bi] - dc_candidate[l][bi-1];
-            cost = compute_dc_huffman_bits(dc_delta, dctbl) + dc_candidate_dist + accumulated_dc_cost[l][bi-1];
-            if (l == 0 || cost < accumulated_dc_cost[k][bi]) {
-              accumulated_dc_cost[k][bi] = cost;
-              dc_cost_backtrack[k][bi] = l;
-            }
-          }
-        }
-      }
+    nonzero_count = 0;
+    for (i = Ss; i <= Se; i++) {
+      int z = jpeg_natural_order[i];
+      int x = abs(src[bi][z]);
+      int q = 8 * qtbl->quantval[z];
+      if ((x + q/2) / q > 0) nonzero_count++;
     }
 
-    /* ===== Speed Optimization: Adaptive Search Limiting =====
-     *
-     * Trellis quantization has O(n²) complexity due to the predecessor
-     * search. For high-entropy blocks (many non-zero coefficients),
-     * this becomes very slow. We detect such blocks and limit the
-     * search to maintain performance with negligible quality impact.
-     *
-     * max_lookback: How many predecessor positions to consider
-     * max_ac_candidates: How many quantization candidates to try
-     *
-     * Controlled by trellis_speed_level (0-10):
-     *   0 = thorough (full search, slowest but optimal)
-     *   7 = default (balanced speed/quality)
-     *   10 = fast (most blocks use reduced search)
-     */
-    int max_lookback = 63;      /* Default: full search (all predecessors) */
-    int max_ac_candidates = 16; /* Default: all candidates */
-    int speed_level = cinfo->master->trellis_speed_level;
-
-    if (speed_level > 0) {
-      int nonzero_count = 0;
-
-      /* Count non-zero coefficients to determine block complexity */
+    if (nonzero_count == 0) {
+      /* ===== Bypass for Blocks That Round to Zero =====
+       *
+       * If every coefficient rounds to zero, then no position has any
+       * candidates, so the trellis search cannot find a path and leaves the
+       * block all zero, with an EOB at the start.  This is common in flat
+       * regions, particularly in the chroma components.  Only the distortion
+       * of the all-zero block is needed, for the cross-block EOB optimization
+       * below.  It is accumulated in the same order as in the search, so the
+       * result is identical.
+       */
       for (i = Ss; i <= Se; i++) {
         int z = jpeg_natural_order[i];
         int x = abs(src[bi][z]);
-        int q = 8 * qtbl->quantval[z];
-        if ((x + q/2) / q > 0) nonzero_count++;
-      }
-
-      /* Threshold decreases as level increases (more blocks affected)
-       * Level 1: threshold=58, Level 7: threshold=40, Level 10: threshold=31
-       */
-      int threshold = 61 - speed_level * 3;
-
-      if (nonzero_count > threshold) {
-        /* Lookback limit: decreases as level increases
-         * Level 1: 24, Level 7: 12, Level 10: 6 */
-        max_lookback = 26 - speed_level * 2;
-        if (max_lookback < 4) max_lookback = 4;
-
-        /* Candidate limit: decreases as level increases
-         * Level 1: 8, Level 7: 5, Level 10: 3 */
-        max_ac_candidates = 9 - (speed_level + 1) / 2;
-        if (max_ac_candidates < 2) max_ac_candidates = 2;
-      }
-    }
-
-    /* ===== AC Coefficient Processing (Viterbi/Trellis Search) =====
-     *
-     * This implements a shortest-path search through a trellis graph where:
-     *
-     * GRAPH STRUCTURE:
-     * - Nodes: Each (position, candidate_value) pair is a node
-     * - Edges: Connect non-zero coefficient at position j to position i,
-     *   with weight = cost to encode zeros from j+1 to i-1, plus i's coeff
-     *
-     * STATE VARIABLES:
-     * - accumulated_cost[i]: Minimum cost to reach position i with a
-     *   non-zero coefficient at i
-     * - accumulated_zero_dist[i]: Distortion if coeffs from Ss to i are all zero
-     * - run_start[i]: Position of previous non-zero coeff on optimal path
-     *
-     * ALGORITHM:
-     * For each position i in zig-zag order:
-     *   1. Update accumulated_zero_dist[i] (cumulative if all zeros)
-     *   2. Skip if coefficient quantizes to zero naturally
-     *   3. Generate candidate values at Huffman category boundaries
-     *   4. For each possible "last non-zero" position j < i:
-     *      - Compute zero_run = i - 1 - j
-     *      - For each candidate value:
-     *        - cost = bits(zero_run, candidate) + distortion(candidate)
-     *              + cost_of_zeros(j+1..i-1) + accumulated_cost[j]
-     *        - Update if this path is cheaper
-     *
-     * The result is the globally optimal quantization given the rate
-     * constraint from the Huffman table.
-     */
-    for (i = Ss; i <= Se; i++) {
-      int z = jpeg_natural_order[i];  /* Convert scan order to zig-zag index */
-
-      /* Extract sign and magnitude of original DCT coefficient */
-      int sign = src[bi][z] >> 31;  /* 0 if positive, -1 if negative */
-      int x = abs(src[bi][z]);       /* Original magnitude (scaled by 8) */
-      int q = 8 * qtbl->quantval[z]; /* Quantization step (scaled) */
-      int candidate[16];
-      int candidate_bits[16];
-      float candidate_dist[16];
-      int num_candidates;
-      int qval;
-
-      /* Step 1: Update cumulative zero distortion.
-       * This tracks what we'd pay in distortion if all coeffs up to here were zero. */
-      accumulated_zero_dist[i] = x * x * lambda * lambda_tbl[z] + accumulated_zero_dist[i-1];
-
-      qval = (x + q/2) / q; /* Round-to-nearest quantization */
-
-      /* If coefficient naturally quantizes to zero, no candidates to explore */
-      if (qval == 0) {
         coef_blocks[bi][z] = 0;
-        accumulated_cost[i] = COST_INFINITY; /* Can't end path here */
-        continue;
+        accumulated_zero_dist[i] = x * x * lambda * lambda_tbl[z] + accumulated_zero_dist[i-1];
       }
+      cost_all_zeros = accumulated_zero_dist[Se];
+      best_cost_skip = cost_all_zeros;
+      has_eob = 2;
+      ctx->num_bypassed++;
+    } else {
+      /* ===== Speed Optimization: Adaptive Search Limiting =====
+       *
+       * Trellis quantization has O(n²) complexity due to the predecessor
+       * search. For high-entropy blocks (many non-zero coefficients),
+       * this becomes very slow. We detect such blocks and limit the
+       * search to maintain performance with negligible quality impact.
+       *
+       * max_lookback: How many predecessor positions to consider
+       * max_ac_candidates: How many quantization candidates to try
+       *
+       * Controlled by trellis_speed_level (0-10):
+       *   0 = thorough (full search, slowest but optimal)
+       *   7 = default (balanced speed/quality)
+       *   10 = fast (most blocks use reduced search)
+       */
+      int max_lookback = 63;      /* Default: full search (all predecessors) */
+      int max_ac_candidates = 16; /* Default: all candidates */
+      int speed_level = cinfo->master->trellis_speed_level;
 
-      if (qval > max_coef_value)
-        qval = max_coef_value;
-
-      /* Step 3: Generate candidate values at Huffman category boundaries.
-       * Candidates: 1, 3, 7, 15, ... (largest in each category), then qval */
-      num_candidates = JPEG_NBITS(qval);
-      if (num_candidates > max_ac_candidates)
-        num_candidates = max_ac_candidates;
-      for (k = 0; k < num_candidates; k++) {
-        int delta;
-        candidate[k] = (k < num_candidates - 1) ? (2 << k) - 1 : qval;
-        delta = candidate[k] * q - x;
-        candidate_bits[k] = k+1;  /* Huffman category = number of magnitude bits */
-        candidate_dist[k] = delta * delta * lambda * lambda_tbl[z];
+      if (speed_level > 0) {
+        /* Threshold decreases as level increases (more blocks affected)
+         * Level 1: threshold=58, Level 7: threshold=40, Level 10: threshold=31
+         */
+        int threshold = 61 - speed_level * 3;
+
+        if (nonzero_count > threshold) {
+          /* Lookback limit: decreases as level increases
+           * Level 1: 24, Level 7: 12, Level 10: 6 */
+          max_lookback = 26 - speed_level * 2;
+          if (max_lookback < 4) max_lookback = 4;
+
+          /* Candidate limit: decreases as level increases
+           * Level 1: 8, Level 7: 5, Level 10: 3 */
+          max_ac_candidates = 9 - (speed_level + 1) / 2;
+          if (max_ac_candidates < 2) max_ac_candidates = 2;
+        }
       }
 
-      accumulated_cost[i] = COST_INFINITY;
-
-      /* Step 4: Search for optimal path - try valid predecessor positions.
-       * Limit lookback distance for high-entropy blocks (speed optimization). */
-      {
-        int j_start = i - max_lookback;
-        if (j_start < Ss - 1) j_start = Ss - 1;
-        for (j = j_start; j < i; j++) {
-        int zz = jpeg_natural_order[j];
-
-        /* Only consider paths from:
-         * - Start of block (j == Ss-1), or
-         * - Positions with non-zero coefficients (valid path endpoints) */
-        if (j != Ss-1 && coef_blocks[bi][zz] == 0)
-          continue;
-
-        /* Compute zero run length between predecessor j and current position i */
-        zero_run = i - 1 - j;
-
-        /* Skip if run length requires ZRL codes (0xF0) but table doesn't have them */
-        if ((zero_run >> 4) && actbl->ehufsi[0xf0] == 0)
+      /* ===== AC Coefficient Processing (Viterbi/Trellis Search) =====
+       *
+       * This implements a shortest-path search through a trellis graph where:
+       *
+       * GRAPH STRUCTURE:
+       * - Nodes: Each (position, candidate_value) pair is a node
+       * - Edges: Connect non-zero coefficient at position j to position i,
+       *   with weight = cost to encode zeros from j+1 to i-1, plus i's coeff
+       *
+       * STATE VARIABLES:
+       * - accumulated_cost[i]: Minimum cost to reach position i with a
+       *   non-zero coefficient at i
+       * - accumulated_zero_dist[i]: Distortion if coeffs from Ss to i are all zero
+       * - run_start[i]: Position of previous non-zero coeff on optimal path
+       *
+       * ALGORITHM:
+       * For each position i in zig-zag order:
+       *   1. Update accumulated_zero_dist[i] (cumulative if all zeros)
+       *   2. Skip if coefficient quantizes to zero naturally
+       *   3. Generate candidate values at Huffman category boundaries
+       *   4. For each possible "last non-zero" position j < i:
+       *      - Compute zero_run = i - 1 - j
+       *      - For each candidate value:
+       *        - cost = bits(zero_run, candidate) + distortion(candidate)
+       *              + cost_of_zeros(j+1..i-1) + accumulated_cost[j]
+       *        - Update if this path is cheaper
+       *
+       * The result is the globally optimal quantization given the rate
+       * constraint from the Huffman table.
+       */
+      for (i = Ss; i <= Se; i++) {
+        int z = jpeg_natural_order[i];  /* Convert scan order to zig-zag index */
+
+        /* Extract sign and magnitude of original DCT coefficient */
+        int sign = src[bi][z] >> 31;  /* 0 if positive, -1 if negative */
+        int x = abs(src[bi][z]);       /* Original magnitude (scaled by 8) */
+        int q = 8 * qtbl->quantval[z]; /* Quantization step (scaled) */
+        int candidate[16];
+        int candidate_bits[16];
+        float candidate_dist[16];
+        int num_candidates;
+        int qval;
+
+        /* Step 1: Update cumulative zero distortion.
+         * This tracks what we'd pay in distortion if all coeffs up to here were zero. */
+        accumulated_zero_dist[i] = x * x * lambda * lambda_tbl[z] + accumulated_zero_dist[i-1];
+
+        qval = (x + q/2) / q; /* Round-to-nearest quantization */
+
+        /* If coefficient naturally quantizes to zero, no candidates to explore */
+        if (qval == 0) {
+          coef_blocks[bi][z] = 0;
+          accumulated_cost[i] = COST_INFINITY; /* Can't end path here */
           continue;
+        }
 
-        /* Cost for zero run length 16+ codes (each encodes 16 zeros) */
-        run_bits = (zero_run >> 4) * actbl->ehufsi[0xf0];
-        zero_run &= 15;  /* Remaining zeros (0-15) encoded with coefficient */
+        if (qval > max_coef_value)
+          qval = max_coef_value;
 
-        /* Try each candidate value from this predecessor */
+        /* Step 3: Generate candidate values at Huffman category boundaries.
+         * Candidates: 1, 3, 7, 15, ... (largest in each category), then qval */
+        num_candidates = JPEG_NBITS(qval);
+        if (num_candidates > max_ac_candidates)
+          num_candidates = max_ac_candidates;
         for (k = 0; k < num_candidates; k++) {
-          /* Look up Huffman code length for (run_length, category) pair */
-          int coef_bits = actbl->ehufsi[16 * zero_run + candidate_bits[k]];
-          if (coef_bits == 0)
-            continue;  /* Symbol not in Huffman table */
+          int delta;
+          candidate[k] = (k < num_candidates - 1) ? (2 << k) - 1 : qval;
+          delta = candidate[k] * q - x;
+          candidate_bits[k] = k+1;  /* Huffman category = number of magnitude bits */
+          candidate_dist[k] = delta * delta * lambda * lambda_tbl[z];
+        }
 
-          /* Total rate = Huffman code + magnitude bits + ZRL codes */
-          rate = coef_bits + candidate_bits[k] + run_bits;
+        accumulated_cost[i] = COST_INFINITY;
 
-          /* Path cost = rate + distortion for this coeff */
-          cost = rate + candidate_dist[k];
+        /* Step 4: Search for optimal path - try valid predecessor positions.
+         * Limit lookback distance for high-entropy blocks (speed optimization). */
+        {
+          int j_start = i - max_lookback;
+          if (j_start < Ss - 1) j_start = Ss - 1;
+#ifdef WITH_SIMD
+          /* The SIMD search visits every predecessor instead of skipping those
+           * that quantized to zero.  This gives the same result, because their
+           * accumulated cost is COST_INFINITY and all other terms are >= 0. */
+          if (simd_search) {
+            int best = jsimd_trellis_ac_search(&accumulated_zero_dist[i],
+                                               &accumulated_cost[i],
+                                               candidate_dist,
+                                               rates->ac_bits[0],
+                                               i - j_start, num_candidates);
+            if (best >= 0) {
+              k = best & 15;
+              coef_blocks[bi][z] = (candidate[k] ^ sign) - sign;
+              run_start[i] = i - 1 - (best >> 4);
+            }
+          } else
+#endif
+          for (j = j_start; j < i; j++) {
+          int zz = jpeg_natural_order[j];
 
-          /* Add cost of zeros between j and i-1, plus accumulated cost to reach j */
-          cost += accumulated_zero_dist[i-1] - accumulated_zero_dist[j] + accumulated_cost[j];
+          /* Only consider paths from:
+           * - Start of block (j == Ss-1), or
+           * - Positions with non-zero coefficients (valid path endpoints) */
+          if (j != Ss-1 && coef_blocks[bi][zz] == 0)
+            continue;
 
-          /* Update if this path is cheaper than any previously found */
-          if (cost < accumulated_cost[i]) {
-            coef_blocks[bi][z] = (candidate[k] ^ sign) - sign;  /* Apply sign */
-            accumulated_cost[i] = cost;
-            run_start[i] = j;  /* Remember predecessor for backtracking */
+          /* Compute zero run length between predecessor j and current position i */
+          zero_run = i - 1 - j;
+
+          /* Try each candidate value from this predecessor */
+          for (k = 0; k < num_candidates; k++) {
+            /* Path cost = rate + distortion for this coeff.  The rate includes
+             * the magnitude bits and any ZRL codes.  It is COST_INFINITY if the
+             * Huffman table cannot code this (run_length, category) pair, in
+             * which case the path can never be cheaper than the best one. */
+            cost = rates->ac_bits[zero_run][candidate_bits[k]] + candidate_dist[k];
+
+            /* Add cost of zeros between j and i-1, plus accumulated cost to reach j */
+            cost += accumulated_zero_dist[i-1] - accumulated_zero_dist[j] + accumulated_cost[j];
+
+            /* Update if this path is cheaper than any previously found */
+            if (cost < accumulated_cost[i]) {
+              coef_blocks[bi][z] = (candidate[k] ^ sign) - sign;  /* Apply sign */
+              accumulated_cost[i] = cost;
+              run_start[i] = j;  /* Remember predecessor for backtracking */
+            }
           }
         }
+        } /* end of lookback limit block */
       }
-      } /* end of lookback limit block */
-    }
 
-    /* ===== End-of-Block Optimization =====
-     * Find the optimal position for the EOB marker using the helper.
-     */
-    {
-      EOBSearchResult eob_result;
-      find_block_eob_position(coef_blocks, bi, Ss, Se,
-                              accumulated_cost, accumulated_zero_dist,
-                              actbl, &eob_result);
+      /* ===== End-of-Block Optimization =====
+       * Find the optimal position for the EOB marker using the helper.
+       */
+      {
+        EOBSearchResult eob_result;
+        find_block_eob_position(coef_blocks, bi, Ss, Se,
+                                accumulated_cost, accumulated_zero_dist,
+                                rates, &eob_result);
 
-      last_coeff_idx = eob_result.last_coeff_idx;
-      best_cost_skip = eob_result.cost_wo_eob;
-      has_eob = eob_result.has_eob;
-      cost_all_zeros = eob_result.cost_all_zeros;
+        last_coeff_idx = eob_result.last_coeff_idx;
+        best_cost_skip = eob_result.cost_wo_eob;
+        has_eob = eob_result.has_eob;
+        cost_all_zeros = eob_result.cost_all_zeros;
 
-      zero_trailing_coefficients(coef_blocks, bi, Ss, Se, last_coeff_idx, run_start);
+        zero_trailing_coefficients(coef_blocks, bi, Ss, Se, last_coeff_idx, run_start);
+      }
     }
 
     /* ===== Cross-Block EOB Optimization (Block-Level Viterbi) =====
@@ -1930,7 +2083,7 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
           /* Add cost of EOBn code for the zero block run */
           zero_block_run = bi - i + requires_eob[i];
           nbits = JPEG_NBITS(zero_block_run);
-          cost += actbl->ehufsi[16*nbits] + nbits;
+          cost += rates->eob_bits[nbits];
 
           if (cost < best_cost) {
             block_run_start[bi] = i;
@@ -1971,7 +2124,7 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
       /* Cost of EOBn code for trailing zero block run */
       zero_block_run = num_blocks - i + requires_eob[i];
       nbits = JPEG_NBITS(zero_block_run);
-      cost += actbl->ehufsi[16*nbits] + nbits;
+      cost += rates->eob_bits[nbits];
 
       if (cost < best_cost) {
         best_cost = cost;
@@ -1995,13 +2148,45 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
       last_block = block_run_start[bi] - 1;
       bi--;
     }
-
-    free(accumulated_zero_block_cost);
-    free(accumulated_block_cost);
-    free(block_run_start);
-    free(requires_eob);
   }
+}
+
+/*
+ * Complete trellis quantization of a row of blocks: accumulate the statistics
+ * used to optimize the quantization tables and, if enabled, trellis-quantize
+ * the DC coefficients.  See above for the calling order.
+ */
+GLOBAL(void)
+quantize_trellis_dc(j_compress_ptr cinfo, trellis_context *ctx,
+                    const trellis_rates *rates, JBLOCKROW coef_blocks,
+                    JBLOCKROW src, JDIMENSION num_blocks, int qtblno,
+                    double *norm_src, double *norm_coef, JCOEF *last_dc_val,
+                    JBLOCKROW coef_blocks_above, JBLOCKROW src_above)
+{
+  int i, j, k, l;
+  int bi;
+  const int max_coef_bits = cinfo->data_precision + 2;
+  const int max_coef_value = (1 << max_coef_bits) - 1;  /* e.g., 1023 for 8-bit */
+  float norm;
+  const JQUANT_TBL *qtbl = cinfo->quant_tbl_ptrs[qtblno];
+  const float lambda_base = ctx->lambda_base[qtblno];
+  const float *lambda_tbl = ctx->lambda_tbl[qtblno];
+  float lambda;
+  float lambda_dc;
+  int Ss, Se;
+  float cost;
+  float **accumulated_dc_cost = ctx->accumulated_dc_cost;
+  int **dc_cost_backtrack = ctx->dc_cost_backtrack;
+  JCOEF **dc_candidate = ctx->dc_candidate;
+  const int dc_trellis_candidates = get_num_dc_trellis_candidates(qtbl->quantval[0]);
   
+  Ss = cinfo->Ss;
+  Se = cinfo->Se;
+  if (Ss == 0)
+    Ss = 1;
+  if (Se < Ss)
+    return;
+
   if (cinfo->master->trellis_q_opt) {
     for (bi = 0; bi < num_blocks; bi++) {
       for (i = 1; i < DCTSIZE2; i++) {
@@ -2010,28 +2195,106 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
       }
     }
   }
-  
-  if (cinfo->master->trellis_quant_dc) {
-    j = 0;
-    for (i = 1; i < dc_trellis_candidates; i++) {
-      if (accumulated_dc_cost[i][num_blocks-1] < accumulated_dc_cost[j][num_blocks-1])
-        j = i;
-    }
-    for (bi = num_blocks-1; bi >= 0; bi--) {
-      coef_blocks[bi][0] = dc_candidate[j][bi];
-      j = dc_cost_backtrack[j][bi];
-    }
 
-    /* Save DC predictor */
-    *last_dc_val = coef_blocks[num_blocks-1][0];
+  if (!cinfo->master->trellis_quant_dc)
+    return;
+
+  /* ===== DC Coefficient Processing =====
+   * The DC coefficient requires special handling because it uses
+   * differential coding (DPCM) across blocks.
+   */
+  for (bi = 0; bi < num_blocks; bi++) {
+    /* Extract sign using arithmetic right shift (2's complement):
+     * positive values → 0, negative values → -1 (all 1s) */
+    int sign = src[bi][0] >> 31;
+    int x = abs(src[bi][0]);
+    int q = 8 * qtbl->quantval[0];
+    int qval;
+    float dc_candidate_dist;
 
-    for (i = 0; i < dc_trellis_candidates; i++) {
-      free(accumulated_dc_cost[i]);
-      free(dc_cost_backtrack[i]);
-      free(dc_candidate[i]);
+    /* Compute block's AC energy for adaptive lambda */
+    norm = compute_block_ac_energy(src, bi);
+
+    /* Compute rate-distortion tradeoff parameter */
+    lambda = compute_block_lambda(cinfo, lambda_base, norm);
+    lambda_dc = lambda * lambda_tbl[0];
+
+    qval = (x + q/2) / q; /* quantized value (round nearest) */
+    for (k = 0; k < dc_trellis_candidates; k++) {
+      int delta;
+      int dc_delta;
+
+      dc_candidate[k][bi] = qval - dc_trellis_candidates/2 + k;
+      /* Clamp to valid coefficient range */
+      if (dc_candidate[k][bi] > max_coef_value)
+        dc_candidate[k][bi] = max_coef_value;
+      if (dc_candidate[k][bi] < -max_coef_value)
+        dc_candidate[k][bi] = -max_coef_value;
+
+      delta = dc_candidate[k][bi] * q - x;
+      dc_candidate_dist = delta * delta * lambda_dc;
+      /* Apply sign: if sign=-1 (negative), multiply by -1; if sign=0, keep positive */
+      dc_candidate[k][bi] *= 1 + 2*sign;
+
+      /* Take into account DC differences */
+      if (coef_blocks_above && src_above && cinfo->master->trellis_delta_dc_weight > 0.0) {
+        int dc_above_orig;
+        int dc_above_recon;
+        int dc_orig;
+        int dc_recon;
+        float vertical_dist;
+        
+        dc_above_orig = src_above[bi][0];
+        dc_above_recon = coef_blocks_above[bi][0] * q;
+        dc_orig = src[bi][0];
+        dc_recon = dc_candidate[k][bi] * q;
+        /* delta is difference of vertical gradients */
+        delta = (dc_above_orig - dc_orig) - (dc_above_recon - dc_recon);
+        vertical_dist = delta * delta * lambda_dc;
+        dc_candidate_dist +=  cinfo->master->trellis_delta_dc_weight * (vertical_dist - dc_candidate_dist);
+      }
+      
+      if (bi == 0) {
+        dc_delta = dc_candidate[k][bi] - *last_dc_val;
+        cost = rates->dc_bits[JPEG_NBITS(abs(dc_delta))] + dc_candidate_dist;
+        accumulated_dc_cost[k][0] = cost;
+        dc_cost_backtrack[k][0] = -1;
+      } else {
+        for (l = 0; l < dc_trellis_candidates; l++) {
+          dc_delta = dc_candidate[k][bi] - dc_candidate[l][bi-1];
+          cost = rates->dc_bits[JPEG_NBITS(abs(dc_delta))] + dc_candidate_dist + accumulated_dc_cost[l][bi-1];
+          if (l == 0 || cost < accumulated_dc_cost[k][bi]) {
+            accumulated_dc_cost[k][bi] = cost;
+            dc_cost_backtrack[k][bi] = l;
+          }
+        }
+      }
     }
   }
 
+  j = 0;
+  for (i = 1; i < dc_trellis_candidates; i++) {
+    if (accumulated_dc_cost[i][num_blocks-1] < accumulated_dc_cost[j][num_blocks-1])
+      j = i;
+  }
+  for (bi = num_blocks-1; bi >= 0; bi--) {
+    coef_blocks[bi][0] = dc_candidate[j][bi];
+    j = dc_cost_backtrack[j][bi];
+  }
+
+  /* Save DC predictor */
+  *last_dc_val = coef_blocks[num_blocks-1][0];
+}
+
+GLOBAL(void)
+quantize_trellis(j_compress_ptr cinfo, trellis_context *ctx, const trellis_rates *rates, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
+                 int qtblno, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
+                 JBLOCKROW coef_blocks_above, JBLOCKROW src_above)
+{
+  quantize_trellis_ac(cinfo, ctx, rates, coef_blocks, src, num_blocks, qtblno);
+  quantize_trellis_dc(cinfo, ctx, rates, coef_blocks, src, num_blocks, qtblno,
+                      norm_src, norm_coef, last_dc_val, coef_blocks_above,
+                      src_above);
 }
 #endif
 
@@ -2077,8 +2340,8 @@ quantize_trellis(j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actb
  *   r - Arithmetic rate tables (replaces dctbl/actbl)
  */
 GLOBAL(void)
-quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
-                 JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
+quantize_trellis_arith(j_compress_ptr cinfo, trellis_context *ctx, arith_rates *r, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
+                 int qtblno, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
                  JBLOCKROW coef_blocks_above, JBLOCKROW src_above)
 {
   int i, j, k, l;
@@ -2089,23 +2352,20 @@ quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_bloc
   float best_cost;
   int last_coeff_idx; /* position of last nonzero coefficient */
   float norm = 0.0;
-  float lambda_base;
+  const JQUANT_TBL *qtbl = cinfo->quant_tbl_ptrs[qtblno];
+  const float lambda_base = ctx->lambda_base[qtblno];
+  const float *lambda_tbl = ctx->lambda_tbl[qtblno];
   float lambda;
   float lambda_dc;
-  const float *lambda_tbl = (cinfo->master->use_lambda_weight_tbl) ?
-  jpeg_lambda_weights_csf_luma :
-  jpeg_lambda_weights_flat;
   int Ss, Se;
   float cost;
   float run_bits;
   int rate;
-  float *accumulated_dc_cost[DC_TRELLIS_MAX_CANDIDATES];
-  int *dc_cost_backtrack[DC_TRELLIS_MAX_CANDIDATES];
-  JCOEF *dc_candidate[DC_TRELLIS_MAX_CANDIDATES];
-  int *dc_context[DC_TRELLIS_MAX_CANDIDATES];
+  float **accumulated_dc_cost = ctx->accumulated_dc_cost;
+  int **dc_cost_backtrack = ctx->dc_cost_backtrack;
+  JCOEF **dc_candidate = ctx->dc_candidate;
+  int **dc_context = ctx->dc_context;
   
-  int mode = 1;
-  float lambda_table[DCTSIZE2];
   const int dc_trellis_candidates = get_num_dc_trellis_candidates(qtbl->quantval[0]);
   
   Ss = cinfo->Ss;
@@ -2114,33 +2374,6 @@ quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_bloc
     Ss = 1;
   if (Se < Ss)
     return;
-  
-  if (cinfo->master->trellis_quant_dc) {
-    for (i = 0; i < dc_trellis_candidates; i++) {
-      accumulated_dc_cost[i] = (float *)malloc(num_blocks * sizeof(float));
-      dc_cost_backtrack[i] = (int *)malloc(num_blocks * sizeof(int));
-      dc_candidate[i] = (JCOEF *)malloc(num_blocks * sizeof(JCOEF));
-      dc_context[i] = (int *)malloc(num_blocks * sizeof(int));
-      if (!accumulated_dc_cost[i] ||
-          !dc_cost_backtrack[i] ||
-          !dc_candidate[i] ||
-          !dc_context[i]) {
-        ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
-      }
-    }
-  }
-  
-  /* Compute initial norm from quantization table for lambda_base */
-  norm = 0.0;
-  for (i = 1; i < DCTSIZE2; i++) {
-    norm += qtbl->quantval[i] * qtbl->quantval[i];
-  }
-  norm /= 63.0;
-
-  /* Initialize lambda weighting table */
-  lambda_base = init_lambda_table(mode, norm, qtbl, lambda_table);
-  if (mode == 1)
-    lambda_tbl = lambda_table;
 
   for (bi = 0; bi < num_blocks; bi++) {
     /* Compute block's AC energy for adaptive lambda */
@@ -2381,13 +2614,6 @@ quantize_trellis_arith(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_bloc
     
     /* Save DC predictor */
     *last_dc_val = coef_blocks[num_blocks-1][0];
-    
-    for (i = 0; i < dc_trellis_candidates; i++) {
-      free(accumulated_dc_cost[i]);
-      free(dc_cost_backtrack[i]);
-      free(dc_candidate[i]);
-      free(dc_context[i]);
-    }
   }
 }
 #endif
@@ -2468,7 +2694,12 @@ _jinit_forward_dct(j_compress_ptr cinfo)
       fdct->convsamp = convsamp;
 
     if (cinfo->master->overshoot_deringing) {
-      fdct->preprocess = preprocess_deringing;
+#ifdef WITH_SIMD
+      if (jsimd_can_preprocess_deringing())
+        fdct->preprocess = jsimd_preprocess_deringing;
+      else
+#endif
+        fdct->preprocess = preprocess_deringing;
     } else {
       fdct->preprocess = NULL;
     }
@@ -2479,6 +2710,16 @@ _jinit_forward_dct(j_compress_ptr cinfo)
     else
 #endif
       fdct->quantize = quantize;
+
+    /* The row routine covers the whole per-block pipeline, so it can only be
+     * used when there is no preprocessing step between convsamp and the DCT.
+     */
+    fdct->dct_row = NULL;
+#ifdef WITH_SIMD
+    if (cinfo->dct_method == JDCT_ISLOW && fdct->preprocess == NULL &&
+        jsimd_can_fdct_islow_row())
+      fdct->dct_row = jsimd_fdct_islow_row;
+#endif
     break;
 #endif
 #ifdef DCT_FLOAT_SUPPORTED
@@ -2491,7 +2732,12 @@ _jinit_forward_dct(j_compress_ptr cinfo)
       fdct->float_convsamp = convsamp_float;
 
     if (cinfo->master->overshoot_deringing) {
-      fdct->float_preprocess = float_preprocess_deringing;
+#ifdef WITH_SIMD
+      if (jsimd_can_preprocess_deringing_float())
+        fdct->float_preprocess = jsimd_preprocess_deringing_float;
+      else
+#endif
+        fdct->float_preprocess = float_preprocess_deringing;
     } else {
       fdct->float_preprocess = NULL;
     }
@@ -2502,6 +2748,18 @@ _jinit_forward_dct(j_compress_ptr cinfo)
     else
 #endif
       fdct->float_quantize = quantize_float;
+
+    fdct->float_dct_x2 = NULL;
+    fdct->float_convsamp_x2 = NULL;
+    fdct->float_quantize_x2 = NULL;
+#ifdef WITH_SIMD
+    if (jsimd_can_fdct_float_x2() && jsimd_can_convsamp_float_x2() &&
+        jsimd_can_quantize_float_x2()) {
+      fdct->float_dct_x2 = jsimd_fdct_float_x2;
+      fdct->float_convsamp_x2 = jsimd_convsamp_float_x2;
+      fdct->float_quantize_x2 = jsimd_quantize_float_x2;
+    }
+#endif
     break;
 #endif
   default:
@@ -2514,7 +2772,7 @@ _jinit_forward_dct(j_compress_ptr cinfo)
   if (cinfo->dct_method == JDCT_FLOAT)
     fdct->float_workspace = (FAST_FLOAT *)
       (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-                                  sizeof(FAST_FLOAT) * DCTSIZE2);
+                                  sizeof(FAST_FLOAT) * DCTSIZE2 * 2);
   else
 #endif
     fdct->workspace = (DCTELEM *)
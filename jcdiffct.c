@@ -351,6 +351,7 @@ _jinit_c_diff_controller(j_compress_ptr cinfo, boolean need_full_buffer)
                                 sizeof(my_diff_controller));
   cinfo->coef = (struct jpeg_c_coef_controller *)diff;
   diff->pub.start_pass = start_pass_diff;
+  diff->pub.encode_scan = NULL;
 
   /* Create the prediction row buffers. */
   for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
@@ -27,6 +27,7 @@ jpeg_c_bool_param_supported (const j_compress_ptr cinfo, J_BOOLEAN_PARAM param)
   case JBOOLEAN_USE_SCANS_IN_TRELLIS:
   case JBOOLEAN_TRELLIS_Q_OPT:
   case JBOOLEAN_OVERSHOOT_DERINGING:
+  case JBOOLEAN_BUFFER_SYMBOLS:
     return TRUE;
   }
 
@@ -63,6 +64,9 @@ jpeg_c_set_bool_param (j_compress_ptr cinfo, J_BOOLEAN_PARAM param,
   case JBOOLEAN_OVERSHOOT_DERINGING:
     cinfo->master->overshoot_deringing = value;
     break;
+  case JBOOLEAN_BUFFER_SYMBOLS:
+    cinfo->master->buffer_symbols = value;
+    break;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -89,6 +93,8 @@ jpeg_c_get_bool_param (const j_compress_ptr cinfo, J_BOOLEAN_PARAM param)
     return cinfo->master->trellis_q_opt;
   case JBOOLEAN_OVERSHOOT_DERINGING:
     return cinfo->master->overshoot_deringing;
+  case JBOOLEAN_BUFFER_SYMBOLS:
+    return cinfo->master->buffer_symbols;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -104,6 +110,7 @@ jpeg_c_float_param_supported (const j_compress_ptr cinfo, J_FLOAT_PARAM param)
   case JFLOAT_LAMBDA_LOG_SCALE1:
   case JFLOAT_LAMBDA_LOG_SCALE2:
   case JFLOAT_TRELLIS_DELTA_DC_WEIGHT:
+  case JFLOAT_TRELLIS_LOOP_EPSILON:
     return TRUE;
   }
 
@@ -124,6 +131,9 @@ jpeg_c_set_float_param (j_compress_ptr cinfo, J_FLOAT_PARAM param, float value)
   case JFLOAT_TRELLIS_DELTA_DC_WEIGHT:
     cinfo->master->trellis_delta_dc_weight = value;
     break;
+  case JFLOAT_TRELLIS_LOOP_EPSILON:
+    cinfo->master->trellis_loop_epsilon = value;
+    break;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -140,6 +150,8 @@ jpeg_c_get_float_param (const j_compress_ptr cinfo, J_FLOAT_PARAM param)
     return cinfo->master->lambda_log_scale2;
   case JFLOAT_TRELLIS_DELTA_DC_WEIGHT:
     return cinfo->master->trellis_delta_dc_weight;
+  case JFLOAT_TRELLIS_LOOP_EPSILON:
+    return cinfo->master->trellis_loop_epsilon;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -158,6 +170,8 @@ jpeg_c_int_param_supported (const j_compress_ptr cinfo, J_INT_PARAM param)
   case JINT_BASE_QUANT_TBL_IDX:
   case JINT_DC_SCAN_OPT_MODE:
   case JINT_TRELLIS_SPEED_LEVEL:
+  case JINT_NUM_THREADS:
+  case JINT_SCAN_COST_MODE:
     return TRUE;
   }
 
@@ -196,6 +210,14 @@ jpeg_c_set_int_param (j_compress_ptr cinfo, J_INT_PARAM param, int value)
     if (value >= 0 && value <= 10)
       cinfo->master->trellis_speed_level = value;
     break;
+  case JINT_NUM_THREADS:
+    if (value >= 1)
+      cinfo->master->num_threads = value;
+    break;
+  case JINT_SCAN_COST_MODE:
+    if (value >= 0 && value <= 2)
+      cinfo->master->scan_cost_mode = value;
+    break;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
@@ -218,6 +240,10 @@ jpeg_c_get_int_param (const j_compress_ptr cinfo, J_INT_PARAM param)
     return cinfo->master->dc_scan_opt_mode;
   case JINT_TRELLIS_SPEED_LEVEL:
     return cinfo->master->trellis_speed_level;
+  case JINT_NUM_THREADS:
+    return cinfo->master->num_threads;
+  case JINT_SCAN_COST_MODE:
+    return cinfo->master->scan_cost_mode;
   default:
     ERREXIT(cinfo, JERR_BAD_PARAM);
   }
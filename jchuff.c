@@ -1124,6 +1124,60 @@ jpeg_gen_optimal_table(j_compress_ptr cinfo, JHUFF_TBL *htbl, long freq[])
 }
 
 
+/*
+ * Count the bits needed to code the symbols tallied in freq[] with the given
+ * table, excluding magnitude bits.  Symbols that have no code in the table are
+ * charged the maximum code length.
+ */
+
+GLOBAL(double)
+jpeg_huff_table_cost(const JHUFF_TBL *htbl, const long freq[])
+{
+  int codesize[256];
+  int l, i, p;
+  double cost = 0.0;
+
+  memset(codesize, 0, sizeof(codesize));
+  p = 0;
+  for (l = 1; l <= 16; l++) {
+    for (i = 0; i < (int)htbl->bits[l] && p < 256; i++)
+      codesize[htbl->huffval[p++]] = l;
+  }
+
+  for (i = 0; i < 256; i++) {
+    if (freq[i])
+      cost += (double)freq[i] * (codesize[i] ? codesize[i] : 16);
+  }
+  return cost;
+}
+
+
+/*
+ * Generate an optimal table at the end of a trellis pass.  This also adds the
+ * size of the pass's symbols, coded with the table that the trellis used and
+ * with the new one, to cinfo->master->trellis_bits_before and
+ * trellis_bits_after.  The master control uses these to stop the trellis
+ * loops once the tables no longer improve.
+ */
+
+GLOBAL(void)
+jpeg_gen_trellis_table(j_compress_ptr cinfo, JHUFF_TBL *htbl, long freq[])
+{
+  long counts[HUFFMAN_ALPHABET_SIZE];
+
+  if (cinfo->master->trellis_loop_epsilon <= 0.0f) {
+    jpeg_gen_optimal_table(cinfo, htbl, freq);
+    return;
+  }
+
+  /* jpeg_gen_optimal_table() clobbers freq[] */
+  memcpy(counts, freq, sizeof(counts));
+  cinfo->master->trellis_bits_before += jpeg_huff_table_cost(htbl, counts);
+  jpeg_gen_optimal_table(cinfo, htbl, freq);
+  cinfo->master->trellis_bits_after += jpeg_huff_table_cost(htbl, counts);
+}
+
+
 /*
  * Finish up a statistics-gathering pass and create the new Huffman tables.
  */
@@ -1152,14 +1206,20 @@ finish_pass_gather(j_compress_ptr cinfo)
       htblptr = &cinfo->dc_huff_tbl_ptrs[dctbl];
       if (*htblptr == NULL)
         *htblptr = jpeg_alloc_huff_table((j_common_ptr)cinfo);
-      jpeg_gen_optimal_table(cinfo, *htblptr, entropy->dc_count_ptrs[dctbl]);
+      if (cinfo->master->trellis_passes)
+        jpeg_gen_trellis_table(cinfo, *htblptr, entropy->dc_count_ptrs[dctbl]);
+      else
+        jpeg_gen_optimal_table(cinfo, *htblptr, entropy->dc_count_ptrs[dctbl]);
       did_dc[dctbl] = TRUE;
     }
     if (!did_ac[actbl]) {
       htblptr = &cinfo->ac_huff_tbl_ptrs[actbl];
       if (*htblptr == NULL)
         *htblptr = jpeg_alloc_huff_table((j_common_ptr)cinfo);
-      jpeg_gen_optimal_table(cinfo, *htblptr, entropy->ac_count_ptrs[actbl]);
+      if (cinfo->master->trellis_passes)
+        jpeg_gen_trellis_table(cinfo, *htblptr, entropy->ac_count_ptrs[actbl]);
+      else
+        jpeg_gen_optimal_table(cinfo, *htblptr, entropy->ac_count_ptrs[actbl]);
       did_ac[actbl] = TRUE;
     }
   }
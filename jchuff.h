@@ -40,10 +40,40 @@ typedef struct {
 EXTERN(void) jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC,
                                      int tblno, c_derived_tbl **pdtbl);
 
+/* Huffman code lengths in the form used by trellis quantization.
+ * ac_bits[r][n] is the number of bits needed to code an AC coefficient with n
+ * magnitude bits after a run of r zeros, including any ZRL codes.  dc_bits[n]
+ * and eob_bits[n] are the number of bits needed to code a DC difference or an
+ * EOBn run with n magnitude bits.  ac_bits is also read by the SIMD trellis
+ * code, so its layout must not change.
+ */
+typedef struct {
+  float ac_bits[DCTSIZE2][16];
+  float dc_bits[16];
+  float eob_bits[16];
+} trellis_rates;
+
+EXTERN(void) jpeg_make_trellis_rates(const c_derived_tbl *dctbl,
+                                     const c_derived_tbl *actbl,
+                                     trellis_rates *rates);
+
 /* Generate an optimal table definition given the specified counts */
 EXTERN(void) quantize_trellis
-        (j_compress_ptr cinfo, c_derived_tbl *dctbl, c_derived_tbl *actbl, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
-                 JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
+        (j_compress_ptr cinfo, trellis_context *ctx, const trellis_rates *rates, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
+                 int qtblno, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
+         JBLOCKROW coef_blocks_above, JBLOCKROW src_above);
+EXTERN(void) quantize_trellis_ac
+        (j_compress_ptr cinfo, trellis_context *ctx,
+         const trellis_rates *rates, JBLOCKROW coef_blocks, JBLOCKROW src,
+         JDIMENSION num_blocks, int qtblno);
+EXTERN(void) quantize_trellis_dc
+        (j_compress_ptr cinfo, trellis_context *ctx,
+         const trellis_rates *rates, JBLOCKROW coef_blocks, JBLOCKROW src,
+         JDIMENSION num_blocks, int qtblno,
+         double *norm_src, double *norm_coef, JCOEF *last_dc_val,
          JBLOCKROW coef_blocks_above, JBLOCKROW src_above);
 EXTERN(void) jpeg_gen_optimal_table(j_compress_ptr cinfo, JHUFF_TBL *htbl,
                                     long freq[]);
+EXTERN(double) jpeg_huff_table_cost(const JHUFF_TBL *htbl, const long freq[]);
+EXTERN(void) jpeg_gen_trellis_table(j_compress_ptr cinfo, JHUFF_TBL *htbl,
+                                    long freq[]);
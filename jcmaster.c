@@ -25,6 +25,8 @@
 #include "jcmaster.h"
 #include "jmemsys.h"
 #include "jconfigint.h"
+#include "jthread.h"
+#include <setjmp.h>
 
 
 /*
@@ -440,6 +442,43 @@ validate_script(j_compress_ptr cinfo)
 #endif /* NEED_SCAN_SCRIPT */
 
 
+#ifdef NEED_SCAN_SCRIPT
+
+LOCAL(void)
+set_script_scan_parameters(j_compress_ptr cinfo, int scan_number)
+/* Set up the scan parameters for the given entry of the scan script */
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  const jpeg_scan_info *scanptr = cinfo->scan_info + scan_number;
+  int ci;
+
+  cinfo->comps_in_scan = scanptr->comps_in_scan;
+  for (ci = 0; ci < scanptr->comps_in_scan; ci++) {
+    cinfo->cur_comp_info[ci] =
+      &cinfo->comp_info[scanptr->component_index[ci]];
+  }
+  cinfo->Ss = scanptr->Ss;
+  cinfo->Se = scanptr->Se;
+  cinfo->Ah = scanptr->Ah;
+  cinfo->Al = scanptr->Al;
+  if (cinfo->master->optimize_scans) {
+    /* luma frequency split passes */
+    if (scan_number >= cinfo->master->num_scans_luma_dc +
+                       3 * cinfo->master->Al_max_luma + 2 &&
+        scan_number < cinfo->master->num_scans_luma)
+      cinfo->Al = master->best_Al_luma;
+    /* chroma frequency split passes */
+    if (scan_number >= cinfo->master->num_scans_luma +
+                       cinfo->master->num_scans_chroma_dc +
+                       (6 * cinfo->master->Al_max_chroma + 4) &&
+        scan_number < cinfo->num_scans)
+      cinfo->Al = master->best_Al_chroma;
+  }
+}
+
+#endif /* NEED_SCAN_SCRIPT */
+
+
 LOCAL(void)
 select_scan_parameters(j_compress_ptr cinfo)
 /* Set up the scan parameters for the current scan */
@@ -468,30 +507,7 @@ select_scan_parameters(j_compress_ptr cinfo)
   }
   else if (cinfo->scan_info != NULL) {
     /* Prepare for current scan --- the script is already validated */
-    const jpeg_scan_info *scanptr = cinfo->scan_info + master->scan_number;
-
-    cinfo->comps_in_scan = scanptr->comps_in_scan;
-    for (ci = 0; ci < scanptr->comps_in_scan; ci++) {
-      cinfo->cur_comp_info[ci] =
-        &cinfo->comp_info[scanptr->component_index[ci]];
-    }
-    cinfo->Ss = scanptr->Ss;
-    cinfo->Se = scanptr->Se;
-    cinfo->Ah = scanptr->Ah;
-    cinfo->Al = scanptr->Al;
-    if (cinfo->master->optimize_scans) {
-      /* luma frequency split passes */
-      if (master->scan_number >= cinfo->master->num_scans_luma_dc +
-                                 3 * cinfo->master->Al_max_luma + 2 &&
-          master->scan_number < cinfo->master->num_scans_luma)
-        cinfo->Al = master->best_Al_luma;
-      /* chroma frequency split passes */
-      if (master->scan_number >= cinfo->master->num_scans_luma +
-                                 cinfo->master->num_scans_chroma_dc +
-                                 (6 * cinfo->master->Al_max_chroma + 4) &&
-          master->scan_number < cinfo->num_scans)
-        cinfo->Al = master->best_Al_chroma;
-  }
+    set_script_scan_parameters(cinfo, master->scan_number);
     /* save value for later retrieval during printout of scans */
     master->actual_Al[master->scan_number] = cinfo->Al;
   } else
@@ -601,6 +617,215 @@ per_scan_setup(j_compress_ptr cinfo)
 }
 
 
+/*
+ * Estimated scan sizes.
+ *
+ * With scan_cost_mode != 0, the candidate scans are not encoded.  The Huffman
+ * optimization pass of each candidate also reports the size of the scan coded
+ * with the resulting tables (see finish_pass_gather_phuff()), select_scans()
+ * decides from these estimates, and only the chosen scans are then encoded,
+ * directly to the destination.  In mode 2, the optimization passes gather
+ * statistics from every SCAN_SAMPLE_INTERVAL-th iMCU row only, and the size is
+ * scaled up to the whole image.
+ */
+
+#define SCAN_SAMPLE_INTERVAL  4
+
+LOCAL(boolean)
+estimate_scan_sizes(j_compress_ptr cinfo)
+{
+  return cinfo->master->optimize_scans && cinfo->master->scan_cost_mode != 0 &&
+         cinfo->progressive_mode && cinfo->optimize_coding &&
+         !cinfo->arith_code && cinfo->coef->encode_scan != NULL;
+}
+
+
+/* Encode one scan of the script, including its Huffman optimization pass,
+ * with cinfo->coef->encode_scan().
+ */
+
+LOCAL(void)
+encode_whole_scan(j_compress_ptr cinfo, int scan_number)
+{
+  JDIMENSION num_MCUs;
+
+  set_script_scan_parameters(cinfo, scan_number);
+  per_scan_setup(cinfo);
+  num_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+
+  /* Huffman optimization pass (not needed for DC refinement scans) */
+  if (cinfo->Ss != 0 || cinfo->Ah == 0) {
+    (*cinfo->entropy->start_pass) (cinfo, TRUE);
+    (*cinfo->coef->encode_scan) (cinfo, 0, num_MCUs);
+    (*cinfo->entropy->finish_pass) (cinfo);
+  }
+
+  /* Output pass */
+  (*cinfo->entropy->start_pass) (cinfo, FALSE);
+  if (scan_number == 0)
+    (*cinfo->marker->write_frame_header) (cinfo);
+  (*cinfo->marker->write_scan_header) (cinfo);
+  (*cinfo->coef->encode_scan) (cinfo, 0, num_MCUs);
+  (*cinfo->entropy->finish_pass) (cinfo);
+}
+
+
+/*
+ * Scan arena.
+ *
+ * The candidate scans are encoded into fixed-size chunks allocated from the
+ * image pool, rather than into separate buffers that are grown (and copied)
+ * as they fill up.  A scan that does not fit in one chunk continues in the
+ * next one, so its output is a list of extents.  As soon as select_scans()
+ * rules a candidate scan out, its extents are put on a free list, and their
+ * chunks are reused by the scans encoded after it.  Thus, the arena only ever
+ * holds the scans that may still be written, plus the scan being encoded.  The
+ * chosen scans are copied from the arena directly to the real destination,
+ * which is the only copy that the destination manager interface allows, and
+ * the chunks are released with the image pool.
+ *
+ * The chunks are sized from the number of coefficients in the image (1/64 of
+ * one bit per coefficient), so that the partly filled last chunk of each scan
+ * wastes little space.
+ */
+
+#define MIN_ARENA_CHUNK  4096
+#define MAX_ARENA_CHUNK  ((size_t)1 << 20)
+
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+
+  scan_extent *extent;          /* extent being written */
+  scan_extent **link;           /* where to link the next extent */
+} scan_destination_mgr;
+
+typedef scan_destination_mgr *scan_dest_ptr;
+
+
+LOCAL(void)
+start_scan_extent(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  scan_dest_ptr dest = (scan_dest_ptr) cinfo->dest;
+  scan_extent *extent;
+
+  if (master->arena_free_list != NULL) {
+    extent = master->arena_free_list;
+    master->arena_free_list = extent->next;
+  } else {
+    extent = (scan_extent *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  sizeof(scan_extent));
+    extent->data = (JOCTET *)
+      (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  master->arena_chunk_size);
+  }
+  extent->size = 0;
+  extent->next = NULL;
+  *dest->link = extent;
+  dest->link = &extent->next;
+  dest->extent = extent;
+
+  dest->pub.next_output_byte = extent->data;
+  dest->pub.free_in_buffer = master->arena_chunk_size;
+}
+
+
+LOCAL(void)
+end_scan_extent(j_compress_ptr cinfo, size_t size)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  scan_dest_ptr dest = (scan_dest_ptr) cinfo->dest;
+
+  dest->extent->size = size;
+  master->scan_size[master->scan_number] += (unsigned long)size;
+}
+
+
+METHODDEF(void)
+init_scan_destination(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  scan_dest_ptr dest = (scan_dest_ptr) cinfo->dest;
+
+  master->scan_extents[master->scan_number] = NULL;
+  master->scan_size[master->scan_number] = 0;
+  dest->link = &master->scan_extents[master->scan_number];
+  start_scan_extent(cinfo);
+}
+
+
+METHODDEF(boolean)
+empty_scan_output_buffer(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+
+  /* The whole chunk is full, whatever next_output_byte says */
+  end_scan_extent(cinfo, master->arena_chunk_size);
+  start_scan_extent(cinfo);
+  return TRUE;
+}
+
+
+METHODDEF(void)
+term_scan_destination(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+
+  end_scan_extent(cinfo,
+                  master->arena_chunk_size - cinfo->dest->free_in_buffer);
+}
+
+
+/* Release the output of num_scans consecutive candidate scans, starting at
+ * scan_idx, once select_scans() has decided not to write them.
+ */
+
+LOCAL(void)
+release_scans(j_compress_ptr cinfo, int scan_idx, int num_scans)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  scan_extent *extent;
+  int i;
+
+  for (i = scan_idx; i < scan_idx + num_scans; i++) {
+    if (master->scan_buffer[i] != NULL) {
+      free(master->scan_buffer[i]);
+      master->scan_buffer[i] = NULL;
+    }
+    if (master->scan_extents[i] != NULL) {
+      extent = master->scan_extents[i];
+      while (extent->next != NULL)
+        extent = extent->next;
+      extent->next = master->arena_free_list;
+      master->arena_free_list = master->scan_extents[i];
+      master->scan_extents[i] = NULL;
+    }
+  }
+}
+
+
+/* Return the destination manager that writes the current scan to the arena */
+
+LOCAL(struct jpeg_destination_mgr *)
+scan_arena_dest(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  scan_dest_ptr dest;
+
+  if (master->scan_dest == NULL) {
+    dest = (scan_dest_ptr)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                  sizeof(scan_destination_mgr));
+    dest->pub.init_destination = init_scan_destination;
+    dest->pub.empty_output_buffer = empty_scan_output_buffer;
+    dest->pub.term_destination = term_scan_destination;
+    master->scan_dest = (struct jpeg_destination_mgr *)dest;
+  }
+  return master->scan_dest;
+}
+
+
 /*
  * Per-pass setup.
  * This is called at the beginning of each pass.  We determine which modules
@@ -615,6 +840,7 @@ prepare_for_pass(j_compress_ptr cinfo)
   my_master_ptr master = (my_master_ptr)cinfo->master;
   cinfo->master->trellis_passes =
     master->pass_number < master->pass_number_scan_opt_base;
+  cinfo->master->scan_sample_interval = 1;
 
   switch (master->pass_type) {
   case main_pass:
@@ -629,6 +855,9 @@ prepare_for_pass(j_compress_ptr cinfo)
       (*cinfo->prep->start_pass) (cinfo, JBUF_PASS_THRU);
     }
     (*cinfo->fdct->start_pass) (cinfo);
+    if (!cinfo->master->trellis_quant && cinfo->master->scan_cost_mode == 2 &&
+        estimate_scan_sizes(cinfo))
+      cinfo->master->scan_sample_interval = SCAN_SAMPLE_INTERVAL;
     (*cinfo->entropy->start_pass) (cinfo, (cinfo->optimize_coding || cinfo->master->trellis_quant) && !cinfo->arith_code);
     (*cinfo->coef->start_pass) (cinfo,
                                 (master->total_passes > 1 ?
@@ -647,6 +876,15 @@ prepare_for_pass(j_compress_ptr cinfo)
     /* Do Huffman optimization for a scan after the first one. */
     select_scan_parameters(cinfo);
     per_scan_setup(cinfo);
+    if (!cinfo->master->trellis_passes && estimate_scan_sizes(cinfo)) {
+      /* Also gather DC refinement scans, which yields their size */
+      if (cinfo->master->scan_cost_mode == 2)
+        cinfo->master->scan_sample_interval = SCAN_SAMPLE_INTERVAL;
+      (*cinfo->entropy->start_pass) (cinfo, TRUE);
+      (*cinfo->coef->start_pass) (cinfo, JBUF_CRANK_DEST);
+      master->pub.call_pass_startup = FALSE;
+      break;
+    }
     if (cinfo->Ss != 0 || cinfo->Ah == 0 || cinfo->arith_code ||
         cinfo->master->lossless) {
       (*cinfo->entropy->start_pass) (cinfo, TRUE);
@@ -670,9 +908,7 @@ prepare_for_pass(j_compress_ptr cinfo)
     }
     if (cinfo->master->optimize_scans) {
       master->saved_dest = cinfo->dest;
-      cinfo->dest = NULL;
-      master->scan_size[master->scan_number] = 0;
-      jpeg_mem_dest_internal(cinfo, &master->scan_buffer[master->scan_number], &master->scan_size[master->scan_number], JPOOL_IMAGE);
+      cinfo->dest = scan_arena_dest(cinfo);
       (*cinfo->dest->init_destination)(cinfo);
     }
     (*cinfo->entropy->start_pass) (cinfo, FALSE);
@@ -696,6 +932,8 @@ prepare_for_pass(j_compress_ptr cinfo)
         }
       }
     }
+    cinfo->master->trellis_bits_before = 0.0;
+    cinfo->master->trellis_bits_after = 0.0;
     (*cinfo->entropy->start_pass) (cinfo, !cinfo->arith_code);
     (*cinfo->coef->start_pass) (cinfo, JBUF_REQUANT);
     master->pub.call_pass_startup = FALSE;
@@ -709,8 +947,10 @@ prepare_for_pass(j_compress_ptr cinfo)
 
   /* Set up progress monitor's pass info if present */
   if (cinfo->progress != NULL) {
-    cinfo->progress->completed_passes = master->pass_number;
-    cinfo->progress->total_passes = master->total_passes;
+    cinfo->progress->completed_passes =
+      master->pass_number - master->skipped_passes;
+    cinfo->progress->total_passes =
+      master->total_passes - master->skipped_passes;
   }
 }
 
@@ -736,23 +976,8 @@ pass_startup(j_compress_ptr cinfo)
 
 
 LOCAL(void)
-copy_buffer (j_compress_ptr cinfo, int scan_idx)
+copy_to_dest (j_compress_ptr cinfo, const JOCTET *src, size_t size)
 {
-  my_master_ptr master = (my_master_ptr) cinfo->master;
-  
-  unsigned long size = master->scan_size[scan_idx];
-  unsigned char * src = master->scan_buffer[scan_idx];
-  int i;
-  
-  if (cinfo->err->trace_level > 0) {
-    fprintf(stderr, "SCAN ");
-    for (i = 0; i < cinfo->scan_info[scan_idx].comps_in_scan; i++)
-      fprintf(stderr, "%s%d", (i==0)?"":",", cinfo->scan_info[scan_idx].component_index[i]);
-    fprintf(stderr, ": %d %d", cinfo->scan_info[scan_idx].Ss, cinfo->scan_info[scan_idx].Se);
-    fprintf(stderr, " %d %d", cinfo->scan_info[scan_idx].Ah, master->actual_Al[scan_idx]);
-    fprintf(stderr, "\n");
-  }
-  
   while (size >= cinfo->dest->free_in_buffer)
   {
     memcpy(cinfo->dest->next_output_byte, src, cinfo->dest->free_in_buffer);
@@ -770,6 +995,38 @@ copy_buffer (j_compress_ptr cinfo, int scan_idx)
   cinfo->dest->free_in_buffer -= size;
 }
 
+LOCAL(void)
+copy_buffer (j_compress_ptr cinfo, int scan_idx)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  scan_extent *extent;
+  int i;
+  
+  if (cinfo->err->trace_level > 0) {
+    fprintf(stderr, "SCAN ");
+    for (i = 0; i < cinfo->scan_info[scan_idx].comps_in_scan; i++)
+      fprintf(stderr, "%s%d", (i==0)?"":",", cinfo->scan_info[scan_idx].component_index[i]);
+    fprintf(stderr, ": %d %d", cinfo->scan_info[scan_idx].Ss, cinfo->scan_info[scan_idx].Se);
+    fprintf(stderr, " %d %d", cinfo->scan_info[scan_idx].Ah, master->actual_Al[scan_idx]);
+    fprintf(stderr, "\n");
+  }
+
+  /* Only the chosen scans are encoded when their sizes were estimated */
+  if (estimate_scan_sizes(cinfo)) {
+    encode_whole_scan(cinfo, scan_idx);
+    return;
+  }
+
+  if (master->scan_buffer[scan_idx] != NULL)
+    copy_to_dest(cinfo, master->scan_buffer[scan_idx],
+                 master->scan_size[scan_idx]);
+  else {
+    for (extent = master->scan_extents[scan_idx]; extent != NULL;
+         extent = extent->next)
+      copy_to_dest(cinfo, extent->data, extent->size);
+  }
+}
+
 LOCAL(void)
 select_scans (j_compress_ptr cinfo, int next_scan_number)
 {
@@ -792,11 +1049,17 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       cost += master->scan_size[next_scan_number-1];
       for (i = 0; i < Al; i++)
         cost += master->scan_size[3 + 3*i];
+      /* the frequency split scans replace the first scans at the chosen Al */
+      release_scans(cinfo, next_scan_number-2, 2);
       
       if (Al == 0 || cost < master->best_cost) {
         master->best_cost = cost;
         master->best_Al_luma = Al;
       } else {
+        /* only the refinements below the chosen Al are written */
+        int first = 3 + 3*master->best_Al_luma;
+
+        release_scans(cinfo, first, luma_freq_split_scan_start - first);
         master->scan_number = luma_freq_split_scan_start - 1;
         master->pass_number = passes_per_scan * (master->scan_number + 1) - 1 + master->pass_number_scan_opt_base;
       }
@@ -815,14 +1078,21 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       cost += master->scan_size[next_scan_number-1];
       
       if (cost < master->best_cost) {
+        if (master->best_freq_split_idx_luma == 0)
+          release_scans(cinfo, luma_freq_split_scan_start, 1);
+        else
+          release_scans(cinfo, luma_freq_split_scan_start+2*(master->best_freq_split_idx_luma-1)+1, 2);
         master->best_cost = cost;
         master->best_freq_split_idx_luma = idx;
-      }
+      } else
+        release_scans(cinfo, next_scan_number-2, 2);
       
       /* if after testing first 3, no split is the best, don't search further */
       if ((idx == 2 && master->best_freq_split_idx_luma == 0) ||
           (idx == 3 && master->best_freq_split_idx_luma != 2) ||
           (idx == 4 && master->best_freq_split_idx_luma != 4)) {
+        release_scans(cinfo, next_scan_number,
+                      cinfo->master->num_scans_luma - next_scan_number);
         master->scan_number = cinfo->master->num_scans_luma - 1;
         master->pass_number = passes_per_scan * (master->scan_number + 1) - 1 + master->pass_number_scan_opt_base;
         master->pub.is_last_pass = (master->pass_number == master->total_passes - 1);
@@ -836,6 +1106,12 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       base_scan_idx = cinfo->master->num_scans_luma;
 
       master->interleave_chroma_dc = master->scan_size[base_scan_idx] <= master->scan_size[base_scan_idx+1] + master->scan_size[base_scan_idx+2];
+      if (cinfo->master->dc_scan_opt_mode == 0)
+        release_scans(cinfo, base_scan_idx, 3);
+      else if (master->interleave_chroma_dc && cinfo->master->dc_scan_opt_mode != 1)
+        release_scans(cinfo, base_scan_idx+1, 2);
+      else
+        release_scans(cinfo, base_scan_idx, 1);
       
     } else if (next_scan_number > cinfo->master->num_scans_luma +
                                   cinfo->master->num_scans_chroma_dc &&
@@ -854,11 +1130,15 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
           cost += master->scan_size[base_scan_idx + 4 + 6*i];
           cost += master->scan_size[base_scan_idx + 5 + 6*i];
         }
+        release_scans(cinfo, next_scan_number-4, 4);
         
         if (Al == 0 || cost < master->best_cost) {
           master->best_cost = cost;
           master->best_Al_chroma = Al;
         } else {
+          int first = base_scan_idx + 6*master->best_Al_chroma + 4;
+
+          release_scans(cinfo, first, chroma_freq_split_scan_start - first);
           master->scan_number = chroma_freq_split_scan_start - 1;
           master->pass_number = passes_per_scan * (master->scan_number + 1) - 1 + master->pass_number_scan_opt_base;
         }
@@ -879,14 +1159,21 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
         cost += master->scan_size[next_scan_number-1];
         
         if (cost < master->best_cost) {
+          if (master->best_freq_split_idx_chroma == 0)
+            release_scans(cinfo, chroma_freq_split_scan_start, 2);
+          else
+            release_scans(cinfo, chroma_freq_split_scan_start+4*(master->best_freq_split_idx_chroma-1)+2, 4);
           master->best_cost = cost;
           master->best_freq_split_idx_chroma = idx;
-        }
+        } else
+          release_scans(cinfo, next_scan_number-4, 4);
         
         /* if after testing first 3, no split is the best, don't search further */
         if ((idx == 2 && master->best_freq_split_idx_chroma == 0) ||
             (idx == 3 && master->best_freq_split_idx_chroma != 2) ||
             (idx == 4 && master->best_freq_split_idx_chroma != 4)) {
+          release_scans(cinfo, next_scan_number,
+                        cinfo->num_scans - next_scan_number);
           master->scan_number = cinfo->num_scans - 1;
           master->pass_number = passes_per_scan * (master->scan_number + 1) - 1 + master->pass_number_scan_opt_base;
           master->pub.is_last_pass = (master->pass_number == master->total_passes - 1);
@@ -896,7 +1183,7 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
   }
   
   if (master->scan_number == cinfo->num_scans - 1) {
-    int i, Al;
+    int Al;
     int min_Al = MIN(master->best_Al_luma, master->best_Al_chroma);
     
     copy_buffer(cinfo, 0);
@@ -954,13 +1241,524 @@ select_scans (j_compress_ptr cinfo, int next_scan_number)
       }
     }
     
-    /* free the memory allocated for buffers */
-    for (i = 0; i < cinfo->num_scans; i++)
-      if (master->scan_buffer[i])
-        free(master->scan_buffer[i]);
+    release_scans(cinfo, 0, cinfo->num_scans);
   }
 }
 
+
+/*
+ * Concurrent trial encoding of the candidate scans.
+ *
+ * With optimize_scans, every candidate scan is encoded into its own buffer
+ * (one Huffman optimization pass and one output pass each), and select_scans()
+ * then picks the scans to keep.  Each candidate scan depends only on the
+ * coefficient buffer and on its own parameters, so when more than one thread
+ * is allowed, the candidates are encoded concurrently instead.  Every task
+ * works on a private copy of the compression object, with its own memory
+ * manager, error handler, entropy encoder, marker writer, Huffman tables, and
+ * destination, and it reads the coefficient buffer through
+ * cinfo->coef->encode_scan().  The tasks encode into malloc'ed buffers rather
+ * than into the scan arena, whose free list is not thread-safe, but
+ * select_scans() frees the buffers of the candidates that it rules out just as
+ * it recycles arena chunks.
+ *
+ * The only parameters that are not known up front are the Al values of the
+ * frequency split scans, which select_scans() decides after the successive
+ * approximation scans.  select_scans() is therefore replayed serially, in
+ * scan order, and the candidates are encoded in batches as soon as their
+ * parameters are known.  The chosen scans and the output are the same as with
+ * serial encoding.
+ */
+
+typedef struct {
+  struct jpeg_error_mgr pub;    /* "public" fields */
+  jmp_buf setjmp_buffer;        /* for return to encode_trial_scan() */
+} trial_error_mgr;
+
+typedef struct {
+  struct jpeg_compress_struct cinfo; /* private copy of the parent object */
+  trial_error_mgr err;
+  jpeg_component_info comp_info[MAX_COMPONENTS];
+  JHUFF_TBL dc_huff_tbls[NUM_HUFF_TBLS];
+  JHUFF_TBL ac_huff_tbls[NUM_HUFF_TBLS];
+  int scan_number;              /* index in scan_info[] */
+  unsigned char *buffer;        /* encoded scan (malloc'ed) */
+  unsigned long size;
+  boolean failed;               /* TRUE if err holds an error */
+} trial_scan;
+
+typedef struct {
+  j_compress_ptr cinfo;
+  trial_scan *trials;
+} trial_batch;
+
+
+METHODDEF(void)
+trial_error_exit(j_common_ptr cinfo)
+{
+  trial_error_mgr *err = (trial_error_mgr *)cinfo->err;
+
+  longjmp(err->setjmp_buffer, 1);
+}
+
+
+METHODDEF(void)
+trial_emit_message(j_common_ptr cinfo, int msg_level)
+{
+  /* Messages from the trial encodes are not reported. */
+}
+
+
+/* Make cinfo a private copy of parent for a task.  The copy still needs its
+ * own memory manager, and the modules that the task uses must be initialized
+ * with it.
+ */
+
+LOCAL(void)
+copy_compress_object(j_compress_ptr parent, j_compress_ptr cinfo,
+                     trial_error_mgr *err)
+{
+  *cinfo = *parent;
+  err->pub = *parent->err;
+  err->pub.error_exit = trial_error_exit;
+  err->pub.emit_message = trial_emit_message;
+  cinfo->err = &err->pub;
+  cinfo->mem = NULL;
+  cinfo->progress = NULL;
+  cinfo->dest = NULL;
+}
+
+
+METHODDEF(void)
+encode_trial_scan(void *arg, int task)
+{
+  trial_batch *batch = (trial_batch *)arg;
+  j_compress_ptr parent = batch->cinfo;
+  trial_scan *trial = &batch->trials[task];
+  j_compress_ptr cinfo = &trial->cinfo;
+  int i;
+
+  copy_compress_object(parent, cinfo, &trial->err);
+  trial->buffer = NULL;
+  trial->size = 0;
+  trial->failed = FALSE;
+
+  if (setjmp(trial->err.setjmp_buffer)) {
+    trial->failed = TRUE;
+    /* The destination may have replaced its buffer since trial->buffer was
+     * last updated.  Once trial->buffer is non-NULL, term_destination() can
+     * be called to retrieve the current one.
+     */
+    if (cinfo->dest != NULL && trial->buffer != NULL) {
+      (*cinfo->dest->term_destination) (cinfo);
+      free(trial->buffer);
+      trial->buffer = NULL;
+    }
+    if (cinfo->mem != NULL)
+      (*cinfo->mem->self_destruct) ((j_common_ptr)cinfo);
+    return;
+  }
+
+  jinit_memory_mgr((j_common_ptr)cinfo);
+  memcpy(trial->comp_info, parent->comp_info,
+         parent->num_components * sizeof(jpeg_component_info));
+  cinfo->comp_info = trial->comp_info;
+  for (i = 0; i < NUM_HUFF_TBLS; i++) {
+    if (parent->dc_huff_tbl_ptrs[i] != NULL) {
+      trial->dc_huff_tbls[i] = *parent->dc_huff_tbl_ptrs[i];
+      cinfo->dc_huff_tbl_ptrs[i] = &trial->dc_huff_tbls[i];
+    }
+    if (parent->ac_huff_tbl_ptrs[i] != NULL) {
+      trial->ac_huff_tbls[i] = *parent->ac_huff_tbl_ptrs[i];
+      cinfo->ac_huff_tbl_ptrs[i] = &trial->ac_huff_tbls[i];
+    }
+  }
+  if (cinfo->progressive_mode)
+    jinit_phuff_encoder(cinfo);
+  else
+    jinit_huff_encoder(cinfo);
+  jinit_marker_writer(cinfo);
+
+  /* The entropy encoder looks at the destination even when it only gathers
+   * statistics.
+   */
+  jpeg_mem_dest_internal(cinfo, &trial->buffer, &trial->size, JPOOL_IMAGE);
+  (*cinfo->dest->init_destination) (cinfo);
+  encode_whole_scan(cinfo, trial->scan_number);
+  (*cinfo->dest->term_destination) (cinfo);
+
+  (*cinfo->mem->self_destruct) ((j_common_ptr)cinfo);
+}
+
+
+/* Encode, on the pool, all candidate scans that have not been encoded yet and
+ * whose parameters are known once select_scans() has been replayed up to
+ * next_scan.
+ */
+
+LOCAL(void)
+encode_trial_batch(j_compress_ptr cinfo, jthread_pool *pool,
+                   trial_scan *trials, boolean *encoded, int next_scan)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  int luma_freq_split_scan_start = cinfo->master->num_scans_luma_dc +
+                                   3 * cinfo->master->Al_max_luma + 2;
+  int chroma_freq_split_scan_start = cinfo->master->num_scans_luma +
+                                     cinfo->master->num_scans_chroma_dc +
+                                     (6 * cinfo->master->Al_max_chroma + 4);
+  trial_batch batch;
+  int i, num_trials = 0;
+
+  for (i = 0; i < cinfo->num_scans; i++) {
+    if (encoded[i])
+      continue;
+    /* Frequency split scans use the Al chosen by the preceding scans */
+    if (i >= luma_freq_split_scan_start && i < cinfo->master->num_scans_luma &&
+        next_scan < luma_freq_split_scan_start)
+      continue;
+    if (i >= chroma_freq_split_scan_start &&
+        next_scan < chroma_freq_split_scan_start)
+      continue;
+    trials[num_trials++].scan_number = i;
+  }
+
+  batch.cinfo = cinfo;
+  batch.trials = trials;
+  jthread_pool_run(pool, encode_trial_scan, &batch, num_trials);
+
+  for (i = 0; i < num_trials; i++) {
+    if (trials[i].failed)
+      break;
+  }
+  if (i < num_trials) {
+    trial_scan *failed = &trials[i];
+
+    /* Release the scans encoded by this batch and by the earlier ones before
+     * reporting the error.
+     */
+    jthread_pool_destroy(pool);
+    for (i = 0; i < num_trials; i++)
+      free(trials[i].buffer);
+    for (i = 0; i < cinfo->num_scans; i++) {
+      free(master->scan_buffer[i]);
+      master->scan_buffer[i] = NULL;
+    }
+    cinfo->err->msg_code = failed->err.pub.msg_code;
+    memcpy(&cinfo->err->msg_parm, &failed->err.pub.msg_parm,
+           sizeof(cinfo->err->msg_parm));
+    (*cinfo->err->error_exit) ((j_common_ptr)cinfo);
+  }
+
+  for (i = 0; i < num_trials; i++) {
+    trial_scan *trial = &trials[i];
+
+    master->scan_buffer[trial->scan_number] = trial->buffer;
+    master->scan_size[trial->scan_number] = trial->size;
+    master->actual_Al[trial->scan_number] = trial->cinfo.Al;
+    encoded[trial->scan_number] = TRUE;
+  }
+}
+
+
+/* Encode all candidate scans concurrently, select the scans to keep, and write
+ * them to the destination.  This replaces all of the remaining Huffman
+ * optimization and output passes.  Returns FALSE if the scans must be encoded
+ * serially instead.
+ */
+
+LOCAL(boolean)
+encode_trial_scans(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  jthread_pool *pool;
+  trial_scan *trials;
+  boolean encoded[64];
+  int scan;
+
+  /* The tasks rely on the residency of the coefficient buffer (see
+   * jinit_c_coef_controller().)  When the scan sizes are only estimated,
+   * there are no trial encodes to run.
+   */
+  if (!cinfo->master->resident_coefs || cinfo->coef->encode_scan == NULL ||
+      estimate_scan_sizes(cinfo) ||
+      !cinfo->optimize_coding || cinfo->arith_code ||
+      cinfo->restart_interval != 0 || cinfo->restart_in_rows != 0)
+    return FALSE;
+
+  pool = jthread_pool_create(cinfo->master->num_threads);
+  if (pool == NULL)
+    return FALSE;
+
+  trials = (trial_scan *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                cinfo->num_scans * sizeof(trial_scan));
+  memset(encoded, 0, sizeof(encoded));
+  cinfo->master->trellis_passes = FALSE;
+
+  /* Replay the serial sequence of output passes */
+  scan = 0;
+  while (scan < cinfo->num_scans) {
+    if (!encoded[scan])
+      encode_trial_batch(cinfo, pool, trials, encoded, scan);
+    master->scan_number = scan;
+    select_scans(cinfo, scan + 1);
+    scan = master->scan_number + 1;
+  }
+  master->scan_number = scan;
+
+  jthread_pool_destroy(pool);
+  return TRUE;
+}
+
+
+/*
+ * Concurrent encoding of restart stripes.
+ *
+ * The restart intervals of a Huffman-coded sequential scan are independent of
+ * each other, since the entropy encoder flushes its bit buffer and resets the
+ * DC predictions at each restart marker.  Thus, when the coefficient buffer
+ * holds the whole image and more than one thread is allowed, the output pass
+ * of a single-scan image is replaced by encoding horizontal stripes of restart
+ * intervals concurrently, each on a private copy of the compression object
+ * with its own entropy encoder and destination, and by concatenating the
+ * stripes.
+ *
+ * Each stripe (except the last) spans a multiple of 8 restart intervals, so
+ * the private entropy encoders, which start over at RST0, number the markers
+ * within their stripes exactly as a serial encode would.  Only the RST7
+ * markers between the stripes are written here.  The output is therefore the
+ * same as with serial encoding.
+ */
+
+#define STRIPES_PER_THREAD  2
+
+typedef struct {
+  struct jpeg_compress_struct cinfo; /* private copy of the parent object */
+  trial_error_mgr err;
+  JDIMENSION start_MCU;         /* first MCU of the stripe */
+  JDIMENSION num_MCUs;
+  unsigned char *buffer;        /* encoded stripe (malloc'ed) */
+  unsigned long size;
+  boolean failed;               /* TRUE if err holds an error */
+} restart_stripe;
+
+typedef struct {
+  j_compress_ptr cinfo;
+  restart_stripe *stripes;
+} stripe_batch;
+
+
+METHODDEF(void)
+encode_restart_stripe(void *arg, int task)
+{
+  stripe_batch *batch = (stripe_batch *)arg;
+  restart_stripe *stripe = &batch->stripes[task];
+  j_compress_ptr cinfo = &stripe->cinfo;
+
+  copy_compress_object(batch->cinfo, cinfo, &stripe->err);
+  stripe->buffer = NULL;
+  stripe->size = 0;
+  stripe->failed = FALSE;
+
+  if (setjmp(stripe->err.setjmp_buffer)) {
+    stripe->failed = TRUE;
+    /* See encode_trial_scan() */
+    if (cinfo->dest != NULL && stripe->buffer != NULL) {
+      (*cinfo->dest->term_destination) (cinfo);
+      free(stripe->buffer);
+      stripe->buffer = NULL;
+    }
+    if (cinfo->mem != NULL)
+      (*cinfo->mem->self_destruct) ((j_common_ptr)cinfo);
+    return;
+  }
+
+  /* The Huffman tables and the component info are only read, so they are
+   * shared with the parent.
+   */
+  jinit_memory_mgr((j_common_ptr)cinfo);
+  jinit_huff_encoder(cinfo);
+  jpeg_mem_dest_internal(cinfo, &stripe->buffer, &stripe->size, JPOOL_IMAGE);
+  (*cinfo->dest->init_destination) (cinfo);
+  (*cinfo->entropy->start_pass) (cinfo, FALSE);
+  (*cinfo->coef->encode_scan) (cinfo, stripe->start_MCU, stripe->num_MCUs);
+  (*cinfo->entropy->finish_pass) (cinfo);
+  (*cinfo->dest->term_destination) (cinfo);
+
+  (*cinfo->mem->self_destruct) ((j_common_ptr)cinfo);
+}
+
+
+/* Encode the output pass of a single-scan sequential image as concurrent
+ * restart stripes, and write it to the destination.  Returns FALSE if the
+ * output pass must be run normally instead.
+ */
+
+LOCAL(boolean)
+encode_restart_stripes(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  static const JOCTET rst7[2] = { 0xFF, JPEG_RST0 + 7 };
+  JDIMENSION num_MCUs, num_groups, group_MCUs, start, end;
+  jthread_pool *pool;
+  restart_stripe *stripes;
+  stripe_batch batch;
+  int i, j, num_stripes;
+
+  /* The tasks rely on the residency of the coefficient buffer (see
+   * jinit_c_coef_controller().)
+   */
+  if (!cinfo->master->resident_coefs || cinfo->coef->encode_scan == NULL ||
+      cinfo->num_scans != 1 || cinfo->progressive_mode ||
+      cinfo->arith_code || cinfo->master->lossless ||
+      cinfo->master->optimize_scans ||
+      (cinfo->restart_interval == 0 && cinfo->restart_in_rows == 0))
+    return FALSE;
+
+  /* We need not repeat per-scan setup if prior optimization pass did it. */
+  if (!cinfo->optimize_coding) {
+    select_scan_parameters(cinfo);
+    per_scan_setup(cinfo);
+  }
+
+  /* Split the scan into groups of 8 restart intervals */
+  num_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  group_MCUs = 8 * (JDIMENSION)cinfo->restart_interval;
+  num_groups = (num_MCUs + group_MCUs - 1) / group_MCUs;
+  num_stripes = cinfo->master->num_threads * STRIPES_PER_THREAD;
+  if ((JDIMENSION)num_stripes > num_groups)
+    num_stripes = (int)num_groups;
+  if (num_stripes < 2)
+    return FALSE;
+
+  pool = jthread_pool_create(cinfo->master->num_threads);
+  if (pool == NULL)
+    return FALSE;
+
+  stripes = (restart_stripe *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                num_stripes * sizeof(restart_stripe));
+  for (i = 0; i < num_stripes; i++) {
+    start = (JDIMENSION)((size_t)num_groups * i / num_stripes) * group_MCUs;
+    end = (JDIMENSION)((size_t)num_groups * (i + 1) / num_stripes) *
+          group_MCUs;
+    stripes[i].start_MCU = start;
+    stripes[i].num_MCUs = MIN(end, num_MCUs) - start;
+  }
+
+  batch.cinfo = cinfo;
+  batch.stripes = stripes;
+  jthread_pool_run(pool, encode_restart_stripe, &batch, num_stripes);
+  jthread_pool_destroy(pool);
+
+  for (i = 0; i < num_stripes; i++) {
+    if (stripes[i].failed) {
+      cinfo->err->msg_code = stripes[i].err.pub.msg_code;
+      memcpy(&cinfo->err->msg_parm, &stripes[i].err.pub.msg_parm,
+             sizeof(cinfo->err->msg_parm));
+      /* Failed stripes have already released their buffers. */
+      for (j = 0; j < num_stripes; j++)
+        free(stripes[j].buffer);
+      (*cinfo->err->error_exit) ((j_common_ptr)cinfo);
+    }
+  }
+
+  /* We emit frame/scan headers now */
+  if (master->scan_number == 0)
+    (*cinfo->marker->write_frame_header) (cinfo);
+  (*cinfo->marker->write_scan_header) (cinfo);
+  for (i = 0; i < num_stripes; i++) {
+    if (i > 0)
+      copy_to_dest(cinfo, rst7, sizeof(rst7));
+    copy_to_dest(cinfo, stripes[i].buffer, stripes[i].size);
+    free(stripes[i].buffer);
+    stripes[i].buffer = NULL;
+  }
+
+  master->scan_number++;
+  return TRUE;
+}
+
+
+/*
+ * Record the estimated size of the current candidate scan after its Huffman
+ * optimization pass, and skip its output pass.
+ */
+
+LOCAL(void)
+finish_scan_estimate(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr) cinfo->master;
+  int interval = cinfo->master->scan_sample_interval;
+  double bits = cinfo->master->scan_data_bits;
+  double size;
+
+  if (interval > 1) {
+    JDIMENSION sampled_rows = (cinfo->total_iMCU_rows + interval - 1) /
+                              interval;
+    bits = bits * cinfo->total_iMCU_rows / sampled_rows;
+  }
+  /* Add the DHT marker (if any) and the SOS marker */
+  size = (bits + 7.0) / 8.0 + cinfo->master->scan_table_bytes +
+         (cinfo->master->scan_table_bytes ? 4 : 0) +
+         8 + 2 * cinfo->comps_in_scan;
+  master->scan_size[master->scan_number] = (unsigned long)size;
+
+  master->pass_type = huff_opt_pass;
+  master->pass_number++;
+  master->skipped_passes++;
+  select_scans(cinfo, master->scan_number + 1);
+  master->scan_number++;
+  if (master->scan_number >= cinfo->num_scans)
+    master->pub.is_last_pass = TRUE;
+}
+
+
+/*
+ * Decide whether the remaining trellis loops for the current component can be
+ * skipped.  This is called at the end of each trellis pass.  Once the Huffman
+ * tables regenerated from a loop's output would shrink that output by less
+ * than trellis_loop_epsilon, another loop is not worth its cost.  (If the
+ * tables do not change at all, then it would produce the same output.)  The
+ * skipped passes keep their slots in the pass numbering, since
+ * select_scan_parameters() derives the component from the pass number.  They
+ * are only dropped from the pass count reported to the progress monitor.
+ *
+ * Quantization table optimization is not supported, because it changes the
+ * quantization tables between loops on a schedule that does not follow the
+ * component boundaries.
+ */
+
+LOCAL(void)
+check_trellis_convergence(j_compress_ptr cinfo)
+{
+  my_master_ptr master = (my_master_ptr)cinfo->master;
+  int passes_per_loop = cinfo->master->use_scans_in_trellis ? 4 : 2;
+  int num_loops = cinfo->master->trellis_num_loops;
+  int loop, skip;
+
+  master->trellis_loop_bits_before += cinfo->master->trellis_bits_before;
+  master->trellis_loop_bits_after += cinfo->master->trellis_bits_after;
+
+  /* Wait for the last trellis pass of the loop */
+  if (master->pass_number % passes_per_loop != passes_per_loop - 1)
+    return;
+
+  loop = (master->pass_number / passes_per_loop) % num_loops;
+  if (loop < num_loops - 1 &&
+      master->trellis_loop_bits_before - master->trellis_loop_bits_after <
+      cinfo->master->trellis_loop_epsilon * master->trellis_loop_bits_before) {
+    skip = (num_loops - 1 - loop) * passes_per_loop;
+    TRACEMS2(cinfo, 1, JTRC_TRELLIS_CONVERGED, loop + 1, num_loops);
+    master->pass_number += skip;
+    master->skipped_passes += skip;
+  }
+
+  master->trellis_loop_bits_before = 0.0;
+  master->trellis_loop_bits_after = 0.0;
+}
+
+
 /*
  * Finish up at end of pass.
  */
@@ -969,6 +1767,7 @@ METHODDEF(void)
 finish_pass_master(j_compress_ptr cinfo)
 {
   my_master_ptr master = (my_master_ptr)cinfo->master;
+  c_pass_type finished_pass = master->pass_type;
 
   /* The entropy coder always needs an end-of-pass call,
    * either to analyze statistics or to flush its output buffer.
@@ -987,11 +1786,15 @@ finish_pass_master(j_compress_ptr cinfo)
     master->pass_type = output_pass;
     if (!cinfo->optimize_coding)
       master->scan_number++;
+    else if (estimate_scan_sizes(cinfo))
+      finish_scan_estimate(cinfo);
     }
     break;
   case huff_opt_pass:
     /* next pass is always output of current scan */
     master->pass_type = (master->pass_number < master->pass_number_scan_opt_base-1) ? trellis_pass : output_pass;
+    if (master->pass_type == output_pass && estimate_scan_sizes(cinfo))
+      finish_scan_estimate(cinfo);
     break;
   case output_pass:
     /* next pass is either optimization or output of next scan */
@@ -1028,10 +1831,34 @@ finish_pass_master(j_compress_ptr cinfo)
   }
       }
     }
+
+    if (cinfo->master->trellis_loop_epsilon > 0.0f &&
+        cinfo->optimize_coding && !cinfo->arith_code &&
+        !cinfo->master->trellis_q_opt)
+      check_trellis_convergence(cinfo);
     break;
   }
 
   master->pass_number++;
+
+  if (cinfo->master->trellis_passes &&
+      master->pass_number >= master->pass_number_scan_opt_base &&
+      cinfo->master->trellis_num_blocks > 0)
+    TRACEMS2(cinfo, 1, JTRC_TRELLIS_BYPASS,
+             (int)cinfo->master->trellis_num_bypassed,
+             (int)cinfo->master->trellis_num_blocks);
+
+  /* The candidate scans follow the main pass or the last trellis pass */
+  if ((finished_pass == main_pass || finished_pass == trellis_pass) &&
+      master->pass_number >= master->pass_number_scan_opt_base &&
+      cinfo->master->optimize_scans && encode_trial_scans(cinfo))
+    master->pub.is_last_pass = TRUE;
+
+  /* So may the output pass of a single-scan image with restart markers */
+  if (master->pass_type == output_pass &&
+      master->pass_number == master->total_passes - 1 &&
+      encode_restart_stripes(cinfo))
+    master->pub.is_last_pass = TRUE;
 }
 
 
@@ -1126,6 +1953,11 @@ jinit_c_master_control(j_compress_ptr cinfo, boolean transcode_only)
   master->jpeg_version = PACKAGE_NAME " version " VERSION " (build " BUILD ")";
   
   master->pass_number_scan_opt_base = 0;
+  master->trellis_loop_bits_before = 0.0;
+  master->trellis_loop_bits_after = 0.0;
+  master->skipped_passes = 0;
+  cinfo->master->trellis_num_blocks = 0;
+  cinfo->master->trellis_num_bypassed = 0;
   if (cinfo->master->trellis_quant) {
     if (cinfo->optimize_coding)
       master->pass_number_scan_opt_base =
@@ -1140,9 +1972,24 @@ jinit_c_master_control(j_compress_ptr cinfo, boolean transcode_only)
   
   if (cinfo->master->optimize_scans) {
     int i;
+    size_t num_coefs = 0;
+    jpeg_component_info *compptr;
+
     master->best_Al_chroma = 0;
     
-    for (i = 0; i < cinfo->num_scans; i++)
+    for (i = 0; i < cinfo->num_scans; i++) {
       master->scan_buffer[i] = NULL;
+      master->scan_extents[i] = NULL;
+    }
+
+    /* Size the scan arena chunks at 1/64 of one bit per coefficient */
+    for (i = 0, compptr = cinfo->comp_info; i < cinfo->num_components;
+         i++, compptr++)
+      num_coefs += (size_t)compptr->width_in_blocks *
+                   compptr->height_in_blocks * DCTSIZE2;
+    master->arena_chunk_size = MAX(num_coefs / 512, MIN_ARENA_CHUNK);
+    master->arena_chunk_size = MIN(master->arena_chunk_size, MAX_ARENA_CHUNK);
+    master->arena_free_list = NULL;
+    master->scan_dest = NULL;
   }
 }
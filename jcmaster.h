@@ -14,6 +14,15 @@
 
 /* Private state */
 
+/* A piece of the output of a candidate scan (see the scan arena in
+ * jcmaster.c)
+ */
+typedef struct scan_extent {
+  JOCTET *data;
+  size_t size;
+  struct scan_extent *next;
+} scan_extent;
+
 typedef enum {
   main_pass,                    /* input data, also do first output step */
   huff_opt_pass,                /* Huffman code optimization pass */
@@ -33,7 +42,8 @@ typedef struct {
 
   /* fields for scan optimisation */
   int pass_number_scan_opt_base; /* pass number where scan optimization begins */
-  unsigned char * scan_buffer[64]; /* buffer for a given scan */
+  unsigned char * scan_buffer[64]; /* malloc'ed buffer for a given scan (concurrent encoding only) */
+  scan_extent * scan_extents[64]; /* output of a given scan in the scan arena */
   unsigned long scan_size[64]; /* size for a given scan */
   int actual_Al[64]; /* actual value of Al used for a scan */
   unsigned long best_cost; /* bit count for best frequency split */
@@ -43,6 +53,14 @@ typedef struct {
   int best_Al_chroma; /* best value for Al found in scan search (luma) */
   boolean interleave_chroma_dc; /* indicate whether to interleave chroma DC scans */
   struct jpeg_destination_mgr * saved_dest; /* saved value of cinfo->dest */
+  struct jpeg_destination_mgr * scan_dest; /* destination for the scan arena */
+  scan_extent * arena_free_list; /* extents of released scans, for reuse */
+  size_t arena_chunk_size; /* size of the chunk behind each extent */
+
+  /* fields for early termination of trellis loops */
+  double trellis_loop_bits_before; /* est. size of current loop, old tables */
+  double trellis_loop_bits_after; /* est. size of current loop, new tables */
+  int skipped_passes; /* # of scheduled passes that were skipped */
 
   /*
    * This is here so we can add libjpeg-turbo version/build information to the
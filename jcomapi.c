@@ -15,6 +15,22 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jthread.h"
+
+
+/* Destroy the thread pool of a compression object, if it has one. */
+
+LOCAL(void)
+release_thread_pool(j_common_ptr cinfo)
+{
+  j_compress_ptr cinfo_c = (j_compress_ptr)cinfo;
+
+  if (!cinfo->is_decompressor && cinfo_c->master != NULL &&
+      cinfo_c->master->thread_pool != NULL) {
+    jthread_pool_destroy(cinfo_c->master->thread_pool);
+    cinfo_c->master->thread_pool = NULL;
+  }
+}
 
 
 /*
@@ -37,6 +53,8 @@ jpeg_abort(j_common_ptr cinfo)
   if (cinfo->mem == NULL)
     return;
 
+  release_thread_pool(cinfo);
+
   /* Releasing pools in reverse order might help avoid fragmentation
    * with some (brain-damaged) malloc libraries.
    */
@@ -74,8 +92,10 @@ jpeg_destroy(j_common_ptr cinfo)
 {
   /* We need only tell the memory manager to release everything. */
   /* NB: mem pointer is NULL if memory mgr failed to initialize. */
-  if (cinfo->mem != NULL)
+  if (cinfo->mem != NULL) {
+    release_thread_pool(cinfo);
     (*cinfo->mem->self_destruct) (cinfo);
+  }
   cinfo->mem = NULL;            /* be safe if jpeg_destroy is called twice */
   cinfo->global_state = 0;      /* mark it destroyed */
 }
@@ -493,6 +493,8 @@ jpeg_set_defaults(j_compress_ptr cinfo)
   jpeg_default_colorspace(cinfo);
 
   cinfo->master->dc_scan_opt_mode = 0;
+  cinfo->master->scan_cost_mode = 0;
+  cinfo->master->buffer_symbols = FALSE;
 
 #ifdef C_PROGRESSIVE_SUPPORTED
   if (cinfo->master->compress_profile == JCP_MAX_COMPRESSION) {
@@ -517,6 +519,7 @@ jpeg_set_defaults(j_compress_ptr cinfo)
   cinfo->master->trellis_q_opt = FALSE;
   cinfo->master->trellis_quant_dc = TRUE;
   cinfo->master->trellis_delta_dc_weight = 0.0;
+  cinfo->master->trellis_loop_epsilon = 0.0;
 }
 
 
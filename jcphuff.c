@@ -48,6 +48,37 @@
 #include "jpeg_nbits.h"
 
 
+/* When buffer_symbols is set, a statistics-gathering pass also records the
+ * symbols and extra bits that it counts, and the output pass for the same
+ * scan emits them with the new tables instead of traversing the coefficients
+ * again.  The stream is kept in a chain of chunks that are reused by every
+ * scan.  Each record is one 32-bit word:
+ *
+ *   bits 31-30  record kind (SYM_BITS, SYM_SYMBOL, SYM_SYMBOL_BITS, or
+ *               SYM_RESTART)
+ *   bits 29-28  Huffman table number (symbol records)
+ *   bits 27-20  Huffman symbol (symbol records)
+ *   bits 19-16  number of extra bits - 1 (bits records)
+ *   bits 15-0   extra bits (bits records) or restart number (SYM_RESTART)
+ *
+ * A symbol followed by its extra bits, which is by far the most common case,
+ * thus takes one record.
+ */
+
+#define SYMBOL_CHUNK_RECS  16384 /* # of records per chunk */
+
+#define SYM_BITS         0U
+#define SYM_SYMBOL       1U
+#define SYM_SYMBOL_BITS  2U
+#define SYM_RESTART      3U
+
+typedef struct symbol_chunk {
+  struct symbol_chunk *next;    /* next chunk in chain, or NULL */
+  unsigned int nrecs;           /* # of records used in this chunk */
+  unsigned int recs[SYMBOL_CHUNK_RECS];
+} symbol_chunk;
+
+
 /* Expanded entropy encoder object for progressive Huffman encoding. */
 
 typedef struct {
@@ -64,6 +95,7 @@ typedef struct {
 
   /* Mode flag: TRUE for optimization, FALSE for actual data output */
   boolean gather_statistics;
+  size_t gathered_bits;         /* # of non-Huffman bits counted in gather mode */
 
   /* Bit-level coding status.
    * next_output_byte/free_in_buffer are local copies of cinfo->dest fields.
@@ -95,6 +127,19 @@ typedef struct {
 
   /* Statistics tables for optimization; again, one set is enough */
   long *count_ptrs[NUM_HUFF_TBLS];
+
+  /* Recorded symbol stream (used only if buffer_symbols is set) */
+  boolean record_symbols;       /* TRUE=record symbols while gathering */
+  boolean stream_valid;         /* TRUE=stream holds the last gathered scan */
+  symbol_chunk *first_chunk;    /* head of chunk chain */
+  symbol_chunk *cur_chunk;      /* chunk being filled, or NULL if none yet */
+  unsigned int *next_rec;       /* => next free record in cur_chunk */
+  unsigned int *rec_limit;      /* => end of cur_chunk */
+  unsigned int *last_rec;       /* => last record written, or NULL */
+  /* Parameters of the scan that the stream was recorded for */
+  jpeg_component_info *stream_comp_info[MAX_COMPS_IN_SCAN];
+  int stream_comps_in_scan, stream_Ss, stream_Se, stream_Ah, stream_Al;
+  unsigned int stream_restart_interval;
 } phuff_entropy_encoder;
 
 typedef phuff_entropy_encoder *phuff_entropy_ptr;
@@ -140,7 +185,10 @@ METHODDEF(int) encode_mcu_AC_refine_prepare
    UJCOEF *absvalues, size_t *bits);
 METHODDEF(boolean) encode_mcu_AC_refine(j_compress_ptr cinfo,
                                         JBLOCKROW *MCU_data);
+METHODDEF(boolean) encode_mcu_replay(j_compress_ptr cinfo,
+                                     JBLOCKROW *MCU_data);
 METHODDEF(void) finish_pass_phuff(j_compress_ptr cinfo);
+METHODDEF(void) finish_pass_replay_phuff(j_compress_ptr cinfo);
 METHODDEF(void) finish_pass_gather_phuff(j_compress_ptr cinfo);
 
 
@@ -172,6 +220,28 @@ count_zeroes(size_t *x)
 }
 
 
+/*
+ * Check whether the recorded symbol stream belongs to the current scan.
+ */
+
+LOCAL(boolean)
+stream_matches_scan(phuff_entropy_ptr entropy, j_compress_ptr cinfo)
+{
+  int ci;
+
+  if (!entropy->stream_valid ||
+      entropy->stream_comps_in_scan != cinfo->comps_in_scan ||
+      entropy->stream_Ss != cinfo->Ss || entropy->stream_Se != cinfo->Se ||
+      entropy->stream_Ah != cinfo->Ah || entropy->stream_Al != cinfo->Al ||
+      entropy->stream_restart_interval != cinfo->restart_interval)
+    return FALSE;
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+    if (entropy->stream_comp_info[ci] != cinfo->cur_comp_info[ci])
+      return FALSE;
+  return TRUE;
+}
+
+
 /*
  * Initialize for a Huffman-compressed scan using progressive JPEG.
  */
@@ -180,12 +250,36 @@ METHODDEF(void)
 start_pass_phuff(j_compress_ptr cinfo, boolean gather_statistics)
 {
   phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
-  boolean is_DC_band;
+  boolean is_DC_band, replay;
   int ci, tbl;
   jpeg_component_info *compptr;
 
   entropy->cinfo = cinfo;
   entropy->gather_statistics = gather_statistics;
+  entropy->gathered_bits = 0;
+
+  /* The stream is only complete if every MCU of the scan is gathered, and
+   * it is pointless for the trellis passes, which are not followed by an
+   * output pass.
+   */
+  replay = (!gather_statistics && stream_matches_scan(entropy, cinfo));
+  entropy->stream_valid = FALSE;
+  entropy->record_symbols = (gather_statistics &&
+                             cinfo->master->buffer_symbols &&
+                             !cinfo->master->trellis_passes &&
+                             cinfo->master->scan_sample_interval <= 1);
+  if (entropy->record_symbols) {
+    entropy->cur_chunk = NULL;
+    entropy->next_rec = entropy->rec_limit = entropy->last_rec = NULL;
+    entropy->stream_comps_in_scan = cinfo->comps_in_scan;
+    for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+      entropy->stream_comp_info[ci] = cinfo->cur_comp_info[ci];
+    entropy->stream_Ss = cinfo->Ss;
+    entropy->stream_Se = cinfo->Se;
+    entropy->stream_Ah = cinfo->Ah;
+    entropy->stream_Al = cinfo->Al;
+    entropy->stream_restart_interval = cinfo->restart_interval;
+  }
 
   is_DC_band = (cinfo->Ss == 0);
 
@@ -223,7 +317,11 @@ start_pass_phuff(j_compress_ptr cinfo, boolean gather_statistics)
   }
   if (gather_statistics)
     entropy->pub.finish_pass = finish_pass_gather_phuff;
-  else
+  else if (replay) {
+    /* The coefficients need not be visited again */
+    entropy->pub.encode_mcu = encode_mcu_replay;
+    entropy->pub.finish_pass = finish_pass_replay_phuff;
+  } else
     entropy->pub.finish_pass = finish_pass_phuff;
 
   /* Only DC coefficients may be interleaved, so cinfo->comps_in_scan = 1
@@ -319,6 +417,60 @@ dump_buffer(phuff_entropy_ptr entropy)
  * between calls, so 24 bits are sufficient.
  */
 
+/* Recording the symbol stream */
+
+LOCAL(void)
+next_symbol_chunk(phuff_entropy_ptr entropy)
+{
+  symbol_chunk *chunk;
+
+  if (entropy->cur_chunk == NULL)
+    chunk = entropy->first_chunk;
+  else {
+    entropy->cur_chunk->nrecs = SYMBOL_CHUNK_RECS;
+    chunk = entropy->cur_chunk->next;
+  }
+  if (chunk == NULL) {
+    chunk = (symbol_chunk *)
+      (*entropy->cinfo->mem->alloc_large) ((j_common_ptr)entropy->cinfo,
+                                           JPOOL_IMAGE, sizeof(symbol_chunk));
+    chunk->next = NULL;
+    if (entropy->cur_chunk == NULL)
+      entropy->first_chunk = chunk;
+    else
+      entropy->cur_chunk->next = chunk;
+  }
+  chunk->nrecs = 0;
+  entropy->cur_chunk = chunk;
+  entropy->next_rec = chunk->recs;
+  entropy->rec_limit = chunk->recs + SYMBOL_CHUNK_RECS;
+}
+
+
+LOCAL(void)
+record_word(phuff_entropy_ptr entropy, unsigned int rec)
+{
+  if (entropy->next_rec == entropy->rec_limit)
+    next_symbol_chunk(entropy);
+  entropy->last_rec = entropy->next_rec;
+  *entropy->next_rec++ = rec;
+}
+
+
+LOCAL(void)
+record_bits(phuff_entropy_ptr entropy, unsigned int code, int size)
+{
+  unsigned int bits = ((unsigned int)(size - 1) << 16) |
+                      (code & ((1U << size) - 1));
+
+  /* Attach the bits to a preceding symbol that has none */
+  if (entropy->last_rec != NULL && (*entropy->last_rec >> 30) == SYM_SYMBOL)
+    *entropy->last_rec ^= ((SYM_SYMBOL ^ SYM_SYMBOL_BITS) << 30) | bits;
+  else
+    record_word(entropy, (SYM_BITS << 30) | bits);
+}
+
+
 LOCAL(void)
 emit_bits(phuff_entropy_ptr entropy, unsigned int code, int size)
 /* Emit some bits, unless we are in gather mode */
@@ -331,8 +483,12 @@ emit_bits(phuff_entropy_ptr entropy, unsigned int code, int size)
   if (size == 0)
     ERREXIT(entropy->cinfo, JERR_HUFF_MISSING_CODE);
 
-  if (entropy->gather_statistics)
-    return;                     /* do nothing if we're only getting stats */
+  if (entropy->gather_statistics) {
+    entropy->gathered_bits += size; /* just count them if we're getting stats */
+    if (entropy->record_symbols)
+      record_bits(entropy, code, size);
+    return;
+  }
 
   put_buffer &= (((size_t)1) << size) - 1; /* mask off any extra bits in code */
 
@@ -374,9 +530,13 @@ flush_bits(phuff_entropy_ptr entropy)
 LOCAL(void)
 emit_symbol(phuff_entropy_ptr entropy, int tbl_no, int symbol)
 {
-  if (entropy->gather_statistics)
+  if (entropy->gather_statistics) {
     entropy->count_ptrs[tbl_no][symbol]++;
-  else {
+    if (entropy->record_symbols)
+      record_word(entropy, (SYM_SYMBOL << 30) |
+                           ((unsigned int)tbl_no << 28) |
+                           ((unsigned int)symbol << 20));
+  } else {
     c_derived_tbl *tbl = entropy->derived_tbls[tbl_no];
     emit_bits(entropy, tbl->ehufco[symbol], tbl->ehufsi[symbol]);
   }
@@ -391,8 +551,20 @@ LOCAL(void)
 emit_buffered_bits(phuff_entropy_ptr entropy, char *bufstart,
                    unsigned int nbits)
 {
-  if (entropy->gather_statistics)
-    return;                     /* no real work */
+  if (entropy->gather_statistics) {
+    entropy->gathered_bits += nbits; /* no real work */
+    /* unless recording: pack up to 16 correction bits per record */
+    while (entropy->record_symbols && nbits > 0) {
+      int i, size = nbits < 16 ? (int)nbits : 16;
+      unsigned int code = 0;
+
+      for (i = 0; i < size; i++)
+        code = (code << 1) | (unsigned int)(*bufstart++);
+      record_bits(entropy, code, size);
+      nbits -= size;
+    }
+    return;
+  }
 
   while (nbits > 0) {
     emit_bits(entropy, (unsigned int)(*bufstart), 1);
@@ -446,7 +618,8 @@ emit_restart(phuff_entropy_ptr entropy, int restart_num)
     flush_bits(entropy);
     emit_byte(entropy, 0xFF);
     emit_byte(entropy, JPEG_RST0 + restart_num);
-  }
+  } else if (entropy->record_symbols)
+    record_word(entropy, (SYM_RESTART << 30) | (unsigned int)restart_num);
 
   if (entropy->cinfo->Ss == 0) {
     /* Re-initialize DC predictions to 0 */
@@ -1017,6 +1190,18 @@ encode_mcu_AC_refine(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+/*
+ * MCU encoding for an output pass whose symbols were recorded during the
+ * statistics-gathering pass.  finish_pass_replay_phuff() emits them all.
+ */
+
+METHODDEF(boolean)
+encode_mcu_replay(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  return TRUE;
+}
+
+
 /*
  * Finish up at the end of a Huffman-compressed progressive scan.
  */
@@ -1038,6 +1223,53 @@ finish_pass_phuff(j_compress_ptr cinfo)
 }
 
 
+/*
+ * Emit the recorded symbol stream using the tables built from it, and finish
+ * up the scan.
+ */
+
+METHODDEF(void)
+finish_pass_replay_phuff(j_compress_ptr cinfo)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+  symbol_chunk *chunk;
+  unsigned int rec, i;
+
+  entropy->next_output_byte = cinfo->dest->next_output_byte;
+  entropy->free_in_buffer = cinfo->dest->free_in_buffer;
+
+  chunk = (entropy->cur_chunk != NULL) ? entropy->first_chunk : NULL;
+  for (; chunk != NULL; chunk = chunk->next) {
+    for (i = 0; i < chunk->nrecs; i++) {
+      rec = chunk->recs[i];
+      switch (rec >> 30) {
+      case SYM_SYMBOL:
+      case SYM_SYMBOL_BITS:
+        emit_symbol(entropy, (int)((rec >> 28) & 3), (int)((rec >> 20) & 0xFF));
+        if ((rec >> 30) == SYM_SYMBOL)
+          break;
+        /* FALLTHROUGH */
+      case SYM_BITS:
+        emit_bits(entropy, rec & 0xFFFF, (int)((rec >> 16) & 15) + 1);
+        break;
+      default:
+        flush_bits(entropy);
+        emit_byte(entropy, 0xFF);
+        emit_byte(entropy, JPEG_RST0 + (int)(rec & 7));
+      }
+    }
+    if (chunk == entropy->cur_chunk)
+      break;
+  }
+
+  /* Flush out any buffered data */
+  flush_bits(entropy);
+
+  cinfo->dest->next_output_byte = entropy->next_output_byte;
+  cinfo->dest->free_in_buffer = entropy->free_in_buffer;
+}
+
+
 /*
  * Finish up a statistics-gathering pass and create the new Huffman tables.
  */
@@ -1051,10 +1283,30 @@ finish_pass_gather_phuff(j_compress_ptr cinfo)
   jpeg_component_info *compptr;
   JHUFF_TBL **htblptr;
   boolean did[NUM_HUFF_TBLS];
+  boolean estimate;
+  long counts[257];
 
   /* Flush out buffered data (all we care about is counting the EOB symbol) */
   emit_eobrun(entropy);
 
+  if (entropy->record_symbols) {
+    if (entropy->cur_chunk != NULL)
+      entropy->cur_chunk->nrecs =
+        (unsigned int)(entropy->next_rec - entropy->cur_chunk->recs);
+    entropy->record_symbols = FALSE;
+    entropy->stream_valid = TRUE;
+  }
+
+  /* When the master control estimates scan sizes instead of encoding the
+   * candidate scans, report the size of this scan coded with the new tables.
+   */
+  estimate = (cinfo->master->optimize_scans &&
+              cinfo->master->scan_cost_mode != 0);
+  if (estimate) {
+    cinfo->master->scan_data_bits = (double)entropy->gathered_bits;
+    cinfo->master->scan_table_bytes = 0;
+  }
+
   is_DC_band = (cinfo->Ss == 0);
 
   /* It's important not to apply jpeg_gen_optimal_table more than once
@@ -1078,7 +1330,21 @@ finish_pass_gather_phuff(j_compress_ptr cinfo)
         htblptr = &cinfo->ac_huff_tbl_ptrs[tbl];
       if (*htblptr == NULL)
         *htblptr = jpeg_alloc_huff_table((j_common_ptr)cinfo);
-      jpeg_gen_optimal_table(cinfo, *htblptr, entropy->count_ptrs[tbl]);
+      if (cinfo->master->trellis_passes)
+        jpeg_gen_trellis_table(cinfo, *htblptr, entropy->count_ptrs[tbl]);
+      else if (estimate) {
+        int i, nsymbols = 0;
+
+        /* jpeg_gen_optimal_table() clobbers the counts */
+        memcpy(counts, entropy->count_ptrs[tbl], sizeof(counts));
+        jpeg_gen_optimal_table(cinfo, *htblptr, entropy->count_ptrs[tbl]);
+        cinfo->master->scan_data_bits +=
+          jpeg_huff_table_cost(*htblptr, counts);
+        for (i = 1; i <= 16; i++)
+          nsymbols += (*htblptr)->bits[i];
+        cinfo->master->scan_table_bytes += 1 + 16 + nsymbols;
+      } else
+        jpeg_gen_optimal_table(cinfo, *htblptr, entropy->count_ptrs[tbl]);
       did[tbl] = TRUE;
     }
   }
@@ -1107,6 +1373,9 @@ jinit_phuff_encoder(j_compress_ptr cinfo)
     entropy->count_ptrs[i] = NULL;
   }
   entropy->bit_buffer = NULL;   /* needed only in AC refinement scan */
+  entropy->record_symbols = FALSE;
+  entropy->stream_valid = FALSE;
+  entropy->first_chunk = entropy->cur_chunk = NULL;
 }
 
 #endif /* C_PROGRESSIVE_SUPPORTED */
@@ -36,6 +36,12 @@
 #define CONTEXT_ROWS_SUPPORTED
 #endif
 
+/* Width (in pixels) of the column tiles used by pre_process_tiled().  One
+ * row group of a tile, before and after color conversion, should fit
+ * comfortably in the L1 cache.
+ */
+#define PREP_TILE_WIDTH  1024
+
 
 /*
  * For the simple (no-context-row) case, we just need to buffer one
@@ -73,6 +79,17 @@ typedef struct {
   int this_row_group;           /* starting row index of group to process */
   int next_buf_stop;            /* downsample when we reach this index */
 #endif
+
+  /* Column-tiled processing (simple case only).  When a whole row group of
+   * input is available, it is color-converted and downsampled one tile of
+   * tile_width columns at a time, so the color-converted samples are read
+   * back by the downsampler while they are still in cache.  tile_width is 0
+   * if tiling is disabled.
+   */
+  JDIMENSION tile_width;
+  _JSAMPARRAY tile_buf[MAX_COMPONENTS]; /* color-converted samples */
+  _JSAMPARRAY tile_input;               /* input rows, offset to the tile */
+  _JSAMPARRAY tile_output[MAX_COMPONENTS]; /* output rows, ditto */
 } my_prep_controller;
 
 typedef my_prep_controller *my_prep_ptr;
@@ -123,6 +140,65 @@ expand_bottom_edge(_JSAMPARRAY image_data, JDIMENSION num_cols, int input_rows,
 }
 
 
+/*
+ * Color-convert and downsample one row group, for which all input rows are
+ * available, in column tiles.
+ *
+ * The color converter and downsampler operate on the full image width given
+ * by cinfo->image_width and compptr->width_in_blocks, so each tile is handed
+ * to them through a copy of the compression object whose width fields
+ * describe just that tile.  Tiles begin on iMCU boundaries, so every
+ * component's share of a tile is a whole number of blocks, and the
+ * downsampler's edge expansion only has an effect in the last tile (exactly
+ * as it would for the full-width row).
+ */
+
+LOCAL(void)
+pre_process_tiled(j_compress_ptr cinfo, _JSAMPARRAY input_buf,
+                  _JSAMPIMAGE output_buf, JDIMENSION out_row_group)
+{
+  my_prep_ptr prep = (my_prep_ptr)cinfo->prep;
+  struct jpeg_compress_struct tile_cinfo;
+  jpeg_component_info tile_comp_info[MAX_COMPONENTS];
+  jpeg_component_info *compptr;
+  JDIMENSION x, mcu_width, mcu_cols, block_offset, tile_blocks;
+  int ci, row;
+
+  tile_cinfo = *cinfo;
+  tile_cinfo.comp_info = tile_comp_info;
+  memcpy(tile_comp_info, cinfo->comp_info,
+         cinfo->num_components * sizeof(jpeg_component_info));
+
+  mcu_width = cinfo->max_h_samp_factor * DCTSIZE;
+  for (x = 0; x < cinfo->image_width; x += prep->tile_width) {
+    tile_cinfo.image_width = MIN(prep->tile_width, cinfo->image_width - x);
+    mcu_cols = x / mcu_width;
+
+    for (row = 0; row < cinfo->max_v_samp_factor; row++)
+      prep->tile_input[row] = input_buf[row] + x * cinfo->input_components;
+
+    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+         ci++, compptr++) {
+      block_offset = mcu_cols * compptr->h_samp_factor;
+      tile_blocks = prep->tile_width / mcu_width * compptr->h_samp_factor;
+      tile_comp_info[ci].width_in_blocks =
+        MIN(tile_blocks, compptr->width_in_blocks - block_offset);
+      for (row = 0; row < compptr->v_samp_factor; row++)
+        prep->tile_output[ci][row] =
+          output_buf[ci][out_row_group * compptr->v_samp_factor + row] +
+          block_offset * DCTSIZE;
+    }
+
+    (*cinfo->cconvert->_color_convert) (&tile_cinfo, prep->tile_input,
+                                        prep->tile_buf, (JDIMENSION)0,
+                                        cinfo->max_v_samp_factor);
+    (*cinfo->downsample->_downsample) (&tile_cinfo, prep->tile_buf,
+                                       (JDIMENSION)0, prep->tile_output,
+                                       (JDIMENSION)0);
+  }
+}
+
+
 /*
  * Process some data in the simple no-context case.
  *
@@ -146,33 +222,43 @@ pre_process_data(j_compress_ptr cinfo, _JSAMPARRAY input_buf,
 
   while (*in_row_ctr < in_rows_avail &&
          *out_row_group_ctr < out_row_groups_avail) {
-    /* Do color conversion to fill the conversion buffer. */
     inrows = in_rows_avail - *in_row_ctr;
-    numrows = cinfo->max_v_samp_factor - prep->next_buf_row;
-    numrows = (int)MIN((JDIMENSION)numrows, inrows);
-    (*cinfo->cconvert->_color_convert) (cinfo, input_buf + *in_row_ctr,
-                                        prep->color_buf,
-                                        (JDIMENSION)prep->next_buf_row,
-                                        numrows);
-    *in_row_ctr += numrows;
-    prep->next_buf_row += numrows;
-    prep->rows_to_go -= numrows;
-    /* If at bottom of image, pad to fill the conversion buffer. */
-    if (prep->rows_to_go == 0 &&
-        prep->next_buf_row < cinfo->max_v_samp_factor) {
-      for (ci = 0; ci < cinfo->num_components; ci++) {
-        expand_bottom_edge(prep->color_buf[ci], cinfo->image_width,
-                           prep->next_buf_row, cinfo->max_v_samp_factor);
-      }
-      prep->next_buf_row = cinfo->max_v_samp_factor;
-    }
-    /* If we've filled the conversion buffer, empty it. */
-    if (prep->next_buf_row == cinfo->max_v_samp_factor) {
-      (*cinfo->downsample->_downsample) (cinfo,
-                                         prep->color_buf, (JDIMENSION)0,
-                                         output_buf, *out_row_group_ctr);
-      prep->next_buf_row = 0;
+    if (prep->tile_width != 0 && prep->next_buf_row == 0 &&
+        inrows >= (JDIMENSION)cinfo->max_v_samp_factor) {
+      /* A whole row group is available, so bypass the conversion buffer. */
+      pre_process_tiled(cinfo, input_buf + *in_row_ctr, output_buf,
+                        *out_row_group_ctr);
+      *in_row_ctr += cinfo->max_v_samp_factor;
+      prep->rows_to_go -= cinfo->max_v_samp_factor;
       (*out_row_group_ctr)++;
+    } else {
+      /* Do color conversion to fill the conversion buffer. */
+      numrows = cinfo->max_v_samp_factor - prep->next_buf_row;
+      numrows = (int)MIN((JDIMENSION)numrows, inrows);
+      (*cinfo->cconvert->_color_convert) (cinfo, input_buf + *in_row_ctr,
+                                          prep->color_buf,
+                                          (JDIMENSION)prep->next_buf_row,
+                                          numrows);
+      *in_row_ctr += numrows;
+      prep->next_buf_row += numrows;
+      prep->rows_to_go -= numrows;
+      /* If at bottom of image, pad to fill the conversion buffer. */
+      if (prep->rows_to_go == 0 &&
+          prep->next_buf_row < cinfo->max_v_samp_factor) {
+        for (ci = 0; ci < cinfo->num_components; ci++) {
+          expand_bottom_edge(prep->color_buf[ci], cinfo->image_width,
+                             prep->next_buf_row, cinfo->max_v_samp_factor);
+        }
+        prep->next_buf_row = cinfo->max_v_samp_factor;
+      }
+      /* If we've filled the conversion buffer, empty it. */
+      if (prep->next_buf_row == cinfo->max_v_samp_factor) {
+        (*cinfo->downsample->_downsample) (cinfo,
+                                           prep->color_buf, (JDIMENSION)0,
+                                           output_buf, *out_row_group_ctr);
+        prep->next_buf_row = 0;
+        (*out_row_group_ctr)++;
+      }
     }
     /* If at bottom of image, pad the output to a full iMCU height.
      * Note we assume the caller is providing a one-iMCU-height output buffer!
@@ -359,6 +445,33 @@ _jinit_c_prep_controller(j_compress_ptr cinfo, boolean need_full_buffer)
                        cinfo->max_h_samp_factor) / compptr->h_samp_factor),
          (JDIMENSION)cinfo->max_v_samp_factor);
     }
+
+    /* Set up column tiling for images that are wider than one tile.  (The
+     * tile width is rounded down to a whole number of iMCUs.)
+     */
+    prep->tile_width = 0;
+    if (!cinfo->master->lossless) {
+      JDIMENSION mcu_width = cinfo->max_h_samp_factor * DCTSIZE;
+      JDIMENSION tile_width = MAX(PREP_TILE_WIDTH / mcu_width, 1) * mcu_width;
+
+      if (cinfo->image_width > tile_width) {
+        prep->tile_width = tile_width;
+        prep->tile_input = (_JSAMPARRAY)
+          (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                      cinfo->max_v_samp_factor *
+                                      sizeof(_JSAMPROW));
+        for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+             ci++, compptr++) {
+          prep->tile_buf[ci] = (_JSAMPARRAY)(*cinfo->mem->alloc_sarray)
+            ((j_common_ptr)cinfo, JPOOL_IMAGE, tile_width,
+             (JDIMENSION)cinfo->max_v_samp_factor);
+          prep->tile_output[ci] = (_JSAMPARRAY)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                        compptr->v_samp_factor *
+                                        sizeof(_JSAMPROW));
+        }
+      }
+    }
   }
 }
 
@@ -491,7 +491,12 @@ _jinit_downsampler(j_compress_ptr cinfo)
         compptr->v_samp_factor == cinfo->max_v_samp_factor) {
 #ifdef INPUT_SMOOTHING_SUPPORTED
       if (cinfo->smoothing_factor) {
-        downsample->methods[ci] = fullsize_smooth_downsample;
+#ifdef WITH_SIMD
+        if (jsimd_can_fullsize_smooth_downsample())
+          downsample->methods[ci] = jsimd_fullsize_smooth_downsample;
+        else
+#endif
+          downsample->methods[ci] = fullsize_smooth_downsample;
         downsample->pub.need_context_rows = TRUE;
       } else
 #endif
@@ -509,7 +514,7 @@ _jinit_downsampler(j_compress_ptr cinfo)
                compptr->v_samp_factor * 2 == cinfo->max_v_samp_factor) {
 #ifdef INPUT_SMOOTHING_SUPPORTED
       if (cinfo->smoothing_factor) {
-#if defined(WITH_SIMD) && defined(__mips__)
+#ifdef WITH_SIMD
         if (jsimd_can_h2v2_smooth_downsample())
           downsample->methods[ci] = jsimd_h2v2_smooth_downsample;
         else
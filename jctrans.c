@@ -407,6 +407,7 @@ transencode_coef_controller(j_compress_ptr cinfo,
   coef->pub.start_pass = start_pass_coef;
   coef->pub.compress_data = compress_output;
   coef->pub.compress_data_12 = compress_output_12;
+  coef->pub.encode_scan = NULL;
 
   /* Save pointer to virtual arrays */
   coef->whole_image = coef_arrays;
@@ -586,8 +586,11 @@ _jpeg_skip_scanlines(j_decompress_ptr cinfo, JDIMENSION num_lines)
   /* For images requiring multiple scans (progressive, non-interleaved, etc.),
    * all of the entropy decoding occurs in jpeg_start_decompress(), assuming
    * that the input data source is non-suspending.  This makes skipping easy.
+   * When the scan is entropy-decoded concurrently, that is done into a
+   * full-image buffer on demand, so the same applies.
    */
-  if (cinfo->inputctl->has_multiple_scans || cinfo->buffered_image) {
+  if (cinfo->inputctl->has_multiple_scans || cinfo->buffered_image ||
+      cinfo->master->concurrent_scan) {
     if (cinfo->upsample->need_context_rows) {
       cinfo->output_scanline += lines_to_skip;
       cinfo->output_iMCU_row += lines_to_skip / lines_per_iMCU_row;
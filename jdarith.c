@@ -349,6 +349,9 @@ decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 
   /* Sections F.2.4.2 & F.1.4.4.2: Decoding of AC coefficients */
 
+  /* This bound holds even if we give up partway */
+  entropy->pub.last_nonzero[0] = cinfo->Se;
+
   /* Figure F.20: Decode_AC_coefficients */
   for (k = cinfo->Ss; k <= cinfo->Se; k++) {
     st = entropy->ac_stats[tbl] + 3 * (k - 1);
@@ -390,6 +393,7 @@ decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
     /* Scale and output coefficient in natural (dezigzagged) order */
     (*block)[jpeg_natural_order[k]] = (JCOEF)((unsigned)v << cinfo->Al);
   }
+  entropy->pub.last_nonzero[0] = k - 1;
 
   return TRUE;
 }
@@ -462,6 +466,11 @@ decode_mcu_AC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
   for (kex = cinfo->Se; kex > 0; kex--)
     if ((*block)[jpeg_natural_order[kex]]) break;
 
+  /* This bound on newly nonzero coefficients holds even if we give up
+   * partway
+   */
+  entropy->pub.last_nonzero[0] = cinfo->Se;
+
   for (k = cinfo->Ss; k <= cinfo->Se; k++) {
     st = entropy->ac_stats[tbl] + 3 * (k - 1);
     if (k > kex)
@@ -492,6 +501,7 @@ decode_mcu_AC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
       }
     }
   }
+  entropy->pub.last_nonzero[0] = k - 1;
 
   return TRUE;
 }
@@ -577,6 +587,9 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 
     tbl = compptr->ac_tbl_no;
 
+    /* This bound holds even if we give up partway */
+    entropy->pub.last_nonzero[blkn] = DCTSIZE2 - 1;
+
     /* Figure F.20: Decode_AC_coefficients */
     for (k = 1; k <= DCTSIZE2 - 1; k++) {
       st = entropy->ac_stats[tbl] + 3 * (k - 1);
@@ -618,6 +631,7 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
       if (block)
         (*block)[jpeg_natural_order[k]] = (JCOEF)v;
     }
+    entropy->pub.last_nonzero[blkn] = k - 1;
   }
 
   return TRUE;
@@ -737,6 +751,12 @@ bad:
   entropy->ct = -16;    /* force reading 2 initial bytes to fill C */
   entropy->pub.insufficient_data = FALSE;
 
+  /* DC scans store only the DC coefficients, and the other decode_mcu()
+   * routines record the last nonzero coefficient of each block.
+   */
+  for (ci = 0; ci < D_MAX_BLOCKS_IN_MCU; ci++)
+    entropy->pub.last_nonzero[ci] = 0;
+
   /* Initialize restart counter */
   entropy->restarts_to_go = cinfo->restart_interval;
 }
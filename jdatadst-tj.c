@@ -196,4 +196,5 @@ jpeg_mem_dest_tj(j_compress_ptr cinfo, unsigned char **outbuffer,
   if (!reused)
     dest->bufsize = *outsize;
   dest->pub.free_in_buffer = dest->bufsize;
+  cinfo->master->nonsuspending_dest = cinfo->dest;
 }
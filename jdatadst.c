@@ -217,6 +217,7 @@ jpeg_stdio_dest(j_compress_ptr cinfo, FILE *outfile)
   dest->pub.empty_output_buffer = empty_output_buffer;
   dest->pub.term_destination = term_destination;
   dest->outfile = outfile;
+  cinfo->master->nonsuspending_dest = cinfo->dest;
 }
 
 
@@ -285,5 +286,6 @@ jpeg_mem_dest (j_compress_ptr cinfo,
    * can be written to the same file without re-executing jpeg_stdio_dest.
    */
   jpeg_mem_dest_internal(cinfo, outbuffer, outsize, JPOOL_PERMANENT);
+  cinfo->master->nonsuspending_dest = cinfo->dest;
 }
 
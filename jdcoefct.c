@@ -38,6 +38,23 @@ METHODDEF(int) decompress_smooth_data(j_decompress_ptr cinfo,
 #endif
 
 
+/* The class of IDCT routine (see jpegint.h) that can process a block, indexed
+ * by the zigzag index of the block's last nonzero coefficient
+ */
+static const unsigned char idct_class[DCTSIZE2] = {
+  IDCT_DC,   IDCT_2X2,  IDCT_2X2,  IDCT_4X4,  IDCT_4X4,  IDCT_4X4,  IDCT_4X4,
+  IDCT_4X4,  IDCT_4X4,  IDCT_4X4,  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL, IDCT_FULL,
+  IDCT_FULL
+};
+
+
 /*
  * Initialize for an input processing pass.
  */
@@ -45,6 +62,11 @@ METHODDEF(int) decompress_smooth_data(j_decompress_ptr cinfo,
 METHODDEF(void)
 start_input_pass(j_decompress_ptr cinfo)
 {
+#ifdef D_MULTISCAN_FILES_SUPPORTED
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+
+  coef->try_concurrent = cinfo->master->concurrent_scan;
+#endif
   cinfo->input_iMCU_row = 0;
   start_iMCU_row(cinfo);
 }
@@ -93,7 +115,8 @@ decompress_onepass(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
   _JSAMPARRAY output_ptr;
   JDIMENSION start_col, output_col;
   jpeg_component_info *compptr;
-  _inverse_DCT_method_ptr inverse_DCT;
+  _inverse_DCT_method_ptr *inverse_DCT;
+  int *last_nonzero = cinfo->entropy->last_nonzero;
 
   /* Loop to process as much as one whole iMCU row */
   for (yoffset = coef->MCU_vert_offset; yoffset < coef->MCU_rows_per_iMCU_row;
@@ -120,7 +143,9 @@ decompress_onepass(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
         /* Determine where data should go in output_buf and do the IDCT thing.
          * We skip dummy blocks at the right and bottom edges (but blkn gets
          * incremented past them!).  Note the inner loop relies on having
-         * allocated the MCU_buffer[] blocks sequentially.
+         * allocated the MCU_buffer[] blocks sequentially.  The IDCT routine
+         * for each block is chosen by the last nonzero coefficient that the
+         * entropy decoder stored into it.
          */
         blkn = 0;               /* index of current DCT block within MCU */
         for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
@@ -130,7 +155,8 @@ decompress_onepass(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
             blkn += compptr->MCU_blocks;
             continue;
           }
-          inverse_DCT = cinfo->idct->_inverse_DCT[compptr->component_index];
+          inverse_DCT =
+            cinfo->idct->_sparse_inverse_DCT[compptr->component_index];
           useful_width = (MCU_col_num < last_MCU_col) ?
                          compptr->MCU_width : compptr->last_col_width;
           output_ptr = output_buf[compptr->component_index] +
@@ -142,9 +168,9 @@ decompress_onepass(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
                 yoffset + yindex < compptr->last_row_height) {
               output_col = start_col;
               for (xindex = 0; xindex < useful_width; xindex++) {
-                (*inverse_DCT) (cinfo, compptr,
-                                (JCOEFPTR)coef->MCU_buffer[blkn + xindex],
-                                output_ptr, output_col);
+                (*inverse_DCT[idct_class[last_nonzero[blkn + xindex]]])
+                  (cinfo, compptr, (JCOEFPTR)coef->MCU_buffer[blkn + xindex],
+                   output_ptr, output_col);
                 output_col += compptr->_DCT_scaled_size;
               }
             }
@@ -182,6 +208,128 @@ dummy_consume_data(j_decompress_ptr cinfo)
 
 #ifdef D_MULTISCAN_FILES_SUPPORTED
 
+/*
+ * Fold the last nonzero coefficient indices that the entropy decoder recorded
+ * for the MCU just decoded into the maps of the blocks that hold it.
+ */
+
+LOCAL(void)
+merge_last_nonzero(j_decompress_ptr cinfo, unsigned char **MCU_last_nonzero)
+{
+  int *last_nonzero = cinfo->entropy->last_nonzero;
+  int blkn;
+
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    if (*MCU_last_nonzero[blkn] < last_nonzero[blkn])
+      *MCU_last_nonzero[blkn] = (unsigned char)last_nonzero[blkn];
+  }
+}
+
+
+/*
+ * Decode num_MCUs MCUs of the current scan, starting with MCU number start_MCU
+ * (in raster order), into the full-image buffer.  This is used by
+ * jdecode_restart_intervals() and jdecode_speculatively() on private copies
+ * of the decompression object, so it must not touch the controller's state or call the memory manager.
+ * consume_concurrently() has made coef->scan_buffer[] point to all block rows
+ * of the components in the scan.  Tasks store only into their own blocks and
+ * the corresponding entries of coef->last_nonzero[].
+ */
+
+METHODDEF(boolean)
+decode_scan(j_decompress_ptr cinfo, JDIMENSION start_MCU, JDIMENSION num_MCUs)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  JDIMENSION MCU_num, MCU_row_num, MCU_col_num;
+  int blkn, ci, xindex, yindex;
+  JDIMENSION start_col;
+  JBLOCKROW MCU_buffer[D_MAX_BLOCKS_IN_MCU];
+  unsigned char *MCU_last_nonzero[D_MAX_BLOCKS_IN_MCU];
+  JBLOCKROW buffer_ptr;
+  unsigned char *last_nonzero_ptr;
+  jpeg_component_info *compptr;
+
+  for (MCU_num = start_MCU; MCU_num < start_MCU + num_MCUs; MCU_num++) {
+    MCU_row_num = MCU_num / cinfo->MCUs_per_row;
+    MCU_col_num = MCU_num % cinfo->MCUs_per_row;
+    /* Construct list of pointers to DCT blocks belonging to this MCU.  In a
+     * noninterleaved scan, MCU_height is 1, and MCU rows are block rows.
+     */
+    blkn = 0;
+    for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+      compptr = cinfo->cur_comp_info[ci];
+      start_col = MCU_col_num * compptr->MCU_width;
+      for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
+        buffer_ptr = coef->scan_buffer[ci][MCU_row_num * compptr->MCU_height +
+                                           yindex] + start_col;
+        last_nonzero_ptr = coef->last_nonzero[compptr->component_index] +
+          (size_t)(MCU_row_num * compptr->MCU_height + yindex) *
+          coef->last_nonzero_width[compptr->component_index] + start_col;
+        for (xindex = 0; xindex < compptr->MCU_width; xindex++) {
+          MCU_last_nonzero[blkn] = last_nonzero_ptr++;
+          MCU_buffer[blkn++] = buffer_ptr++;
+        }
+      }
+    }
+    if (!(*cinfo->entropy->decode_mcu) (cinfo, MCU_buffer))
+      return FALSE;
+    merge_last_nonzero(cinfo, MCU_last_nonzero);
+  }
+  return TRUE;
+}
+
+
+/*
+ * Try to decode the whole scan at once, concurrently.  Scans with restart
+ * markers are split at the markers; other scans are decoded speculatively.
+ * Returns FALSE if the scan must be decoded serially instead,
+ * in which case the coefficient buffer has been left zeroed.
+ */
+
+LOCAL(boolean)
+consume_concurrently(j_decompress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  JDIMENSION block_rows[MAX_COMPS_IN_SCAN], row;
+  boolean dirty = FALSE;
+  int ci;
+  jpeg_component_info *compptr;
+
+  /* The virtual arrays are fully resident (see jinit_d_coef_controller()), so
+   * this does no I/O, and the tasks can store into the returned rows.
+   */
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+    block_rows[ci] = (JDIMENSION)jround_up((long)compptr->height_in_blocks,
+                                           (long)compptr->v_samp_factor);
+    coef->scan_buffer[ci] = (*cinfo->mem->access_virt_barray)
+      ((j_common_ptr)cinfo, coef->whole_image[compptr->component_index],
+       (JDIMENSION)0, block_rows[ci], TRUE);
+  }
+
+  if (!(cinfo->restart_interval ? jdecode_restart_intervals(cinfo, &dirty) :
+                                  jdecode_speculatively(cinfo, &dirty))) {
+    /* The serial decoder expects the buffer to be zeroed. */
+    if (dirty) {
+      for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+        compptr = cinfo->cur_comp_info[ci];
+        for (row = 0; row < block_rows[ci]; row++)
+          jzero_far((void *)coef->scan_buffer[ci][row],
+                    (size_t)jround_up((long)compptr->width_in_blocks,
+                                      (long)compptr->h_samp_factor) *
+                    sizeof(JBLOCK));
+      }
+    }
+    return FALSE;
+  }
+
+  cinfo->master->last_good_iMCU_row = cinfo->total_iMCU_rows - 1;
+  cinfo->input_iMCU_row = cinfo->total_iMCU_rows;
+  (*cinfo->inputctl->finish_input_pass) (cinfo);
+  return TRUE;
+}
+
+
 /*
  * Consume input data and store it in the full-image coefficient buffer.
  * We read as much as one fully interleaved MCU row ("iMCU" row) per call,
@@ -198,8 +346,17 @@ consume_data(j_decompress_ptr cinfo)
   JDIMENSION start_col;
   JBLOCKARRAY buffer[MAX_COMPS_IN_SCAN];
   JBLOCKROW buffer_ptr;
+  unsigned char *MCU_last_nonzero[D_MAX_BLOCKS_IN_MCU];
+  unsigned char *last_nonzero_ptr;
   jpeg_component_info *compptr;
 
+  /* At the start of the scan, try to decode all of it concurrently. */
+  if (coef->try_concurrent) {
+    coef->try_concurrent = FALSE;
+    if (consume_concurrently(cinfo))
+      return JPEG_SCAN_COMPLETED;
+  }
+
   /* Align the virtual buffers for the components used in this scan. */
   for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
     compptr = cinfo->cur_comp_info[ci];
@@ -225,7 +382,12 @@ consume_data(j_decompress_ptr cinfo)
         start_col = MCU_col_num * compptr->MCU_width;
         for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
           buffer_ptr = buffer[ci][yindex + yoffset] + start_col;
+          last_nonzero_ptr = coef->last_nonzero[compptr->component_index] +
+            (size_t)(cinfo->input_iMCU_row * compptr->v_samp_factor +
+                     yindex + yoffset) *
+            coef->last_nonzero_width[compptr->component_index] + start_col;
           for (xindex = 0; xindex < compptr->MCU_width; xindex++) {
+            MCU_last_nonzero[blkn] = last_nonzero_ptr++;
             coef->MCU_buffer[blkn++] = buffer_ptr++;
           }
         }
@@ -239,6 +401,7 @@ consume_data(j_decompress_ptr cinfo)
         coef->MCU_ctr = MCU_col_num;
         return JPEG_SUSPENDED;
       }
+      merge_last_nonzero(cinfo, MCU_last_nonzero);
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
     coef->MCU_ctr = 0;
@@ -274,7 +437,8 @@ decompress_data(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
   _JSAMPARRAY output_ptr;
   JDIMENSION output_col;
   jpeg_component_info *compptr;
-  _inverse_DCT_method_ptr inverse_DCT;
+  _inverse_DCT_method_ptr *inverse_DCT;
+  unsigned char *last_nonzero_ptr;
 
   /* Force some input to be done if we are getting ahead of the input. */
   while (cinfo->input_scan_number < cinfo->output_scan_number ||
@@ -303,16 +467,20 @@ decompress_data(j_decompress_ptr cinfo, _JSAMPIMAGE output_buf)
       block_rows = (int)(compptr->height_in_blocks % compptr->v_samp_factor);
       if (block_rows == 0) block_rows = compptr->v_samp_factor;
     }
-    inverse_DCT = cinfo->idct->_inverse_DCT[ci];
+    inverse_DCT = cinfo->idct->_sparse_inverse_DCT[ci];
     output_ptr = output_buf[ci];
     /* Loop over all DCT blocks to be processed. */
     for (block_row = 0; block_row < block_rows; block_row++) {
       buffer_ptr = buffer[block_row] + cinfo->master->first_MCU_col[ci];
+      last_nonzero_ptr = coef->last_nonzero[ci] +
+        (size_t)(cinfo->output_iMCU_row * compptr->v_samp_factor +
+                 block_row) * coef->last_nonzero_width[ci] +
+        cinfo->master->first_MCU_col[ci];
       output_col = 0;
       for (block_num = cinfo->master->first_MCU_col[ci];
            block_num <= cinfo->master->last_MCU_col[ci]; block_num++) {
-        (*inverse_DCT) (cinfo, compptr, (JCOEFPTR)buffer_ptr, output_ptr,
-                        output_col);
+        (*inverse_DCT[idct_class[*last_nonzero_ptr++]])
+          (cinfo, compptr, (JCOEFPTR)buffer_ptr, output_ptr, output_col);
         buffer_ptr++;
         output_col += compptr->_DCT_scaled_size;
       }
@@ -839,6 +1007,7 @@ _jinit_d_coef_controller(j_decompress_ptr cinfo, boolean need_full_buffer)
     /* padded to a multiple of samp_factor DCT blocks in each direction. */
     /* Note we ask for a pre-zeroed array. */
     int ci, access_rows;
+    size_t map_size;
     jpeg_component_info *compptr;
 
     for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
@@ -849,6 +1018,10 @@ _jinit_d_coef_controller(j_decompress_ptr cinfo, boolean need_full_buffer)
       if (cinfo->progressive_mode)
         access_rows *= 5;
 #endif
+      /* Concurrent entropy decoding needs access to all block rows at once. */
+      if (cinfo->master->concurrent_scan)
+        access_rows = (int)jround_up((long)compptr->height_in_blocks,
+                                     (long)compptr->v_samp_factor);
       coef->whole_image[ci] = (*cinfo->mem->request_virt_barray)
         ((j_common_ptr)cinfo, JPOOL_IMAGE, TRUE,
          (JDIMENSION)jround_up((long)compptr->width_in_blocks,
@@ -856,10 +1029,22 @@ _jinit_d_coef_controller(j_decompress_ptr cinfo, boolean need_full_buffer)
          (JDIMENSION)jround_up((long)compptr->height_in_blocks,
                                (long)compptr->v_samp_factor),
          (JDIMENSION)access_rows);
+      /* The virtual array starts out zeroed, so every block is DC-only. */
+      coef->last_nonzero_width[ci] =
+        (JDIMENSION)jround_up((long)compptr->width_in_blocks,
+                              (long)compptr->h_samp_factor);
+      map_size = (size_t)coef->last_nonzero_width[ci] *
+                 (size_t)jround_up((long)compptr->height_in_blocks,
+                                   (long)compptr->v_samp_factor);
+      coef->last_nonzero[ci] = (unsigned char *)
+        (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    map_size);
+      memset(coef->last_nonzero[ci], 0, map_size);
     }
     coef->pub.consume_data = consume_data;
     coef->pub._decompress_data = decompress_data;
     coef->pub.coef_arrays = coef->whole_image; /* link to virtual arrays */
+    coef->pub.decode_scan = decode_scan;
 #else
     ERREXIT(cinfo, JERR_NOT_COMPILED);
 #endif
@@ -50,6 +50,20 @@ typedef struct {
 #ifdef D_MULTISCAN_FILES_SUPPORTED
   /* In multi-pass modes, we need a virtual block array for each component. */
   jvirt_barray_ptr whole_image[MAX_COMPONENTS];
+
+  /* When the restart intervals are decoded concurrently, the whole-image
+   * buffers of the components in the scan are accessed all at once, through
+   * these block row arrays.
+   */
+  boolean try_concurrent;       /* TRUE until the first consume_data() call */
+  JBLOCKARRAY scan_buffer[MAX_COMPS_IN_SCAN];
+
+  /* For each block in the virtual arrays, an upper bound on the zigzag index
+   * of its last nonzero coefficient, accumulated over the scans read so far.
+   * Each component's map has the same dimensions as its virtual array.
+   */
+  unsigned char *last_nonzero[MAX_COMPONENTS];
+  JDIMENSION last_nonzero_width[MAX_COMPONENTS];
 #endif
 
 #ifdef BLOCK_SMOOTHING_SUPPORTED
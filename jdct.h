@@ -101,6 +101,21 @@ EXTERN(void) _jpeg_idct_islow(j_decompress_ptr cinfo,
                               jpeg_component_info *compptr,
                               JCOEFPTR coef_block, _JSAMPARRAY output_buf,
                               JDIMENSION output_col);
+EXTERN(void) _jpeg_idct_islow_sparse_dc(j_decompress_ptr cinfo,
+                                        jpeg_component_info *compptr,
+                                        JCOEFPTR coef_block,
+                                        _JSAMPARRAY output_buf,
+                                        JDIMENSION output_col);
+EXTERN(void) _jpeg_idct_islow_sparse_2x2(j_decompress_ptr cinfo,
+                                         jpeg_component_info *compptr,
+                                         JCOEFPTR coef_block,
+                                         _JSAMPARRAY output_buf,
+                                         JDIMENSION output_col);
+EXTERN(void) _jpeg_idct_islow_sparse_4x4(j_decompress_ptr cinfo,
+                                         jpeg_component_info *compptr,
+                                         JCOEFPTR coef_block,
+                                         _JSAMPARRAY output_buf,
+                                         JDIMENSION output_col);
 EXTERN(void) _jpeg_idct_ifast(j_decompress_ptr cinfo,
                               jpeg_component_info *compptr,
                               JCOEFPTR coef_block, _JSAMPARRAY output_buf,
@@ -254,6 +254,29 @@ start_pass(j_decompress_ptr cinfo)
     #endif
 
     idct->pub._inverse_DCT[ci] = method_ptr;
+    /* Select the routines for blocks with few nonzero coefficients (see
+     * jdcoefct.c).  Reduced routines exist only for the full-size accurate
+     * integer IDCT, and they must produce exactly the same output as the
+     * routine selected above, so the SIMD IDCT is paired only with a SIMD
+     * DC-only routine that mimics its arithmetic.  Only the x86-64 SIMD
+     * extensions provide such a routine.  Elsewhere, the SIMD IDCT is used
+     * for every block.
+     */
+    for (i = 0; i < NUM_IDCT_CLASSES; i++)
+      idct->pub._sparse_inverse_DCT[ci][i] = method_ptr;
+#ifdef DCT_ISLOW_SUPPORTED
+    if (method_ptr == _jpeg_idct_islow) {
+      idct->pub._sparse_inverse_DCT[ci][IDCT_DC] = _jpeg_idct_islow_sparse_dc;
+      idct->pub._sparse_inverse_DCT[ci][IDCT_2X2] =
+        _jpeg_idct_islow_sparse_2x2;
+      idct->pub._sparse_inverse_DCT[ci][IDCT_4X4] =
+        _jpeg_idct_islow_sparse_4x4;
+    }
+#if defined(WITH_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+    else if (method_ptr == jsimd_idct_islow && jsimd_can_idct_islow_dc())
+      idct->pub._sparse_inverse_DCT[ci][IDCT_DC] = jsimd_idct_islow_dc;
+#endif
+#endif
     /* Create multiplier table from quant table.
      * However, we can skip this if the component is uninteresting
      * or if we already built the table.  Also, if no quant table
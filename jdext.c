@@ -0,0 +1,55 @@
+/*
+ * jdext.c
+ *
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains accessor functions for decompression extension
+ * parameters.  These allow for extending the functionality of the libjpeg API
+ * without breaking backward ABI compatibility.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+
+
+GLOBAL(boolean)
+jpeg_d_int_param_supported (const j_decompress_ptr cinfo, J_INT_PARAM param)
+{
+  switch (param) {
+  case JINT_NUM_THREADS:
+    return TRUE;
+  default:
+    break;
+  }
+
+  return FALSE;
+}
+
+
+GLOBAL(void)
+jpeg_d_set_int_param (j_decompress_ptr cinfo, J_INT_PARAM param, int value)
+{
+  switch (param) {
+  case JINT_NUM_THREADS:
+    if (value >= 1)
+      cinfo->master->num_threads = value;
+    break;
+  default:
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+  }
+}
+
+
+GLOBAL(int)
+jpeg_d_get_int_param (const j_decompress_ptr cinfo, J_INT_PARAM param)
+{
+  switch (param) {
+  case JINT_NUM_THREADS:
+    return cinfo->master->num_threads;
+  default:
+    ERREXIT(cinfo, JERR_BAD_PARAM);
+  }
+
+  return -1;
+}
@@ -28,7 +28,9 @@
 #include "jpeglib.h"
 #include "jdhuff.h"             /* Declarations shared with jd*huff.c */
 #include "jpegapicomp.h"
+#include "jthread.h"
 #include "jstdhuff.c"
+#include <setjmp.h>
 
 
 /*
@@ -96,7 +98,7 @@ start_pass_huff_decoder(j_decompress_ptr cinfo)
     dctbl = compptr->dc_tbl_no;
     actbl = compptr->ac_tbl_no;
     /* Compute derived values for Huffman tables */
-    /* We may do this more than once for a table, but it's not expensive */
+    /* This is skipped for a table that has not been redefined */
     pdtbl = (d_derived_tbl **)(entropy->dc_derived_tbls) + dctbl;
     jpeg_make_d_derived_tbl(cinfo, TRUE, dctbl, pdtbl);
     pdtbl = (d_derived_tbl **)(entropy->ac_derived_tbls) + actbl;
@@ -163,13 +165,19 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
   if (htbl == NULL)
     ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
 
-  /* Allocate a workspace if we haven't already done so. */
+  /* Allocate a workspace if we haven't already done so.  Otherwise, reuse
+   * the derived table if it was derived from the same table definition.
+   */
   if (*pdtbl == NULL)
     *pdtbl = (d_derived_tbl *)
       (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
                                   sizeof(d_derived_tbl));
+  else if ((*pdtbl)->pub == htbl && (*pdtbl)->isDC == isDC &&
+           !memcmp((*pdtbl)->bits, htbl->bits, sizeof(htbl->bits)) &&
+           !memcmp((*pdtbl)->huffval, htbl->huffval, sizeof(htbl->huffval)))
+    return;
   dtbl = *pdtbl;
-  dtbl->pub = htbl;             /* fill in back link */
+  dtbl->pub = NULL;             /* not valid until fully derived */
 
   /* Figure C.1: make table of Huffman code length for each symbol */
 
@@ -258,6 +266,42 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
         ERREXIT(cinfo, JERR_BAD_HUFF_TABLE);
     }
   }
+
+  /* Compute the full-symbol lookahead table from the lookahead table.  An AC
+   * coefficient is often the last one in its block, so if the EOB code fits
+   * after it, its length is stored as well.
+   */
+  for (i = 0; i < (1 << HUFF_FULL_LOOKAHEAD); i++) {
+    int entry, sym, r, s, rest, value = 0;
+
+    entry = dtbl->lookup[i >> (HUFF_FULL_LOOKAHEAD - HUFF_LOOKAHEAD)];
+    l = entry >> HUFF_LOOKAHEAD;
+    sym = entry & ((1 << HUFF_LOOKAHEAD) - 1);
+    r = isDC ? 0 : sym >> 4;
+    s = isDC ? sym : sym & 15;
+    dtbl->full_lookup[i] = 0;
+    if (l > HUFF_LOOKAHEAD || l + s > HUFF_FULL_LOOKAHEAD)
+      continue;
+    rest = HUFF_FULL_LOOKAHEAD - l - s;
+    if (s) {
+      value = (i >> rest) & ((1 << s) - 1);
+      if (value < (1 << (s - 1)))
+        value -= (1 << s) - 1;
+    }
+    dtbl->full_lookup[i] = value * 65536 | (r << 4) | (l + s);
+    if (!isDC && s && rest > 0) {
+      entry = dtbl->lookup[((i << (l + s)) & ((1 << HUFF_FULL_LOOKAHEAD) - 1)) >>
+                           (HUFF_FULL_LOOKAHEAD - HUFF_LOOKAHEAD)];
+      if ((entry >> HUFF_LOOKAHEAD) <= rest &&
+          (entry & ((1 << HUFF_LOOKAHEAD) - 1)) == 0)
+        dtbl->full_lookup[i] |= (entry >> HUFF_LOOKAHEAD) << 8;
+    }
+  }
+
+  dtbl->pub = htbl;             /* fill in back link */
+  dtbl->isDC = isDC;
+  memcpy(dtbl->bits, htbl->bits, sizeof(htbl->bits));
+  memcpy(dtbl->huffval, htbl->huffval, sizeof(htbl->huffval));
 }
 
 
@@ -266,23 +310,8 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
  * See jdhuff.h for info about usage.
  * Note: current values of get_buffer and bits_left are passed as parameters,
  * but are returned in the corresponding fields of the state struct.
- *
- * On most machines MIN_GET_BITS should be 25 to allow the full 32-bit width
- * of get_buffer to be used.  (On machines with wider words, an even larger
- * buffer could be used.)  However, on some machines 32-bit shifts are
- * quite slow and take time proportional to the number of places shifted.
- * (This is true with most PC compilers, for instance.)  In this case it may
- * be a win to set MIN_GET_BITS to the minimum value of 15.  This reduces the
- * average shift distance at the cost of more calls to jpeg_fill_bit_buffer.
  */
 
-#ifdef SLOW_SHIFT_32
-#define MIN_GET_BITS  15        /* minimum allowable value */
-#else
-#define MIN_GET_BITS  (BIT_BUF_SIZE - 7)
-#endif
-
-
 GLOBAL(boolean)
 jpeg_fill_bit_buffer(bitread_working_state *state,
                      register bit_buf_type get_buffer, register int bits_left,
@@ -384,49 +413,6 @@ no_more_bytes:
 }
 
 
-/* Macro version of the above, which performs much better but does not
-   handle markers.  We have to hand off any blocks with markers to the
-   slower routines. */
-
-#define GET_BYTE { \
-  register int c0, c1; \
-  c0 = *buffer++; \
-  c1 = *buffer; \
-  /* Pre-execute most common case */ \
-  get_buffer = (get_buffer << 8) | c0; \
-  bits_left += 8; \
-  if (c0 == 0xFF) { \
-    /* Pre-execute case of FF/00, which represents an FF data byte */ \
-    buffer++; \
-    if (c1 != 0) { \
-      /* Oops, it's actually a marker indicating end of compressed data. */ \
-      cinfo->unread_marker = c1; \
-      /* Back out pre-execution and fill the buffer with zero bits */ \
-      buffer -= 2; \
-      get_buffer &= ~0xFF; \
-    } \
-  } \
-}
-
-#if SIZEOF_SIZE_T == 8 || defined(_WIN64) || (defined(__x86_64__) && defined(__ILP32__))
-
-/* Pre-fetch 48 bytes, because the holding register is 64-bit */
-#define FILL_BIT_BUFFER_FAST \
-  if (bits_left <= 16) { \
-    GET_BYTE GET_BYTE GET_BYTE GET_BYTE GET_BYTE GET_BYTE \
-  }
-
-#else
-
-/* Pre-fetch 16 bytes, because the holding register is 32-bit */
-#define FILL_BIT_BUFFER_FAST \
-  if (bits_left <= 16) { \
-    GET_BYTE GET_BYTE \
-  }
-
-#endif
-
-
 /*
  * Out-of-line code for Huffman code decoding.
  * See jdhuff.h for info about usage.
@@ -622,6 +608,8 @@ decode_mcu_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
           k += 15;
         }
       }
+      /* No coefficient at or after k was stored */
+      entropy->pub.last_nonzero[blkn] = MIN(k, DCTSIZE2) - 1;
 
     } else {
 
@@ -643,6 +631,7 @@ decode_mcu_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
           k += 15;
         }
       }
+      entropy->pub.last_nonzero[blkn] = 0;
     }
   }
 
@@ -680,11 +669,19 @@ decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
     d_derived_tbl *actbl = entropy->ac_cur_tbls[blkn];
     register int s, k, r, l;
 
-    HUFF_DECODE_FAST(s, l, dctbl);
+    /* Decode the DC difference with a single table lookup if possible */
+    FILL_BIT_BUFFER_FAST
+    s = dctbl->full_lookup[PEEK_BITS(HUFF_FULL_LOOKAHEAD)];
     if (s) {
-      FILL_BIT_BUFFER_FAST
-      r = GET_BITS(s);
-      s = HUFF_EXTEND(r, s);
+      DROP_BITS(s & 15);
+      s >>= 16;
+    } else {
+      HUFF_DECODE_FAST(s, l, dctbl);
+      if (s) {
+        FILL_BIT_BUFFER_FAST
+        r = GET_BITS(s);
+        s = HUFF_EXTEND(r, s);
+      }
     }
 
     if (entropy->dc_needed[blkn]) {
@@ -698,9 +695,34 @@ decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
         (*block)[0] = (JCOEF)s;
     }
 
+    /* In both of the loops below, the full-symbol lookahead table resolves
+     * most AC coefficients, along with an EOB code that follows the last one,
+     * in a single lookup.  A coefficient at k = 63 is never followed by an
+     * EOB code.
+     */
     if (entropy->ac_needed[blkn] && block) {
 
       for (k = 1; k < DCTSIZE2; k++) {
+        FILL_BIT_BUFFER_FAST
+        s = actbl->full_lookup[PEEK_BITS(HUFF_FULL_LOOKAHEAD)];
+        if (s) {
+          DROP_BITS(s & 15);
+          r = (s >> 4) & 15;
+          if (s >> 16) {
+            k += r;
+            (*block)[jpeg_natural_order[k]] = (JCOEF)(s >> 16);
+            if ((s & 0xF00) && k < DCTSIZE2 - 1) {
+              DROP_BITS((s >> 8) & 15);
+              k++;              /* as if the EOB code had been read alone */
+              break;
+            }
+          } else {
+            if (r != 15) break;
+            k += 15;
+          }
+          continue;
+        }
+
         HUFF_DECODE_FAST(s, l, actbl);
         r = s >> 4;
         s &= 15;
@@ -716,10 +738,30 @@ decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
           k += 15;
         }
       }
+      /* No coefficient at or after k was stored */
+      entropy->pub.last_nonzero[blkn] = MIN(k, DCTSIZE2) - 1;
 
     } else {
 
       for (k = 1; k < DCTSIZE2; k++) {
+        FILL_BIT_BUFFER_FAST
+        s = actbl->full_lookup[PEEK_BITS(HUFF_FULL_LOOKAHEAD)];
+        if (s) {
+          DROP_BITS(s & 15);
+          r = (s >> 4) & 15;
+          if (s >> 16) {
+            k += r;
+            if ((s & 0xF00) && k < DCTSIZE2 - 1) {
+              DROP_BITS((s >> 8) & 15);
+              break;
+            }
+          } else {
+            if (r != 15) break;
+            k += 15;
+          }
+          continue;
+        }
+
         HUFF_DECODE_FAST(s, l, actbl);
         r = s >> 4;
         s &= 15;
@@ -733,6 +775,7 @@ decode_mcu_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
           k += 15;
         }
       }
+      entropy->pub.last_nonzero[blkn] = 0;
     }
   }
 
@@ -794,6 +837,15 @@ decode_mcu(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
     } else {
 use_slow:
       if (!decode_mcu_slow(cinfo, MCU_data)) return FALSE;
+      /* If the fast path gave up, it may have stored coefficients that the
+       * slow path did not overwrite.
+       */
+      if (usefast) {
+        int blkn;
+
+        for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++)
+          entropy->pub.last_nonzero[blkn] = DCTSIZE2 - 1;
+      }
     }
 
   }
@@ -806,6 +858,719 @@ use_slow:
 }
 
 
+/*
+ * Concurrent decoding of restart intervals.
+ *
+ * The restart intervals of a Huffman-coded sequential scan are independent of
+ * each other, since the bit buffer is flushed and the DC predictions are reset
+ * at each restart marker.  Thus, when the whole scan is in the source buffer
+ * (as it is with jpeg_mem_src()), the buffer is searched for the markers, the
+ * scan is split into stripes of whole restart intervals, and the stripes are
+ * decoded into the full-image coefficient buffer concurrently, each on a
+ * private copy of the decompression object with its own source manager,
+ * marker reader state, and entropy decoder state.  The derived Huffman tables
+ * are only read, so they are shared with the parent.
+ *
+ * A stripe fails if it produces a warning, if it runs out of data, or if it
+ * does not end cleanly at the restart marker that was found for it.  The scan
+ * is then decoded serially instead, so any warnings are emitted exactly as
+ * they would be without concurrency.  Otherwise, the coefficients are the
+ * same as with serial decoding, and the parent is left in the same state as
+ * serial decoding would leave it.  Trace messages from the stripes are not
+ * reported.
+ */
+
+#define STRIPES_PER_THREAD  4
+
+typedef struct {
+  struct jpeg_error_mgr pub;    /* "public" fields */
+  jmp_buf setjmp_buffer;        /* for return to decode_restart_stripe() */
+} stripe_error_mgr;
+
+typedef struct {
+  struct jpeg_decompress_struct cinfo; /* private copy of the parent object */
+  stripe_error_mgr err;
+  struct jpeg_source_mgr src;
+  struct jpeg_marker_reader marker;
+  huff_entropy_decoder entropy;
+  JDIMENSION first_interval;    /* index of the first restart interval */
+  JDIMENSION start_MCU;         /* first MCU of the stripe */
+  JDIMENSION num_MCUs;
+  const JOCTET *data;           /* compressed data of the stripe, including */
+  size_t size;                  /* the marker that terminates it */
+  boolean failed;
+} restart_stripe;
+
+typedef struct {
+  j_decompress_ptr cinfo;
+  restart_stripe *stripes;
+  int num_stripes;
+} stripe_batch;
+
+
+METHODDEF(void)
+stripe_error_exit(j_common_ptr cinfo)
+{
+  stripe_error_mgr *err = (stripe_error_mgr *)cinfo->err;
+
+  longjmp(err->setjmp_buffer, 1);
+}
+
+
+METHODDEF(void)
+stripe_emit_message(j_common_ptr cinfo, int msg_level)
+{
+  /* A warning makes the stripe fail.  Trace messages are ignored. */
+  if (msg_level < 0)
+    stripe_error_exit(cinfo);
+}
+
+
+METHODDEF(boolean)
+stripe_fill_input_buffer(j_decompress_ptr cinfo)
+{
+  /* Each stripe ends with a marker, beyond which the entropy decoder does not
+   * read unless the data are corrupt.
+   */
+  ERREXIT(cinfo, JERR_INPUT_EOF);
+  return FALSE;
+}
+
+
+/*
+ * Find the compressed data of each stripe in the source buffer.  The
+ * restart intervals of the scan must be terminated by RSTn markers, except
+ * for the last one, which must be terminated by another marker.  Returns
+ * FALSE if the buffer does not hold the whole scan in that form.
+ */
+
+LOCAL(boolean)
+find_stripe_data(j_decompress_ptr cinfo, restart_stripe *stripes,
+                 int num_stripes, JDIMENSION num_intervals)
+{
+  const JOCTET *ptr = cinfo->src->next_input_byte;
+  const JOCTET *end = ptr + cinfo->src->bytes_in_buffer;
+  JDIMENSION interval = 0;      /* index of the current restart interval */
+  int stripe = 0, c;
+
+  stripes[0].data = ptr;
+  for (;;) {
+    ptr = (const JOCTET *)memchr(ptr, 0xFF, end - ptr);
+    if (ptr == NULL)
+      return FALSE;
+    /* Skip any fill bytes, in the same way as jpeg_fill_bit_buffer() */
+    do {
+      if (++ptr == end)
+        return FALSE;
+    } while (*ptr == 0xFF);
+    c = *ptr++;
+    if (c == 0)                 /* FF/00 represents an FF data byte */
+      continue;
+
+    /* The marker terminates the current restart interval. */
+    if ((c >= JPEG_RST0 && c <= JPEG_RST0 + 7) !=
+        (interval < num_intervals - 1))
+      return FALSE;
+    interval++;
+    if (stripe == num_stripes - 1) {
+      if (interval == num_intervals) {
+        stripes[stripe].size = ptr - stripes[stripe].data;
+        return TRUE;
+      }
+    } else if (interval == stripes[stripe + 1].first_interval) {
+      stripes[stripe].size = ptr - stripes[stripe].data;
+      stripes[++stripe].data = ptr;
+    }
+  }
+}
+
+
+METHODDEF(void)
+decode_restart_stripe(void *arg, int task)
+{
+  stripe_batch *batch = (stripe_batch *)arg;
+  j_decompress_ptr parent = batch->cinfo;
+  restart_stripe *stripe = &batch->stripes[task];
+  j_decompress_ptr cinfo = &stripe->cinfo;
+
+  *cinfo = *parent;
+  stripe->err.pub = *parent->err;
+  stripe->err.pub.error_exit = stripe_error_exit;
+  stripe->err.pub.emit_message = stripe_emit_message;
+  cinfo->err = &stripe->err.pub;
+  cinfo->mem = NULL;
+  cinfo->progress = NULL;
+
+  stripe->src = *parent->src;
+  stripe->src.next_input_byte = stripe->data;
+  stripe->src.bytes_in_buffer = stripe->size;
+  stripe->src.fill_input_buffer = stripe_fill_input_buffer;
+  cinfo->src = &stripe->src;
+
+  /* Start in the state that process_restart() leaves before the first
+   * interval of the stripe.  The parent is still at the start of the scan.
+   */
+  stripe->marker = *parent->marker;
+  stripe->marker.next_restart_num =
+    (parent->marker->next_restart_num + (int)(stripe->first_interval & 7)) & 7;
+  cinfo->marker = &stripe->marker;
+  stripe->entropy = *(huff_entropy_ptr)parent->entropy;
+  cinfo->entropy = &stripe->entropy.pub;
+
+  stripe->failed = TRUE;
+  if (setjmp(stripe->err.setjmp_buffer))
+    return;
+
+  if (!(*cinfo->coef->decode_scan) (cinfo, stripe->start_MCU,
+                                    stripe->num_MCUs))
+    return;
+  /* Read the RSTn marker that terminates the stripe, as the serial decoder
+   * would before the next interval, so that extraneous data and misnumbered
+   * markers are detected.
+   */
+  if (task < batch->num_stripes - 1 && !process_restart(cinfo))
+    return;
+  /* Discarded bytes that have not been reported yet would be reported
+   * serially.
+   */
+  if (stripe->marker.discarded_bytes != 0)
+    return;
+  stripe->failed = FALSE;
+}
+
+
+/*
+ * Decode the current scan, which must not have been started yet, with its
+ * restart intervals decoded concurrently.  This is only called by the
+ * coefficient controller if cinfo->master->concurrent_restarts is TRUE, in
+ * which case this module is the entropy decoder.  Returns FALSE if the scan
+ * must be decoded serially instead.  *dirty is set to TRUE if coefficients
+ * may have been stored in the coefficient buffer before failing.
+ */
+
+GLOBAL(boolean)
+jdecode_restart_intervals(j_decompress_ptr cinfo, boolean *dirty)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  JDIMENSION num_MCUs, num_intervals, first, next;
+  jthread_pool *pool;
+  restart_stripe *stripes, *last;
+  stripe_batch batch;
+  int i, num_stripes;
+
+  if (cinfo->master->num_threads < 2 || cinfo->coef->decode_scan == NULL ||
+      cinfo->restart_interval == 0 || cinfo->unread_marker != 0 ||
+      cinfo->marker->discarded_bytes != 0 || entropy->bitstate.bits_left != 0 ||
+      entropy->restarts_to_go != cinfo->restart_interval ||
+      entropy->pub.insufficient_data)
+    return FALSE;
+
+  /* Split the scan into stripes of whole restart intervals */
+  num_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  num_intervals = (JDIMENSION)jdiv_round_up((long)num_MCUs,
+                                            (long)cinfo->restart_interval);
+  num_stripes = cinfo->master->num_threads * STRIPES_PER_THREAD;
+  if ((JDIMENSION)num_stripes > num_intervals)
+    num_stripes = (int)num_intervals;
+  if (num_stripes < 2)
+    return FALSE;
+
+  stripes = (restart_stripe *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                num_stripes * sizeof(restart_stripe));
+  for (i = 0; i < num_stripes; i++) {
+    first = (JDIMENSION)((unsigned long long)num_intervals * i / num_stripes);
+    next = (JDIMENSION)((unsigned long long)num_intervals * (i + 1) /
+                        num_stripes);
+    stripes[i].first_interval = first;
+    stripes[i].start_MCU = first * cinfo->restart_interval;
+    stripes[i].num_MCUs = MIN(next * cinfo->restart_interval, num_MCUs) -
+                          stripes[i].start_MCU;
+  }
+  if (!find_stripe_data(cinfo, stripes, num_stripes, num_intervals))
+    return FALSE;
+
+  pool = jthread_pool_create(cinfo->master->num_threads);
+  if (pool == NULL)
+    return FALSE;
+
+  *dirty = TRUE;
+  batch.cinfo = cinfo;
+  batch.stripes = stripes;
+  batch.num_stripes = num_stripes;
+  jthread_pool_run(pool, decode_restart_stripe, &batch, num_stripes);
+  jthread_pool_destroy(pool);
+
+  for (i = 0; i < num_stripes; i++) {
+    if (stripes[i].failed)
+      return FALSE;
+  }
+
+  /* Leave the parent where serial decoding would have left it. */
+  last = &stripes[num_stripes - 1];
+  *entropy = last->entropy;
+  cinfo->src->bytes_in_buffer -=
+    last->src.next_input_byte - cinfo->src->next_input_byte;
+  cinfo->src->next_input_byte = last->src.next_input_byte;
+  cinfo->unread_marker = last->cinfo.unread_marker;
+  cinfo->marker->next_restart_num = last->marker.next_restart_num;
+  return TRUE;
+}
+
+
+/*
+ * Speculative concurrent decoding of scans without restart markers.
+ *
+ * Without restart markers, the position of each MCU in the compressed data is
+ * only known once all of the preceding MCUs have been decoded.  However,
+ * Huffman codes tend to resynchronize: a decoder that starts at an arbitrary
+ * bit position usually decodes garbage for a while and then lands on a true
+ * MCU boundary, after which it decodes exactly the same symbols as the serial
+ * decoder.  Thus, when the whole scan is in the source buffer, the scan is
+ * split at equally spaced byte positions into one chunk per thread, and it is
+ * decoded in three concurrent phases:
+ *
+ * 1. Starting at the beginning of each chunk (which is the true beginning of
+ *    the scan only for the first chunk) as if an MCU started there, the
+ *    chunk is decoded without storing any coefficients.  The bit positions
+ *    and DC predictions at the first SYNC_WINDOW MCU boundaries are recorded.
+ * 2. The decoder of each chunk continues into the next chunk until it reaches
+ *    one of the MCU boundaries that were recorded for that chunk.  From that
+ *    point on, the two decoders agree.  Since the decoder of the first chunk
+ *    is correct, this proves, chunk by chunk, that the decoder of each chunk
+ *    has joined the true sequence of MCUs, and it tells us the MCU number and
+ *    the DC predictions at that point.
+ * 3. Each chunk's validated range of MCUs is decoded into the full-image
+ *    coefficient buffer, starting at its known bit position with its known
+ *    DC predictions.
+ *
+ * If a decoder does not synchronize within the next chunk's window, or if any
+ * warning is produced in phase 3, then the scan is decoded serially instead.
+ * The coefficients are the same as with serial decoding, and the parent is
+ * left in a state that cannot be distinguished from the serial decoder's
+ * state.  Phases 1 and 3 each decode the whole scan, so the speedup is at
+ * most half the number of threads.
+ */
+
+#define SYNC_WINDOW  512        /* # of MCU boundaries recorded per chunk */
+#define MIN_CHUNK_SIZE  32768   /* min. # of bytes of compressed data/chunk */
+
+typedef struct {
+  size_t pos;                   /* bit position of the MCU in the scan */
+  int last_dc_val[MAX_COMPS_IN_SCAN]; /* DC predictions at that position */
+} mcu_checkpoint;
+
+typedef struct {
+  struct jpeg_decompress_struct cinfo; /* private copy of the parent object */
+  stripe_error_mgr err;
+  struct jpeg_source_mgr src;
+  huff_entropy_decoder entropy;
+  size_t end;                   /* bit position of the end of the chunk */
+  /* Phase 1 and 2 results.  The DC predictions are relative to the start of
+   * the chunk, and MCU counts are relative to the start of the chunk.
+   */
+  mcu_checkpoint window[SYNC_WINDOW];
+  int num_checkpoints;
+  JDIMENSION num_decoded;       /* # of MCUs decoded in phases 1 and 2 */
+  int sync;                     /* index of the checkpoint at which the chunk
+                                   joins the true MCU sequence, or -1 */
+  JDIMENSION next_sync_MCUs;    /* # of MCUs decoded to reach the next */
+  mcu_checkpoint next_sync;     /* chunk's sync checkpoint */
+  /* Phase 3 parameters */
+  mcu_checkpoint start;         /* true starting point and DC predictions */
+  JDIMENSION start_MCU;
+  JDIMENSION num_MCUs;
+  boolean failed;
+} speculative_stripe;
+
+typedef struct {
+  j_decompress_ptr cinfo;
+  speculative_stripe *stripes;
+  int num_stripes;
+  const JOCTET *data;           /* start of the compressed data of the scan */
+} speculative_batch;
+
+
+METHODDEF(void)
+probe_emit_message(j_common_ptr cinfo, int msg_level)
+{
+  /* Warnings are expected while a speculative decoder has not synchronized,
+   * and they are reproduced in phase 3 otherwise.
+   */
+}
+
+
+/*
+ * Return the bit position in the compressed data of the next bit that the
+ * entropy decoder will read.  The bits in the bit buffer are walked back over
+ * their source bytes, taking byte stuffing into account, so the position does
+ * not depend on how far ahead the bit buffer has been filled.  This must not
+ * be called after a marker has been read.
+ */
+
+LOCAL(size_t)
+scan_bit_position(j_decompress_ptr cinfo, const JOCTET *data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  const JOCTET *ptr = cinfo->src->next_input_byte;
+  int bits = entropy->bitstate.bits_left;
+
+  while (bits > 0) {
+    ptr--;
+    if (*ptr == 0 && ptr > data && ptr[-1] == 0xFF)
+      ptr--;                    /* FF/00 represents an FF data byte */
+    bits -= 8;
+  }
+  return (size_t)(ptr - data) * 8 - bits;
+}
+
+
+/*
+ * Set up the private decompression object of a stripe so that its entropy
+ * decoder starts reading at the given bit position.
+ */
+
+LOCAL(boolean)
+seek_stripe(speculative_batch *batch, speculative_stripe *stripe,
+            const mcu_checkpoint *checkpoint)
+{
+  j_decompress_ptr parent = batch->cinfo;
+  j_decompress_ptr cinfo = &stripe->cinfo;
+  const JOCTET *ptr = batch->data + checkpoint->pos / 8;
+  const JOCTET *end = parent->src->next_input_byte +
+                      parent->src->bytes_in_buffer;
+  int c;
+
+  *cinfo = *parent;
+  stripe->err.pub = *parent->err;
+  stripe->err.pub.error_exit = stripe_error_exit;
+  cinfo->err = &stripe->err.pub;
+  cinfo->mem = NULL;
+  cinfo->progress = NULL;
+
+  stripe->entropy = *(huff_entropy_ptr)parent->entropy;
+  memcpy(stripe->entropy.saved.last_dc_val, checkpoint->last_dc_val,
+         sizeof(checkpoint->last_dc_val));
+  cinfo->entropy = &stripe->entropy.pub;
+
+  /* Load the byte that contains the starting bit, and drop the bits that
+   * precede it.
+   */
+  if (ptr >= end)
+    return FALSE;
+  c = *ptr++;
+  if (c == 0xFF) {
+    while (ptr < end && *ptr == 0xFF)
+      ptr++;
+    if (ptr >= end || *ptr++ != 0)
+      return FALSE;
+  }
+  stripe->entropy.bitstate.get_buffer = (bit_buf_type)c;
+  stripe->entropy.bitstate.bits_left = 8 - (int)(checkpoint->pos % 8);
+
+  stripe->src = *parent->src;
+  stripe->src.next_input_byte = ptr;
+  stripe->src.bytes_in_buffer = end - ptr;
+  stripe->src.fill_input_buffer = stripe_fill_input_buffer;
+  cinfo->src = &stripe->src;
+  return TRUE;
+}
+
+
+/*
+ * Decode one MCU without storing it, and record the new position.  Returns
+ * FALSE if the decoder has read a marker, which means that the end of the scan
+ * has been reached or that the decoder is not synchronized.
+ */
+
+LOCAL(boolean)
+probe_mcu(speculative_batch *batch, speculative_stripe *stripe,
+          mcu_checkpoint *checkpoint)
+{
+  j_decompress_ptr cinfo = &stripe->cinfo;
+
+  if (!(*cinfo->entropy->decode_mcu) (cinfo, NULL) ||
+      cinfo->unread_marker != 0 || stripe->entropy.pub.insufficient_data)
+    return FALSE;
+  checkpoint->pos = scan_bit_position(cinfo, batch->data);
+  memcpy(checkpoint->last_dc_val, stripe->entropy.saved.last_dc_val,
+         sizeof(checkpoint->last_dc_val));
+  stripe->num_decoded++;
+  return TRUE;
+}
+
+
+/*
+ * Phase 1: decode the chunk as if an MCU started at its beginning.
+ */
+
+METHODDEF(void)
+probe_chunk(void *arg, int task)
+{
+  speculative_batch *batch = (speculative_batch *)arg;
+  speculative_stripe *stripe = &batch->stripes[task];
+  mcu_checkpoint checkpoint;
+
+  stripe->num_checkpoints = 0;
+  stripe->num_decoded = 0;
+  stripe->failed = TRUE;
+  /* The parent is at the beginning of the scan, so the first chunk starts
+   * with its DC predictions.  For the others, the DC predictions are relative
+   * to the chunk's starting point.
+   */
+  checkpoint = stripe->start;
+  if (!seek_stripe(batch, stripe, &checkpoint))
+    return;
+  stripe->err.pub.emit_message = probe_emit_message;
+  if (setjmp(stripe->err.setjmp_buffer))
+    return;
+
+  for (;;) {
+    if (stripe->num_checkpoints < SYNC_WINDOW)
+      stripe->window[stripe->num_checkpoints++] = checkpoint;
+    else if (task == batch->num_stripes - 1)
+      break;                    /* The last chunk only needs the window. */
+    if (checkpoint.pos >= stripe->end)
+      break;
+    if (!probe_mcu(batch, stripe, &checkpoint))
+      break;
+  }
+  stripe->next_sync = checkpoint;
+  stripe->failed = FALSE;
+}
+
+
+/*
+ * Phase 2: continue decoding into the next chunk until the decoder reaches
+ * one of the MCU boundaries that were recorded for that chunk in phase 1.
+ */
+
+LOCAL(int)
+find_sync_point(speculative_batch *batch, speculative_stripe *stripe,
+                speculative_stripe *next, mcu_checkpoint *checkpoint)
+/* Returns the index of the boundary in next->window, or -1 if none */
+{
+  int i = 0;
+
+  for (;;) {
+    while (i < next->num_checkpoints && next->window[i].pos < checkpoint->pos)
+      i++;
+    if (i == next->num_checkpoints)
+      return -1;
+    if (next->window[i].pos == checkpoint->pos)
+      return i;
+    if (!probe_mcu(batch, stripe, checkpoint))
+      return -1;
+  }
+}
+
+
+METHODDEF(void)
+sync_chunk(void *arg, int task)
+{
+  speculative_batch *batch = (speculative_batch *)arg;
+  speculative_stripe *stripe = &batch->stripes[task];
+  speculative_stripe *next = &batch->stripes[task + 1];
+  mcu_checkpoint checkpoint = stripe->next_sync;
+
+  stripe->failed = TRUE;
+  next->sync = -1;
+  /* The search is done by a separate function so that no local variable of
+   * this function is modified between setjmp() and longjmp().
+   */
+  if (setjmp(stripe->err.setjmp_buffer))
+    return;
+
+  next->sync = find_sync_point(batch, stripe, next, &checkpoint);
+  if (next->sync < 0)
+    return;
+  stripe->next_sync = checkpoint;
+  stripe->next_sync_MCUs = stripe->num_decoded;
+  stripe->failed = FALSE;
+}
+
+
+/*
+ * Phase 3: decode the chunk's validated range of MCUs into the coefficient
+ * buffer.
+ */
+
+METHODDEF(void)
+decode_chunk(void *arg, int task)
+{
+  speculative_batch *batch = (speculative_batch *)arg;
+  speculative_stripe *stripe = &batch->stripes[task];
+  j_decompress_ptr cinfo = &stripe->cinfo;
+
+  stripe->failed = TRUE;
+  if (!seek_stripe(batch, stripe, &stripe->start))
+    return;
+  stripe->err.pub.emit_message = stripe_emit_message;
+  if (setjmp(stripe->err.setjmp_buffer))
+    return;
+
+  if (!(*cinfo->coef->decode_scan) (cinfo, stripe->start_MCU,
+                                    stripe->num_MCUs))
+    return;
+  if (task < batch->num_stripes - 1) {
+    /* The chunk must end where the next one starts. */
+    if (cinfo->unread_marker != 0 ||
+        scan_bit_position(cinfo, batch->data) !=
+        batch->stripes[task + 1].start.pos)
+      return;
+  } else {
+    /* The scan must end with less than a byte of padding before the marker,
+     * so that the serial decoder would not have found any extraneous data.
+     */
+    if (cinfo->unread_marker == 0 || stripe->entropy.bitstate.bits_left >= 8)
+      return;
+  }
+  stripe->failed = FALSE;
+}
+
+
+LOCAL(boolean)
+run_stripes(jthread_pool *pool, void (*fn) (void *arg, int task),
+            speculative_batch *batch, int num_tasks)
+{
+  int i;
+
+  jthread_pool_run(pool, fn, batch, num_tasks);
+  for (i = 0; i < num_tasks; i++) {
+    if (batch->stripes[i].failed)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+
+/*
+ * Decode the current scan, which must not have been started yet and must not
+ * have restart markers, speculatively in concurrent chunks.  This is only
+ * called by the coefficient controller if cinfo->master->concurrent_scan is
+ * TRUE, in which case this module is the entropy decoder.  Returns FALSE if
+ * the scan must be decoded serially instead.  *dirty is set to TRUE if
+ * coefficients may have been stored in the coefficient buffer before failing.
+ */
+
+GLOBAL(boolean)
+jdecode_speculatively(j_decompress_ptr cinfo, boolean *dirty)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  const JOCTET *data = cinfo->src->next_input_byte;
+  const JOCTET *ptr, *end;
+  JDIMENSION num_MCUs, next_MCU;
+  speculative_stripe *stripes, *stripe;
+  speculative_batch batch;
+  jthread_pool *pool;
+  size_t size, offset;
+  int i, ci, num_stripes;
+  boolean retval = FALSE;
+
+  if (cinfo->master->num_threads < 2 || cinfo->coef->decode_scan == NULL ||
+      cinfo->restart_interval != 0 || cinfo->unread_marker != 0 ||
+      entropy->bitstate.bits_left != 0 || entropy->pub.insufficient_data)
+    return FALSE;
+
+  /* Find the marker that terminates the scan. */
+  ptr = data;
+  end = data + cinfo->src->bytes_in_buffer;
+  for (;;) {
+    ptr = (const JOCTET *)memchr(ptr, 0xFF, end - ptr);
+    if (ptr == NULL)
+      return FALSE;
+    size = ptr - data;
+    do {
+      if (++ptr == end)
+        return FALSE;
+    } while (*ptr == 0xFF);
+    if (*ptr++ != 0)
+      break;
+  }
+  if (size > (size_t)-1 / 8)
+    return FALSE;
+
+  num_stripes = cinfo->master->num_threads;
+  if ((size_t)num_stripes > size / MIN_CHUNK_SIZE)
+    num_stripes = (int)(size / MIN_CHUNK_SIZE);
+  if (num_stripes < 2)
+    return FALSE;
+
+  stripes = (speculative_stripe *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                num_stripes * sizeof(speculative_stripe));
+  memset(stripes, 0, num_stripes * sizeof(speculative_stripe));
+  for (i = 0; i < num_stripes; i++) {
+    /* Don't start a chunk in the middle of a stuffed FF byte. */
+    offset = size / num_stripes * i;
+    while (offset > 0 && offset < size && data[offset - 1] == 0xFF)
+      offset++;
+    stripes[i].start.pos = offset * 8;
+    if (i > 0)
+      stripes[i - 1].end = stripes[i].start.pos;
+  }
+  stripes[num_stripes - 1].end = size * 8;
+  memcpy(stripes[0].start.last_dc_val, entropy->saved.last_dc_val,
+         sizeof(entropy->saved.last_dc_val));
+
+  pool = jthread_pool_create(cinfo->master->num_threads);
+  if (pool == NULL)
+    return FALSE;
+  batch.cinfo = cinfo;
+  batch.stripes = stripes;
+  batch.num_stripes = num_stripes;
+  batch.data = data;
+
+  if (!run_stripes(pool, probe_chunk, &batch, num_stripes) ||
+      !run_stripes(pool, sync_chunk, &batch, num_stripes - 1))
+    goto bailout;
+
+  /* Chain the synchronization points, starting with the first chunk, which is
+   * synchronized at its beginning, to find where each chunk's range of MCUs
+   * starts and what the DC predictions are there.
+   */
+  num_MCUs = cinfo->MCUs_per_row * cinfo->MCU_rows_in_scan;
+  stripes[0].sync = 0;
+  stripes[0].start_MCU = 0;
+  for (i = 0; i < num_stripes - 1; i++) {
+    mcu_checkpoint *sync;
+
+    stripe = &stripes[i];
+    sync = &stripe->window[stripe->sync];
+    next_MCU = stripe->start_MCU +
+               (stripe->next_sync_MCUs - (JDIMENSION)stripe->sync);
+    if (next_MCU <= stripe->start_MCU || next_MCU >= num_MCUs)
+      goto bailout;
+    stripe->num_MCUs = next_MCU - stripe->start_MCU;
+    stripes[i + 1].start_MCU = next_MCU;
+    stripes[i + 1].start.pos = stripe->next_sync.pos;
+    for (ci = 0; ci < MAX_COMPS_IN_SCAN; ci++)
+      stripes[i + 1].start.last_dc_val[ci] = (int)
+        ((unsigned int)stripe->start.last_dc_val[ci] +
+         (unsigned int)stripe->next_sync.last_dc_val[ci] -
+         (unsigned int)sync->last_dc_val[ci]);
+  }
+  stripe = &stripes[num_stripes - 1];
+  stripe->num_MCUs = num_MCUs - stripe->start_MCU;
+
+  *dirty = TRUE;
+  if (!run_stripes(pool, decode_chunk, &batch, num_stripes))
+    goto bailout;
+
+  /* Leave the parent where serial decoding would have left it. */
+  *entropy = stripe->entropy;
+  cinfo->src->bytes_in_buffer -=
+    stripe->src.next_input_byte - cinfo->src->next_input_byte;
+  cinfo->src->next_input_byte = stripe->src.next_input_byte;
+  cinfo->unread_marker = stripe->cinfo.unread_marker;
+  retval = TRUE;
+
+bailout:
+  jthread_pool_destroy(pool);
+  return retval;
+}
+
+
 /*
  * Module initialization routine for Huffman entropy decoding.
  */
@@ -833,4 +1598,7 @@ jinit_huff_decoder(j_decompress_ptr cinfo)
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
     entropy->dc_derived_tbls[i] = entropy->ac_derived_tbls[i] = NULL;
   }
+
+  for (i = 0; i < D_MAX_BLOCKS_IN_MCU; i++)
+    entropy->pub.last_nonzero[i] = DCTSIZE2 - 1;
 }
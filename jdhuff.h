@@ -23,6 +23,7 @@
 /* Derived data constructed for each Huffman table */
 
 #define HUFF_LOOKAHEAD  8       /* # of bits of lookahead */
+#define HUFF_FULL_LOOKAHEAD  10 /* # of bits of full-symbol lookahead */
 
 typedef struct {
   /* Basic tables: (element [0] of each array is unused) */
@@ -48,6 +49,31 @@ typedef struct {
    * symbol.
    */
   int lookup[1 << HUFF_LOOKAHEAD];
+
+  /* Full-symbol lookahead table: indexed by the next HUFF_FULL_LOOKAHEAD
+   * bits of the input data stream.  If the next Huffman code and the
+   * magnitude bits that follow it fit in HUFF_FULL_LOOKAHEAD bits, we can
+   * obtain the decoded value directly from this table.
+   *
+   * Bits 0-3 of each table entry contain the total number of bits in the
+   * code and the magnitude bits, or the entry is 0 if they do not fit.  In
+   * AC tables, bits 4-7 contain the run length, and bits 8-11 contain the
+   * length of the EOB code if an EOB code also fits in the remaining bits
+   * (otherwise 0.)  The upper 16 bits contain the signed coefficient value
+   * (for a DC table, the DC difference.)  In an AC table, the value is 0 only
+   * for the EOB and ZRL symbols.  This table is used only by the fast-path
+   * decoders (decode_mcu_fast() and its progressive counterparts in
+   * jdphuff.c.)
+   */
+  int full_lookup[1 << HUFF_FULL_LOOKAHEAD];
+
+  /* Copy of the public Huffman table from which this table was derived, so
+   * that the derivation can be skipped if the table is not redefined
+   * between scans
+   */
+  boolean isDC;
+  UINT8 bits[17];
+  UINT8 huffval[256];
 } d_derived_tbl;
 
 /* Expand a Huffman table definition into the derived format */
@@ -101,6 +127,22 @@ typedef unsigned long bit_buf_type;     /* type of bit-extraction buffer */
  * because not all machines measure sizeof in 8-bit bytes.
  */
 
+/* jpeg_fill_bit_buffer() loads the bit buffer to a depth of at least
+ * MIN_GET_BITS.  On most machines MIN_GET_BITS should be 25 to allow the full
+ * 32-bit width of get_buffer to be used.  (On machines with wider words, an
+ * even larger buffer could be used.)  However, on some machines 32-bit shifts
+ * are quite slow and take time proportional to the number of places shifted.
+ * (This is true with most PC compilers, for instance.)  In this case it may
+ * be a win to set MIN_GET_BITS to the minimum value of 15.  This reduces the
+ * average shift distance at the cost of more calls to jpeg_fill_bit_buffer.
+ */
+
+#ifdef SLOW_SHIFT_32
+#define MIN_GET_BITS  15        /* minimum allowable value */
+#else
+#define MIN_GET_BITS  (BIT_BUF_SIZE - 7)
+#endif
+
 typedef struct {                /* Bitreading state saved across MCUs */
   bit_buf_type get_buffer;      /* current bit-extraction buffer */
   int bits_left;                /* # of unused bits in it */
@@ -179,6 +221,50 @@ EXTERN(boolean) jpeg_fill_bit_buffer(bitread_working_state *state,
                                      register bit_buf_type get_buffer,
                                      register int bits_left, int nbits);
 
+/* Macro version of the above, which performs much better but does not
+   handle markers.  We have to hand off any blocks with markers to the
+   slower routines.  The variables buffer (a pointer into the source buffer)
+   and cinfo are assumed to be locals, and the caller must ensure that enough
+   input is buffered before using these. */
+
+#define GET_BYTE { \
+  register int c0, c1; \
+  c0 = *buffer++; \
+  c1 = *buffer; \
+  /* Pre-execute most common case */ \
+  get_buffer = (get_buffer << 8) | c0; \
+  bits_left += 8; \
+  if (c0 == 0xFF) { \
+    /* Pre-execute case of FF/00, which represents an FF data byte */ \
+    buffer++; \
+    if (c1 != 0) { \
+      /* Oops, it's actually a marker indicating end of compressed data. */ \
+      cinfo->unread_marker = c1; \
+      /* Back out pre-execution and fill the buffer with zero bits */ \
+      buffer -= 2; \
+      get_buffer &= ~0xFF; \
+    } \
+  } \
+}
+
+#if SIZEOF_SIZE_T == 8 || defined(_WIN64) || (defined(__x86_64__) && defined(__ILP32__))
+
+/* Pre-fetch 48 bytes, because the holding register is 64-bit */
+#define FILL_BIT_BUFFER_FAST \
+  if (bits_left <= 16) { \
+    GET_BYTE GET_BYTE GET_BYTE GET_BYTE GET_BYTE GET_BYTE \
+  }
+
+#else
+
+/* Pre-fetch 16 bytes, because the holding register is 32-bit */
+#define FILL_BIT_BUFFER_FAST \
+  if (bits_left <= 16) { \
+    GET_BYTE GET_BYTE \
+  }
+
+#endif
+
 
 /*
  * Code for extracting next Huffman-coded symbol from input bit stream.
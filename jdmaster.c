@@ -496,6 +496,36 @@ prepare_range_limit_table(j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Determine whether the scan may be entropy-decoded concurrently (see
+ * jdecode_restart_intervals() and jdecode_speculatively() in jdhuff.c.)  That
+ * requires a single-scan sequential Huffman-coded image, and the whole-image
+ * coefficient buffer must be able to stay resident in memory.  The source
+ * buffer must also hold the entire scan (as with the memory source);
+ * otherwise, the scan would be decoded serially into the whole-image buffer,
+ * which is slower than the single-pass coefficient controller.  The header
+ * has been read up to the SOS marker, so the rest of the buffer holds the
+ * entire scan if it ends with the EOI marker.
+ */
+
+LOCAL(boolean)
+use_concurrent_scan(j_decompress_ptr cinfo)
+{
+#ifdef D_MULTISCAN_FILES_SUPPORTED
+  const JOCTET *data = cinfo->src->next_input_byte;
+  size_t size = cinfo->src->bytes_in_buffer;
+
+  return cinfo->master->num_threads > 1 && !cinfo->progressive_mode &&
+         !cinfo->arith_code && !cinfo->master->lossless &&
+         !cinfo->inputctl->has_multiple_scans &&
+         cinfo->mem->max_memory_to_use == 0 && size >= 2 &&
+         data[size - 2] == 0xFF && data[size - 1] == JPEG_EOI;
+#else
+  return FALSE;
+#endif
+}
+
+
 /*
  * Master selection of decompression modules.
  * This is done once at jpeg_start_decompress time.  We determine
@@ -644,6 +674,8 @@ master_selection(j_decompress_ptr cinfo)
       jinit_d_post_controller(cinfo, cinfo->enable_2pass_quant);
   }
 
+  cinfo->master->concurrent_scan = use_concurrent_scan(cinfo);
+
   if (cinfo->master->lossless) {
 #ifdef D_LOSSLESS_SUPPORTED
     /* Prediction, sample undifferencing, point transform, and sample size
@@ -702,7 +734,7 @@ master_selection(j_decompress_ptr cinfo)
 
     /* Initialize principal buffer controllers. */
     use_c_buffer = cinfo->inputctl->has_multiple_scans ||
-                   cinfo->buffered_image;
+                   cinfo->buffered_image || cinfo->master->concurrent_scan;
     if (cinfo->data_precision == 12)
       j12init_d_coef_controller(cinfo, use_c_buffer);
     else
@@ -83,7 +83,7 @@ start_pass_phuff_decoder(j_decompress_ptr cinfo)
 {
   phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
   boolean is_DC_band, bad;
-  int ci, coefi, tbl;
+  int ci, coefi, tbl, blkn;
   d_derived_tbl **pdtbl;
   int *coef_bit_ptr, *prev_coef_bit_ptr;
   jpeg_component_info *compptr;
@@ -186,6 +186,12 @@ start_pass_phuff_decoder(j_decompress_ptr cinfo)
   /* Initialize private state variables */
   entropy->saved.EOBRUN = 0;
 
+  /* DC scans store only the DC coefficients, and the AC scans' decode_mcu()
+   * routines record the last nonzero coefficient of their single block.
+   */
+  for (blkn = 0; blkn < D_MAX_BLOCKS_IN_MCU; blkn++)
+    entropy->pub.last_nonzero[blkn] = 0;
+
   /* Initialize restart counter */
   entropy->restarts_to_go = cinfo->restart_interval;
 }
@@ -279,15 +285,81 @@ process_restart(j_decompress_ptr cinfo)
  * coefficients may already have been assigned.  This is harmless for
  * spectral selection, since we'll just re-assign them on the next call.
  * Successive approximation AC refinement has to be more careful, however.)
+ *
+ * As in jdhuff.c, the Huffman-coded scans have a slow path, which handles
+ * markers and suspension, and a fast path, which fetches whole bytes from the
+ * source buffer without checking for either.  The fast path is used only if
+ * enough input is buffered to decode the MCU.  If it encounters a marker or a
+ * bad Huffman code, it returns FALSE without updating the permanent state, and
+ * the slow path decodes the MCU again (and issues any warnings.)
+ *
+ * The fast path loads the bit buffer at the same points, and by the same
+ * amount, as the slow path.  Otherwise, the position in the source buffer at
+ * the end of a scan would depend on which path decoded each MCU, and so would
+ * the number of extraneous bytes that is reported for corrupt data.
+ */
+
+#define BUFSIZE  (DCTSIZE2 * 8)
+
+LOCAL(boolean)
+use_fast_path(j_decompress_ptr cinfo)
+{
+  if (cinfo->restart_interval ||
+      cinfo->src->bytes_in_buffer < BUFSIZE * (size_t)cinfo->blocks_in_MCU ||
+      cinfo->unread_marker != 0)
+    return FALSE;
+
+  return TRUE;
+}
+
+
+/* Equivalent of CHECK_BIT_BUFFER() for the fast path.  As in
+ * jpeg_fill_bit_buffer(), the bit buffer is loaded to a depth of at least
+ * MIN_GET_BITS whenever fewer than nbits bits are left.
  */
 
+#define CHECK_BIT_BUFFER_FAST(nbits) { \
+  if (bits_left < (nbits)) { \
+    do GET_BYTE while (bits_left < MIN_GET_BITS); \
+  } \
+}
+
+/* Equivalent of HUFF_DECODE() for the fast path.  The full-symbol lookahead
+ * table is used only if at least HUFF_FULL_LOOKAHEAD bits are left, in which
+ * case HUFF_DECODE() would not load the bit buffer either.
+ */
+
+#define HUFF_DECODE_EXACT(result, nb, htbl, failaction) { \
+  CHECK_BIT_BUFFER_FAST(HUFF_LOOKAHEAD) \
+  result = htbl->lookup[PEEK_BITS(HUFF_LOOKAHEAD)]; \
+  nb = result >> HUFF_LOOKAHEAD; \
+  if (nb <= HUFF_LOOKAHEAD) { \
+    DROP_BITS(nb); \
+    result &= (1 << HUFF_LOOKAHEAD) - 1; \
+  } else { \
+    /* Equivalent of jpeg_huff_decode() */ \
+    CHECK_BIT_BUFFER_FAST(nb) \
+    result = GET_BITS(nb); \
+    while (result > htbl->maxcode[nb]) { \
+      result <<= 1; \
+      CHECK_BIT_BUFFER_FAST(1) \
+      result |= GET_BITS(1); \
+      nb++; \
+    } \
+    if (nb > 16) \
+      { failaction; } \
+    result = htbl->pub->huffval[(int)(result + htbl->valoffset[nb])]; \
+  } \
+}
+
+
 /*
  * MCU decoding for DC initial scan (either spectral selection,
  * or first pass of successive approximation).
  */
 
-METHODDEF(boolean)
-decode_mcu_DC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+LOCAL(boolean)
+decode_mcu_DC_first_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 {
   phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
   int Al = cinfo->Al;
@@ -299,54 +371,133 @@ decode_mcu_DC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
   d_derived_tbl *tbl;
   jpeg_component_info *compptr;
 
-  /* Process restart marker if needed; may have to suspend */
-  if (cinfo->restart_interval) {
-    if (entropy->restarts_to_go == 0)
-      if (!process_restart(cinfo))
-        return FALSE;
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+  state = entropy->saved;
+
+  /* Outer loop handles each block in the MCU */
+
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    block = MCU_data[blkn];
+    ci = cinfo->MCU_membership[blkn];
+    compptr = cinfo->cur_comp_info[ci];
+    tbl = entropy->derived_tbls[compptr->dc_tbl_no];
+
+    /* Decode a single block's worth of coefficients */
+
+    /* Section F.2.2.1: decode the DC coefficient difference */
+    HUFF_DECODE(s, br_state, tbl, return FALSE, label1);
+    if (s) {
+      CHECK_BIT_BUFFER(br_state, s, return FALSE);
+      r = GET_BITS(s);
+      s = HUFF_EXTEND(r, s);
+    }
+
+    /* Convert DC difference to actual value, update last_dc_val */
+    if ((state.last_dc_val[ci] >= 0 &&
+         s > INT_MAX - state.last_dc_val[ci]) ||
+        (state.last_dc_val[ci] < 0 && s < INT_MIN - state.last_dc_val[ci]))
+      ERREXIT(cinfo, JERR_BAD_DCT_COEF);
+    s += state.last_dc_val[ci];
+    state.last_dc_val[ci] = s;
+    /* Scale and output the coefficient (assumes jpeg_natural_order[0]=0) */
+    (*block)[0] = (JCOEF)LEFT_SHIFT(s, Al);
   }
 
-  /* If we've run out of data, just leave the MCU set to zeroes.
-   * This way, we return uniform gray for the remainder of the segment.
-   */
-  if (!entropy->pub.insufficient_data) {
+  /* Completed MCU, so update state */
+  BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+  entropy->saved = state;
+  return TRUE;
+}
 
-    /* Load up working state */
-    BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
-    state = entropy->saved;
 
-    /* Outer loop handles each block in the MCU */
+LOCAL(boolean)
+decode_mcu_DC_first_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+  int Al = cinfo->Al;
+  register int s, r, l;
+  int blkn, ci;
+  JBLOCKROW block;
+  BITREAD_STATE_VARS;
+  JOCTET *buffer;
+  savable_state state;
+  d_derived_tbl *tbl;
+  jpeg_component_info *compptr;
 
-    for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
-      block = MCU_data[blkn];
-      ci = cinfo->MCU_membership[blkn];
-      compptr = cinfo->cur_comp_info[ci];
-      tbl = entropy->derived_tbls[compptr->dc_tbl_no];
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+  buffer = (JOCTET *)br_state.next_input_byte;
+  state = entropy->saved;
+
+  /* Outer loop handles each block in the MCU */
 
-      /* Decode a single block's worth of coefficients */
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    block = MCU_data[blkn];
+    ci = cinfo->MCU_membership[blkn];
+    compptr = cinfo->cur_comp_info[ci];
+    tbl = entropy->derived_tbls[compptr->dc_tbl_no];
 
-      /* Section F.2.2.1: decode the DC coefficient difference */
-      HUFF_DECODE(s, br_state, tbl, return FALSE, label1);
+    /* Decode the DC difference with a single table lookup if possible */
+    if (bits_left >= HUFF_FULL_LOOKAHEAD &&
+        (s = tbl->full_lookup[PEEK_BITS(HUFF_FULL_LOOKAHEAD)]) != 0) {
+      DROP_BITS(s & 15);
+      s >>= 16;
+    } else {
+      HUFF_DECODE_EXACT(s, l, tbl, goto fallback);
       if (s) {
-        CHECK_BIT_BUFFER(br_state, s, return FALSE);
+        CHECK_BIT_BUFFER_FAST(s)
         r = GET_BITS(s);
         s = HUFF_EXTEND(r, s);
       }
-
-      /* Convert DC difference to actual value, update last_dc_val */
-      if ((state.last_dc_val[ci] >= 0 &&
-           s > INT_MAX - state.last_dc_val[ci]) ||
-          (state.last_dc_val[ci] < 0 && s < INT_MIN - state.last_dc_val[ci]))
-        ERREXIT(cinfo, JERR_BAD_DCT_COEF);
-      s += state.last_dc_val[ci];
-      state.last_dc_val[ci] = s;
-      /* Scale and output the coefficient (assumes jpeg_natural_order[0]=0) */
-      (*block)[0] = (JCOEF)LEFT_SHIFT(s, Al);
     }
 
-    /* Completed MCU, so update state */
-    BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
-    entropy->saved = state;
+    /* Convert DC difference to actual value, update last_dc_val */
+    if ((state.last_dc_val[ci] >= 0 &&
+         s > INT_MAX - state.last_dc_val[ci]) ||
+        (state.last_dc_val[ci] < 0 && s < INT_MIN - state.last_dc_val[ci]))
+      ERREXIT(cinfo, JERR_BAD_DCT_COEF);
+    s += state.last_dc_val[ci];
+    state.last_dc_val[ci] = s;
+    /* Scale and output the coefficient (assumes jpeg_natural_order[0]=0) */
+    (*block)[0] = (JCOEF)LEFT_SHIFT(s, Al);
+  }
+
+  if (cinfo->unread_marker != 0)
+    goto fallback;
+
+  /* Completed MCU, so update state */
+  br_state.bytes_in_buffer -= (buffer - br_state.next_input_byte);
+  br_state.next_input_byte = buffer;
+  BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+  entropy->saved = state;
+  return TRUE;
+
+fallback:
+  cinfo->unread_marker = 0;
+  return FALSE;
+}
+
+
+METHODDEF(boolean)
+decode_mcu_DC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+
+  /* Process restart marker if needed; may have to suspend */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0)
+      if (!process_restart(cinfo))
+        return FALSE;
+  }
+
+  /* If we've run out of data, just leave the MCU set to zeroes.
+   * This way, we return uniform gray for the remainder of the segment.
+   */
+  if (!entropy->pub.insufficient_data) {
+    if (!use_fast_path(cinfo) || !decode_mcu_DC_first_fast(cinfo, MCU_data))
+      if (!decode_mcu_DC_first_slow(cinfo, MCU_data))
+        return FALSE;
   }
 
   /* Account for restart interval (no-op if not using restarts) */
@@ -362,8 +513,8 @@ decode_mcu_DC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
  * or first pass of successive approximation).
  */
 
-METHODDEF(boolean)
-decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+LOCAL(boolean)
+decode_mcu_AC_first_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 {
   phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
   int Se = cinfo->Se;
@@ -374,6 +525,151 @@ decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
   BITREAD_STATE_VARS;
   d_derived_tbl *tbl;
 
+  /* Load up working state.
+   * We can avoid loading/saving bitread state if in an EOB run.
+   */
+  EOBRUN = entropy->saved.EOBRUN;       /* only part of saved state we need */
+
+  /* There is always only one block per MCU */
+
+  if (EOBRUN > 0) {             /* if it's a band of zeroes... */
+    EOBRUN--;                   /* ...process it now (we do nothing) */
+    entropy->pub.last_nonzero[0] = 0;
+  } else {
+    BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+    block = MCU_data[0];
+    tbl = entropy->ac_derived_tbl;
+
+    for (k = cinfo->Ss; k <= Se; k++) {
+      HUFF_DECODE(s, br_state, tbl, return FALSE, label2);
+      r = s >> 4;
+      s &= 15;
+      if (s) {
+        k += r;
+        CHECK_BIT_BUFFER(br_state, s, return FALSE);
+        r = GET_BITS(s);
+        s = HUFF_EXTEND(r, s);
+        /* Scale and output coefficient in natural (dezigzagged) order */
+        (*block)[jpeg_natural_order[k]] = (JCOEF)LEFT_SHIFT(s, Al);
+      } else {
+        if (r == 15) {          /* ZRL */
+          k += 15;              /* skip 15 zeroes in band */
+        } else {                /* EOBr, run length is 2^r + appended bits */
+          EOBRUN = 1 << r;
+          if (r) {              /* EOBr, r > 0 */
+            CHECK_BIT_BUFFER(br_state, r, return FALSE);
+            r = GET_BITS(r);
+            EOBRUN += r;
+          }
+          EOBRUN--;             /* this band is processed at this moment */
+          break;                /* force end-of-band */
+        }
+      }
+    }
+    /* No coefficient at or after k was stored */
+    entropy->pub.last_nonzero[0] = MIN(k, DCTSIZE2) - 1;
+
+    BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+  }
+
+  /* Completed MCU, so update state */
+  entropy->saved.EOBRUN = EOBRUN;       /* only part of saved state we need */
+  return TRUE;
+}
+
+
+LOCAL(boolean)
+decode_mcu_AC_first_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+  int Se = cinfo->Se;
+  int Al = cinfo->Al;
+  register int s, k, r, l;
+  unsigned int EOBRUN = 0;
+  JBLOCKROW block = MCU_data[0];
+  BITREAD_STATE_VARS;
+  JOCTET *buffer;
+  d_derived_tbl *tbl = entropy->ac_derived_tbl;
+
+  /* Load up working state.  The caller handles EOB runs, so we are always at
+   * the start of a band that contains coded data.
+   */
+  BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+  buffer = (JOCTET *)br_state.next_input_byte;
+
+  /* The full-symbol lookahead table resolves most coefficients, along with an
+   * EOB code (an EOB run of length 1) that follows the last one, in a single
+   * lookup.  A coefficient at k = Se is never followed by an EOB code.
+   */
+  for (k = cinfo->Ss; k <= Se; k++) {
+    if (bits_left >= HUFF_FULL_LOOKAHEAD &&
+        (s = tbl->full_lookup[PEEK_BITS(HUFF_FULL_LOOKAHEAD)]) != 0) {
+      DROP_BITS(s & 15);
+      r = (s >> 4) & 15;
+      if (s >> 16) {
+        k += r;
+        (*block)[jpeg_natural_order[k]] = (JCOEF)LEFT_SHIFT(s >> 16, Al);
+        /* HUFF_DECODE() would load the bit buffer before decoding the EOB
+         * code if fewer than HUFF_LOOKAHEAD bits were left.
+         */
+        if ((s & 0xF00) && k < Se && bits_left >= HUFF_LOOKAHEAD) {
+          DROP_BITS((s >> 8) & 15);
+          k++;                  /* as if the EOB code had been read alone */
+          break;
+        }
+        continue;
+      }
+    } else {
+      HUFF_DECODE_EXACT(s, l, tbl, goto fallback);
+      r = s >> 4;
+      s &= 15;
+      if (s) {
+        k += r;
+        CHECK_BIT_BUFFER_FAST(s)
+        r = GET_BITS(s);
+        s = HUFF_EXTEND(r, s);
+        /* Scale and output coefficient in natural (dezigzagged) order */
+        (*block)[jpeg_natural_order[k]] = (JCOEF)LEFT_SHIFT(s, Al);
+        continue;
+      }
+    }
+    if (r == 15) {              /* ZRL */
+      k += 15;                  /* skip 15 zeroes in band */
+    } else {                    /* EOBr, run length is 2^r + appended bits */
+      EOBRUN = 1 << r;
+      if (r) {                  /* EOBr, r > 0 */
+        CHECK_BIT_BUFFER_FAST(r)
+        r = GET_BITS(r);
+        EOBRUN += r;
+      }
+      EOBRUN--;                 /* this band is processed at this moment */
+      break;                    /* force end-of-band */
+    }
+  }
+  /* No coefficient at or after k was stored */
+  entropy->pub.last_nonzero[0] = MIN(k, DCTSIZE2) - 1;
+
+  if (cinfo->unread_marker != 0)
+    goto fallback;
+
+  /* Completed MCU, so update state */
+  br_state.bytes_in_buffer -= (buffer - br_state.next_input_byte);
+  br_state.next_input_byte = buffer;
+  BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+  entropy->saved.EOBRUN = EOBRUN;       /* only part of saved state we need */
+  return TRUE;
+
+fallback:
+  cinfo->unread_marker = 0;
+  return FALSE;
+}
+
+
+METHODDEF(boolean)
+decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+
   /* Process restart marker if needed; may have to suspend */
   if (cinfo->restart_interval) {
     if (entropy->restarts_to_go == 0)
@@ -383,55 +679,21 @@ decode_mcu_AC_first(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 
   /* If we've run out of data, just leave the MCU set to zeroes.
    * This way, we return uniform gray for the remainder of the segment.
+   * Blocks within an EOB run read no input, so they always take the slow
+   * path.
    */
   if (!entropy->pub.insufficient_data) {
-
-    /* Load up working state.
-     * We can avoid loading/saving bitread state if in an EOB run.
-     */
-    EOBRUN = entropy->saved.EOBRUN;     /* only part of saved state we need */
-
-    /* There is always only one block per MCU */
-
-    if (EOBRUN > 0)             /* if it's a band of zeroes... */
-      EOBRUN--;                 /* ...process it now (we do nothing) */
-    else {
-      BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
-      block = MCU_data[0];
-      tbl = entropy->ac_derived_tbl;
-
-      for (k = cinfo->Ss; k <= Se; k++) {
-        HUFF_DECODE(s, br_state, tbl, return FALSE, label2);
-        r = s >> 4;
-        s &= 15;
-        if (s) {
-          k += r;
-          CHECK_BIT_BUFFER(br_state, s, return FALSE);
-          r = GET_BITS(s);
-          s = HUFF_EXTEND(r, s);
-          /* Scale and output coefficient in natural (dezigzagged) order */
-          (*block)[jpeg_natural_order[k]] = (JCOEF)LEFT_SHIFT(s, Al);
-        } else {
-          if (r == 15) {        /* ZRL */
-            k += 15;            /* skip 15 zeroes in band */
-          } else {              /* EOBr, run length is 2^r + appended bits */
-            EOBRUN = 1 << r;
-            if (r) {            /* EOBr, r > 0 */
-              CHECK_BIT_BUFFER(br_state, r, return FALSE);
-              r = GET_BITS(r);
-              EOBRUN += r;
-            }
-            EOBRUN--;           /* this band is processed at this moment */
-            break;              /* force end-of-band */
-          }
-        }
-      }
-
-      BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+    if (entropy->saved.EOBRUN > 0 || !use_fast_path(cinfo)) {
+      if (!decode_mcu_AC_first_slow(cinfo, MCU_data))
+        return FALSE;
+    } else if (!decode_mcu_AC_first_fast(cinfo, MCU_data)) {
+      if (!decode_mcu_AC_first_slow(cinfo, MCU_data))
+        return FALSE;
+      /* The fast path may have stored coefficients that the slow path did
+       * not overwrite.
+       */
+      entropy->pub.last_nonzero[0] = DCTSIZE2 - 1;
     }
-
-    /* Completed MCU, so update state */
-    entropy->saved.EOBRUN = EOBRUN;     /* only part of saved state we need */
   }
 
   /* Account for restart interval (no-op if not using restarts) */
@@ -498,8 +760,8 @@ decode_mcu_DC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
  * MCU decoding for AC successive approximation refinement scan.
  */
 
-METHODDEF(boolean)
-decode_mcu_AC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+LOCAL(boolean)
+decode_mcu_AC_refine_slow(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 {
   phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
   int Se = cinfo->Se;
@@ -514,137 +776,291 @@ decode_mcu_AC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
   int num_newnz;
   int newnz_pos[DCTSIZE2];
 
-  /* Process restart marker if needed; may have to suspend */
-  if (cinfo->restart_interval) {
-    if (entropy->restarts_to_go == 0)
-      if (!process_restart(cinfo))
-        return FALSE;
-  }
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+  EOBRUN = entropy->saved.EOBRUN; /* only part of saved state we need */
 
-  /* If we've run out of data, don't modify the MCU.
-   */
-  if (!entropy->pub.insufficient_data) {
+  /* There is always only one block per MCU */
+  block = MCU_data[0];
+  tbl = entropy->ac_derived_tbl;
 
-    /* Load up working state */
-    BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
-    EOBRUN = entropy->saved.EOBRUN; /* only part of saved state we need */
+  /* If we are forced to suspend, we must undo the assignments to any newly
+   * nonzero coefficients in the block, because otherwise we'd get confused
+   * next time about which coefficients were already nonzero.
+   * But we need not undo addition of bits to already-nonzero coefficients;
+   * instead, we can test the current bit to see if we already did it.
+   */
+  num_newnz = 0;
 
-    /* There is always only one block per MCU */
-    block = MCU_data[0];
-    tbl = entropy->ac_derived_tbl;
+  /* initialize coefficient loop counter to start of band */
+  k = cinfo->Ss;
 
-    /* If we are forced to suspend, we must undo the assignments to any newly
-     * nonzero coefficients in the block, because otherwise we'd get confused
-     * next time about which coefficients were already nonzero.
-     * But we need not undo addition of bits to already-nonzero coefficients;
-     * instead, we can test the current bit to see if we already did it.
+  if (EOBRUN == 0) {
+    for (; k <= Se; k++) {
+      HUFF_DECODE(s, br_state, tbl, goto undoit, label3);
+      r = s >> 4;
+      s &= 15;
+      if (s) {
+        if (s != 1)             /* size of new coef should always be 1 */
+          WARNMS(cinfo, JWRN_HUFF_BAD_CODE);
+        CHECK_BIT_BUFFER(br_state, 1, goto undoit);
+        if (GET_BITS(1))
+          s = p1;               /* newly nonzero coef is positive */
+        else
+          s = m1;               /* newly nonzero coef is negative */
+      } else {
+        if (r != 15) {
+          EOBRUN = 1 << r;      /* EOBr, run length is 2^r + appended bits */
+          if (r) {
+            CHECK_BIT_BUFFER(br_state, r, goto undoit);
+            r = GET_BITS(r);
+            EOBRUN += r;
+          }
+          break;                /* rest of block is handled by EOB logic */
+        }
+        /* note s = 0 for processing ZRL */
+      }
+      /* Advance over already-nonzero coefs and r still-zero coefs,
+       * appending correction bits to the nonzeroes.  A correction bit is 1
+       * if the absolute value of the coefficient must be increased.
+       */
+      do {
+        thiscoef = *block + jpeg_natural_order[k];
+        if (*thiscoef != 0) {
+          CHECK_BIT_BUFFER(br_state, 1, goto undoit);
+          if (GET_BITS(1)) {
+            if ((*thiscoef & p1) == 0) { /* do nothing if already set it */
+              if (*thiscoef >= 0)
+                *thiscoef += (JCOEF)p1;
+              else
+                *thiscoef += (JCOEF)m1;
+            }
+          }
+        } else {
+          if (--r < 0)
+            break;              /* reached target zero coefficient */
+        }
+        k++;
+      } while (k <= Se);
+      if (s) {
+        int pos = jpeg_natural_order[k];
+        /* Output newly nonzero coefficient */
+        (*block)[pos] = (JCOEF)s;
+        /* Remember its position in case we have to suspend */
+        newnz_pos[num_newnz++] = pos;
+      }
+    }
+  }
+  /* No coefficient at or after k was made newly nonzero */
+  entropy->pub.last_nonzero[0] = MIN(k, DCTSIZE2) - 1;
+
+  if (EOBRUN > 0) {
+    /* Scan any remaining coefficient positions after the end-of-band
+     * (the last newly nonzero coefficient, if any).  Append a correction
+     * bit to each already-nonzero coefficient.  A correction bit is 1
+     * if the absolute value of the coefficient must be increased.
      */
-    num_newnz = 0;
+    for (; k <= Se; k++) {
+      thiscoef = *block + jpeg_natural_order[k];
+      if (*thiscoef != 0) {
+        CHECK_BIT_BUFFER(br_state, 1, goto undoit);
+        if (GET_BITS(1)) {
+          if ((*thiscoef & p1) == 0) { /* do nothing if already changed it */
+            if (*thiscoef >= 0)
+              *thiscoef += (JCOEF)p1;
+            else
+              *thiscoef += (JCOEF)m1;
+          }
+        }
+      }
+    }
+    /* Count one block completed in EOB run */
+    EOBRUN--;
+  }
 
-    /* initialize coefficient loop counter to start of band */
-    k = cinfo->Ss;
+  /* Completed MCU, so update state */
+  BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+  entropy->saved.EOBRUN = EOBRUN; /* only part of saved state we need */
+  return TRUE;
 
-    if (EOBRUN == 0) {
-      for (; k <= Se; k++) {
-        HUFF_DECODE(s, br_state, tbl, goto undoit, label3);
+undoit:
+  /* Re-zero any output coefficients that we made newly nonzero */
+  while (num_newnz > 0)
+    (*block)[newnz_pos[--num_newnz]] = 0;
+
+  return FALSE;
+}
+
+
+LOCAL(boolean)
+decode_mcu_AC_refine_fast(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+  int Se = cinfo->Se;
+  int p1 = 1 << cinfo->Al;        /* 1 in the bit position being coded */
+  int m1 = (NEG_1) << cinfo->Al;  /* -1 in the bit position being coded */
+  register int s, k, r, l;
+  unsigned int EOBRUN;
+  JBLOCKROW block = MCU_data[0];
+  JCOEFPTR thiscoef;
+  BITREAD_STATE_VARS;
+  JOCTET *buffer;
+  d_derived_tbl *tbl = entropy->ac_derived_tbl;
+  int num_newnz = 0;
+  int newnz_pos[DCTSIZE2];
+
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo, entropy->bitstate);
+  buffer = (JOCTET *)br_state.next_input_byte;
+  EOBRUN = entropy->saved.EOBRUN; /* only part of saved state we need */
+
+  /* initialize coefficient loop counter to start of band */
+  k = cinfo->Ss;
+
+  if (EOBRUN == 0) {
+    for (; k <= Se; k++) {
+      /* A newly nonzero coefficient is coded as a size-1 symbol followed by
+       * its sign bit, so the full-symbol lookahead table resolves it if the
+       * looked-up value is +/-1.  EOBr and ZRL symbols have a value of 0.
+       */
+      if (bits_left >= HUFF_FULL_LOOKAHEAD &&
+          (s = tbl->full_lookup[PEEK_BITS(HUFF_FULL_LOOKAHEAD)]) != 0 &&
+          (s >> 16) >= -1 && (s >> 16) <= 1) {
+        DROP_BITS(s & 15);
+        r = (s >> 4) & 15;
+        s >>= 16;
+        if (s)
+          s = s > 0 ? p1 : m1;
+      } else {
+        HUFF_DECODE_EXACT(s, l, tbl, goto fallback);
         r = s >> 4;
         s &= 15;
         if (s) {
-          if (s != 1)           /* size of new coef should always be 1 */
-            WARNMS(cinfo, JWRN_HUFF_BAD_CODE);
-          CHECK_BIT_BUFFER(br_state, 1, goto undoit);
+          /* The size of a new coefficient should always be 1.  Leave the
+           * warning to the slow path.
+           */
+          if (s != 1)
+            goto fallback;
+          CHECK_BIT_BUFFER_FAST(1)
           if (GET_BITS(1))
             s = p1;             /* newly nonzero coef is positive */
           else
             s = m1;             /* newly nonzero coef is negative */
-        } else {
-          if (r != 15) {
-            EOBRUN = 1 << r;    /* EOBr, run length is 2^r + appended bits */
-            if (r) {
-              CHECK_BIT_BUFFER(br_state, r, goto undoit);
-              r = GET_BITS(r);
-              EOBRUN += r;
-            }
-            break;              /* rest of block is handled by EOB logic */
-          }
-          /* note s = 0 for processing ZRL */
         }
-        /* Advance over already-nonzero coefs and r still-zero coefs,
-         * appending correction bits to the nonzeroes.  A correction bit is 1
-         * if the absolute value of the coefficient must be increased.
-         */
-        do {
-          thiscoef = *block + jpeg_natural_order[k];
-          if (*thiscoef != 0) {
-            CHECK_BIT_BUFFER(br_state, 1, goto undoit);
-            if (GET_BITS(1)) {
-              if ((*thiscoef & p1) == 0) { /* do nothing if already set it */
-                if (*thiscoef >= 0)
-                  *thiscoef += (JCOEF)p1;
-                else
-                  *thiscoef += (JCOEF)m1;
-              }
-            }
-          } else {
-            if (--r < 0)
-              break;            /* reached target zero coefficient */
-          }
-          k++;
-        } while (k <= Se);
-        if (s) {
-          int pos = jpeg_natural_order[k];
-          /* Output newly nonzero coefficient */
-          (*block)[pos] = (JCOEF)s;
-          /* Remember its position in case we have to suspend */
-          newnz_pos[num_newnz++] = pos;
+      }
+      if (!s && r != 15) {
+        EOBRUN = 1 << r;        /* EOBr, run length is 2^r + appended bits */
+        if (r) {
+          CHECK_BIT_BUFFER_FAST(r)
+          r = GET_BITS(r);
+          EOBRUN += r;
         }
+        break;                  /* rest of block is handled by EOB logic */
       }
-    }
-
-    if (EOBRUN > 0) {
-      /* Scan any remaining coefficient positions after the end-of-band
-       * (the last newly nonzero coefficient, if any).  Append a correction
-       * bit to each already-nonzero coefficient.  A correction bit is 1
-       * if the absolute value of the coefficient must be increased.
+      /* Advance over already-nonzero coefs and r still-zero coefs,
+       * appending correction bits to the nonzeroes.
        */
-      for (; k <= Se; k++) {
+      do {
         thiscoef = *block + jpeg_natural_order[k];
         if (*thiscoef != 0) {
-          CHECK_BIT_BUFFER(br_state, 1, goto undoit);
+          CHECK_BIT_BUFFER_FAST(1)
           if (GET_BITS(1)) {
-            if ((*thiscoef & p1) == 0) { /* do nothing if already changed it */
+            if ((*thiscoef & p1) == 0) { /* do nothing if already set it */
               if (*thiscoef >= 0)
                 *thiscoef += (JCOEF)p1;
               else
                 *thiscoef += (JCOEF)m1;
             }
           }
+        } else {
+          if (--r < 0)
+            break;              /* reached target zero coefficient */
         }
+        k++;
+      } while (k <= Se);
+      if (s) {
+        int pos = jpeg_natural_order[k];
+        /* Output newly nonzero coefficient */
+        (*block)[pos] = (JCOEF)s;
+        /* Remember its position in case we have to fall back */
+        newnz_pos[num_newnz++] = pos;
       }
-      /* Count one block completed in EOB run */
-      EOBRUN--;
     }
+  }
+  /* No coefficient at or after k was made newly nonzero */
+  entropy->pub.last_nonzero[0] = MIN(k, DCTSIZE2) - 1;
 
-    /* Completed MCU, so update state */
-    BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
-    entropy->saved.EOBRUN = EOBRUN; /* only part of saved state we need */
+  if (EOBRUN > 0) {
+    /* Append a correction bit to each already-nonzero coefficient after the
+     * end-of-band.
+     */
+    for (; k <= Se; k++) {
+      thiscoef = *block + jpeg_natural_order[k];
+      if (*thiscoef != 0) {
+        CHECK_BIT_BUFFER_FAST(1)
+        if (GET_BITS(1)) {
+          if ((*thiscoef & p1) == 0) { /* do nothing if already changed it */
+            if (*thiscoef >= 0)
+              *thiscoef += (JCOEF)p1;
+            else
+              *thiscoef += (JCOEF)m1;
+          }
+        }
+      }
+    }
+    /* Count one block completed in EOB run */
+    EOBRUN--;
   }
 
-  /* Account for restart interval (no-op if not using restarts) */
-  if (cinfo->restart_interval)
-    entropy->restarts_to_go--;
+  if (cinfo->unread_marker != 0)
+    goto fallback;
 
+  /* Completed MCU, so update state */
+  br_state.bytes_in_buffer -= (buffer - br_state.next_input_byte);
+  br_state.next_input_byte = buffer;
+  BITREAD_SAVE_STATE(cinfo, entropy->bitstate);
+  entropy->saved.EOBRUN = EOBRUN; /* only part of saved state we need */
   return TRUE;
 
-undoit:
-  /* Re-zero any output coefficients that we made newly nonzero */
+fallback:
+  /* Re-zero any output coefficients that we made newly nonzero, so that the
+   * slow path can decode the block again.
+   */
   while (num_newnz > 0)
     (*block)[newnz_pos[--num_newnz]] = 0;
-
+  cinfo->unread_marker = 0;
   return FALSE;
 }
 
 
+METHODDEF(boolean)
+decode_mcu_AC_refine(j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  phuff_entropy_ptr entropy = (phuff_entropy_ptr)cinfo->entropy;
+
+  /* Process restart marker if needed; may have to suspend */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0)
+      if (!process_restart(cinfo))
+        return FALSE;
+  }
+
+  /* If we've run out of data, don't modify the MCU.
+   */
+  if (!entropy->pub.insufficient_data) {
+    if (!use_fast_path(cinfo) || !decode_mcu_AC_refine_fast(cinfo, MCU_data))
+      if (!decode_mcu_AC_refine_slow(cinfo, MCU_data))
+        return FALSE;
+  }
+
+  /* Account for restart interval (no-op if not using restarts) */
+  if (cinfo->restart_interval)
+    entropy->restarts_to_go--;
+
+  return TRUE;
+}
+
+
 /*
  * Module initialization routine for progressive Huffman entropy decoding.
  */
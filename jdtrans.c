@@ -129,7 +129,8 @@ transdecode_master_selection(j_decompress_ptr cinfo)
       jinit_huff_decoder(cinfo);
   }
 
-  /* Always get a full-image coefficient buffer. */
+  /* Always get a full-image coefficient buffer.  It is filled serially. */
+  cinfo->master->concurrent_scan = FALSE;
   if (cinfo->data_precision == 12)
     j12init_d_coef_controller(cinfo, TRUE);
   else
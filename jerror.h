@@ -220,6 +220,10 @@ JMESSAGE(JERR_BAD_DROP_SAMPLING,
 #endif
 JMESSAGE(JERR_BAD_RESTART,
          "Invalid restart interval %d; must be an integer multiple of the number of MCUs in an MCU row (%d)")
+JMESSAGE(JTRC_TRELLIS_BYPASS,
+         "Trellis passes: %d of %d blocks rounded to zero and were not searched")
+JMESSAGE(JTRC_TRELLIS_CONVERGED,
+         "Trellis loops converged after loop %d of %d")
 
 #ifdef JMAKE_ENUM_LIST
 
@@ -412,6 +412,420 @@ _jpeg_idct_islow(j_decompress_ptr cinfo, jpeg_component_info *compptr,
   }
 }
 
+
+/*
+ * Sparse variants of jpeg_idct_islow(), for blocks whose nonzero coefficients
+ * all lie in the DC position or in the top-left 2x2 or 4x4 corner of the
+ * block.  This is typical of the chroma components and of heavily quantized
+ * or trellis-optimized luma.  The coefficient controller selects one of these
+ * routines based on the zigzag index of the last nonzero coefficient, as
+ * recorded by the entropy decoder.
+ *
+ * Each variant performs the same computation as jpeg_idct_islow() with the
+ * terms involving the zero coefficients removed.  Since the removed terms are
+ * exact integer zeroes, and since the zero-column and zero-row shortcuts
+ * produce the same values as the full calculation, the output is identical to
+ * that of jpeg_idct_islow().
+ */
+
+/*
+ * Only the DC coefficient is nonzero, so the output block is flat.
+ */
+
+GLOBAL(void)
+_jpeg_idct_islow_sparse_dc(j_decompress_ptr cinfo,
+                           jpeg_component_info *compptr, JCOEFPTR coef_block,
+                           _JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  ISLOW_MULT_TYPE *quantptr;
+  _JSAMPROW outptr;
+  _JSAMPLE *range_limit = IDCT_range_limit(cinfo);
+  _JSAMPLE dcval;
+  int wsval, ctr;
+  SHIFT_TEMPS
+
+  /* Pass 1 stores the scaled DC value into every row of column 0, and every
+   * row then takes the zero-row shortcut in pass 2.
+   */
+  quantptr = (ISLOW_MULT_TYPE *)compptr->dct_table;
+  wsval = LEFT_SHIFT(DEQUANTIZE(coef_block[0], quantptr[0]), PASS1_BITS);
+  dcval = range_limit[(int)DESCALE((JLONG)wsval, PASS1_BITS + 3) & RANGE_MASK];
+
+  for (ctr = 0; ctr < DCTSIZE; ctr++) {
+    outptr = output_buf[ctr] + output_col;
+    outptr[0] = dcval;
+    outptr[1] = dcval;
+    outptr[2] = dcval;
+    outptr[3] = dcval;
+    outptr[4] = dcval;
+    outptr[5] = dcval;
+    outptr[6] = dcval;
+    outptr[7] = dcval;
+  }
+}
+
+
+/*
+ * Only the top-left 2x2 coefficients may be nonzero.  In both passes, the
+ * even part reduces to input 0, and the odd part reduces to input 1.
+ */
+
+GLOBAL(void)
+_jpeg_idct_islow_sparse_2x2(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr, JCOEFPTR coef_block,
+                            _JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  JLONG tmp0, tmp1, tmp2, tmp3, tmp10;
+  JLONG z1, z4, z5;
+  JCOEFPTR inptr;
+  ISLOW_MULT_TYPE *quantptr;
+  int *wsptr;
+  _JSAMPROW outptr;
+  _JSAMPLE *range_limit = IDCT_range_limit(cinfo);
+  int ctr;
+  int workspace[DCTSIZE2];      /* buffers data between passes */
+  SHIFT_TEMPS
+
+  /* Pass 1: process columns 0 and 1 from input, store into work array.
+   * Columns 2-7 are all zero, and pass 2 does not read them.
+   */
+
+  inptr = coef_block;
+  quantptr = (ISLOW_MULT_TYPE *)compptr->dct_table;
+  wsptr = workspace;
+  for (ctr = 2; ctr > 0; ctr--) {
+    if (inptr[DCTSIZE * 1] == 0) {
+      /* AC terms all zero */
+      int dcval = LEFT_SHIFT(DEQUANTIZE(inptr[DCTSIZE * 0],
+                             quantptr[DCTSIZE * 0]), PASS1_BITS);
+
+      wsptr[DCTSIZE * 0] = dcval;
+      wsptr[DCTSIZE * 1] = dcval;
+      wsptr[DCTSIZE * 2] = dcval;
+      wsptr[DCTSIZE * 3] = dcval;
+      wsptr[DCTSIZE * 4] = dcval;
+      wsptr[DCTSIZE * 5] = dcval;
+      wsptr[DCTSIZE * 6] = dcval;
+      wsptr[DCTSIZE * 7] = dcval;
+
+      inptr++;                  /* advance pointers to next column */
+      quantptr++;
+      wsptr++;
+      continue;
+    }
+
+    /* Even part: tmp10 = tmp11 = tmp12 = tmp13 */
+
+    z1 = DEQUANTIZE(inptr[DCTSIZE * 0], quantptr[DCTSIZE * 0]);
+    tmp10 = LEFT_SHIFT(z1, CONST_BITS);
+
+    /* Odd part: z1 = z4 = y1, z2 = z3 = 0 */
+
+    z4 = DEQUANTIZE(inptr[DCTSIZE * 1], quantptr[DCTSIZE * 1]);
+    z5 = MULTIPLY(z4, FIX_1_175875602); /* sqrt(2) * c3 */
+
+    tmp3 = MULTIPLY(z4, FIX_1_501321110); /* sqrt(2) * ( c1+c3-c5-c7) */
+    z1 = MULTIPLY(z4, -FIX_0_899976223); /* sqrt(2) * ( c7-c3) */
+    z4 = MULTIPLY(z4, -FIX_0_390180644); /* sqrt(2) * ( c5-c3) */
+
+    z4 += z5;
+
+    tmp0 = z1 + z5;
+    tmp1 = z4;
+    tmp2 = z5;
+    tmp3 += z1 + z4;
+
+    /* Final output stage: inputs are tmp10, tmp0..tmp3 */
+
+    wsptr[DCTSIZE * 0] = (int)DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 7] = (int)DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 1] = (int)DESCALE(tmp10 + tmp2, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 6] = (int)DESCALE(tmp10 - tmp2, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 2] = (int)DESCALE(tmp10 + tmp1, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 5] = (int)DESCALE(tmp10 - tmp1, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 3] = (int)DESCALE(tmp10 + tmp0, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 4] = (int)DESCALE(tmp10 - tmp0, CONST_BITS - PASS1_BITS);
+
+    inptr++;                    /* advance pointers to next column */
+    quantptr++;
+    wsptr++;
+  }
+
+  /* Pass 2: process rows from work array, store into output array. */
+
+  wsptr = workspace;
+  for (ctr = 0; ctr < DCTSIZE; ctr++) {
+    outptr = output_buf[ctr] + output_col;
+
+    if (wsptr[1] == 0) {
+      /* AC terms all zero */
+      _JSAMPLE dcval = range_limit[(int)DESCALE((JLONG)wsptr[0],
+                                                PASS1_BITS + 3) & RANGE_MASK];
+
+      outptr[0] = dcval;
+      outptr[1] = dcval;
+      outptr[2] = dcval;
+      outptr[3] = dcval;
+      outptr[4] = dcval;
+      outptr[5] = dcval;
+      outptr[6] = dcval;
+      outptr[7] = dcval;
+
+      wsptr += DCTSIZE;         /* advance pointer to next row */
+      continue;
+    }
+
+    /* Even part: tmp10 = tmp11 = tmp12 = tmp13 */
+
+    tmp10 = LEFT_SHIFT((JLONG)wsptr[0], CONST_BITS);
+
+    /* Odd part: z1 = z4 = y1, z2 = z3 = 0 */
+
+    z4 = (JLONG)wsptr[1];
+    z5 = MULTIPLY(z4, FIX_1_175875602); /* sqrt(2) * c3 */
+
+    tmp3 = MULTIPLY(z4, FIX_1_501321110); /* sqrt(2) * ( c1+c3-c5-c7) */
+    z1 = MULTIPLY(z4, -FIX_0_899976223); /* sqrt(2) * ( c7-c3) */
+    z4 = MULTIPLY(z4, -FIX_0_390180644); /* sqrt(2) * ( c5-c3) */
+
+    z4 += z5;
+
+    tmp0 = z1 + z5;
+    tmp1 = z4;
+    tmp2 = z5;
+    tmp3 += z1 + z4;
+
+    /* Final output stage: inputs are tmp10, tmp0..tmp3 */
+
+    outptr[0] = range_limit[(int)DESCALE(tmp10 + tmp3,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[7] = range_limit[(int)DESCALE(tmp10 - tmp3,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[1] = range_limit[(int)DESCALE(tmp10 + tmp2,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[6] = range_limit[(int)DESCALE(tmp10 - tmp2,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[2] = range_limit[(int)DESCALE(tmp10 + tmp1,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[5] = range_limit[(int)DESCALE(tmp10 - tmp1,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[3] = range_limit[(int)DESCALE(tmp10 + tmp0,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[4] = range_limit[(int)DESCALE(tmp10 - tmp0,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+
+    wsptr += DCTSIZE;           /* advance pointer to next row */
+  }
+}
+
+
+/*
+ * Only the top-left 4x4 coefficients may be nonzero.  In both passes, inputs
+ * 4-7 are zero, so the rotator in the even part reduces to input 2, and the
+ * odd part reduces to inputs 1 and 3.
+ */
+
+GLOBAL(void)
+_jpeg_idct_islow_sparse_4x4(j_decompress_ptr cinfo,
+                            jpeg_component_info *compptr, JCOEFPTR coef_block,
+                            _JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  JLONG tmp0, tmp1, tmp2, tmp3;
+  JLONG tmp10, tmp11, tmp12, tmp13;
+  JLONG z1, z2, z3, z4, z5;
+  JCOEFPTR inptr;
+  ISLOW_MULT_TYPE *quantptr;
+  int *wsptr;
+  _JSAMPROW outptr;
+  _JSAMPLE *range_limit = IDCT_range_limit(cinfo);
+  int ctr;
+  int workspace[DCTSIZE2];      /* buffers data between passes */
+  SHIFT_TEMPS
+
+  /* Pass 1: process columns 0-3 from input, store into work array.
+   * Columns 4-7 are all zero, and pass 2 does not read them.
+   */
+
+  inptr = coef_block;
+  quantptr = (ISLOW_MULT_TYPE *)compptr->dct_table;
+  wsptr = workspace;
+  for (ctr = 4; ctr > 0; ctr--) {
+    if (inptr[DCTSIZE * 1] == 0 && inptr[DCTSIZE * 2] == 0 &&
+        inptr[DCTSIZE * 3] == 0) {
+      /* AC terms all zero */
+      int dcval = LEFT_SHIFT(DEQUANTIZE(inptr[DCTSIZE * 0],
+                             quantptr[DCTSIZE * 0]), PASS1_BITS);
+
+      wsptr[DCTSIZE * 0] = dcval;
+      wsptr[DCTSIZE * 1] = dcval;
+      wsptr[DCTSIZE * 2] = dcval;
+      wsptr[DCTSIZE * 3] = dcval;
+      wsptr[DCTSIZE * 4] = dcval;
+      wsptr[DCTSIZE * 5] = dcval;
+      wsptr[DCTSIZE * 6] = dcval;
+      wsptr[DCTSIZE * 7] = dcval;
+
+      inptr++;                  /* advance pointers to next column */
+      quantptr++;
+      wsptr++;
+      continue;
+    }
+
+    /* Even part: y4 = y6 = 0 */
+
+    z2 = DEQUANTIZE(inptr[DCTSIZE * 2], quantptr[DCTSIZE * 2]);
+
+    z1 = MULTIPLY(z2, FIX_0_541196100);
+    tmp2 = z1;
+    tmp3 = z1 + MULTIPLY(z2, FIX_0_765366865);
+
+    z2 = DEQUANTIZE(inptr[DCTSIZE * 0], quantptr[DCTSIZE * 0]);
+
+    tmp0 = LEFT_SHIFT(z2, CONST_BITS);
+
+    tmp10 = tmp0 + tmp3;
+    tmp13 = tmp0 - tmp3;
+    tmp11 = tmp0 + tmp2;
+    tmp12 = tmp0 - tmp2;
+
+    /* Odd part: y5 = y7 = 0, so z1 = z4 = y1 and z2 = z3 = y3 */
+
+    tmp2 = DEQUANTIZE(inptr[DCTSIZE * 3], quantptr[DCTSIZE * 3]);
+    tmp3 = DEQUANTIZE(inptr[DCTSIZE * 1], quantptr[DCTSIZE * 1]);
+
+    z5 = MULTIPLY(tmp2 + tmp3, FIX_1_175875602); /* sqrt(2) * c3 */
+
+    z1 = MULTIPLY(tmp3, -FIX_0_899976223); /* sqrt(2) * ( c7-c3) */
+    z2 = MULTIPLY(tmp2, -FIX_2_562915447); /* sqrt(2) * (-c1-c3) */
+    z3 = MULTIPLY(tmp2, -FIX_1_961570560); /* sqrt(2) * (-c3-c5) */
+    z4 = MULTIPLY(tmp3, -FIX_0_390180644); /* sqrt(2) * ( c5-c3) */
+    tmp2 = MULTIPLY(tmp2, FIX_3_072711026); /* sqrt(2) * ( c1+c3+c5-c7) */
+    tmp3 = MULTIPLY(tmp3, FIX_1_501321110); /* sqrt(2) * ( c1+c3-c5-c7) */
+
+    z3 += z5;
+    z4 += z5;
+
+    tmp0 = z1 + z3;
+    tmp1 = z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    /* Final output stage: inputs are tmp10..tmp13, tmp0..tmp3 */
+
+    wsptr[DCTSIZE * 0] = (int)DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 7] = (int)DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 1] = (int)DESCALE(tmp11 + tmp2, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 6] = (int)DESCALE(tmp11 - tmp2, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 2] = (int)DESCALE(tmp12 + tmp1, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 5] = (int)DESCALE(tmp12 - tmp1, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 3] = (int)DESCALE(tmp13 + tmp0, CONST_BITS - PASS1_BITS);
+    wsptr[DCTSIZE * 4] = (int)DESCALE(tmp13 - tmp0, CONST_BITS - PASS1_BITS);
+
+    inptr++;                    /* advance pointers to next column */
+    quantptr++;
+    wsptr++;
+  }
+
+  /* Pass 2: process rows from work array, store into output array. */
+
+  wsptr = workspace;
+  for (ctr = 0; ctr < DCTSIZE; ctr++) {
+    outptr = output_buf[ctr] + output_col;
+
+    if (wsptr[1] == 0 && wsptr[2] == 0 && wsptr[3] == 0) {
+      /* AC terms all zero */
+      _JSAMPLE dcval = range_limit[(int)DESCALE((JLONG)wsptr[0],
+                                                PASS1_BITS + 3) & RANGE_MASK];
+
+      outptr[0] = dcval;
+      outptr[1] = dcval;
+      outptr[2] = dcval;
+      outptr[3] = dcval;
+      outptr[4] = dcval;
+      outptr[5] = dcval;
+      outptr[6] = dcval;
+      outptr[7] = dcval;
+
+      wsptr += DCTSIZE;         /* advance pointer to next row */
+      continue;
+    }
+
+    /* Even part: y4 = y6 = 0 */
+
+    z2 = (JLONG)wsptr[2];
+
+    z1 = MULTIPLY(z2, FIX_0_541196100);
+    tmp2 = z1;
+    tmp3 = z1 + MULTIPLY(z2, FIX_0_765366865);
+
+    tmp0 = LEFT_SHIFT((JLONG)wsptr[0], CONST_BITS);
+
+    tmp10 = tmp0 + tmp3;
+    tmp13 = tmp0 - tmp3;
+    tmp11 = tmp0 + tmp2;
+    tmp12 = tmp0 - tmp2;
+
+    /* Odd part: y5 = y7 = 0, so z1 = z4 = y1 and z2 = z3 = y3 */
+
+    tmp2 = (JLONG)wsptr[3];
+    tmp3 = (JLONG)wsptr[1];
+
+    z5 = MULTIPLY(tmp2 + tmp3, FIX_1_175875602); /* sqrt(2) * c3 */
+
+    z1 = MULTIPLY(tmp3, -FIX_0_899976223); /* sqrt(2) * ( c7-c3) */
+    z2 = MULTIPLY(tmp2, -FIX_2_562915447); /* sqrt(2) * (-c1-c3) */
+    z3 = MULTIPLY(tmp2, -FIX_1_961570560); /* sqrt(2) * (-c3-c5) */
+    z4 = MULTIPLY(tmp3, -FIX_0_390180644); /* sqrt(2) * ( c5-c3) */
+    tmp2 = MULTIPLY(tmp2, FIX_3_072711026); /* sqrt(2) * ( c1+c3+c5-c7) */
+    tmp3 = MULTIPLY(tmp3, FIX_1_501321110); /* sqrt(2) * ( c1+c3-c5-c7) */
+
+    z3 += z5;
+    z4 += z5;
+
+    tmp0 = z1 + z3;
+    tmp1 = z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    /* Final output stage: inputs are tmp10..tmp13, tmp0..tmp3 */
+
+    outptr[0] = range_limit[(int)DESCALE(tmp10 + tmp3,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[7] = range_limit[(int)DESCALE(tmp10 - tmp3,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[1] = range_limit[(int)DESCALE(tmp11 + tmp2,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[6] = range_limit[(int)DESCALE(tmp11 - tmp2,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[2] = range_limit[(int)DESCALE(tmp12 + tmp1,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[5] = range_limit[(int)DESCALE(tmp12 - tmp1,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[3] = range_limit[(int)DESCALE(tmp13 + tmp0,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+    outptr[4] = range_limit[(int)DESCALE(tmp13 - tmp0,
+                                         CONST_BITS + PASS1_BITS + 3) &
+                            RANGE_MASK];
+
+    wsptr += DCTSIZE;           /* advance pointer to next row */
+  }
+}
+
 #ifdef IDCT_SCALING_SUPPORTED
 
 
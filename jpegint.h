@@ -109,6 +109,8 @@ struct jpeg_comp_master {
   boolean trellis_passes; /* TRUE=currently doing trellis-related passes [not exposed] */
   boolean trellis_q_opt; /* TRUE=optimize quant table in trellis loop */
   boolean overshoot_deringing; /* TRUE=preprocess input to reduce ringing of edges on white background */
+  boolean buffer_symbols; /* TRUE=write scans from the symbols recorded while optimizing Huffman tables */
+  boolean resident_coefs; /* TRUE=coefficient arrays are fully resident, so they can be read concurrently [not exposed] */
 
   double norm_src[NUM_QUANT_TBLS][DCTSIZE2];
   double norm_coef[NUM_QUANT_TBLS][DCTSIZE2];
@@ -119,6 +121,10 @@ struct jpeg_comp_master {
   int trellis_freq_split; /* splitting point for frequency in trellis quantization */
   int trellis_num_loops; /* number of trellis loops */
   int trellis_speed_level; /* speed optimization 0-10 (0=thorough, 10=fast) */
+  int num_threads; /* max. # of threads used for compression */
+  struct jthread_pool *thread_pool; /* threads shared by the passes over the image, or NULL [not exposed] */
+  struct jpeg_destination_mgr *nonsuspending_dest; /* destination manager set up by jpeg_stdio_dest() or jpeg_mem_dest(), which never suspends [not exposed] */
+  int scan_cost_mode; /* how candidate scans are sized when optimizing scans */
 
   int num_scans_luma; /* # of entries in scan_info array pertaining to luma (used when optimize_scans is TRUE */
   int num_scans_luma_dc;
@@ -132,6 +138,27 @@ struct jpeg_comp_master {
   float lambda_log_scale2;
   
   float trellis_delta_dc_weight;
+  float trellis_loop_epsilon; /* stop trellis loops once the estimated size changes by less than this fraction (0=never) */
+
+  /* Estimated size (in bits) of the last trellis pass's symbols, coded with
+   * the Huffman tables that it used and with the tables regenerated from it
+   * [not exposed]
+   */
+  double trellis_bits_before;
+  double trellis_bits_after;
+
+  /* # of blocks quantized by the trellis passes so far, and # of those that
+   * were rounded to zero without a search [not exposed]
+   */
+  long trellis_num_blocks;
+  long trellis_num_bypassed;
+
+  /* Estimated size of the last scan gathered while scan_cost_mode != 0:
+   * entropy-coded bits and bytes of Huffman table definitions [not exposed]
+   */
+  double scan_data_bits;
+  int scan_table_bytes;
+  int scan_sample_interval; /* >1=gather only every n-th iMCU row [not exposed] */
   boolean lossless;             /* True if lossless mode is enabled */
 };
 
@@ -161,6 +188,9 @@ typedef struct {
 } arith_rates;
 #endif
 
+/* Trellis quantization workspace (opaque; see jcdctmgr.c) */
+typedef struct trellis_context trellis_context;
+
 /* Main buffer control (downsampled-data buffer) */
 struct jpeg_c_main_controller {
   void (*start_pass) (j_compress_ptr cinfo, J_BUF_MODE pass_mode);
@@ -208,6 +238,14 @@ struct jpeg_c_coef_controller {
 #ifdef C_LOSSLESS_SUPPORTED
   boolean (*compress_data_16) (j_compress_ptr cinfo, J16SAMPIMAGE input_buf);
 #endif
+  /* Feed num_MCUs MCUs of the current scan, starting with MCU number
+   * start_MCU, from the full-image buffer to the entropy encoder, without
+   * touching the controller's pass state.  cinfo may be a private copy of the
+   * compression object, so several scans, or several parts of a scan, can be
+   * encoded concurrently.  NULL if not supported.
+   */
+  void (*encode_scan) (j_compress_ptr cinfo, JDIMENSION start_MCU,
+                       JDIMENSION num_MCUs);
 };
 
 /* Colorspace conversion */
@@ -252,11 +290,16 @@ struct jpeg_forward_dct {
 
   /* Lossy mode */
   /* perhaps this should be an array??? */
-  void (*forward_DCT) (j_compress_ptr cinfo, jpeg_component_info *compptr,
+  /* fdct is the controller whose work area is used: normally cinfo->fdct, but
+   * the multi-threaded first pass (see jccoefct.c) has one for each iMCU row.
+   */
+  void (*forward_DCT) (j_compress_ptr cinfo, struct jpeg_forward_dct *fdct,
+                       jpeg_component_info *compptr,
                        JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
                        JDIMENSION start_row, JDIMENSION start_col,
                        JDIMENSION num_blocks, JBLOCKROW dst);
-  void (*forward_DCT_12) (j_compress_ptr cinfo, jpeg_component_info *compptr,
+  void (*forward_DCT_12) (j_compress_ptr cinfo, struct jpeg_forward_dct *fdct,
+                          jpeg_component_info *compptr,
                           J12SAMPARRAY sample_data, JBLOCKROW coef_blocks,
                           JDIMENSION start_row, JDIMENSION start_col,
                           JDIMENSION num_blocks, JBLOCKROW dst);
@@ -312,6 +355,14 @@ struct jpeg_decomp_master {
   /* Last iMCU row that was successfully decoded */
   JDIMENSION last_good_iMCU_row;
 
+  /* Extension parameters */
+  int num_threads; /* max. # of threads used for decompression */
+
+  /* TRUE if the (single) scan may be entropy-decoded concurrently into a
+   * full-image coefficient buffer
+   */
+  boolean concurrent_scan;
+
   /* Tail of list of saved markers */
   jpeg_saved_marker_ptr marker_list_end;
 };
@@ -365,6 +416,16 @@ struct jpeg_d_coef_controller {
   /* Lossy mode */
   /* Pointer to array of coefficient virtual arrays, or NULL if none */
   jvirt_barray_ptr *coef_arrays;
+
+  /* Decode num_MCUs MCUs of the current scan, starting with MCU number
+   * start_MCU, into the full-image buffer, without touching the controller's
+   * pass state.  cinfo may be a private copy of the decompression object with
+   * its own entropy decoder, so several parts of a scan can be decoded
+   * concurrently.  Returns FALSE if the entropy decoder suspended.  NULL if
+   * not supported.
+   */
+  boolean (*decode_scan) (j_decompress_ptr cinfo, JDIMENSION start_MCU,
+                          JDIMENSION num_MCUs);
 };
 
 /* Decompression postprocessing (color quantization buffer control) */
@@ -426,6 +487,14 @@ struct jpeg_entropy_decoder {
   /* This is here to share code between baseline and progressive decoders; */
   /* other modules probably should not use it */
   boolean insufficient_data;    /* set TRUE after emitting warning */
+
+  /* Lossy mode: for each block of the MCU, an upper bound (<= DCTSIZE2-1) on
+   * the zigzag index of the last coefficient that the most recent
+   * decode_mcu() call stored into it.  Blocks that decode_mcu() did not
+   * modify may have any value here.  The coefficient controller uses this to
+   * select a reduced IDCT routine.
+   */
+  int last_nonzero[D_MAX_BLOCKS_IN_MCU];
 };
 
 /* Lossy mode: Inverse DCT (also performs dequantization)
@@ -443,6 +512,17 @@ typedef void (*inverse_DCT_12_method_ptr) (j_decompress_ptr cinfo,
                                            J12SAMPARRAY output_buf,
                                            JDIMENSION output_col);
 
+/* Classes of coefficient blocks for which a reduced IDCT routine can be used,
+ * by the zigzag index of the last nonzero coefficient.  Zigzag indices 0-2
+ * lie within the top-left 2x2 coefficients, and indices 0-9 lie within the
+ * top-left 4x4 coefficients.
+ */
+#define IDCT_DC       0         /* DC coefficient only */
+#define IDCT_2X2      1         /* last nonzero zigzag index <= 2 */
+#define IDCT_4X4      2         /* last nonzero zigzag index <= 9 */
+#define IDCT_FULL     3         /* any other block */
+#define NUM_IDCT_CLASSES  4
+
 struct jpeg_inverse_dct {
   void (*start_pass) (j_decompress_ptr cinfo);
 
@@ -450,6 +530,13 @@ struct jpeg_inverse_dct {
   /* It is useful to allow each component to have a separate IDCT method. */
   inverse_DCT_method_ptr inverse_DCT[MAX_COMPONENTS];
   inverse_DCT_12_method_ptr inverse_DCT_12[MAX_COMPONENTS];
+  /* Routines to use for each class of block.  Each produces the same output
+   * as inverse_DCT[] for the blocks in its class, and the IDCT_FULL entry is
+   * inverse_DCT[] itself.
+   */
+  inverse_DCT_method_ptr sparse_inverse_DCT[MAX_COMPONENTS][NUM_IDCT_CLASSES];
+  inverse_DCT_12_method_ptr
+    sparse_inverse_DCT_12[MAX_COMPONENTS][NUM_IDCT_CLASSES];
 };
 
 /* Upsampling (note that upsampler must also call color converter) */
@@ -599,6 +686,9 @@ EXTERN(void) j12init_d_post_controller(j_decompress_ptr cinfo,
 EXTERN(void) jinit_input_controller(j_decompress_ptr cinfo);
 EXTERN(void) jinit_marker_reader(j_decompress_ptr cinfo);
 EXTERN(void) jinit_huff_decoder(j_decompress_ptr cinfo);
+EXTERN(boolean) jdecode_restart_intervals(j_decompress_ptr cinfo,
+                                          boolean *dirty);
+EXTERN(boolean) jdecode_speculatively(j_decompress_ptr cinfo, boolean *dirty);
 EXTERN(void) jinit_phuff_decoder(j_decompress_ptr cinfo);
 EXTERN(void) jinit_arith_decoder(j_decompress_ptr cinfo);
 EXTERN(void) jinit_inverse_dct(j_decompress_ptr cinfo);
@@ -659,12 +749,21 @@ EXTERN(void) jcopy_block_row(JBLOCKROW input_row, JBLOCKROW output_row,
                              JDIMENSION num_blocks);
 EXTERN(void) jzero_far(void *target, size_t bytestozero);
 
+/* Trellis quantization workspace management in jcdctmgr.c */
+EXTERN(trellis_context *) jinit_trellis_context(j_compress_ptr cinfo,
+                                                JDIMENSION max_blocks,
+                                                boolean need_dc);
+EXTERN(void) jstart_trellis_context(j_compress_ptr cinfo,
+                                    trellis_context *ctx);
+EXTERN(void) jget_trellis_stats(trellis_context *ctx, long *num_blocks,
+                                long *num_bypassed);
+
 #ifdef C_ARITH_CODING_SUPPORTED
 EXTERN(void) jget_arith_rates (j_compress_ptr cinfo, int dc_tbl_no, int ac_tbl_no, arith_rates *r);
 
 EXTERN(void) quantize_trellis_arith
-(j_compress_ptr cinfo, arith_rates *r, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
- JQUANT_TBL * qtbl, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
+(j_compress_ptr cinfo, trellis_context *ctx, arith_rates *r, JBLOCKROW coef_blocks, JBLOCKROW src, JDIMENSION num_blocks,
+ int qtblno, double *norm_src, double *norm_coef, JCOEF *last_dc_val,
  JBLOCKROW coef_blocks_above, JBLOCKROW src_above);
 #endif
 
@@ -326,7 +326,8 @@ typedef enum {
   JBOOLEAN_USE_LAMBDA_WEIGHT_TBL = 0x339DB65F, /* TRUE=use lambda weighting table */
   JBOOLEAN_USE_SCANS_IN_TRELLIS = 0xFD841435, /* TRUE=use scans in trellis optimization */
   JBOOLEAN_TRELLIS_Q_OPT = 0xE12AE269, /* TRUE=optimize quant table in trellis loop */
-  JBOOLEAN_OVERSHOOT_DERINGING = 0x3F4BBBF9 /* TRUE=preprocess input to reduce ringing of edges on white background */
+  JBOOLEAN_OVERSHOOT_DERINGING = 0x3F4BBBF9, /* TRUE=preprocess input to reduce ringing of edges on white background */
+  JBOOLEAN_BUFFER_SYMBOLS = 0x9B3E71D2 /* TRUE=write scans from the symbols recorded while optimizing Huffman tables */
 } J_BOOLEAN_PARAM;
 
 /* Floating point parameters */
@@ -334,7 +335,8 @@ typedef enum {
 typedef enum {
   JFLOAT_LAMBDA_LOG_SCALE1 = 0x5B61A599,
   JFLOAT_LAMBDA_LOG_SCALE2 = 0xB9BBAE03,
-  JFLOAT_TRELLIS_DELTA_DC_WEIGHT = 0x13775453
+  JFLOAT_TRELLIS_DELTA_DC_WEIGHT = 0x13775453,
+  JFLOAT_TRELLIS_LOOP_EPSILON = 0x2C5E8B17 /* stop trellis loops once the estimated size changes by less than this fraction (0=never) */
 } J_FLOAT_PARAM;
 
 /* Integer parameters */
@@ -345,7 +347,9 @@ typedef enum {
   JINT_TRELLIS_NUM_LOOPS = 0xB63EBF39, /* number of trellis loops */
   JINT_BASE_QUANT_TBL_IDX = 0x44492AB1, /* base quantization table index */
   JINT_DC_SCAN_OPT_MODE = 0x0BE7AD3C, /* DC scan optimization mode */
-  JINT_TRELLIS_SPEED_LEVEL = 0x3C8D1F47 /* trellis speed optimization 0-10 (0=thorough, 10=fast) */
+  JINT_TRELLIS_SPEED_LEVEL = 0x3C8D1F47, /* trellis speed optimization 0-10 (0=thorough, 10=fast) */
+  JINT_NUM_THREADS = 0x7A2E61C5, /* max. # of threads used for compression or decompression (1=single-threaded) */
+  JINT_SCAN_COST_MODE = 0x5D31C8A4 /* how candidate scans are sized (0=trial encoding, 1=estimate from statistics, 2=estimate from sampled iMCU rows) */
 } J_INT_PARAM;
 
 
@@ -1220,6 +1224,14 @@ EXTERN(boolean) jpeg_c_int_param_supported (const j_compress_ptr cinfo,
 EXTERN(void) jpeg_c_set_int_param (j_compress_ptr cinfo, J_INT_PARAM param,
                                    int value);
 EXTERN(int) jpeg_c_get_int_param (const j_compress_ptr cinfo, J_INT_PARAM param);
+
+#define JPEG_D_PARAM_SUPPORTED 1
+EXTERN(boolean) jpeg_d_int_param_supported (const j_decompress_ptr cinfo,
+                                            J_INT_PARAM param);
+EXTERN(void) jpeg_d_set_int_param (j_decompress_ptr cinfo, J_INT_PARAM param,
+                                   int value);
+EXTERN(int) jpeg_d_get_int_param (const j_decompress_ptr cinfo, J_INT_PARAM param);
+
 /* Read ICC profile.  See libjpeg.txt for usage information. */
 EXTERN(boolean) jpeg_read_icc_profile(j_decompress_ptr cinfo,
                                       JOCTET **icc_data_ptr,
@@ -144,6 +144,7 @@
 /* Use the 12-bit method in the jpeg_inverse_dct structure. */
 #define _inverse_DCT_method_ptr  inverse_DCT_12_method_ptr
 #define _inverse_DCT  inverse_DCT_12
+#define _sparse_inverse_DCT  sparse_inverse_DCT_12
 /* Use the 12-bit method in the jpeg_upsampler structure. */
 #define _upsample  upsample_12
 /* Use the 12-bit method in the jpeg_color_converter structure. */
@@ -184,6 +185,9 @@
 #define _jpeg_fdct_ifast  jpeg12_fdct_ifast
 
 #define _jpeg_idct_islow  jpeg12_idct_islow
+#define _jpeg_idct_islow_sparse_dc  jpeg12_idct_islow_sparse_dc
+#define _jpeg_idct_islow_sparse_2x2  jpeg12_idct_islow_sparse_2x2
+#define _jpeg_idct_islow_sparse_4x4  jpeg12_idct_islow_sparse_4x4
 #define _jpeg_idct_ifast  jpeg12_idct_ifast
 #define _jpeg_idct_float  jpeg12_idct_float
 #define _jpeg_idct_7x7  jpeg12_idct_7x7
@@ -259,6 +263,7 @@
 /* Use the 8-bit method in the jpeg_inverse_dct structure. */
 #define _inverse_DCT_method_ptr  inverse_DCT_method_ptr
 #define _inverse_DCT  inverse_DCT
+#define _sparse_inverse_DCT  sparse_inverse_DCT
 /* Use the 8-bit method in the jpeg_upsampler structure. */
 #define _upsample  upsample
 /* Use the 8-bit method in the jpeg_color_converter structure. */
@@ -299,6 +304,9 @@
 #define _jpeg_fdct_ifast  jpeg_fdct_ifast
 
 #define _jpeg_idct_islow  jpeg_idct_islow
+#define _jpeg_idct_islow_sparse_dc  jpeg_idct_islow_sparse_dc
+#define _jpeg_idct_islow_sparse_2x2  jpeg_idct_islow_sparse_2x2
+#define _jpeg_idct_islow_sparse_4x4  jpeg_idct_islow_sparse_4x4
 #define _jpeg_idct_ifast  jpeg_idct_ifast
 #define _jpeg_idct_float  jpeg_idct_float
 #define _jpeg_idct_7x7  jpeg_idct_7x7
@@ -54,6 +54,13 @@ EXTERN(void) jsimd_h2v2_smooth_downsample(j_compress_ptr cinfo,
                                           JSAMPARRAY input_data,
                                           JSAMPARRAY output_data);
 
+EXTERN(int) jsimd_can_fullsize_smooth_downsample(void);
+
+EXTERN(void) jsimd_fullsize_smooth_downsample(j_compress_ptr cinfo,
+                                              jpeg_component_info *compptr,
+                                              JSAMPARRAY input_data,
+                                              JSAMPARRAY output_data);
+
 EXTERN(void) jsimd_h2v1_downsample(j_compress_ptr cinfo,
                                    jpeg_component_info *compptr,
                                    JSAMPARRAY input_data,
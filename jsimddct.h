@@ -33,6 +33,39 @@ EXTERN(void) jsimd_quantize(JCOEFPTR coef_block, DCTELEM *divisors,
 EXTERN(void) jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
                                   FAST_FLOAT *workspace);
 
+EXTERN(int) jsimd_can_convsamp_float_x2(void);
+EXTERN(int) jsimd_can_fdct_float_x2(void);
+EXTERN(int) jsimd_can_quantize_float_x2(void);
+
+EXTERN(void) jsimd_convsamp_float_x2(JSAMPARRAY sample_data,
+                                     JDIMENSION start_col,
+                                     FAST_FLOAT *workspace);
+EXTERN(void) jsimd_fdct_float_x2(FAST_FLOAT *data);
+EXTERN(void) jsimd_quantize_float_x2(JCOEFPTR coef_block,
+                                     FAST_FLOAT *divisors,
+                                     FAST_FLOAT *workspace);
+
+EXTERN(int) jsimd_can_fdct_islow_row(void);
+
+EXTERN(void) jsimd_fdct_islow_row(JSAMPARRAY sample_data, JDIMENSION start_col,
+                                  JDIMENSION num_blocks,
+                                  JBLOCKROW coef_blocks, DCTELEM *divisors,
+                                  JBLOCKROW dst);
+
+EXTERN(int) jsimd_can_preprocess_deringing(void);
+EXTERN(int) jsimd_can_preprocess_deringing_float(void);
+
+EXTERN(void) jsimd_preprocess_deringing(DCTELEM *data,
+                                        const JQUANT_TBL *quantization_table);
+EXTERN(void) jsimd_preprocess_deringing_float
+  (FAST_FLOAT *data, const JQUANT_TBL *quantization_table);
+
+EXTERN(int) jsimd_can_trellis_ac_search(void);
+
+EXTERN(int) jsimd_trellis_ac_search
+  (const float *zero_dist, float *cost, const float *candidate_dist,
+   const float *ac_bits, int num_pred, int num_candidates);
+
 EXTERN(int) jsimd_can_idct_2x2(void);
 EXTERN(int) jsimd_can_idct_4x4(void);
 EXTERN(int) jsimd_can_idct_6x6(void);
@@ -68,3 +101,11 @@ EXTERN(void) jsimd_idct_float(j_decompress_ptr cinfo,
                               jpeg_component_info *compptr,
                               JCOEFPTR coef_block, JSAMPARRAY output_buf,
                               JDIMENSION output_col);
+
+/* x86-64 only */
+EXTERN(int) jsimd_can_idct_islow_dc(void);
+
+EXTERN(void) jsimd_idct_islow_dc(j_decompress_ptr cinfo,
+                                 jpeg_component_info *compptr,
+                                 JCOEFPTR coef_block, JSAMPARRAY output_buf,
+                                 JDIMENSION output_col);
@@ -0,0 +1,252 @@
+/*
+ * jthread.c
+ *
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This file contains a minimal worker thread pool.  The pool is deliberately
+ * simple: the caller hands it a batch of numbered tasks, the tasks are handed
+ * out to the worker threads (and to the calling thread) in increasing order,
+ * and the caller blocks until the whole batch has completed.  Any ordering
+ * that matters to the output must therefore be imposed by the caller, which
+ * keeps the results independent of the number of threads and of scheduling.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jthread.h"
+
+#ifdef WITH_THREADS
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+
+typedef HANDLE thread_t;
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+
+#define mutex_init(m)     (InitializeCriticalSection(m), 0)
+#define mutex_destroy(m)  DeleteCriticalSection(m)
+#define mutex_lock(m)     EnterCriticalSection(m)
+#define mutex_unlock(m)   LeaveCriticalSection(m)
+#define cond_init(c)      (InitializeConditionVariable(c), 0)
+#define cond_destroy(c)
+#define cond_wait(c, m)   SleepConditionVariableCS(c, m, INFINITE)
+#define cond_signal(c)    WakeConditionVariable(c)
+#define cond_broadcast(c) WakeAllConditionVariable(c)
+#define THREAD_FUNC(name, arg)  static unsigned __stdcall name(void *arg)
+#define THREAD_RETURN     return 0
+
+#else
+#include <pthread.h>
+
+typedef pthread_t thread_t;
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t cond_t;
+
+#define mutex_init(m)     pthread_mutex_init(m, NULL)
+#define mutex_destroy(m)  pthread_mutex_destroy(m)
+#define mutex_lock(m)     pthread_mutex_lock(m)
+#define mutex_unlock(m)   pthread_mutex_unlock(m)
+#define cond_init(c)      pthread_cond_init(c, NULL)
+#define cond_destroy(c)   pthread_cond_destroy(c)
+#define cond_wait(c, m)   pthread_cond_wait(c, m)
+#define cond_signal(c)    pthread_cond_signal(c)
+#define cond_broadcast(c) pthread_cond_broadcast(c)
+#define THREAD_FUNC(name, arg)  static void *name(void *arg)
+#define THREAD_RETURN     return NULL
+#endif
+
+
+struct jthread_pool {
+  int num_workers;              /* # of worker threads (excluding caller) */
+  thread_t *workers;
+
+  mutex_t lock;                 /* protects all of the fields below */
+  cond_t work_cond;             /* signaled when a new batch is posted */
+  cond_t done_cond;             /* signaled when the last worker finishes */
+
+  jthread_task_fn fn;           /* current batch */
+  void *arg;
+  int num_tasks;
+  int next_task;                /* next task index to hand out */
+  int busy_workers;             /* workers that have not finished the batch */
+  unsigned int generation;      /* incremented for each batch */
+  boolean shutdown;
+};
+
+
+/* Run tasks from the current batch until there are none left.  Called with
+ * the pool lock held.
+ */
+
+LOCAL(void)
+run_tasks(jthread_pool *pool)
+{
+  while (pool->next_task < pool->num_tasks) {
+    int task = pool->next_task++;
+
+    mutex_unlock(&pool->lock);
+    (*pool->fn) (pool->arg, task);
+    mutex_lock(&pool->lock);
+  }
+}
+
+
+THREAD_FUNC(worker_thread, arg)
+{
+  jthread_pool *pool = (jthread_pool *)arg;
+  unsigned int generation = 0;
+
+  mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->generation == generation && !pool->shutdown)
+      cond_wait(&pool->work_cond, &pool->lock);
+    if (pool->shutdown)
+      break;
+    generation = pool->generation;
+    run_tasks(pool);
+    if (--pool->busy_workers == 0)
+      cond_signal(&pool->done_cond);
+  }
+  mutex_unlock(&pool->lock);
+
+  THREAD_RETURN;
+}
+
+
+GLOBAL(jthread_pool *)
+jthread_pool_create(int num_threads)
+{
+  jthread_pool *pool;
+  int i;
+
+  if (num_threads < 2)
+    return NULL;
+
+  pool = (jthread_pool *)malloc(sizeof(jthread_pool));
+  if (pool == NULL)
+    return NULL;
+  memset(pool, 0, sizeof(jthread_pool));
+  pool->num_workers = num_threads - 1;
+  pool->workers = (thread_t *)malloc(pool->num_workers * sizeof(thread_t));
+  if (pool->workers == NULL) {
+    free(pool);
+    return NULL;
+  }
+  if (mutex_init(&pool->lock) != 0) {
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+  if (cond_init(&pool->work_cond) != 0) {
+    mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+  if (cond_init(&pool->done_cond) != 0) {
+    cond_destroy(&pool->work_cond);
+    mutex_destroy(&pool->lock);
+    free(pool->workers);
+    free(pool);
+    return NULL;
+  }
+
+  for (i = 0; i < pool->num_workers; i++) {
+#ifdef _WIN32
+    pool->workers[i] =
+      (HANDLE)_beginthreadex(NULL, 0, worker_thread, pool, 0, NULL);
+    if (pool->workers[i] == 0)
+      break;
+#else
+    if (pthread_create(&pool->workers[i], NULL, worker_thread, pool) != 0)
+      break;
+#endif
+  }
+  if (i < pool->num_workers) {
+    pool->num_workers = i;
+    jthread_pool_destroy(pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
+
+GLOBAL(void)
+jthread_pool_run(jthread_pool *pool, jthread_task_fn fn, void *arg,
+                 int num_tasks)
+{
+  mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->num_tasks = num_tasks;
+  pool->next_task = 0;
+  pool->busy_workers = pool->num_workers;
+  pool->generation++;
+  cond_broadcast(&pool->work_cond);
+
+  /* The calling thread takes part in the work as well. */
+  run_tasks(pool);
+  while (pool->busy_workers > 0)
+    cond_wait(&pool->done_cond, &pool->lock);
+  mutex_unlock(&pool->lock);
+}
+
+
+GLOBAL(void)
+jthread_pool_destroy(jthread_pool *pool)
+{
+  int i;
+
+  if (pool == NULL)
+    return;
+
+  mutex_lock(&pool->lock);
+  pool->shutdown = TRUE;
+  cond_broadcast(&pool->work_cond);
+  mutex_unlock(&pool->lock);
+
+  for (i = 0; i < pool->num_workers; i++) {
+#ifdef _WIN32
+    WaitForSingleObject(pool->workers[i], INFINITE);
+    CloseHandle(pool->workers[i]);
+#else
+    pthread_join(pool->workers[i], NULL);
+#endif
+  }
+
+  cond_destroy(&pool->done_cond);
+  cond_destroy(&pool->work_cond);
+  mutex_destroy(&pool->lock);
+  free(pool->workers);
+  free(pool);
+}
+
+#else /* WITH_THREADS */
+
+GLOBAL(jthread_pool *)
+jthread_pool_create(int num_threads)
+{
+  return NULL;
+}
+
+GLOBAL(void)
+jthread_pool_run(jthread_pool *pool, jthread_task_fn fn, void *arg,
+                 int num_tasks)
+{
+  int task;
+
+  for (task = 0; task < num_tasks; task++)
+    (*fn) (arg, task);
+}
+
+GLOBAL(void)
+jthread_pool_destroy(jthread_pool *pool)
+{
+}
+
+#endif /* WITH_THREADS */
@@ -0,0 +1,34 @@
+/*
+ * jthread.h
+ *
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This file contains declarations for the worker thread pool that is used to
+ * spread independent units of work (such as block rows) across several
+ * threads.  No other modules need to see these.
+ */
+
+/* A task function is called once for each task index in 0..num_tasks-1.  The
+ * tasks of one jthread_pool_run() call may run concurrently and in any order,
+ * so each task must only write data that no other task reads or writes.  Task
+ * functions must not call ERREXIT() or otherwise longjmp() out of the pool;
+ * errors must be recorded in the task data and raised by the caller once
+ * jthread_pool_run() has returned.
+ */
+typedef void (*jthread_task_fn) (void *arg, int task);
+
+typedef struct jthread_pool jthread_pool;
+
+/* Create a pool that runs tasks on num_threads threads (including the calling
+ * thread.)  Returns NULL if num_threads < 2, if the library was built without
+ * thread support, or if the threads could not be created.  Callers are
+ * expected to fall back to running the tasks serially in that case.
+ */
+EXTERN(jthread_pool *) jthread_pool_create(int num_threads);
+
+/* Run num_tasks tasks on the pool and wait for all of them to complete. */
+EXTERN(void) jthread_pool_run(jthread_pool *pool, jthread_task_fn fn,
+                              void *arg, int num_tasks);
+
+EXTERN(void) jthread_pool_destroy(jthread_pool *pool);
@@ -449,6 +449,32 @@ jsimd_h2v2_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
                              input_data, output_data);
 }
 
+GLOBAL(int)
+jsimd_can_h2v2_smooth_downsample(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_fullsize_smooth_downsample(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_h2v2_smooth_downsample(j_compress_ptr cinfo,
+                             jpeg_component_info *compptr,
+                             JSAMPARRAY input_data, JSAMPARRAY output_data)
+{
+}
+
+GLOBAL(void)
+jsimd_fullsize_smooth_downsample(j_compress_ptr cinfo,
+                                 jpeg_component_info *compptr,
+                                 JSAMPARRAY input_data, JSAMPARRAY output_data)
+{
+}
+
 GLOBAL(void)
 jsimd_h2v1_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
                       JSAMPARRAY input_data, JSAMPARRAY output_data)
@@ -827,6 +853,78 @@ jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
 {
 }
 
+GLOBAL(int)
+jsimd_can_convsamp_float_x2(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_fdct_float_x2(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_quantize_float_x2(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_convsamp_float_x2(JSAMPARRAY sample_data, JDIMENSION start_col,
+                        FAST_FLOAT *workspace)
+{
+}
+
+GLOBAL(void)
+jsimd_fdct_float_x2(FAST_FLOAT *data)
+{
+}
+
+GLOBAL(void)
+jsimd_quantize_float_x2(JCOEFPTR coef_block, FAST_FLOAT *divisors,
+                        FAST_FLOAT *workspace)
+{
+}
+
+GLOBAL(int)
+jsimd_can_fdct_islow_row(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_fdct_islow_row(JSAMPARRAY sample_data, JDIMENSION start_col,
+                     JDIMENSION num_blocks, JBLOCKROW coef_blocks,
+                     DCTELEM *divisors, JBLOCKROW dst)
+{
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing_float(void)
+{
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_preprocess_deringing(DCTELEM *data,
+                           const JQUANT_TBL *quantization_table)
+{
+}
+
+GLOBAL(void)
+jsimd_preprocess_deringing_float(FAST_FLOAT *data,
+                                 const JQUANT_TBL *quantization_table)
+{
+}
+
 GLOBAL(int)
 jsimd_can_idct_2x2(void)
 {
@@ -1055,3 +1153,17 @@ jsimd_encode_mcu_AC_refine_prepare(const JCOEF *block,
                                                  jpeg_natural_order_start,
                                                  Sl, Al, absvalues, bits);
 }
+
+GLOBAL(int)
+jsimd_can_trellis_ac_search(void)
+{
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_trellis_ac_search(const float *zero_dist, float *cost,
+                        const float *candidate_dist, const float *ac_bits,
+                        int num_pred, int num_candidates)
+{
+  return -1;
+}
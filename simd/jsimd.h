@@ -27,6 +27,7 @@
 #define JSIMD_ALTIVEC  0x40
 #define JSIMD_AVX2     0x80
 #define JSIMD_MMI      0x100
+#define JSIMD_BMI2     0x200     /* BMI1, BMI2, and LZCNT (with AVX2 only) */
 
 /* SIMD Ext: retrieve SIMD/CPU information */
 EXTERN(unsigned int) jpeg_simd_cpu_support(void);
@@ -592,6 +593,23 @@ EXTERN(void) jsimd_h2v2_smooth_downsample_dspr2
    int max_v_samp_factor, int smoothing_factor, JDIMENSION width_in_blocks,
    JDIMENSION image_width);
 
+EXTERN(void) jsimd_h2v2_smooth_downsample_sse2
+  (JDIMENSION image_width, int max_v_samp_factor, int smoothing_factor,
+   JDIMENSION width_in_blocks, JSAMPARRAY input_data, JSAMPARRAY output_data);
+
+EXTERN(void) jsimd_h2v2_smooth_downsample_avx2
+  (JDIMENSION image_width, int max_v_samp_factor, int smoothing_factor,
+   JDIMENSION width_in_blocks, JSAMPARRAY input_data, JSAMPARRAY output_data);
+
+/* Full-size Smooth Downsampling */
+EXTERN(void) jsimd_fullsize_smooth_downsample_sse2
+  (JDIMENSION image_width, int max_v_samp_factor, int smoothing_factor,
+   JDIMENSION width_in_blocks, JSAMPARRAY input_data, JSAMPARRAY output_data);
+
+EXTERN(void) jsimd_fullsize_smooth_downsample_avx2
+  (JDIMENSION image_width, int max_v_samp_factor, int smoothing_factor,
+   JDIMENSION width_in_blocks, JSAMPARRAY input_data, JSAMPARRAY output_data);
+
 
 /* Upsampling */
 EXTERN(void) jsimd_h2v1_upsample_mmx
@@ -1036,6 +1054,9 @@ EXTERN(void) jsimd_convsamp_float_sse
 EXTERN(void) jsimd_convsamp_float_sse2
   (JSAMPARRAY sample_data, JDIMENSION start_col, FAST_FLOAT *workspace);
 
+EXTERN(void) jsimd_convsamp_float_avx2
+  (JSAMPARRAY sample_data, JDIMENSION start_col, FAST_FLOAT *workspace);
+
 EXTERN(void) jsimd_convsamp_float_dspr2
   (JSAMPARRAY sample_data, JDIMENSION start_col, FAST_FLOAT *workspace);
 
@@ -1047,6 +1068,9 @@ EXTERN(void) jsimd_fdct_islow_sse2(DCTELEM *data);
 
 extern const int jconst_fdct_islow_avx2[];
 EXTERN(void) jsimd_fdct_islow_avx2(DCTELEM *data);
+EXTERN(void) jsimd_fdct_islow_row_avx2
+  (JSAMPARRAY sample_data, JDIMENSION start_col, JDIMENSION num_blocks,
+   JBLOCKROW coef_blocks, DCTELEM *divisors, JBLOCKROW dst);
 
 EXTERN(void) jsimd_fdct_islow_neon(DCTELEM *data);
 
@@ -1076,6 +1100,9 @@ EXTERN(void) jsimd_fdct_float_3dnow(FAST_FLOAT *data);
 extern const int jconst_fdct_float_sse[];
 EXTERN(void) jsimd_fdct_float_sse(FAST_FLOAT *data);
 
+extern const int jconst_fdct_float_avx2[];
+EXTERN(void) jsimd_fdct_float_avx2(FAST_FLOAT *data);
+
 /* Quantization */
 EXTERN(void) jsimd_quantize_mmx
   (JCOEFPTR coef_block, DCTELEM *divisors, DCTELEM *workspace);
@@ -1108,6 +1135,9 @@ EXTERN(void) jsimd_quantize_float_sse
 EXTERN(void) jsimd_quantize_float_sse2
   (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
 
+EXTERN(void) jsimd_quantize_float_avx2
+  (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
+
 EXTERN(void) jsimd_quantize_float_dspr2
   (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
 
@@ -1178,6 +1208,10 @@ EXTERN(void) jsimd_idct_islow_altivec
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
 
+EXTERN(void) jsimd_idct_islow_dc_sse2
+  (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
+   JDIMENSION output_col);
+
 /* Fast Integer Inverse DCT */
 EXTERN(void) jsimd_idct_ifast_mmx
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
@@ -1222,12 +1256,24 @@ EXTERN(void) jsimd_idct_float_sse2
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
 
+/* Overshoot deringing */
+extern const int jconst_preprocess_deringing_avx2[];
+EXTERN(void) jsimd_preprocess_deringing_avx2
+  (DCTELEM *data, const JQUANT_TBL *quantization_table);
+EXTERN(void) jsimd_preprocess_deringing_float_avx2
+  (FAST_FLOAT *data, const JQUANT_TBL *quantization_table);
+
 /* Huffman coding */
 extern const int jconst_huff_encode_one_block[];
 EXTERN(JOCTET *) jsimd_huff_encode_one_block_sse2
   (void *state, JOCTET *buffer, JCOEFPTR block, int last_dc_val,
    c_derived_tbl *dctbl, c_derived_tbl *actbl);
 
+extern const int jconst_huff_encode_one_block_avx2[];
+EXTERN(JOCTET *) jsimd_huff_encode_one_block_avx2
+  (void *state, JOCTET *buffer, JCOEFPTR block, int last_dc_val,
+   c_derived_tbl *dctbl, c_derived_tbl *actbl);
+
 EXTERN(JOCTET *) jsimd_huff_encode_one_block_neon
   (void *state, JOCTET *buffer, JCOEFPTR block, int last_dc_val,
    c_derived_tbl *dctbl, c_derived_tbl *actbl);
@@ -1245,6 +1291,11 @@ EXTERN(void) jsimd_encode_mcu_AC_first_prepare_sse2
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    UJCOEF *values, size_t *zerobits);
 
+extern const int jconst_encode_mcu_AC_prepare_avx2[];
+EXTERN(void) jsimd_encode_mcu_AC_first_prepare_avx2
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
+   UJCOEF *values, size_t *zerobits);
+
 EXTERN(void) jsimd_encode_mcu_AC_first_prepare_neon
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    UJCOEF *values, size_t *zerobits);
@@ -1253,6 +1304,16 @@ EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_sse2
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    UJCOEF *absvalues, size_t *bits);
 
+EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_avx2
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
+   UJCOEF *absvalues, size_t *bits);
+
 EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_neon
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    UJCOEF *absvalues, size_t *bits);
+
+/* Trellis quantization */
+extern const int jconst_trellis_ac_search_avx2[];
+EXTERN(int) jsimd_trellis_ac_search_avx2
+  (const float *zero_dist, float *cost, const float *candidate_dist,
+   const float *ac_bits, int num_pred, int num_candidates);
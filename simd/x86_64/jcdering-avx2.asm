@@ -0,0 +1,613 @@
+;
+; jcdering-avx2.asm - overshoot deringing preprocessor (64-bit AVX2)
+;
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains AVX2 implementations of preprocess_deringing() and
+; float_preprocess_deringing(); see jcdctmgr.c for more details.  The sum of
+; the samples and the number of samples at the maximum value are computed with
+; vector operations, so blocks that contain no such samples (the vast majority)
+; are rejected after a handful of instructions.  For the remaining blocks, the
+; runs of maximum-valued samples are located in a 64-bit zigzag-order bitmap,
+; and the Catmull-Rom curve that replaces each run is evaluated for eight
+; samples at a time.  The curve is computed with the same single-precision
+; operations as catmull_rom(), so the results are bit-identical to the C code.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+; vpshufb controls that move the elements of one row of the block into their
+; positions within a group of 16 elements in zigzag order.  The row is
+; broadcast to both 128-bit lanes, so each control selects the elements of the
+; row that belong in the group and zeroes the others.  (These are the same
+; controls that jchuff-avx2.asm uses.)
+
+%define W(col)  (((col) * 2 + 1) << 8 | (col) * 2)
+%define XX      0x8080
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_preprocess_deringing_avx2)
+
+EXTN(jconst_preprocess_deringing_avx2):
+
+; Zigzag positions 0-15
+ZZ_0_ROW0  dw W(0), W(1),   XX,   XX,   XX, W(2), W(3),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX, W(4), W(5)
+ZZ_0_ROW1  dw   XX,   XX, W(0),   XX, W(1),   XX,   XX, W(2)
+            dw   XX,   XX,   XX,   XX,   XX, W(3),   XX,   XX
+ZZ_0_ROW2  dw   XX,   XX,   XX, W(0),   XX,   XX,   XX,   XX
+            dw W(1),   XX,   XX,   XX, W(2),   XX,   XX,   XX
+ZZ_0_ROW3  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(0),   XX, W(1),   XX,   XX,   XX,   XX
+ZZ_0_ROW4  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX, W(0),   XX,   XX,   XX,   XX,   XX
+; Zigzag positions 16-31
+ZZ_1_ROW0  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX,   XX, W(6), W(7),   XX,   XX,   XX
+ZZ_1_ROW1  dw W(4),   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX, W(5),   XX,   XX, W(6),   XX,   XX
+ZZ_1_ROW2  dw   XX, W(3),   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(4),   XX,   XX,   XX,   XX, W(5),   XX
+ZZ_1_ROW3  dw   XX,   XX, W(2),   XX,   XX,   XX,   XX,   XX
+            dw W(3),   XX,   XX,   XX,   XX,   XX,   XX, W(4)
+ZZ_1_ROW4  dw   XX,   XX,   XX, W(1),   XX,   XX,   XX, W(2)
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_1_ROW5  dw   XX,   XX,   XX,   XX, W(0),   XX, W(1),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_1_ROW6  dw   XX,   XX,   XX,   XX,   XX, W(0),   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+; Zigzag positions 32-47
+ZZ_2_ROW1  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX, W(7),   XX,   XX,   XX,   XX,   XX
+ZZ_2_ROW2  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(6),   XX, W(7),   XX,   XX,   XX,   XX
+ZZ_2_ROW3  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw W(5),   XX,   XX,   XX, W(6),   XX,   XX,   XX
+ZZ_2_ROW4  dw W(3),   XX,   XX,   XX,   XX,   XX,   XX, W(4)
+            dw   XX,   XX,   XX,   XX,   XX, W(5),   XX,   XX
+ZZ_2_ROW5  dw   XX, W(2),   XX,   XX,   XX,   XX, W(3),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX, W(4),   XX
+ZZ_2_ROW6  dw   XX,   XX, W(1),   XX,   XX, W(2),   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX, W(3)
+ZZ_2_ROW7  dw   XX,   XX,   XX, W(0), W(1),   XX,   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+; Zigzag positions 48-63
+ZZ_3_ROW3  dw   XX,   XX,   XX,   XX,   XX, W(7),   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_3_ROW4  dw   XX,   XX,   XX,   XX, W(6),   XX, W(7),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_3_ROW5  dw   XX,   XX,   XX, W(5),   XX,   XX,   XX, W(6)
+            dw   XX,   XX,   XX,   XX, W(7),   XX,   XX,   XX
+ZZ_3_ROW6  dw   XX,   XX, W(4),   XX,   XX,   XX,   XX,   XX
+            dw W(5),   XX,   XX, W(6),   XX, W(7),   XX,   XX
+ZZ_3_ROW7  dw W(2), W(3),   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(4), W(5),   XX,   XX,   XX, W(6), W(7)
+
+PW_ONE          times 16 dw 1
+PW_MAXSAMPLE    times 16 dw 255 - CENTERJSAMPLE
+PS_MAXSAMPLE    times 8 dd 0x42FE0000       ; 127.0f (255 - CENTERJSAMPLE)
+PS_ONE          times 8 dd 0x3F800000       ;   1.0f
+PS_TWO          times 8 dd 0x40000000       ;   2.0f
+PS_THREE        times 8 dd 0x40400000       ;   3.0f
+PS_NEG_TWO      times 8 dd 0xC0000000       ;  -2.0f
+PS_MAXSUM       dd 0x45FE0000               ; 8128.0f (maxsample * DCTSIZE2)
+
+; jpeg_natural_order[], as bytes
+NATURAL_ORDER   db  0,  1,  8, 16,  9,  2,  3, 10
+                db 17, 24, 32, 25, 18, 11,  4,  5
+                db 12, 19, 26, 33, 40, 48, 41, 34
+                db 27, 20, 13,  6,  7, 14, 21, 28
+                db 35, 42, 49, 56, 57, 50, 43, 36
+                db 29, 22, 15, 23, 30, 37, 44, 51
+                db 58, 59, 52, 45, 38, 31, 39, 46
+                db 53, 60, 61, 54, 47, 55, 62, 63
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+; Local variables, addressed relative to rbx
+
+%define MASKS   rbx + 0                 ; natural-order sample masks (64 words)
+%define POS     rbx + 128               ; curve positions (64 floats)
+%define RES     rbx + 384               ; replacement samples (64 dwords)
+%define TAN1    rbx + 640               ; tan1 (broadcast to 8 floats)
+%define TAN2    rbx + 672               ; tan2 (broadcast to 8 floats)
+%define MAXOV   rbx + 704               ; maxovershoot (broadcast to 8 lanes)
+%define LOCALS  736
+
+%define data    r10
+%define qtbl    r11
+%define zzmask  r12
+%define zzmaskd r12d
+%define natural r13
+%define start   rsi
+%define startd  esi
+%define end     rdi
+%define endd    edi
+%define len     r8
+%define lend    r8d
+
+; Gather the elements of row %3 of MASKS that belong in zigzag group %2
+; (zigzag positions 16 * %2 to 16 * %2 + 15) into %1, which must be zeroed
+; beforehand.  ymm4 is clobbered.
+
+%macro ZZ_ROW 3
+    vbroadcasti128 ymm4, XMMWORD [MASKS + %3 * DCTSIZE * SIZEOF_WORD]
+    vpshufb     ymm4, ymm4, [rel ZZ_%2_ROW%3]
+    vpor        %1, %1, ymm4
+%endmacro
+
+; Convert the sample masks in MASKS to a bitmap in zigzag order (bit k of
+; zzmask is set if data[jpeg_natural_order[k]] >= maxsample.)
+
+%macro ZIGZAG_MASK 0
+    vpxor       ymm0, ymm0, ymm0
+    vpxor       ymm1, ymm1, ymm1
+    vpxor       ymm2, ymm2, ymm2
+    vpxor       ymm3, ymm3, ymm3
+    ZZ_ROW      ymm0, 0, 0
+    ZZ_ROW      ymm0, 0, 1
+    ZZ_ROW      ymm0, 0, 2
+    ZZ_ROW      ymm0, 0, 3
+    ZZ_ROW      ymm0, 0, 4
+    ZZ_ROW      ymm1, 1, 0
+    ZZ_ROW      ymm1, 1, 1
+    ZZ_ROW      ymm1, 1, 2
+    ZZ_ROW      ymm1, 1, 3
+    ZZ_ROW      ymm1, 1, 4
+    ZZ_ROW      ymm1, 1, 5
+    ZZ_ROW      ymm1, 1, 6
+    ZZ_ROW      ymm2, 2, 1
+    ZZ_ROW      ymm2, 2, 2
+    ZZ_ROW      ymm2, 2, 3
+    ZZ_ROW      ymm2, 2, 4
+    ZZ_ROW      ymm2, 2, 5
+    ZZ_ROW      ymm2, 2, 6
+    ZZ_ROW      ymm2, 2, 7
+    ZZ_ROW      ymm3, 3, 3
+    ZZ_ROW      ymm3, 3, 4
+    ZZ_ROW      ymm3, 3, 5
+    ZZ_ROW      ymm3, 3, 6
+    ZZ_ROW      ymm3, 3, 7
+    vpacksswb   ymm0, ymm0, ymm1
+    vpacksswb   ymm2, ymm2, ymm3
+    vpermq      ymm0, ymm0, 0xd8
+    vpermq      ymm2, ymm2, 0xd8
+    vpmovmskb   eax, ymm0
+    vpmovmskb   zzmaskd, ymm2
+    shl         zzmask, 32
+    or          zzmask, rax
+%endmacro
+
+; Find the next run of maximum-valued samples in zigzag order.  On exit, start
+; is the first sample inside the run, end is the first sample outside of it,
+; len = end - start, and the run has been removed from zzmask.  Jumps to %1 if
+; there are no more runs.  rax and rdx are clobbered.
+
+%macro NEXT_RUN 1
+    test        zzmask, zzmask
+    jz          %1
+    bsf         start, zzmask           ; start = index of the first set bit
+    mov         rax, zzmask
+    neg         rax
+    and         rax, zzmask
+    add         rax, zzmask             ; carry through the run to bit end
+    jc          %%.LAST
+    mov         rdx, rax
+    xor         rdx, zzmask             ; rdx = run | (1 << end)
+    bsr         end, rdx
+    and         zzmask, rax
+    jmp         %%.FOUND
+%%.LAST:
+    mov         endd, DCTSIZE2          ; the run extends to the end of the block
+    xor         zzmask, zzmask
+%%.FOUND:
+    mov         lend, endd
+    sub         lend, startd
+%endmacro
+
+; Compute the zigzag indices of the samples that determine the slopes at the
+; edges of the run: eax = start - 1, ecx = start - 2, edx = end, and
+; r9d = end + 1, each clamped to [0, DCTSIZE2 - 1] as in the C code, and then
+; translate them into natural-order indices.
+
+%macro EDGE_INDICES 0
+    xor         r9d, r9d
+    lea         eax, [start - 1]
+    lea         ecx, [start - 2]
+    test        eax, eax
+    cmovs       eax, r9d
+    test        ecx, ecx
+    cmovs       ecx, r9d
+    mov         r9d, DCTSIZE2 - 1
+    mov         edx, endd
+    cmp         edx, r9d
+    cmovg       edx, r9d
+    lea         r11d, [end + 1]
+    cmp         r11d, r9d
+    cmovl       r9d, r11d
+    movzx       eax, byte [natural + rax]
+    movzx       ecx, byte [natural + rcx]
+    movzx       edx, byte [natural + rdx]
+    movzx       r9d, byte [natural + r9]
+%endmacro
+
+; Store the curve positions for the run (step, 2 * step, ...) in POS, rounding
+; the count up to a multiple of 8.  Each position is the sum of the previous
+; one and step, as in the C code.  xmm0 and xmm1 are clobbered.
+
+%macro POSITIONS 0
+    lea         eax, [len + 1]
+    vcvtsi2ss   xmm0, xmm0, eax
+    vmovss      xmm1, [rel PS_ONE]
+    vdivss      xmm0, xmm1, xmm0        ; step = 1.f/(float)(length + 1)
+    vmovaps     xmm1, xmm0              ; position = step
+    lea         ecx, [len + 7]
+    and         ecx, -8
+    xor         eax, eax
+%%.LOOP:
+    vmovss      DWORD [POS + rax * 4], xmm1
+    vaddss      xmm1, xmm1, xmm0        ; position += step
+    inc         eax
+    cmp         eax, ecx
+    jb          %%.LOOP
+%endmacro
+
+; Evaluate catmull_rom(maxsample - fslope, maxsample, maxsample,
+; maxsample - lslope, t, length) for the eight positions t in ymm0, using
+; tan1 = fslope * length and tan2 = -lslope * length.  The result is returned
+; in ymm3, and ymm1-ymm7 are clobbered.
+
+%macro CATMULL_ROM 0
+    vmulps      ymm1, ymm0, ymm0                    ; t2 = t * t
+    vmulps      ymm2, ymm1, ymm0                    ; t3 = t2 * t
+    vmulps      ymm3, ymm2, [rel PS_TWO]
+    vmulps      ymm4, ymm1, [rel PS_THREE]
+    vsubps      ymm3, ymm3, ymm4
+    vaddps      ymm3, ymm3, [rel PS_ONE]            ; f1 = 2 * t3 - 3 * t2 + 1
+    vmulps      ymm5, ymm2, [rel PS_NEG_TWO]
+    vaddps      ymm5, ymm5, ymm4                    ; f2 = -2 * t3 + 3 * t2
+    vmulps      ymm6, ymm1, [rel PS_TWO]
+    vsubps      ymm6, ymm2, ymm6
+    vaddps      ymm6, ymm6, ymm0                    ; f3 = t3 - 2 * t2 + t
+    vsubps      ymm7, ymm2, ymm1                    ; f4 = t3 - t2
+    vmulps      ymm3, ymm3, [rel PS_MAXSAMPLE]
+    vmulps      ymm6, ymm6, YMMWORD [TAN1]
+    vaddps      ymm3, ymm3, ymm6
+    vmulps      ymm5, ymm5, [rel PS_MAXSAMPLE]
+    vaddps      ymm3, ymm3, ymm5
+    vmulps      ymm7, ymm7, YMMWORD [TAN2]
+    vaddps      ymm3, ymm3, ymm7                    ; value2 * f1 + tan1 * f3 +
+                                                    ; value3 * f2 + tan2 * f4
+%endmacro
+
+; Broadcast the integer tangents in %1 (tan1) and %2 (tan2) to TAN1 and TAN2
+; as floats.
+
+%macro STORE_TANGENTS 2
+    vcvtsi2ss   xmm0, xmm0, %1
+    vcvtsi2ss   xmm1, xmm1, %2
+    vbroadcastss ymm0, xmm0
+    vbroadcastss ymm1, xmm1
+    vmovaps     YMMWORD [TAN1], ymm0
+    vmovaps     YMMWORD [TAN2], ymm1
+%endmacro
+
+%macro PROLOGUE 0
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    push        rbx
+    push        r12
+    push        r13
+    and         rsp, byte (-SIZEOF_YMMWORD)
+    sub         rsp, LOCALS
+    mov         rbx, rsp
+    COLLECT_ARGS 2
+    lea         natural, [rel NATURAL_ORDER]
+%endmacro
+
+%macro EPILOGUE 0
+    vzeroupper
+    UNCOLLECT_ARGS 2
+    lea         rsp, [rbp - 3 * SIZEOF_QWORD]
+    pop         r13
+    pop         r12
+    pop         rbx
+    pop         rbp
+    ret
+%endmacro
+
+;
+; Apply overshoot deringing to the samples in data.
+;
+; GLOBAL(void)
+; jsimd_preprocess_deringing_avx2(DCTELEM *data,
+;                                 const JQUANT_TBL *quantization_table);
+;
+
+; r10 = DCTELEM *data
+; r11 = const JQUANT_TBL *quantization_table (used as a scratch register once
+;       maxovershoot has been computed)
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_preprocess_deringing_avx2)
+
+EXTN(jsimd_preprocess_deringing_avx2):
+    PROLOGUE
+
+    vmovdqa     ymm7, [rel PW_MAXSAMPLE]
+    vpcmpgtw    ymm0, ymm7, YMMWORD [data + 0 * SIZEOF_YMMWORD]  ; maxsample > data[i]
+    vpcmpgtw    ymm1, ymm7, YMMWORD [data + 1 * SIZEOF_YMMWORD]
+    vpcmpgtw    ymm2, ymm7, YMMWORD [data + 2 * SIZEOF_YMMWORD]
+    vpcmpgtw    ymm3, ymm7, YMMWORD [data + 3 * SIZEOF_YMMWORD]
+    vpcmpeqw    ymm7, ymm7, ymm7
+    vpxor       ymm0, ymm0, ymm7                    ; data[i] >= maxsample
+    vpxor       ymm1, ymm1, ymm7
+    vpxor       ymm2, ymm2, ymm7
+    vpxor       ymm3, ymm3, ymm7
+    vpaddw      ymm4, ymm0, ymm1
+    vpaddw      ymm5, ymm2, ymm3
+    vpaddw      ymm4, ymm4, ymm5                    ; ymm4 = -partial counts
+    vptest      ymm4, ymm4
+    jz          near .RETURN                        ; no maximum-valued samples
+
+    vmovdqa     YMMWORD [MASKS + 0 * SIZEOF_YMMWORD], ymm0
+    vmovdqa     YMMWORD [MASKS + 1 * SIZEOF_YMMWORD], ymm1
+    vmovdqa     YMMWORD [MASKS + 2 * SIZEOF_YMMWORD], ymm2
+    vmovdqa     YMMWORD [MASKS + 3 * SIZEOF_YMMWORD], ymm3
+
+    vmovdqa     ymm7, [rel PW_ONE]
+    vpmaddwd    ymm0, ymm7, YMMWORD [data + 0 * SIZEOF_YMMWORD]
+    vpmaddwd    ymm1, ymm7, YMMWORD [data + 1 * SIZEOF_YMMWORD]
+    vpmaddwd    ymm2, ymm7, YMMWORD [data + 2 * SIZEOF_YMMWORD]
+    vpmaddwd    ymm3, ymm7, YMMWORD [data + 3 * SIZEOF_YMMWORD]
+    vpmaddwd    ymm4, ymm4, ymm7
+    vpaddd      ymm0, ymm0, ymm1
+    vpaddd      ymm2, ymm2, ymm3
+    vpaddd      ymm0, ymm0, ymm2                    ; ymm0 = partial sums
+    vphaddd     ymm0, ymm0, ymm4
+    vextracti128 xmm1, ymm0, 1
+    vpaddd      xmm0, xmm0, xmm1
+    vphaddd     xmm0, xmm0, xmm0
+    vmovd       eax, xmm0                           ; eax = sum
+    vpextrd     ecx, xmm0, 1
+    neg         ecx                                 ; ecx = maxsample_count
+    cmp         ecx, DCTSIZE2
+    je          near .RETURN                        ; the block is flat
+
+    ; maxovershoot = maxsample + MIN(MIN(31, 2 * quantval[0]),
+    ;                                (maxsample * size - sum) / maxsample_count)
+    mov         r9d, eax
+    mov         eax, (255 - CENTERJSAMPLE) * DCTSIZE2
+    sub         eax, r9d
+    cdq
+    idiv        ecx
+    movzx       ecx, word [qtbl]                    ; quantval[0]
+    add         ecx, ecx
+    mov         edx, 31
+    cmp         ecx, edx
+    cmovg       ecx, edx
+    cmp         eax, ecx
+    cmovg       eax, ecx
+    add         eax, 255 - CENTERJSAMPLE
+    vmovd       xmm0, eax
+    vpbroadcastd ymm0, xmm0
+    vmovdqa     YMMWORD [MAXOV], ymm0
+
+    ZIGZAG_MASK
+
+.RUNLOOP:
+    NEXT_RUN    .RETURN
+
+    ; fslope = MAX(f1 - f2, maxsample - f1);
+    ; lslope = MAX(l1 - l2, maxsample - l1);
+    EDGE_INDICES
+    movsx       eax, word [data + rax * SIZEOF_WORD]        ; f1
+    movsx       ecx, word [data + rcx * SIZEOF_WORD]        ; f2
+    movsx       edx, word [data + rdx * SIZEOF_WORD]        ; l1
+    movsx       r9d, word [data + r9 * SIZEOF_WORD]         ; l2
+    sub         ecx, eax
+    neg         ecx
+    mov         r11d, 255 - CENTERJSAMPLE
+    sub         r11d, eax
+    cmp         ecx, r11d
+    cmovl       ecx, r11d                           ; ecx = fslope
+    sub         r9d, edx
+    neg         r9d
+    mov         r11d, 255 - CENTERJSAMPLE
+    sub         r11d, edx
+    cmp         r9d, r11d
+    cmovl       r9d, r11d                           ; r9d = lslope
+    test        startd, startd
+    cmovz       ecx, r9d                            ; if (start == 0) fslope = lslope;
+    cmp         endd, DCTSIZE2
+    cmove       r9d, ecx                            ; if (end == size) lslope = fslope;
+
+    imul        ecx, lend                           ; tan1 = fslope * length
+    imul        r9d, lend
+    neg         r9d                                 ; tan2 = -lslope * length
+    STORE_TANGENTS ecx, r9d
+    POSITIONS
+
+    xor         eax, eax
+.CURVELOOP:
+    vmovaps     ymm0, YMMWORD [POS + rax * 4]
+    CATMULL_ROM
+    vroundps    ymm3, ymm3, 0x0A                    ; ceilf()
+    vcvttps2dq  ymm3, ymm3
+    vpminsd     ymm3, ymm3, YMMWORD [MAXOV]
+    vmovdqa     YMMWORD [RES + rax * 4], ymm3
+    add         eax, 8
+    cmp         eax, lend
+    jb          .CURVELOOP
+
+    ; data[jpeg_natural_order[start + i]] = MIN(tmp, maxovershoot);
+    add         start, natural
+    xor         eax, eax
+.STORELOOP:
+    movzx       ecx, byte [start + rax]
+    mov         edx, DWORD [RES + rax * 4]
+    mov         word [data + rcx * SIZEOF_WORD], dx
+    inc         eax
+    cmp         eax, lend
+    jb          .STORELOOP
+    jmp         .RUNLOOP
+
+.RETURN:
+    EPILOGUE
+
+;
+; Apply overshoot deringing to the samples in data (floating-point version.)
+;
+; GLOBAL(void)
+; jsimd_preprocess_deringing_float_avx2(FAST_FLOAT *data,
+;                                       const JQUANT_TBL *quantization_table);
+;
+; The samples are integers (see convsamp_float()), so their sum is exact
+; regardless of the order in which they are added.
+
+; r10 = FAST_FLOAT *data
+; r11 = const JQUANT_TBL *quantization_table (used as a scratch register once
+;       maxovershoot has been computed)
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_preprocess_deringing_float_avx2)
+
+EXTN(jsimd_preprocess_deringing_float_avx2):
+    PROLOGUE
+
+    vmovaps     ymm7, [rel PS_MAXSAMPLE]
+    vxorps      ymm6, ymm6, ymm6                    ; ymm6 = partial sums
+    vpxor       ymm5, ymm5, ymm5                    ; ymm5 = -partial counts
+    xor         eax, eax
+.SUMLOOP:
+    vmovups     ymm0, YMMWORD [data + rax * 4 + 0 * SIZEOF_YMMWORD]
+    vmovups     ymm1, YMMWORD [data + rax * 4 + 1 * SIZEOF_YMMWORD]
+    vaddps      ymm6, ymm6, ymm0
+    vaddps      ymm6, ymm6, ymm1
+    vcmpps      ymm0, ymm0, ymm7, 0x0D              ; data[i] >= maxsample
+    vcmpps      ymm1, ymm1, ymm7, 0x0D
+    vpaddd      ymm5, ymm5, ymm0
+    vpaddd      ymm5, ymm5, ymm1
+    vpackssdw   ymm0, ymm0, ymm1
+    vpermq      ymm0, ymm0, 0xd8
+    vmovdqa     YMMWORD [MASKS + rax * 2], ymm0
+    add         eax, 16
+    cmp         eax, DCTSIZE2
+    jb          .SUMLOOP
+
+    vptest      ymm5, ymm5
+    jz          near .RETURN                        ; no maximum-valued samples
+
+    vextracti128 xmm0, ymm5, 1
+    vpaddd      xmm5, xmm5, xmm0
+    vphaddd     xmm5, xmm5, xmm5
+    vphaddd     xmm5, xmm5, xmm5
+    vmovd       ecx, xmm5
+    neg         ecx                                 ; ecx = maxsample_count
+    cmp         ecx, DCTSIZE2
+    je          near .RETURN                        ; the block is flat
+
+    vextractf128 xmm0, ymm6, 1
+    vaddps      xmm6, xmm6, xmm0
+    vhaddps     xmm6, xmm6, xmm6
+    vhaddps     xmm6, xmm6, xmm6                    ; xmm6 = sum
+
+    ; maxovershoot = maxsample + MIN(MIN(31, 2 * quantval[0]),
+    ;                                (maxsample * size - sum) / maxsample_count)
+    vmovss      xmm0, [rel PS_MAXSUM]
+    vsubss      xmm0, xmm0, xmm6
+    vcvtsi2ss   xmm1, xmm1, ecx
+    vdivss      xmm0, xmm0, xmm1
+    movzx       eax, word [qtbl]                    ; quantval[0]
+    add         eax, eax
+    mov         edx, 31
+    cmp         eax, edx
+    cmovg       eax, edx
+    vcvtsi2ss   xmm1, xmm1, eax
+    vminss      xmm0, xmm1, xmm0
+    vaddss      xmm0, xmm0, [rel PS_MAXSAMPLE]
+    vbroadcastss ymm0, xmm0
+    vmovaps     YMMWORD [MAXOV], ymm0
+
+    ZIGZAG_MASK
+
+.RUNLOOP:
+    NEXT_RUN    .RETURN
+
+    ; fslope = MAX(f1 - f2, maxsample - f1);
+    ; lslope = MAX(l1 - l2, maxsample - l1);
+    EDGE_INDICES
+    vmovss      xmm7, [rel PS_MAXSAMPLE]
+    vmovss      xmm0, DWORD [data + rax * 4]        ; f1
+    vmovss      xmm1, DWORD [data + rcx * 4]        ; f2
+    vmovss      xmm2, DWORD [data + rdx * 4]        ; l1
+    vmovss      xmm3, DWORD [data + r9 * 4]         ; l2
+    vsubss      xmm1, xmm0, xmm1
+    vsubss      xmm0, xmm7, xmm0
+    vmaxss      xmm0, xmm1, xmm0                    ; xmm0 = fslope
+    vsubss      xmm3, xmm2, xmm3
+    vsubss      xmm2, xmm7, xmm2
+    vmaxss      xmm2, xmm3, xmm2                    ; xmm2 = lslope
+    test        startd, startd
+    jnz         .FSLOPE_OK
+    vmovaps     xmm0, xmm2                          ; if (start == 0) fslope = lslope;
+.FSLOPE_OK:
+    cmp         endd, DCTSIZE2
+    jne         .LSLOPE_OK
+    vmovaps     xmm2, xmm0                          ; if (end == size) lslope = fslope;
+.LSLOPE_OK:
+
+    ; catmull_rom() takes its sample values as DCTELEMs, so
+    ; tan1 = (maxsample - (DCTELEM)(maxsample - fslope)) * length and
+    ; tan2 = ((DCTELEM)(maxsample - lslope) - maxsample) * length.
+    vsubss      xmm0, xmm7, xmm0
+    vsubss      xmm2, xmm7, xmm2
+    vcvttss2si  ecx, xmm0
+    vcvttss2si  r9d, xmm2
+    movsx       ecx, cx
+    movsx       r9d, r9w
+    neg         ecx
+    add         ecx, 255 - CENTERJSAMPLE
+    sub         r9d, 255 - CENTERJSAMPLE
+    imul        ecx, lend
+    imul        r9d, lend
+    STORE_TANGENTS ecx, r9d
+    POSITIONS
+
+    xor         eax, eax
+.CURVELOOP:
+    vmovaps     ymm0, YMMWORD [POS + rax * 4]
+    CATMULL_ROM
+    vminps      ymm3, ymm3, YMMWORD [MAXOV]
+    vmovaps     YMMWORD [RES + rax * 4], ymm3
+    add         eax, 8
+    cmp         eax, lend
+    jb          .CURVELOOP
+
+    ; data[jpeg_natural_order[start + i]] = MIN(tmp, maxovershoot);
+    add         start, natural
+    xor         eax, eax
+.STORELOOP:
+    movzx       ecx, byte [start + rax]
+    mov         edx, DWORD [RES + rax * 4]
+    mov         DWORD [data + rcx * 4], edx
+    inc         eax
+    cmp         eax, lend
+    jb          .STORELOOP
+    jmp         .RUNLOOP
+
+.RETURN:
+    EPILOGUE
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
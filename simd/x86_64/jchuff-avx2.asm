@@ -0,0 +1,515 @@
+;
+; jchuff-avx2.asm - Huffman entropy encoding (64-bit AVX2)
+;
+; Copyright (C) 2009-2011, 2014-2016, 2019, 2021, 2023-2024, D. R. Commander.
+; Copyright (C) 2015, Matthieu Darbois.
+; Copyright (C) 2018, Matthias Räncker.
+; Copyright (C) 2023, Aliaksiej Kandracienka.
+; Copyright (C) 2014, Mozilla Corporation.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains an AVX2 implementation for Huffman coding of one block.
+; The following code is based on jchuff.c and jchuff-sse2.asm; see jchuff.c
+; for more details.  It also requires the BMI1, BMI2, and LZCNT instructions:
+; the number of bits in each coefficient is computed with lzcnt rather than
+; looked up in jpeg_nbits_table, and the bit buffer is updated with shlx and
+; bzhi.  The bit buffer has the same layout as in the SSE2 implementation, so
+; the two can be used interchangeably with the same working state.
+
+%include "jsimdext.inc"
+
+struc working_state
+.next_output_byte:   resp 1     ; => next byte to write in buffer
+.free_in_buffer:     resp 1     ; # of byte spaces remaining in buffer
+.cur.put_buffer.simd resq 1     ; current bit accumulation buffer
+.cur.free_bits       resd 1     ; # of bits available in it
+.cur.last_dc_val     resd 4     ; last DC coef for each component
+.cinfo:              resp 1     ; dump_buffer needs access to this
+endstruc
+
+struc c_derived_tbl
+.ehufco:             resd 256   ; code for each symbol
+.ehufsi:             resb 256   ; length of code for each symbol
+; If no code has been allocated for a symbol S, ehufsi[S] contains 0
+endstruc
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+; vpshufb controls that move the coefficients of one row of the block into
+; their positions within a group of 16 coefficients in zigzag order.  The row
+; is broadcast to both 128-bit lanes, so each control selects the elements of
+; the row that belong in the group and zeroes the others.
+
+%define W(col)  (((col) * 2 + 1) << 8 | (col) * 2)
+%define XX      0x8080
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_huff_encode_one_block_avx2)
+
+EXTN(jconst_huff_encode_one_block_avx2):
+
+; Zigzag positions 0-15
+ZZ_0_ROW0  dw W(0), W(1),   XX,   XX,   XX, W(2), W(3),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX, W(4), W(5)
+ZZ_0_ROW1  dw   XX,   XX, W(0),   XX, W(1),   XX,   XX, W(2)
+            dw   XX,   XX,   XX,   XX,   XX, W(3),   XX,   XX
+ZZ_0_ROW2  dw   XX,   XX,   XX, W(0),   XX,   XX,   XX,   XX
+            dw W(1),   XX,   XX,   XX, W(2),   XX,   XX,   XX
+ZZ_0_ROW3  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(0),   XX, W(1),   XX,   XX,   XX,   XX
+ZZ_0_ROW4  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX, W(0),   XX,   XX,   XX,   XX,   XX
+; Zigzag positions 16-31
+ZZ_1_ROW0  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX,   XX, W(6), W(7),   XX,   XX,   XX
+ZZ_1_ROW1  dw W(4),   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX, W(5),   XX,   XX, W(6),   XX,   XX
+ZZ_1_ROW2  dw   XX, W(3),   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(4),   XX,   XX,   XX,   XX, W(5),   XX
+ZZ_1_ROW3  dw   XX,   XX, W(2),   XX,   XX,   XX,   XX,   XX
+            dw W(3),   XX,   XX,   XX,   XX,   XX,   XX, W(4)
+ZZ_1_ROW4  dw   XX,   XX,   XX, W(1),   XX,   XX,   XX, W(2)
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_1_ROW5  dw   XX,   XX,   XX,   XX, W(0),   XX, W(1),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_1_ROW6  dw   XX,   XX,   XX,   XX,   XX, W(0),   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+; Zigzag positions 32-47
+ZZ_2_ROW1  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX,   XX, W(7),   XX,   XX,   XX,   XX,   XX
+ZZ_2_ROW2  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(6),   XX, W(7),   XX,   XX,   XX,   XX
+ZZ_2_ROW3  dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+            dw W(5),   XX,   XX,   XX, W(6),   XX,   XX,   XX
+ZZ_2_ROW4  dw W(3),   XX,   XX,   XX,   XX,   XX,   XX, W(4)
+            dw   XX,   XX,   XX,   XX,   XX, W(5),   XX,   XX
+ZZ_2_ROW5  dw   XX, W(2),   XX,   XX,   XX,   XX, W(3),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX, W(4),   XX
+ZZ_2_ROW6  dw   XX,   XX, W(1),   XX,   XX, W(2),   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX, W(3)
+ZZ_2_ROW7  dw   XX,   XX,   XX, W(0), W(1),   XX,   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+; Zigzag positions 48-63
+ZZ_3_ROW3  dw   XX,   XX,   XX,   XX,   XX, W(7),   XX,   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_3_ROW4  dw   XX,   XX,   XX,   XX, W(6),   XX, W(7),   XX
+            dw   XX,   XX,   XX,   XX,   XX,   XX,   XX,   XX
+ZZ_3_ROW5  dw   XX,   XX,   XX, W(5),   XX,   XX,   XX, W(6)
+            dw   XX,   XX,   XX,   XX, W(7),   XX,   XX,   XX
+ZZ_3_ROW6  dw   XX,   XX, W(4),   XX,   XX,   XX,   XX,   XX
+            dw W(5),   XX,   XX, W(6),   XX, W(7),   XX,   XX
+ZZ_3_ROW7  dw W(2), W(3),   XX,   XX,   XX,   XX,   XX,   XX
+            dw   XX, W(4), W(5),   XX,   XX,   XX, W(6), W(7)
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+; Fill the bit buffer to capacity with the leading bits from code, then output
+; the bit buffer and put the remaining bits from code into the bit buffer.
+;
+; Usage:
+; code - contains the bits to shift into the bit buffer (LSB-aligned)
+; %1 - the label to which to jump when the macro completes
+; %2 (optional) - extra instructions to execute after nbits has been set
+;
+; Upon completion, free_bits will be set to the number of remaining bits from
+; code, and put_buffer will contain those remaining bits.  temp and code will
+; be clobbered.
+;
+; This macro encodes any 0xFF bytes as 0xFF 0x00, as does the EMIT_BYTE()
+; macro in jchuff.c.
+
+%macro EMIT_QWORD 1-2
+    add         nbitsb, free_bitsb      ; nbits += free_bits;
+    neg         free_bitsb              ; free_bits = -free_bits;
+    mov         tempd, code             ; temp = code;
+    shl         put_buffer, nbitsb      ; put_buffer <<= nbits;
+    mov         nbitsb, free_bitsb      ; nbits = free_bits;
+    neg         free_bitsb              ; free_bits = -free_bits;
+    shr         tempd, nbitsb           ; temp >>= nbits;
+    or          tempq, put_buffer       ; temp |= put_buffer;
+    vmovq       xmm0, tempq             ; xmm0.u64 = { temp, 0 };
+    bswap       tempq                   ; temp = htonl(temp);
+    mov         put_buffer, codeq       ; put_buffer = code;
+    vpcmpeqb    xmm0, xmm0, xmm1        ; b0[i] = (b0[i] == 0xFF ? 0xFF : 0);
+    %2
+    vpmovmskb   code, xmm0              ; code = 0;  code |= ((b0[i] >> 7) << i);
+    mov         qword [buffer], tempq   ; memcpy(buffer, &temp, 8);
+                                        ; (speculative; will be overwritten if
+                                        ; code contains any 0xFF bytes)
+    add         free_bitsb, 64          ; free_bits += 64;
+    add         bufferp, 8              ; buffer += 8;
+    test        code, code              ; if (code == 0)  /* No 0xFF bytes */
+    jz          %1                      ;   return;
+    ; Execute the equivalent of the EMIT_BYTE() macro in jchuff.c for all 8
+    ; bytes in the qword.
+    cmp         tempb, 0xFF             ; Set CF if temp[0] < 0xFF
+    mov         byte [buffer-7], 0      ; buffer[-7] = 0;
+    sbb         bufferp, 6              ; buffer -= (6 + (temp[0] < 0xFF ? 1 : 0));
+    mov         byte [buffer], temph    ; buffer[0] = temp[1];
+    cmp         temph, 0xFF             ; Set CF if temp[1] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[1] < 0xFF ? 1 : 0));
+    shr         tempq, 16               ; temp >>= 16;
+    mov         byte [buffer], tempb    ; buffer[0] = temp[0];
+    cmp         tempb, 0xFF             ; Set CF if temp[0] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[0] < 0xFF ? 1 : 0));
+    mov         byte [buffer], temph    ; buffer[0] = temp[1];
+    cmp         temph, 0xFF             ; Set CF if temp[1] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[1] < 0xFF ? 1 : 0));
+    shr         tempq, 16               ; temp >>= 16;
+    mov         byte [buffer], tempb    ; buffer[0] = temp[0];
+    cmp         tempb, 0xFF             ; Set CF if temp[0] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[0] < 0xFF ? 1 : 0));
+    mov         byte [buffer], temph    ; buffer[0] = temp[1];
+    cmp         temph, 0xFF             ; Set CF if temp[1] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[1] < 0xFF ? 1 : 0));
+    shr         tempd, 16               ; temp >>= 16;
+    mov         byte [buffer], tempb    ; buffer[0] = temp[0];
+    cmp         tempb, 0xFF             ; Set CF if temp[0] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[0] < 0xFF ? 1 : 0));
+    mov         byte [buffer], temph    ; buffer[0] = temp[1];
+    cmp         temph, 0xFF             ; Set CF if temp[1] < 0xFF
+    mov         byte [buffer+1], 0      ; buffer[1] = 0;
+    sbb         bufferp, -2             ; buffer -= (-2 + (temp[1] < 0xFF ? 1 : 0));
+    jmp         %1                      ; return;
+%endmacro
+
+; Gather the elements of row %2 that belong in zigzag group %1 (zigzag
+; positions 16 * %1 to 16 * %1 + 15) into ymm0.  ZZ_FIRST must be used for the
+; first row of each group.
+
+%macro ZZ_FIRST 2
+    vbroadcasti128 ymm0, XMMWORD [block + %2 * DCTSIZE * SIZEOF_WORD]
+    vpshufb     ymm0, ymm0, [rel ZZ_%1_ROW%2]
+%endmacro
+
+%macro ZZ_NEXT 2
+    vbroadcasti128 ymm1, XMMWORD [block + %2 * DCTSIZE * SIZEOF_WORD]
+    vpshufb     ymm1, ymm1, [rel ZZ_%1_ROW%2]
+    vpor        ymm0, ymm0, ymm1
+%endmacro
+
+; Store the zigzag group in ymm0 to t[16 * %1], after converting each negative
+; coefficient to its complement minus one (which yields the JPEG
+; representation of its magnitude bits), and set %2 to a mask of the zero
+; coefficients in the group.
+
+%macro ZZ_STORE 2
+    vpsraw      ymm1, ymm0, 15                      ; w1[i] = (w0[i] < 0 ? -1 : 0);
+    vpcmpeqw    %2, ymm0, ymm5                      ; w%2[i] = (w0[i] == 0 ? -1 : 0);
+    vpaddw      ymm0, ymm0, ymm1                    ; w0[i] += w1[i];
+    vmovdqa     YMMWORD [t + %1 * 16 * SIZEOF_WORD], ymm0  ; t[16 * %1 + i] = w0[i];
+%endmacro
+
+;
+; Encode a single block's worth of coefficients.
+;
+; GLOBAL(JOCTET *)
+; jsimd_huff_encode_one_block_avx2(working_state *state, JOCTET *buffer,
+;                                  JCOEFPTR block, int last_dc_val,
+;                                  c_derived_tbl *dctbl, c_derived_tbl *actbl)
+;
+; NOTES:
+; Unlike the SSE2 implementation, which must avoid pinsrw chains, this
+; implementation reorders the block into zigzag order with one vpshufb per
+; (row, group of 16 zigzag positions) pair: each row is broadcast into both
+; lanes of a YMM register, and the shuffles for the same group are ORed
+; together.  The nonzero mask for all 64 coefficients is then built from two
+; vpmovmskb instructions, and the AC coefficients are visited in order by
+; repeatedly extracting the lowest set bit of the mask with tzcnt and blsr.
+;
+; Register allocation
+; rax - buffer
+; rbx - temp
+; rcx - nbits
+; rdx - code
+; rsi - last (zigzag position of the last nonzero coefficient coded)
+; rdi - t
+; r8  - dctbl --> code_temp
+; r9  - actbl
+; r10 - state
+; r11 - index
+; r12 - put_buffer
+; r15 - block --> free_bits
+
+%define buffer       rax
+%ifdef WIN64
+%define bufferp      rax
+%else
+%define bufferp      raxp
+%endif
+%define tempq        rbx
+%define tempd        ebx
+%define tempb        bl
+%define temph        bh
+%define nbitsq       rcx
+%define nbits        ecx
+%define nbitsb       cl
+%define codeq        rdx
+%define code         edx
+%define lastq        rsi
+%define last         esi
+%define t            rdi
+%define dctbl        r8
+%define actbl        r9
+%define state        r10
+%define index        r11
+%define indexd       r11d
+%define put_buffer   r12
+%define put_bufferd  r12d
+%define block        r15
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_huff_encode_one_block_avx2)
+
+EXTN(jsimd_huff_encode_one_block_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    push        r15
+    push        rbx
+    push        r12
+
+%ifdef WIN64
+
+; rcx = working_state *state
+; rdx = JOCTET *buffer
+; r8 = JCOEFPTR block
+; r9 = int last_dc_val
+; [rbp+48] = c_derived_tbl *dctbl
+; [rbp+56] = c_derived_tbl *actbl
+
+    push        rsi
+    push        rdi
+    mov         state, rcx
+    mov         buffer, rdx
+    mov         block, r8
+    movsx       code, word [block]          ; code = block[0];
+    sub         code, r9d                   ; code -= last_dc_val;
+    mov         dctbl, POINTER [rbp+48]
+    mov         actbl, POINTER [rbp+56]
+
+%else
+
+; rdi = working_state *state
+; rsi = JOCTET *buffer
+; rdx = JCOEFPTR block
+; rcx = int last_dc_val
+; r8 = c_derived_tbl *dctbl
+; r9 = c_derived_tbl *actbl
+
+    mov         state, rdi
+    mov         buffer, rsi
+    mov         block, rdx
+    movsx       code, word [block]          ; code = block[0];
+    sub         code, ecx                   ; code -= last_dc_val;
+
+%endif
+
+    ; Allocate stack space for t array, and align it for vmovdqa.
+    sub         rsp, DCTSIZE2 * SIZEOF_WORD
+    and         rsp, -SIZEOF_YMMWORD
+    mov         t, rsp
+
+    ; Step 1: Re-arrange input data according to jpeg_natural_order, and find
+    ; the nonzero coefficients.
+
+    vpxor       ymm5, ymm5, ymm5            ; w5[i] = 0;
+
+    ZZ_FIRST    0, 0
+    ZZ_NEXT     0, 1
+    ZZ_NEXT     0, 2
+    ZZ_NEXT     0, 3
+    ZZ_NEXT     0, 4
+    ZZ_STORE    0, ymm2
+    ZZ_FIRST    1, 0
+    ZZ_NEXT     1, 1
+    ZZ_NEXT     1, 2
+    ZZ_NEXT     1, 3
+    ZZ_NEXT     1, 4
+    ZZ_NEXT     1, 5
+    ZZ_NEXT     1, 6
+    ZZ_STORE    1, ymm3
+    vpacksswb   ymm2, ymm2, ymm3            ; b2 = zero flags for positions
+    vpermq      ymm2, ymm2, 0xd8            ;      0-31 (w/ signed saturation)
+    ZZ_FIRST    2, 1
+    ZZ_NEXT     2, 2
+    ZZ_NEXT     2, 3
+    ZZ_NEXT     2, 4
+    ZZ_NEXT     2, 5
+    ZZ_NEXT     2, 6
+    ZZ_NEXT     2, 7
+    ZZ_STORE    2, ymm3
+    ZZ_FIRST    3, 3
+    ZZ_NEXT     3, 4
+    ZZ_NEXT     3, 5
+    ZZ_NEXT     3, 6
+    ZZ_NEXT     3, 7
+    ZZ_STORE    3, ymm4
+    vpacksswb   ymm3, ymm3, ymm4            ; b3 = zero flags for positions
+    vpermq      ymm3, ymm3, 0xd8            ;      32-63 (w/ signed saturation)
+
+    vpmovmskb   indexd, ymm2                ; index = 0;  index |= ((b2[i] >> 7) << i);
+    vpmovmskb   tempd, ymm3                 ; temp = 0;  temp |= ((b3[i] >> 7) << i);
+    shl         tempq, 32                   ; temp <<= 32;
+    or          index, tempq                ; index |= temp;
+    not         index                       ; index = ~index;
+    btr         index, 0                    ; index &= ~1;  /* Skip the DC coefficient */
+    vpcmpeqb    xmm1, xmm1, xmm1            ; b1[i] = 0xFF;
+
+    ; Step 2: Encode the DC coefficient difference.
+
+%undef block
+%define free_bitsq  r15
+%define free_bitsd  r15d
+%define free_bitsb  r15b
+    mov         tempd, code                 ; temp = code;
+    sar         tempd, 31                   ; temp >>= 31;  /* -1 if code < 0 */
+    add         code, tempd                 ; code += temp;
+    xor         tempd, code                 ; temp ^= code;  /* temp = abs(diff) */
+    lzcnt       tempd, tempd                ; temp = # of leading 0 bits in temp
+    mov         nbits, 32
+    sub         nbits, tempd                ; nbits = JPEG_NBITS(abs(diff));
+    bzhi        code, code, nbits           ; code &= (1 << nbits) - 1;
+    mov         tempd, [dctbl + c_derived_tbl.ehufco + nbitsq * 4]
+                                            ; temp = dctbl->ehufco[nbits];
+    shlx        tempd, tempd, nbits         ; temp <<= nbits;
+    or          code, tempd                 ; code |= temp;
+    add         nbitsb, byte [dctbl + c_derived_tbl.ehufsi + nbitsq]
+                                            ; nbits += dctbl->ehufsi[nbits];
+%undef dctbl
+%define code_temp  r8d
+    mov         free_bitsd, [state + working_state.cur.free_bits]
+                                            ; free_bits = state->cur.free_bits;
+    mov         put_buffer, [state + working_state.cur.put_buffer.simd]
+                                            ; put_buffer = state->cur.put_buffer.simd;
+    xor         last, last                  ; last = 0;
+    sub         free_bitsb, nbitsb          ; if ((free_bits -= nbits) <= 0)
+    jle         .EMIT_CODE                  ;   goto .EMIT_CODE;
+    shlx        put_buffer, put_buffer, nbitsq  ; put_buffer <<= nbits;
+    or          put_buffer, codeq           ; put_buffer |= code;
+    jmp         .BLOOP_COND
+
+    align       16
+.EMIT_CODE:                                 ; .EMIT_CODE:
+    EMIT_QWORD  .BLOOP_COND                 ; insert code, flush buffer, goto .BLOOP_COND
+
+    ; Step 3: Encode the AC coefficients.
+
+; ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    align       16
+.BRLOOP:                                    ; do {
+    lea         code_temp, [nbitsq - 16]    ;   code_temp = nbits - 16;
+    movzx       nbits, byte [actbl + c_derived_tbl.ehufsi + 0xf0]
+                                            ;   nbits = actbl->ehufsi[0xf0];
+    mov         code, [actbl + c_derived_tbl.ehufco + 0xf0 * 4]
+                                            ;   code = actbl->ehufco[0xf0];
+    sub         free_bitsb, nbitsb          ;   if ((free_bits -= nbits) <= 0)
+    jle         .EMIT_BRLOOP_CODE           ;     goto .EMIT_BRLOOP_CODE;
+    shlx        put_buffer, put_buffer, nbitsq  ;   put_buffer <<= nbits;
+    mov         nbits, code_temp            ;   nbits = code_temp;
+    or          put_buffer, codeq           ;   put_buffer |= code;
+    cmp         nbits, 16                   ;   if (nbits <= 16)
+    jle         .ERLOOP                     ;     break;
+    jmp         .BRLOOP                     ; } while (1);
+
+; ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    align       16
+.BLOOP_COND:                                ; .BLOOP_COND:
+    test        index, index                ; if (index != 0)
+    jz          .ELOOP                      ; {
+.BLOOP:                                     ;   do {
+    xor         nbits, nbits                ;     nbits = 0;  /* kill tzcnt input dependency */
+    tzcnt       nbitsq, index               ;     nbits = # of trailing 0 bits in index
+    blsr        index, index                ;     index &= index - 1;
+    mov         tempd, nbits                ;     temp = nbits;
+    sub         nbits, last                 ;     nbits -= last;  /* zero run length + 1 */
+    mov         last, tempd                 ;     last = temp;
+.EMIT_BRLOOP_CODE_END:                      ; .EMIT_BRLOOP_CODE_END:
+    cmp         nbits, 16                   ;     if (nbits > 16)
+    jg          .BRLOOP                     ;       goto .BRLOOP;
+.ERLOOP:                                    ; .ERLOOP:
+    movsx       codeq, word [t + lastq * SIZEOF_WORD]
+                                            ;     code = t[last];
+    mov         tempd, code                 ;     temp = code;
+    sar         tempd, 31                   ;     temp >>= 31;  /* -1 if code < 0 */
+    xor         tempd, code                 ;     temp ^= code;
+    lzcnt       tempd, tempd                ;     temp = # of leading 0 bits in temp
+    shl         nbits, 4                    ;     nbits <<= 4;
+    neg         tempd                       ;     temp = 32 - temp;
+    add         tempd, 32                   ;     /* temp = JPEG_NBITS(coef) */
+    add         nbits, tempd                ;     nbits += temp;  /* symbol + 16 */
+    bzhi        code, code, tempd           ;     code &= (1 << temp) - 1;
+    mov         code_temp, [actbl + c_derived_tbl.ehufco + (nbitsq - 16) * 4]
+                                            ;     code_temp = actbl->ehufco[nbits - 16];
+    shlx        code_temp, code_temp, tempd ;     code_temp <<= temp;
+    movzx       nbits, byte [actbl + c_derived_tbl.ehufsi + nbitsq - 16]
+                                            ;     nbits = actbl->ehufsi[nbits - 16];
+    or          code, code_temp             ;     code |= code_temp;
+    add         nbits, tempd                ;     nbits += temp;
+    sub         free_bitsb, nbitsb          ;     if ((free_bits -= nbits) <= 0)
+    jle         .EMIT_CODE                  ;       goto .EMIT_CODE;
+    shlx        put_buffer, put_buffer, nbitsq  ;     put_buffer <<= nbits;
+    or          put_buffer, codeq           ;     put_buffer |= code;
+    test        index, index
+    jnz         .BLOOP                      ;   } while (index != 0);
+.ELOOP:                                     ; }  /* index != 0 */
+    cmp         last, DCTSIZE2 - 1          ; if (last != 63)
+    je          .EFN                        ; {
+    movzx       nbits, byte [actbl + c_derived_tbl.ehufsi + 0]
+                                            ;   nbits = actbl->ehufsi[0];
+    mov         code, [actbl + c_derived_tbl.ehufco + 0]  ;   code = actbl->ehufco[0];
+    sub         free_bitsb, nbitsb          ;   if ((free_bits -= nbits) <= 0)
+    jg          .EFN_SKIP_EMIT_CODE         ;   {
+    EMIT_QWORD  .EFN                        ;     insert code, flush buffer
+    align       16
+.EFN_SKIP_EMIT_CODE:                        ;   } else {
+    shlx        put_buffer, put_buffer, nbitsq  ;     put_buffer <<= nbits;
+    or          put_buffer, codeq           ;     put_buffer |= code;
+.EFN:                                       ; } }
+    mov         [state + working_state.cur.put_buffer.simd], put_buffer
+                                            ; state->cur.put_buffer.simd = put_buffer;
+    mov         byte [state + working_state.cur.free_bits], free_bitsb
+                                            ; state->cur.free_bits = free_bits;
+    vzeroupper
+%ifdef WIN64
+    lea         rsp, [rbp - 5 * SIZEOF_POINTER]
+    pop         rdi
+    pop         rsi
+%else
+    lea         rsp, [rbp - 3 * SIZEOF_POINTER]
+%endif
+    pop         r12
+    pop         rbx
+    pop         r15
+    pop         rbp
+    ret
+
+; ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    align       16
+.EMIT_BRLOOP_CODE:
+    EMIT_QWORD  .EMIT_BRLOOP_CODE_END, { mov nbits, code_temp }
+                                            ; insert code, flush buffer,
+                                            ; nbits = code_temp, goto .EMIT_BRLOOP_CODE_END
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -0,0 +1,328 @@
+;
+; jcphuff-avx2.asm - prepare data for progressive Huffman encoding
+; (64-bit AVX2)
+;
+; Copyright (C) 2016, 2018, Matthieu Darbois
+; Copyright (C) 2023, Aliaksiej Kandracienka.
+; Copyright (C) 2024, D. R. Commander.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains an AVX2 implementation of data preparation for
+; progressive Huffman encoding.  See jcphuff.c for more details.  The results
+; are identical to those of the SSE2 implementation, but 32 coefficients are
+; processed at a time: the coefficients are fetched in zigzag order with masked
+; gathers, and the bitmaps are built with a single vpmovmskb per half-block.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_encode_mcu_AC_prepare_avx2)
+
+EXTN(jconst_encode_mcu_AC_prepare_avx2):
+
+PD_LANE     dd  0,  1,  2,  3,  4,  5,  6,  7
+            dd  8,  9, 10, 11, 12, 13, 14, 15
+            dd 16, 17, 18, 19, 20, 21, 22, 23
+            dd 24, 25, 26, 27, 28, 29, 30, 31
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+; --------------------------------------------------------------------------
+; Macros to load data for jsimd_encode_mcu_AC_first_prepare_avx2() and
+; jsimd_encode_mcu_AC_refine_prepare_avx2()
+
+; Gather the eight coefficients block[LUT[8*j]] ... block[LUT[8*j + 7]] into
+; the doublewords of %1 (j = %2).  Lanes at or beyond the end of the spectral
+; band (REM = Sl - k) are neither read from LUT nor from the block, so they
+; are left at zero.  Since Ss >= 1, every natural-order index is at least 1,
+; and the doubleword at BLOCK + (index - 1) * 2 holds the coefficient in its
+; upper word without reading outside of the block.
+;
+; ymm4 and ymm5 are clobbered.
+
+%macro GATHER8 2
+    vpcmpgtd    ymm4, REM, [rel PD_LANE + (%2) * SIZEOF_YMMWORD]
+    vpmaskmovd  ymm5, ymm4, [LUT + (%2) * 8 * SIZEOF_INT]
+    vpxor       %1, %1, %1
+    vpgatherdd  %1, [BLOCK - 2 + ymm5 * 2], ymm4
+%endmacro
+
+; Load 32 coefficients and compute X0/X1 = abs(coef) >> Al (coefficients 0-15
+; and 16-31) and N0/N1 = 0 for positive coefficients and -1 for negative ones.
+; Groups of eight that lie entirely beyond the end of the band are not
+; gathered at all.
+
+%macro LOAD32 0
+    GATHER8     ymm0, 0
+    vpxor       ymm1, ymm1, ymm1
+    vpxor       ymm2, ymm2, ymm2
+    vpxor       ymm3, ymm3, ymm3
+    cmp         LEN, 8
+    jle         %%.GATHERED
+    GATHER8     ymm1, 1
+    cmp         LEN, 16
+    jle         %%.GATHERED
+    GATHER8     ymm2, 2
+    cmp         LEN, 24
+    jle         %%.GATHERED
+    GATHER8     ymm3, 3
+%%.GATHERED:
+
+    vpsrad      ymm0, ymm0, 16
+    vpsrad      ymm1, ymm1, 16
+    vpsrad      ymm2, ymm2, 16
+    vpsrad      ymm3, ymm3, 16
+    vpackssdw   X0, ymm0, ymm1
+    vpackssdw   X1, ymm2, ymm3
+    vpermq      X0, X0, 0xd8            ; X0=(00 01 .. 15)
+    vpermq      X1, X1, 0xd8            ; X1=(16 17 .. 31)
+
+    vpsraw      N0, X0, 15
+    vpsraw      N1, X1, 15
+    vpabsw      X0, X0
+    vpabsw      X1, X1
+    vpsrlw      X0, X0, AL
+    vpsrlw      X1, X1, AL
+%endmacro
+
+; Pack X0/X1 into one byte per coefficient in ymm4.  Saturation preserves
+; both zero and one, so the bytes can be compared instead of the words.
+
+%macro PACK32 0
+    vpacksswb   ymm4, X0, X1
+    vpermq      ymm4, ymm4, 0xd8
+%endmacro
+
+;
+; Prepare data for jsimd_encode_mcu_AC_first().
+;
+; GLOBAL(void)
+; jsimd_encode_mcu_AC_first_prepare_avx2(const JCOEF *block,
+;                                        const int *jpeg_natural_order_start,
+;                                        int Sl, int Al, JCOEF *values,
+;                                        size_t *zerobits)
+;
+; r10 = const JCOEF *block
+; r11 = const int *jpeg_natural_order_start
+; r12 = int Sl
+; r13 = int Al
+; r14 = JCOEF *values
+; r15 = size_t *zerobits
+
+%define ZERO    ymm8
+%define X0      ymm0
+%define X1      ymm2
+%define N0      ymm1
+%define N1      ymm3
+%define AL      xmm6
+%define REM     ymm7
+%define LUT     r11
+%define BLOCK   r10
+%define VALUES  r14
+%define LEN     r12d
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_encode_mcu_AC_first_prepare_avx2)
+
+EXTN(jsimd_encode_mcu_AC_first_prepare_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    1
+    COLLECT_ARGS 6
+
+    vmovd       AL, r13d
+    vmovd       xmm7, LEN
+    vpbroadcastd REM, xmm7
+    vpxor       ZERO, ZERO, ZERO
+
+    LOAD32
+    vpxor       N0, N0, X0
+    vpxor       N1, N1, X1
+    vmovdqu     YMMWORD [VALUES + (0) * 2], X0
+    vmovdqu     YMMWORD [VALUES + (16) * 2], X1
+    vmovdqu     YMMWORD [VALUES + (0 + DCTSIZE2) * 2], N0
+    vmovdqu     YMMWORD [VALUES + (16 + DCTSIZE2) * 2], N1
+    PACK32
+    vpcmpeqb    ymm4, ymm4, ZERO
+    vpmovmskb   eax, ymm4
+
+    mov         ecx, -1
+    cmp         LEN, 32
+    jg          .SECOND
+    vmovdqu     YMMWORD [VALUES + (32) * 2], ZERO
+    vmovdqu     YMMWORD [VALUES + (48) * 2], ZERO
+    jmp         .REDUCE
+.SECOND:
+    sub         LEN, 32
+    add         LUT, 32*SIZEOF_INT
+    vmovd       xmm7, LEN
+    vpbroadcastd REM, xmm7
+
+    LOAD32
+    vpxor       N0, N0, X0
+    vpxor       N1, N1, X1
+    vmovdqu     YMMWORD [VALUES + (32) * 2], X0
+    vmovdqu     YMMWORD [VALUES + (48) * 2], X1
+    vmovdqu     YMMWORD [VALUES + (32 + DCTSIZE2) * 2], N0
+    vmovdqu     YMMWORD [VALUES + (48 + DCTSIZE2) * 2], N1
+    PACK32
+    vpcmpeqb    ymm4, ymm4, ZERO
+    vpmovmskb   ecx, ymm4
+.REDUCE:
+    shl         rcx, 32
+    or          rax, rcx
+    not         rax
+    mov         MMWORD [r15], rax
+
+    vzeroupper
+    UNCOLLECT_ARGS 6
+    POP_XMM     1
+    pop         rbp
+    ret
+
+%undef ZERO
+%undef X0
+%undef X1
+%undef N0
+%undef N1
+%undef AL
+%undef REM
+%undef LUT
+%undef BLOCK
+%undef VALUES
+%undef LEN
+
+;
+; Prepare data for jsimd_encode_mcu_AC_refine().
+;
+; GLOBAL(int)
+; jsimd_encode_mcu_AC_refine_prepare_avx2(const JCOEF *block,
+;                                         const int *jpeg_natural_order_start,
+;                                         int Sl, int Al, JCOEF *absvalues,
+;                                         size_t *bits)
+;
+; r10 = const JCOEF *block
+; r11 = const int *jpeg_natural_order_start
+; r12 = int Sl
+; r13 = int Al
+; r14 = JCOEF *values
+; r15 = size_t *bits
+
+%define ZERO    ymm8
+%define ONE     ymm9
+%define X0      ymm0
+%define X1      ymm2
+%define N0      ymm1
+%define N1      ymm3
+%define AL      xmm6
+%define REM     ymm7
+%define LUT     r11
+%define BLOCK   r10
+%define VALUES  r14
+%define LEN     r12d
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_encode_mcu_AC_refine_prepare_avx2)
+
+EXTN(jsimd_encode_mcu_AC_refine_prepare_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    2
+    COLLECT_ARGS 6
+
+    vmovd       AL, r13d
+    vmovd       xmm7, LEN
+    vpbroadcastd REM, xmm7
+    vpxor       ZERO, ZERO, ZERO
+    vpcmpeqb    ONE, ONE, ONE
+    vpabsb      ONE, ONE
+
+    LOAD32
+    vmovdqu     YMMWORD [VALUES + (0) * 2], X0
+    vmovdqu     YMMWORD [VALUES + (16) * 2], X1
+    vpacksswb   N0, N0, N1
+    vpermq      N0, N0, 0xd8
+    vpmovmskb   edx, N0                 ; edx=negative coefficients
+    PACK32
+    vpcmpeqb    ymm5, ymm4, ZERO
+    vpcmpeqb    ymm4, ymm4, ONE
+    vpmovmskb   eax, ymm5               ; eax=zero coefficients
+    vpmovmskb   edi, ymm4               ; edi=coefficients with abs value 1
+
+    mov         ecx, -1
+    xor         r8d, r8d
+    xor         esi, esi
+    cmp         LEN, 32
+    jg          .SECONDR
+    vmovdqu     YMMWORD [VALUES + (32) * 2], ZERO
+    vmovdqu     YMMWORD [VALUES + (48) * 2], ZERO
+    jmp         .REDUCER
+.SECONDR:
+    sub         LEN, 32
+    add         LUT, 32*SIZEOF_INT
+    vmovd       xmm7, LEN
+    vpbroadcastd REM, xmm7
+
+    LOAD32
+    vmovdqu     YMMWORD [VALUES + (32) * 2], X0
+    vmovdqu     YMMWORD [VALUES + (48) * 2], X1
+    vpacksswb   N0, N0, N1
+    vpermq      N0, N0, 0xd8
+    vpmovmskb   r8d, N0
+    PACK32
+    vpcmpeqb    ymm5, ymm4, ZERO
+    vpcmpeqb    ymm4, ymm4, ONE
+    vpmovmskb   ecx, ymm5
+    vpmovmskb   esi, ymm4
+.REDUCER:
+    shl         rcx, 32
+    shl         r8, 32
+    shl         rsi, 32
+    or          rax, rcx
+    or          rdx, r8
+    or          rsi, rdi
+    not         rax
+    not         rdx
+    mov         MMWORD [r15], rax
+    mov         MMWORD [r15+SIZEOF_MMWORD], rdx
+
+    xor         eax, eax
+    bsr         rsi, rsi                ; EOB = index of last coef with abs 1
+    cmovnz      eax, esi
+
+    vzeroupper
+    UNCOLLECT_ARGS 6
+    POP_XMM     2
+    pop         rbp
+    ret
+
+%undef ZERO
+%undef ONE
+%undef X0
+%undef X1
+%undef N0
+%undef N1
+%undef AL
+%undef REM
+%undef LUT
+%undef BLOCK
+%undef VALUES
+%undef LEN
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -358,6 +358,429 @@ EXTN(jsimd_h2v2_downsample_avx2):
     pop         rbp
     ret
 
+; --------------------------------------------------------------------------
+;
+; Downsample pixel values of a single component.
+; This version handles the standard case of 2:1 horizontal and 2:1 vertical,
+; with smoothing.  One row of context is required.
+;
+; GLOBAL(void)
+; jsimd_h2v2_smooth_downsample_avx2(JDIMENSION image_width,
+;                                   int max_v_samp_factor,
+;                                   int smoothing_factor,
+;                                   JDIMENSION width_in_blocks,
+;                                   JSAMPARRAY input_data,
+;                                   JSAMPARRAY output_data);
+;
+; (The component's v_samp_factor is always max_v_samp_factor / 2.)
+;
+
+; r10d = JDIMENSION image_width
+; r11 = int max_v_samp_factor
+; r12d = int smoothing_factor
+; r13d = JDIMENSION width_in_blocks
+; r14 = JSAMPARRAY input_data
+; r15 = JSAMPARRAY output_data
+
+; Compute eax = 2 * (inptr0[rdx] + inptr1[rdx]) + above_ptr[rdx] +
+; below_ptr[rdx], the weighted column sum of the input samples in column rdx.
+; (The weighted column sums of the two columns adjacent to an output sample
+; contribute to its neighbor sum.)
+
+%macro H2V2_COLSUM 0
+    movzx       eax, JSAMPLE [r9+rdx]
+    movzx       ebx, JSAMPLE [r10+rdx]
+    add         eax, ebx
+    add         eax, eax
+    movzx       ebx, JSAMPLE [r8+rdx]
+    add         eax, ebx
+    movzx       ebx, JSAMPLE [r11+rdx]
+    add         eax, ebx
+%endmacro
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_h2v2_smooth_downsample_avx2)
+
+EXTN(jsimd_h2v2_smooth_downsample_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    2
+    COLLECT_ARGS 6
+    push        rbx
+
+    mov         ecx, r13d
+    shl         rcx, 4                  ; rcx = output_cols * 2
+    jz          near .return
+
+    ; Round output_cols * 2 up to a whole number of YMMWORDs.  The sample rows
+    ; are padded to a multiple of 2 * ALIGN_SIZE samples, so the extra columns
+    ; can be filled in by expand_right_edge and read back by the main loop.
+    add         rcx, byte SIZEOF_YMMWORD-1
+    and         rcx, byte -SIZEOF_YMMWORD
+
+    mov         edx, r10d
+
+    ; -- expand_right_edge (max_v_samp_factor + 2 rows, from input_data[-1])
+
+    push        rcx
+    sub         rcx, rdx
+    jle         short .expand_end
+
+    mov         rax, r11
+    add         rax, byte 2
+
+    cld
+    lea         rsi, [r14-SIZEOF_JSAMPROW]  ; input_data - 1
+.expandloop:
+    push        rax
+    push        rcx
+
+    mov         rdip, JSAMPROW [rsi]
+    add         rdi, rdx
+    mov         al, JSAMPLE [rdi-1]
+
+    rep stosb
+
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_JSAMPROW
+    dec         rax
+    jg          short .expandloop
+
+.expand_end:
+    pop         rcx                     ; output_cols * 2, rounded up
+
+    ; -- h2v2_smooth_downsample
+
+    mov         eax, r12d
+    imul        eax, eax, 16            ; neighscale = smoothing_factor * 16
+    shl         eax, WORD_BIT
+    imul        edx, r12d, -80
+    add         edx, 16384              ; memberscale = 16384 - smoothing_factor * 80
+    or          eax, edx
+    vmovd       xmm6, eax
+    vpbroadcastd ymm6, xmm6             ; ymm6={memberscale, neighscale, ..}
+    vpcmpeqw    ymm7, ymm7, ymm7
+    vpsrlw      ymm7, ymm7, BYTE_BIT    ; ymm7={0xFF 0x00 0xFF 0x00 ..}
+    vpcmpeqd    ymm8, ymm8, ymm8
+    vpsrld      ymm8, ymm8, 31
+    vpslld      ymm8, ymm8, 15          ; ymm8={32768 x 8}
+
+    mov         rax, r11
+    shr         rax, 1                  ; rowctr = v_samp_factor
+    test        rax, rax
+    jle         near .return
+
+    mov         rsi, r14                ; input_data
+    mov         rdi, r15                ; output_data
+.rowloop:
+    push        rax
+    push        rcx
+    push        rdi
+    push        rsi
+
+    mov         r8p, JSAMPROW [rsi-1*SIZEOF_JSAMPROW]  ; above_ptr
+    mov         r9p, JSAMPROW [rsi+0*SIZEOF_JSAMPROW]  ; inptr0
+    mov         r10p, JSAMPROW [rsi+1*SIZEOF_JSAMPROW] ; inptr1
+    mov         r11p, JSAMPROW [rsi+2*SIZEOF_JSAMPROW] ; below_ptr
+    mov         rdip, JSAMPROW [rdi]                   ; outptr
+
+    ; First column: pretend column -1 is the same as column 0.
+    xor         edx, edx
+    H2V2_COLSUM
+    vmovd       xmm9, eax
+    vpslldq     xmm9, xmm9, 14
+    vperm2i128  ymm9, ymm9, ymm9, 0x00  ; ymm9.hi=(-- .. -- colsum[-1])
+
+.columnloop:
+    ; The column to the right of this chunk, or the last column if there
+    ; isn't one
+    xor         edx, edx
+    cmp         rcx, byte SIZEOF_YMMWORD
+    seta        dl
+    add         edx, byte SIZEOF_YMMWORD-1
+    H2V2_COLSUM
+
+    vmovdqu     ymm0, YMMWORD [r9]      ; ymm0=inptr0
+    vmovdqu     ymm1, YMMWORD [r10]     ; ymm1=inptr1
+    vmovdqu     ymm4, YMMWORD [r8]      ; ymm4=above_ptr
+    vmovdqu     ymm5, YMMWORD [r11]     ; ymm5=below_ptr
+
+    vpsrlw      ymm2, ymm0, BYTE_BIT
+    vpsrlw      ymm3, ymm1, BYTE_BIT
+    vpand       ymm0, ymm0, ymm7
+    vpand       ymm1, ymm1, ymm7
+    vpaddw      ymm0, ymm0, ymm1        ; ymm0=member rows, even columns
+    vpaddw      ymm2, ymm2, ymm3        ; ymm2=member rows, odd columns
+
+    vpand       ymm1, ymm4, ymm7
+    vpand       ymm3, ymm5, ymm7
+    vpsrlw      ymm4, ymm4, BYTE_BIT
+    vpsrlw      ymm5, ymm5, BYTE_BIT
+    vpaddw      ymm1, ymm1, ymm3        ; ymm1=neighbor rows, even columns
+    vpaddw      ymm4, ymm4, ymm5        ; ymm4=neighbor rows, odd columns
+
+    vpaddw      ymm3, ymm0, ymm2        ; ymm3=membersum
+    vpaddw      ymm5, ymm1, ymm4
+    vpaddw      ymm5, ymm5, ymm5        ; ymm5=2*(edge-neighbors above and below)
+
+    vpaddw      ymm0, ymm0, ymm0
+    vpaddw      ymm0, ymm0, ymm1        ; ymm0=colsum[2*j]
+    vpaddw      ymm2, ymm2, ymm2
+    vpaddw      ymm2, ymm2, ymm4        ; ymm2=colsum[2*j+1]
+
+    vperm2i128  ymm1, ymm2, ymm9, 0x03
+    vpalignr    ymm1, ymm2, ymm1, 14    ; ymm1=colsum[2*j-1]
+    vmovdqa     ymm9, ymm2
+
+    vmovd       xmm4, eax
+    vperm2i128  ymm4, ymm0, ymm4, 0x21
+    vpalignr    ymm0, ymm4, ymm0, 2     ; ymm0=colsum[2*j+2]
+
+    vpaddw      ymm5, ymm5, ymm1
+    vpaddw      ymm5, ymm5, ymm0        ; ymm5=neighsum
+
+    vpunpcklwd  ymm0, ymm3, ymm5
+    vpunpckhwd  ymm3, ymm3, ymm5
+    vpmaddwd    ymm0, ymm0, ymm6
+    vpmaddwd    ymm3, ymm3, ymm6
+    vpaddd      ymm0, ymm0, ymm8
+    vpaddd      ymm3, ymm3, ymm8
+    vpsrld      ymm0, ymm0, 16
+    vpsrld      ymm3, ymm3, 16
+    vpackssdw   ymm0, ymm0, ymm3
+    vpackuswb   ymm0, ymm0, ymm0
+    vpermq      ymm0, ymm0, 0x08
+
+    vmovdqu     XMMWORD [rdi], xmm0
+
+    add         r8, byte SIZEOF_YMMWORD     ; above_ptr
+    add         r9, byte SIZEOF_YMMWORD     ; inptr0
+    add         r10, byte SIZEOF_YMMWORD    ; inptr1
+    add         r11, byte SIZEOF_YMMWORD    ; below_ptr
+    add         rdi, byte SIZEOF_YMMWORD/2  ; outptr
+    sub         rcx, byte SIZEOF_YMMWORD
+    jnz         near .columnloop
+
+    pop         rsi
+    pop         rdi
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte 2*SIZEOF_JSAMPROW  ; input_data
+    add         rdi, byte 1*SIZEOF_JSAMPROW  ; output_data
+    dec         rax                          ; rowctr
+    jg          near .rowloop
+
+.return:
+    vzeroupper
+    pop         rbx
+    UNCOLLECT_ARGS 6
+    POP_XMM     2
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Downsample pixel values of a single component.
+; This version handles the special case of a full-size component,
+; with smoothing.  One row of context is required.
+;
+; GLOBAL(void)
+; jsimd_fullsize_smooth_downsample_avx2(JDIMENSION image_width,
+;                                       int max_v_samp_factor,
+;                                       int smoothing_factor,
+;                                       JDIMENSION width_in_blocks,
+;                                       JSAMPARRAY input_data,
+;                                       JSAMPARRAY output_data);
+;
+; (The component's v_samp_factor is always max_v_samp_factor.)
+;
+
+; r10d = JDIMENSION image_width
+; r11 = int max_v_samp_factor
+; r12d = int smoothing_factor
+; r13d = JDIMENSION width_in_blocks
+; r14 = JSAMPARRAY input_data
+; r15 = JSAMPARRAY output_data
+
+; Compute eax = inptr[rdx] + above_ptr[rdx] + below_ptr[rdx], the sum of the
+; input samples in column rdx.
+
+%macro FULLSIZE_COLSUM 0
+    movzx       eax, JSAMPLE [r9+rdx]
+    movzx       ebx, JSAMPLE [r8+rdx]
+    add         eax, ebx
+    movzx       ebx, JSAMPLE [r11+rdx]
+    add         eax, ebx
+%endmacro
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_fullsize_smooth_downsample_avx2)
+
+EXTN(jsimd_fullsize_smooth_downsample_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 6
+    push        rbx
+
+    mov         ecx, r13d
+    shl         rcx, 3                  ; imul rcx,DCTSIZE (rcx = output_cols)
+    jz          near .return
+
+    ; Round output_cols up to a whole number of YMMWORDs.  The sample rows are
+    ; padded to a multiple of 2 * ALIGN_SIZE samples, so the extra columns
+    ; can be filled in by expand_right_edge and read back by the main loop.
+    add         rcx, byte SIZEOF_YMMWORD-1
+    and         rcx, byte -SIZEOF_YMMWORD
+
+    mov         edx, r10d
+
+    ; -- expand_right_edge (max_v_samp_factor + 2 rows, from input_data[-1])
+
+    push        rcx
+    sub         rcx, rdx
+    jle         short .expand_end
+
+    mov         rax, r11
+    add         rax, byte 2
+
+    cld
+    lea         rsi, [r14-SIZEOF_JSAMPROW]  ; input_data - 1
+.expandloop:
+    push        rax
+    push        rcx
+
+    mov         rdip, JSAMPROW [rsi]
+    add         rdi, rdx
+    mov         al, JSAMPLE [rdi-1]
+
+    rep stosb
+
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_JSAMPROW
+    dec         rax
+    jg          short .expandloop
+
+.expand_end:
+    pop         rcx                     ; output_cols, rounded up
+
+    ; -- fullsize_smooth_downsample
+
+    ; Since memberscale + 8 * neighscale = 65536, the output is
+    ; member + descale(neighscale * (neighsum - 8 * member), 16), which
+    ; vpmulhrsw computes directly when given neighscale / 2.
+
+    mov         eax, r12d
+    shl         eax, 5                  ; neighscale / 2 = smoothing_factor * 32
+    vmovd       xmm6, eax
+    vpbroadcastw ymm6, xmm6             ; ymm6={neighscale / 2 x 16}
+
+    mov         rax, r11                ; rowctr
+    test        rax, rax
+    jle         near .return
+
+    mov         rsi, r14                ; input_data
+    mov         rdi, r15                ; output_data
+.rowloop:
+    push        rax
+    push        rcx
+    push        rdi
+    push        rsi
+
+    mov         r8p, JSAMPROW [rsi-1*SIZEOF_JSAMPROW]  ; above_ptr
+    mov         r9p, JSAMPROW [rsi+0*SIZEOF_JSAMPROW]  ; inptr
+    mov         r11p, JSAMPROW [rsi+1*SIZEOF_JSAMPROW] ; below_ptr
+    mov         rdip, JSAMPROW [rdi]                   ; outptr
+
+    ; First column: pretend column -1 is the same as column 0.
+    xor         edx, edx
+    FULLSIZE_COLSUM
+    vmovd       xmm7, eax
+    vpslldq     xmm7, xmm7, 14
+    vperm2i128  ymm7, ymm7, ymm7, 0x00  ; ymm7.hi=(-- .. -- colsum[-1])
+
+.columnloop:
+    ; The column to the right of this chunk, or the last column if there
+    ; isn't one
+    xor         edx, edx
+    cmp         rcx, byte SIZEOF_YMMWORD
+    seta        dl
+    add         edx, byte SIZEOF_YMMWORD-1
+    FULLSIZE_COLSUM
+
+    vpmovzxbw   ymm0, XMMWORD [r9]                    ; ymm0=inptr (0 .. 15)
+    vpmovzxbw   ymm1, XMMWORD [r9+SIZEOF_XMMWORD]     ; ymm1=inptr (16 .. 31)
+    vpmovzxbw   ymm2, XMMWORD [r8]
+    vpmovzxbw   ymm3, XMMWORD [r8+SIZEOF_XMMWORD]
+    vpmovzxbw   ymm4, XMMWORD [r11]
+    vpmovzxbw   ymm5, XMMWORD [r11+SIZEOF_XMMWORD]
+    vpaddw      ymm2, ymm2, ymm4
+    vpaddw      ymm3, ymm3, ymm5
+    vpaddw      ymm2, ymm2, ymm0        ; ymm2=colsum (0 .. 15)
+    vpaddw      ymm3, ymm3, ymm1        ; ymm3=colsum (16 .. 31)
+
+    vperm2i128  ymm4, ymm2, ymm7, 0x03
+    vpalignr    ymm4, ymm2, ymm4, 14    ; ymm4=colsum (-1 .. 14)
+    vperm2i128  ymm5, ymm2, ymm3, 0x21
+    vpalignr    ymm5, ymm5, ymm2, 2     ; ymm5=colsum (1 .. 16)
+    vpaddw      ymm4, ymm4, ymm5
+    vpaddw      ymm4, ymm4, ymm2        ; ymm4=neighsum+member (0 .. 15)
+
+    vperm2i128  ymm5, ymm3, ymm2, 0x03
+    vpalignr    ymm5, ymm3, ymm5, 14    ; ymm5=colsum (15 .. 30)
+    vmovd       xmm7, eax
+    vperm2i128  ymm7, ymm3, ymm7, 0x21
+    vpalignr    ymm7, ymm7, ymm3, 2     ; ymm7=colsum (17 .. 32)
+    vpaddw      ymm5, ymm5, ymm7
+    vpaddw      ymm5, ymm5, ymm3        ; ymm5=neighsum+member (16 .. 31)
+    vmovdqa     ymm7, ymm3
+
+    vpsllw      ymm2, ymm0, 3
+    vpsllw      ymm3, ymm1, 3
+    vpaddw      ymm2, ymm2, ymm0
+    vpaddw      ymm3, ymm3, ymm1
+    vpsubw      ymm4, ymm4, ymm2        ; ymm4=neighsum-8*member (0 .. 15)
+    vpsubw      ymm5, ymm5, ymm3        ; ymm5=neighsum-8*member (16 .. 31)
+
+    vpmulhrsw   ymm4, ymm4, ymm6
+    vpmulhrsw   ymm5, ymm5, ymm6
+    vpaddw      ymm0, ymm0, ymm4
+    vpaddw      ymm1, ymm1, ymm5
+    vpackuswb   ymm0, ymm0, ymm1
+    vpermq      ymm0, ymm0, 0xd8
+
+    vmovdqu     YMMWORD [rdi], ymm0
+
+    add         r8, byte SIZEOF_YMMWORD     ; above_ptr
+    add         r9, byte SIZEOF_YMMWORD     ; inptr
+    add         r11, byte SIZEOF_YMMWORD    ; below_ptr
+    add         rdi, byte SIZEOF_YMMWORD    ; outptr
+    sub         rcx, byte SIZEOF_YMMWORD
+    jnz         near .columnloop
+
+    pop         rsi
+    pop         rdi
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_JSAMPROW  ; input_data
+    add         rdi, byte SIZEOF_JSAMPROW  ; output_data
+    dec         rax                        ; rowctr
+    jg          near .rowloop
+
+.return:
+    vzeroupper
+    pop         rbx
+    UNCOLLECT_ARGS 6
+    pop         rbp
+    ret
+
 ; For some reason, the OS X linker does not honor the request to align the
 ; segment unless we do this.
     align       32
@@ -321,6 +321,467 @@ EXTN(jsimd_h2v2_downsample_sse2):
     pop         rbp
     ret
 
+; --------------------------------------------------------------------------
+;
+; Downsample pixel values of a single component.
+; This version handles the standard case of 2:1 horizontal and 2:1 vertical,
+; with smoothing.  One row of context is required.
+;
+; GLOBAL(void)
+; jsimd_h2v2_smooth_downsample_sse2(JDIMENSION image_width,
+;                                   int max_v_samp_factor,
+;                                   int smoothing_factor,
+;                                   JDIMENSION width_in_blocks,
+;                                   JSAMPARRAY input_data,
+;                                   JSAMPARRAY output_data);
+;
+; (The component's v_samp_factor is always max_v_samp_factor / 2.)
+;
+
+; r10d = JDIMENSION image_width
+; r11 = int max_v_samp_factor
+; r12d = int smoothing_factor
+; r13d = JDIMENSION width_in_blocks
+; r14 = JSAMPARRAY input_data
+; r15 = JSAMPARRAY output_data
+
+; Compute eax = 2 * (inptr0[rdx] + inptr1[rdx]) + above_ptr[rdx] +
+; below_ptr[rdx], the weighted column sum of the input samples in column rdx.
+; (The weighted column sums of the two columns adjacent to an output sample
+; contribute to its neighbor sum.)
+
+%macro H2V2_COLSUM 0
+    movzx       eax, JSAMPLE [r9+rdx]
+    movzx       ebx, JSAMPLE [r10+rdx]
+    add         eax, ebx
+    add         eax, eax
+    movzx       ebx, JSAMPLE [r8+rdx]
+    add         eax, ebx
+    movzx       ebx, JSAMPLE [r11+rdx]
+    add         eax, ebx
+%endmacro
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_h2v2_smooth_downsample_sse2)
+
+EXTN(jsimd_h2v2_smooth_downsample_sse2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    2
+    COLLECT_ARGS 6
+    push        rbx
+
+    mov         ecx, r13d
+    shl         rcx, 4                  ; rcx = output_cols * 2
+    jz          near .return
+
+    mov         edx, r10d
+
+    ; -- expand_right_edge (max_v_samp_factor + 2 rows, from input_data[-1])
+
+    push        rcx
+    sub         rcx, rdx
+    jle         short .expand_end
+
+    mov         rax, r11
+    add         rax, byte 2
+
+    cld
+    lea         rsi, [r14-SIZEOF_JSAMPROW]  ; input_data - 1
+.expandloop:
+    push        rax
+    push        rcx
+
+    mov         rdip, JSAMPROW [rsi]
+    add         rdi, rdx
+    mov         al, JSAMPLE [rdi-1]
+
+    rep stosb
+
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_JSAMPROW
+    dec         rax
+    jg          short .expandloop
+
+.expand_end:
+    pop         rcx                     ; output_cols * 2
+
+    ; -- h2v2_smooth_downsample
+
+    mov         eax, r12d
+    imul        eax, eax, 16            ; neighscale = smoothing_factor * 16
+    shl         eax, WORD_BIT
+    imul        edx, r12d, -80
+    add         edx, 16384              ; memberscale = 16384 - smoothing_factor * 80
+    or          eax, edx
+    movd        xmm6, eax
+    pshufd      xmm6, xmm6, 0x00        ; xmm6={memberscale, neighscale, ..}
+    pcmpeqw     xmm7, xmm7
+    psrlw       xmm7, BYTE_BIT          ; xmm7={0xFF 0x00 0xFF 0x00 ..}
+    pcmpeqd     xmm8, xmm8
+    psrld       xmm8, 31
+    pslld       xmm8, 15                ; xmm8={32768, 32768, 32768, 32768}
+
+    mov         rax, r11
+    shr         rax, 1                  ; rowctr = v_samp_factor
+    test        rax, rax
+    jle         near .return
+
+    mov         rsi, r14                ; input_data
+    mov         rdi, r15                ; output_data
+.rowloop:
+    push        rax
+    push        rcx
+    push        rdi
+    push        rsi
+
+    mov         r8p, JSAMPROW [rsi-1*SIZEOF_JSAMPROW]  ; above_ptr
+    mov         r9p, JSAMPROW [rsi+0*SIZEOF_JSAMPROW]  ; inptr0
+    mov         r10p, JSAMPROW [rsi+1*SIZEOF_JSAMPROW] ; inptr1
+    mov         r11p, JSAMPROW [rsi+2*SIZEOF_JSAMPROW] ; below_ptr
+    mov         rdip, JSAMPROW [rdi]                   ; outptr
+
+    ; First column: pretend column -1 is the same as column 0.
+    xor         edx, edx
+    H2V2_COLSUM
+    movd        xmm9, eax
+    pslldq      xmm9, 14                ; xmm9=(-- -- -- -- -- -- -- colsum[-1])
+
+.columnloop:
+    ; The column to the right of this chunk, or the last column if there
+    ; isn't one
+    xor         edx, edx
+    cmp         rcx, byte SIZEOF_XMMWORD
+    seta        dl
+    add         edx, byte SIZEOF_XMMWORD-1
+    H2V2_COLSUM
+
+    movdqu      xmm0, XMMWORD [r9]      ; xmm0=inptr0
+    movdqu      xmm1, XMMWORD [r10]     ; xmm1=inptr1
+    movdqu      xmm4, XMMWORD [r8]      ; xmm4=above_ptr
+    movdqu      xmm5, XMMWORD [r11]     ; xmm5=below_ptr
+
+    movdqa      xmm2, xmm0
+    movdqa      xmm3, xmm1
+    pand        xmm0, xmm7
+    pand        xmm1, xmm7
+    psrlw       xmm2, BYTE_BIT
+    psrlw       xmm3, BYTE_BIT
+    paddw       xmm0, xmm1              ; xmm0=member rows, even columns
+    paddw       xmm2, xmm3              ; xmm2=member rows, odd columns
+
+    movdqa      xmm1, xmm4
+    movdqa      xmm3, xmm5
+    pand        xmm1, xmm7
+    pand        xmm3, xmm7
+    psrlw       xmm4, BYTE_BIT
+    psrlw       xmm5, BYTE_BIT
+    paddw       xmm1, xmm3              ; xmm1=neighbor rows, even columns
+    paddw       xmm4, xmm5              ; xmm4=neighbor rows, odd columns
+
+    movdqa      xmm3, xmm0
+    paddw       xmm3, xmm2              ; xmm3=membersum
+    movdqa      xmm5, xmm1
+    paddw       xmm5, xmm4
+    paddw       xmm5, xmm5              ; xmm5=2*(edge-neighbors above and below)
+
+    paddw       xmm0, xmm0
+    paddw       xmm0, xmm1              ; xmm0=colsum[2*j]
+    paddw       xmm2, xmm2
+    paddw       xmm2, xmm4              ; xmm2=colsum[2*j+1]
+
+    psrldq      xmm9, 14
+    movdqa      xmm1, xmm2
+    pslldq      xmm1, 2
+    por         xmm1, xmm9              ; xmm1=colsum[2*j-1]
+    movdqa      xmm9, xmm2
+
+    movd        xmm4, eax
+    pslldq      xmm4, 14
+    psrldq      xmm0, 2
+    por         xmm0, xmm4              ; xmm0=colsum[2*j+2]
+
+    paddw       xmm5, xmm1
+    paddw       xmm5, xmm0              ; xmm5=neighsum
+
+    movdqa      xmm0, xmm3
+    punpcklwd   xmm3, xmm5
+    punpckhwd   xmm0, xmm5
+    pmaddwd     xmm3, xmm6
+    pmaddwd     xmm0, xmm6
+    paddd       xmm3, xmm8
+    paddd       xmm0, xmm8
+    psrld       xmm3, 16
+    psrld       xmm0, 16
+    packssdw    xmm3, xmm0
+    packuswb    xmm3, xmm3
+
+    movq        XMM_MMWORD [rdi], xmm3
+
+    add         r8, byte SIZEOF_XMMWORD     ; above_ptr
+    add         r9, byte SIZEOF_XMMWORD     ; inptr0
+    add         r10, byte SIZEOF_XMMWORD    ; inptr1
+    add         r11, byte SIZEOF_XMMWORD    ; below_ptr
+    add         rdi, byte SIZEOF_XMMWORD/2  ; outptr
+    sub         rcx, byte SIZEOF_XMMWORD
+    jnz         near .columnloop
+
+    pop         rsi
+    pop         rdi
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte 2*SIZEOF_JSAMPROW  ; input_data
+    add         rdi, byte 1*SIZEOF_JSAMPROW  ; output_data
+    dec         rax                          ; rowctr
+    jg          near .rowloop
+
+.return:
+    pop         rbx
+    UNCOLLECT_ARGS 6
+    POP_XMM     2
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Downsample pixel values of a single component.
+; This version handles the special case of a full-size component,
+; with smoothing.  One row of context is required.
+;
+; GLOBAL(void)
+; jsimd_fullsize_smooth_downsample_sse2(JDIMENSION image_width,
+;                                       int max_v_samp_factor,
+;                                       int smoothing_factor,
+;                                       JDIMENSION width_in_blocks,
+;                                       JSAMPARRAY input_data,
+;                                       JSAMPARRAY output_data);
+;
+; (The component's v_samp_factor is always max_v_samp_factor.)
+;
+
+; r10d = JDIMENSION image_width
+; r11 = int max_v_samp_factor
+; r12d = int smoothing_factor
+; r13d = JDIMENSION width_in_blocks
+; r14 = JSAMPARRAY input_data
+; r15 = JSAMPARRAY output_data
+
+; Compute eax = inptr[rdx] + above_ptr[rdx] + below_ptr[rdx], the sum of the
+; input samples in column rdx.
+
+%macro FULLSIZE_COLSUM 0
+    movzx       eax, JSAMPLE [r9+rdx]
+    movzx       ebx, JSAMPLE [r8+rdx]
+    add         eax, ebx
+    movzx       ebx, JSAMPLE [r11+rdx]
+    add         eax, ebx
+%endmacro
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_fullsize_smooth_downsample_sse2)
+
+EXTN(jsimd_fullsize_smooth_downsample_sse2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    3
+    COLLECT_ARGS 6
+    push        rbx
+
+    mov         ecx, r13d
+    shl         rcx, 3                  ; imul rcx,DCTSIZE (rcx = output_cols)
+    jz          near .return
+
+    ; Round output_cols up to a whole number of XMMWORDs.  The sample rows are
+    ; padded to a multiple of 2 * ALIGN_SIZE samples, so the extra columns
+    ; can be filled in by expand_right_edge and read back by the main loop.
+    add         rcx, byte SIZEOF_XMMWORD-1
+    and         rcx, byte -SIZEOF_XMMWORD
+
+    mov         edx, r10d
+
+    ; -- expand_right_edge (max_v_samp_factor + 2 rows, from input_data[-1])
+
+    push        rcx
+    sub         rcx, rdx
+    jle         short .expand_end
+
+    mov         rax, r11
+    add         rax, byte 2
+
+    cld
+    lea         rsi, [r14-SIZEOF_JSAMPROW]  ; input_data - 1
+.expandloop:
+    push        rax
+    push        rcx
+
+    mov         rdip, JSAMPROW [rsi]
+    add         rdi, rdx
+    mov         al, JSAMPLE [rdi-1]
+
+    rep stosb
+
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_JSAMPROW
+    dec         rax
+    jg          short .expandloop
+
+.expand_end:
+    pop         rcx                     ; output_cols, rounded up
+
+    ; -- fullsize_smooth_downsample
+
+    ; Since memberscale + 8 * neighscale = 65536, the scaled output is
+    ; 65536 * member + neighscale * (neighsum - 8 * member), and only the
+    ; second term needs to be computed with 32-bit precision.
+
+    mov         eax, r12d
+    shl         eax, 6                  ; neighscale = smoothing_factor * 64
+    or          eax, 0x40000000         ; 16384 in the high word
+    movd        xmm6, eax
+    pshufd      xmm6, xmm6, 0x00        ; xmm6={neighscale, 16384, ..}
+    pxor        xmm7, xmm7              ; xmm7=(all 0's)
+    pcmpeqw     xmm8, xmm8
+    psrlw       xmm8, 15
+    psllw       xmm8, 1                 ; xmm8={2, 2, 2, 2, 2, 2, 2, 2}
+
+    mov         rax, r11                ; rowctr
+    test        rax, rax
+    jle         near .return
+
+    mov         rsi, r14                ; input_data
+    mov         rdi, r15                ; output_data
+.rowloop:
+    push        rax
+    push        rcx
+    push        rdi
+    push        rsi
+
+    mov         r8p, JSAMPROW [rsi-1*SIZEOF_JSAMPROW]  ; above_ptr
+    mov         r9p, JSAMPROW [rsi+0*SIZEOF_JSAMPROW]  ; inptr
+    mov         r11p, JSAMPROW [rsi+1*SIZEOF_JSAMPROW] ; below_ptr
+    mov         rdip, JSAMPROW [rdi]                   ; outptr
+
+    ; First column: pretend column -1 is the same as column 0.
+    xor         edx, edx
+    FULLSIZE_COLSUM
+    movd        xmm9, eax
+    pslldq      xmm9, 14                ; xmm9=(-- -- -- -- -- -- -- colsum[-1])
+
+.columnloop:
+    ; The column to the right of this chunk, or the last column if there
+    ; isn't one
+    xor         edx, edx
+    cmp         rcx, byte SIZEOF_XMMWORD
+    seta        dl
+    add         edx, byte SIZEOF_XMMWORD-1
+    FULLSIZE_COLSUM
+
+    movdqu      xmm0, XMMWORD [r9]      ; xmm0=inptr
+    movdqu      xmm2, XMMWORD [r8]      ; xmm2=above_ptr
+    movdqu      xmm4, XMMWORD [r11]     ; xmm4=below_ptr
+
+    movdqa      xmm1, xmm0
+    movdqa      xmm3, xmm2
+    movdqa      xmm5, xmm4
+    punpcklbw   xmm0, xmm7              ; xmm0=inptr (0 1 2 3 4 5 6 7)
+    punpckhbw   xmm1, xmm7              ; xmm1=inptr (8 9 10 11 12 13 14 15)
+    punpcklbw   xmm2, xmm7
+    punpckhbw   xmm3, xmm7
+    punpcklbw   xmm4, xmm7
+    punpckhbw   xmm5, xmm7
+    paddw       xmm2, xmm4
+    paddw       xmm3, xmm5
+    paddw       xmm2, xmm0              ; xmm2=colsum (0 1 2 3 4 5 6 7)
+    paddw       xmm3, xmm1              ; xmm3=colsum (8 9 10 11 12 13 14 15)
+
+    psrldq      xmm9, 14
+    movdqa      xmm4, xmm2
+    pslldq      xmm4, 2
+    por         xmm4, xmm9              ; xmm4=colsum (-1 0 1 2 3 4 5 6)
+    movdqa      xmm5, xmm3
+    pslldq      xmm5, 14
+    movdqa      xmm10, xmm2
+    psrldq      xmm10, 2
+    por         xmm5, xmm10             ; xmm5=colsum (1 2 3 4 5 6 7 8)
+    paddw       xmm4, xmm5
+    paddw       xmm4, xmm2              ; xmm4=neighsum+member (0 1 2 3 4 5 6 7)
+
+    movdqa      xmm5, xmm2
+    psrldq      xmm5, 14
+    movdqa      xmm10, xmm3
+    pslldq      xmm10, 2
+    por         xmm5, xmm10             ; xmm5=colsum (7 8 9 10 11 12 13 14)
+    movd        xmm9, eax
+    pslldq      xmm9, 14
+    movdqa      xmm10, xmm3
+    psrldq      xmm10, 2
+    por         xmm9, xmm10             ; xmm9=colsum (9 10 11 12 13 14 15 16)
+    paddw       xmm5, xmm9
+    paddw       xmm5, xmm3              ; xmm5=neighsum+member (8 9 10 11 12 13 14 15)
+    movdqa      xmm9, xmm3
+
+    movdqa      xmm2, xmm0
+    movdqa      xmm3, xmm1
+    psllw       xmm2, 3
+    psllw       xmm3, 3
+    paddw       xmm2, xmm0
+    paddw       xmm3, xmm1
+    psubw       xmm4, xmm2              ; xmm4=neighsum-8*member (0 1 2 3 4 5 6 7)
+    psubw       xmm5, xmm3              ; xmm5=neighsum-8*member (8 9 10 11 12 13 14 15)
+
+    movdqa      xmm2, xmm4
+    movdqa      xmm3, xmm5
+    punpcklwd   xmm4, xmm8
+    punpckhwd   xmm2, xmm8
+    punpcklwd   xmm5, xmm8
+    punpckhwd   xmm3, xmm8
+    pmaddwd     xmm4, xmm6
+    pmaddwd     xmm2, xmm6
+    pmaddwd     xmm5, xmm6
+    pmaddwd     xmm3, xmm6
+    psrad       xmm4, 16
+    psrad       xmm2, 16
+    psrad       xmm5, 16
+    psrad       xmm3, 16
+    packssdw    xmm4, xmm2
+    packssdw    xmm5, xmm3
+    paddw       xmm0, xmm4
+    paddw       xmm1, xmm5
+    packuswb    xmm0, xmm1
+
+    movdqu      XMMWORD [rdi], xmm0
+
+    add         r8, byte SIZEOF_XMMWORD     ; above_ptr
+    add         r9, byte SIZEOF_XMMWORD     ; inptr
+    add         r11, byte SIZEOF_XMMWORD    ; below_ptr
+    add         rdi, byte SIZEOF_XMMWORD    ; outptr
+    sub         rcx, byte SIZEOF_XMMWORD
+    jnz         near .columnloop
+
+    pop         rsi
+    pop         rdi
+    pop         rcx
+    pop         rax
+
+    add         rsi, byte SIZEOF_JSAMPROW  ; input_data
+    add         rdi, byte SIZEOF_JSAMPROW  ; output_data
+    dec         rax                        ; rowctr
+    jg          near .rowloop
+
+.return:
+    pop         rbx
+    UNCOLLECT_ARGS 6
+    POP_XMM     3
+    pop         rbp
+    ret
+
 ; For some reason, the OS X linker does not honor the request to align the
 ; segment unless we do this.
     align       32
@@ -0,0 +1,185 @@
+;
+; jctrellis-avx2.asm - trellis quantization predecessor search (64-bit AVX2)
+;
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains an AVX2 implementation of the inner (predecessor x
+; candidate) search of the Huffman trellis quantizer.  The following code is
+; based on quantize_trellis() in jcdctmgr.c; see jcdctmgr.c for more details.
+; The results are bit-identical to the C code: each cost is formed with the
+; same sequence of single-precision operations, and ties are resolved in favor
+; of the earliest predecessor and then the smallest candidate, which is the
+; order in which the C code visits them.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_trellis_ac_search_avx2)
+
+EXTN(jconst_trellis_ac_search_avx2):
+
+PD_LANE     dd 0, 1, 2, 3, 4, 5, 6, 7
+PD_ONE      times 8 dd 1
+PD_EIGHT    times 8 dd 8
+PD_INF      times 8 dd 0x7F800000
+PD_KEYMAX   times 8 dd 0x7FFFFFFF
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Find the cheapest way of reaching AC coefficient i with a nonzero value.
+;
+; Eight predecessor positions j are evaluated in parallel.  For each of them,
+; the cost of every candidate value k is
+;
+;   (ac_bits[zero_run][k + 1] + candidate_dist[k]) +
+;   ((zero_dist[-1] - zero_dist[j - i]) + cost[j - i])
+;
+; where zero_run = i - 1 - j and ac_bits is the trellis_rates table built by
+; jpeg_make_trellis_rates().  Combinations that the Huffman table cannot code
+; have a rate of COST_INFINITY in that table, and predecessors whose cost is
+; COST_INFINITY (positions that quantized to zero) can never yield a cheaper
+; path either, so neither needs special treatment.
+;
+; If a path cheaper than cost[0] was found, then cost[0] is updated, and the
+; return value is (zero_run << 4) | k for the best path.  Otherwise, -1 is
+; returned.
+;
+; GLOBAL(int)
+; jsimd_trellis_ac_search_avx2(const float *zero_dist, float *cost,
+;                              const float *candidate_dist,
+;                              const float *ac_bits, int num_pred,
+;                              int num_candidates);
+;
+
+; r10 = const float *zero_dist  (points to accumulated_zero_dist[i])
+; r11 = float *cost             (points to accumulated_cost[i])
+; r12 = const float *candidate_dist
+; r13 = const float *ac_bits    (float [DCTSIZE2][16])
+; r14d = int num_pred           (number of predecessors, i - j_start)
+; r15d = int num_candidates
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_trellis_ac_search_avx2)
+
+EXTN(jsimd_trellis_ac_search_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    4
+    COLLECT_ARGS 6
+
+    vmovaps     ymm9, [rel PD_INF]          ; ymm9=best cost in each lane
+    vmovdqa     ymm8, [rel PD_KEYMAX]       ; ymm8=best key in each lane
+
+    movsxd      rdx, r14d
+    neg         rdx                         ; rdx=j - i for the first lane
+    vmovd       xmm7, edx
+    vpbroadcastd ymm7, xmm7
+    vpaddd      ymm7, ymm7, [rel PD_LANE]   ; ymm7=j - i for each lane
+
+.predloop:
+    vpxor       xmm0, xmm0, xmm0
+    vpcmpgtd    ymm6, ymm0, ymm7            ; ymm6=lanes with j < i
+
+    ; ymm5=(zero_dist[i-1] - zero_dist[j]) + cost[j]
+    vbroadcastss ymm5, FP32 [r10-1*SIZEOF_FP32]
+    vmaskmovps  ymm1, ymm6, [r10+rdx*SIZEOF_FP32]
+    vmaskmovps  ymm2, ymm6, [r11+rdx*SIZEOF_FP32]
+    vsubps      ymm5, ymm5, ymm1
+    vaddps      ymm5, ymm5, ymm2
+
+    ; zero_run = i - 1 - j = ~(j - i)
+    vpcmpeqd    ymm1, ymm1, ymm1
+    vpxor       ymm1, ymm1, ymm7            ; ymm1=zero_run
+    vpslld      ymm3, ymm1, 4               ; ymm3=16 * zero_run
+
+    ; The C code visits the predecessors in increasing order of j and the
+    ; candidates in increasing order of k, keeping the first of several equal
+    ; costs.  The key (j - i) * 32 + k + 1 sorts the paths in the same order.
+    vpslld      ymm2, ymm7, 5               ; ymm2=(j - i) * 32
+
+    vmovdqa     ymm1, [rel PD_ONE]          ; ymm1=k + 1 (magnitude bits)
+    xor         ecx, ecx
+.candloop:
+    ; Lanes with j >= i are not gathered and keep an infinite rate.
+    vpaddd      ymm0, ymm3, ymm1            ; ymm0=16 * zero_run + k + 1
+    vmovdqa     ymm10, ymm6
+    vmovaps     ymm11, [rel PD_INF]
+    vgatherdps  ymm11, [r13+ymm0*SIZEOF_FP32], ymm10 ; ymm11=rate
+
+    vbroadcastss ymm10, FP32 [r12+rcx*SIZEOF_FP32]
+    vaddps      ymm11, ymm11, ymm10         ; rate + candidate_dist[k]
+    vaddps      ymm11, ymm11, ymm5          ; + zero_dist[i-1] - ... + cost[j]
+
+    vcmpltps    ymm0, ymm11, ymm9
+    vblendvps   ymm9, ymm9, ymm11, ymm0
+    vpaddd      ymm10, ymm2, ymm1
+    vblendvps   ymm8, ymm8, ymm10, ymm0
+
+    vpaddd      ymm1, ymm1, [rel PD_ONE]
+    inc         ecx
+    cmp         ecx, r15d
+    jl          short .candloop
+
+    vpaddd      ymm7, ymm7, [rel PD_EIGHT]
+    add         rdx, 8
+    js          near .predloop
+
+    ; -- Find the minimum cost across all lanes.
+
+    vextractf128 xmm0, ymm9, 1
+    vminps      xmm0, xmm0, xmm9
+    vshufps     xmm1, xmm0, xmm0, 0x4E
+    vminps      xmm0, xmm0, xmm1
+    vshufps     xmm1, xmm0, xmm0, 0xB1
+    vminps      xmm0, xmm0, xmm1            ; xmm0=(min min min min)
+
+    vcomiss     xmm0, FP32 [r11]
+    jae         short .nopath               ; no path cheaper than cost[0]
+    vmovss      FP32 [r11], xmm0
+
+    ; -- Among the lanes that reached the minimum, take the smallest key.
+
+    vinsertf128 ymm0, ymm0, xmm0, 1
+    vcmpeqps    ymm0, ymm0, ymm9
+    vmovdqa     ymm1, [rel PD_KEYMAX]
+    vblendvps   ymm1, ymm1, ymm8, ymm0
+    vextracti128 xmm0, ymm1, 1
+    vpminsd     xmm0, xmm0, xmm1
+    vpshufd     xmm1, xmm0, 0x4E
+    vpminsd     xmm0, xmm0, xmm1
+    vpshufd     xmm1, xmm0, 0xB1
+    vpminsd     xmm0, xmm0, xmm1
+    vmovd       eax, xmm0
+
+    mov         ecx, eax
+    and         ecx, 31
+    dec         ecx                         ; ecx=k
+    sar         eax, 5                      ; eax=j - i
+    not         eax                         ; eax=zero_run
+    shl         eax, 4
+    or          eax, ecx
+    jmp         short .return
+
+.nopath:
+    mov         eax, -1
+
+.return:
+    vzeroupper
+    UNCOLLECT_ARGS 6
+    POP_XMM     4
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
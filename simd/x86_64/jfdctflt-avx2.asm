@@ -0,0 +1,217 @@
+;
+; jfdctflt.asm - floating-point FDCT (64-bit AVX2)
+;
+; Copyright 2009 Pierre Ossman <ossman@cendio.se> for Cendio AB
+; Copyright (C) 2009, 2016, 2024, D. R. Commander.
+; Copyright (C) 2023, Aliaksiej Kandracienka.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; This file contains a floating-point implementation of the forward DCT
+; (Discrete Cosine Transform). The following code is based directly on
+; the IJG's original jfdctflt.c; see the jfdctflt.c for more details.
+;
+; Two consecutive blocks are transformed per call.  The first block occupies
+; the lower 128-bit lane of each register and the second block the upper
+; lane, so the in-lane shuffles of the SSE implementation carry over as-is.
+; The arithmetic is performed in the same order as in the SSE implementation
+; (no fused multiply-add), so the results are bit-for-bit identical.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+
+; Load the 4x4 quadrant (%2,%3) of both blocks into ymm%1.  rdx points to
+; the first block and rax to the second.
+
+%macro vloadps2 3
+    vmovups     xmm%1, XMMWORD [XMMBLOCK(%2,%3,rdx,SIZEOF_FAST_FLOAT)]
+    vinsertf128 ymm%1, ymm%1, XMMWORD [XMMBLOCK(%2,%3,rax,SIZEOF_FAST_FLOAT)], 1
+%endmacro
+
+; Store ymm%1 into the 4x4 quadrant (%2,%3) of both blocks.
+
+%macro vstoreps2 3
+    vmovups     XMMWORD [XMMBLOCK(%2,%3,rdx,SIZEOF_FAST_FLOAT)], xmm%1
+    vextractf128 XMMWORD [XMMBLOCK(%2,%3,rax,SIZEOF_FAST_FLOAT)], ymm%1, 1
+%endmacro
+
+; Perform one pass of the DCT on four rows (or columns) of both blocks.
+; %1-%16 are the (row, column) quadrant coordinates of data0-data7, in the
+; layout used by the corresponding pass of jsimd_fdct_float_sse().
+
+%macro DODCT 16
+    vloadps2    0, %5, %6
+    vloadps2    1, %7, %8
+    vloadps2    2, %13, %14
+    vloadps2    3, %15, %16
+
+    ; ymm0=(20 21 22 23), ymm2=(24 25 26 27)
+    ; ymm1=(30 31 32 33), ymm3=(34 35 36 37)
+
+    vunpckhps   ymm8, ymm0, ymm1        ; ymm8=(22 32 23 33)
+    vunpcklps   ymm0, ymm0, ymm1        ; ymm0=(20 30 21 31)
+    vunpcklps   ymm9, ymm2, ymm3        ; ymm9=(24 34 25 35)
+    vunpckhps   ymm5, ymm2, ymm3        ; ymm5=(26 36 27 37)
+
+    vloadps2    6, %1, %2
+    vloadps2    7, %3, %4
+    vloadps2    1, %9, %10
+    vloadps2    3, %11, %12
+
+    ; ymm6=(00 01 02 03), ymm1=(04 05 06 07)
+    ; ymm7=(10 11 12 13), ymm3=(14 15 16 17)
+
+    vunpckhps   ymm4, ymm6, ymm7        ; ymm4=(02 12 03 13)
+    vunpcklps   ymm6, ymm6, ymm7        ; ymm6=(00 10 01 11)
+    vunpckhps   ymm2, ymm1, ymm3        ; ymm2=(06 16 07 17)
+    vunpcklps   ymm1, ymm1, ymm3        ; ymm1=(04 14 05 15)
+
+    vshufps     ymm7, ymm6, ymm0, 0xEE  ; ymm7=(01 11 21 31)=data1
+    vshufps     ymm6, ymm6, ymm0, 0x44  ; ymm6=(00 10 20 30)=data0
+    vshufps     ymm3, ymm2, ymm5, 0xEE  ; ymm3=(07 17 27 37)=data7
+    vshufps     ymm2, ymm2, ymm5, 0x44  ; ymm2=(06 16 26 36)=data6
+
+    vsubps      ymm10, ymm7, ymm2       ; ymm10=data1-data6=tmp6
+    vsubps      ymm11, ymm6, ymm3       ; ymm11=data0-data7=tmp7
+    vaddps      ymm0, ymm7, ymm2        ; ymm0=data1+data6=tmp1
+    vaddps      ymm5, ymm6, ymm3        ; ymm5=data0+data7=tmp0
+
+    vshufps     ymm7, ymm4, ymm8, 0xEE  ; ymm7=(03 13 23 33)=data3
+    vshufps     ymm4, ymm4, ymm8, 0x44  ; ymm4=(02 12 22 32)=data2
+    vshufps     ymm6, ymm1, ymm9, 0xEE  ; ymm6=(05 15 25 35)=data5
+    vshufps     ymm1, ymm1, ymm9, 0x44  ; ymm1=(04 14 24 34)=data4
+
+    vsubps      ymm2, ymm7, ymm1        ; ymm2=data3-data4=tmp4
+    vsubps      ymm3, ymm4, ymm6        ; ymm3=data2-data5=tmp5
+    vaddps      ymm7, ymm7, ymm1        ; ymm7=data3+data4=tmp3
+    vaddps      ymm4, ymm4, ymm6        ; ymm4=data2+data5=tmp2
+
+    ; -- Even part
+
+    vaddps      ymm1, ymm5, ymm7        ; ymm1=tmp10
+    vaddps      ymm6, ymm0, ymm4        ; ymm6=tmp11
+    vsubps      ymm5, ymm5, ymm7        ; ymm5=tmp13
+    vsubps      ymm0, ymm0, ymm4        ; ymm0=tmp12
+
+    vaddps      ymm0, ymm0, ymm5
+    vmulps      ymm0, ymm0, [rel PD_0_707]  ; ymm0=z1
+
+    vsubps      ymm7, ymm1, ymm6        ; ymm7=data4
+    vaddps      ymm1, ymm1, ymm6        ; ymm1=data0
+    vsubps      ymm6, ymm5, ymm0        ; ymm6=data6
+    vaddps      ymm5, ymm5, ymm0        ; ymm5=data2
+
+    vstoreps2   7, %9, %10
+    vstoreps2   6, %13, %14
+    vstoreps2   1, %1, %2
+    vstoreps2   5, %5, %6
+
+    ; -- Odd part
+
+    vaddps      ymm2, ymm2, ymm3        ; ymm2=tmp10
+    vaddps      ymm3, ymm3, ymm10       ; ymm3=tmp11
+    vaddps      ymm6, ymm10, ymm11      ; ymm6=tmp12, ymm11=tmp7
+
+    vmulps      ymm3, ymm3, [rel PD_0_707]  ; ymm3=z3
+
+    vsubps      ymm4, ymm2, ymm6
+    vmulps      ymm4, ymm4, [rel PD_0_382]  ; ymm4=z5
+    vmulps      ymm1, ymm2, [rel PD_0_541]  ; ymm1=MULTIPLY(tmp10,FIX_0_541196)
+    vmulps      ymm6, ymm6, [rel PD_1_306]  ; ymm6=MULTIPLY(tmp12,FIX_1_306562)
+    vaddps      ymm1, ymm1, ymm4        ; ymm1=z2
+    vaddps      ymm6, ymm6, ymm4        ; ymm6=z4
+
+    vsubps      ymm0, ymm11, ymm3       ; ymm0=z13
+    vaddps      ymm5, ymm11, ymm3       ; ymm5=z11
+
+    vsubps      ymm2, ymm0, ymm1        ; ymm2=data3
+    vaddps      ymm0, ymm0, ymm1        ; ymm0=data5
+    vsubps      ymm3, ymm5, ymm6        ; ymm3=data7
+    vaddps      ymm5, ymm5, ymm6        ; ymm5=data1
+
+    vstoreps2   2, %7, %8
+    vstoreps2   3, %15, %16
+    vstoreps2   0, %11, %12
+    vstoreps2   5, %3, %4
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    ALIGNZ      32
+    GLOBAL_DATA(jconst_fdct_float_avx2)
+
+EXTN(jconst_fdct_float_avx2):
+
+PD_0_382 times 8 dd 0.382683432365089771728460
+PD_0_707 times 8 dd 0.707106781186547524400844
+PD_0_541 times 8 dd 0.541196100146196984399723
+PD_1_306 times 8 dd 1.306562964876376527856643
+
+    ALIGNZ      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Perform the forward DCT on two consecutive blocks of samples.
+;
+; GLOBAL(void)
+; jsimd_fdct_float_avx2(FAST_FLOAT *data)
+;
+
+; r10 = FAST_FLOAT *data
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_fdct_float_avx2)
+
+EXTN(jsimd_fdct_float_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    PUSH_XMM    4
+    COLLECT_ARGS 1
+
+    ; ---- Pass 1: process rows.
+
+    mov         rdx, r10                ; (FAST_FLOAT *)
+    lea         rax, [r10+DCTSIZE2*SIZEOF_FAST_FLOAT]  ; (FAST_FLOAT *)
+    mov         rcx, DCTSIZE/4
+.rowloop:
+
+    DODCT       0, 0, 1, 0, 2, 0, 3, 0, 0, 1, 1, 1, 2, 1, 3, 1
+
+    add         rdx, 4*DCTSIZE*SIZEOF_FAST_FLOAT
+    add         rax, 4*DCTSIZE*SIZEOF_FAST_FLOAT
+    dec         rcx
+    jnz         near .rowloop
+
+    ; ---- Pass 2: process columns.
+
+    mov         rdx, r10                ; (FAST_FLOAT *)
+    lea         rax, [r10+DCTSIZE2*SIZEOF_FAST_FLOAT]  ; (FAST_FLOAT *)
+    mov         rcx, DCTSIZE/4
+.columnloop:
+
+    DODCT       0, 0, 1, 0, 2, 0, 3, 0, 4, 0, 5, 0, 6, 0, 7, 0
+
+    add         rdx, byte 4*SIZEOF_FAST_FLOAT
+    add         rax, byte 4*SIZEOF_FAST_FLOAT
+    dec         rcx
+    jnz         near .columnloop
+
+    vzeroupper
+    UNCOLLECT_ARGS 1
+    POP_XMM     4
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
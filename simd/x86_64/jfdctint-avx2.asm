@@ -237,6 +237,7 @@ PD_DESCALE_P2              times 8  dd  1 << (DESCALE_P2 - 1)
 PW_DESCALE_P2X             times 16 dw  1 << (PASS1_BITS - 1)
 PW_1_NEG1                  times 8  dw  1
                            times 8  dw -1
+PW_CENTERJSAMPLE           times 16 dw  CENTERJSAMPLE
 
     ALIGNZ      32
 
@@ -311,6 +312,149 @@ EXTN(jsimd_fdct_islow_avx2):
     pop         rbp
     ret
 
+;
+; Load a row of blocks, apply unsigned->signed conversion, perform the forward
+; DCT, and quantize the coefficients.  This is equivalent to calling
+; jsimd_convsamp_avx2(), jsimd_fdct_islow_avx2(), and jsimd_quantize_avx2()
+; for each block in turn, but the samples and coefficients stay in registers
+; between the three stages.  If dst is not NULL, then the unquantized
+; coefficients of each block are also stored there.
+;
+; GLOBAL(void)
+; jsimd_fdct_islow_row_avx2(JSAMPARRAY sample_data, JDIMENSION start_col,
+;                           JDIMENSION num_blocks, JBLOCKROW coef_blocks,
+;                           DCTELEM *divisors, JBLOCKROW dst)
+;
+
+%define RECIPROCAL(m, n, b) \
+  YMMBLOCK(DCTSIZE * 0 + (m), (n), (b), SIZEOF_DCTELEM)
+%define CORRECTION(m, n, b) \
+  YMMBLOCK(DCTSIZE * 1 + (m), (n), (b), SIZEOF_DCTELEM)
+%define SCALE(m, n, b) \
+  YMMBLOCK(DCTSIZE * 2 + (m), (n), (b), SIZEOF_DCTELEM)
+
+; Quantize %1 (two rows of coefficients) into %2 using rows %3 and %3+1 of
+; the divisor tables.
+
+%macro DOQUANT 3
+    vpabsw      %2, %1
+    vpaddw      %2, %2, YMMWORD [CORRECTION(%3,0,r14)]  ; correction + roundfactor
+    vpmulhuw    %2, %2, YMMWORD [RECIPROCAL(%3,0,r14)]  ; reciprocal
+    vpmulhuw    %2, %2, YMMWORD [SCALE(%3,0,r14)]       ; scale
+    vpsignw     %2, %2, %1
+%endmacro
+
+; r10 = JSAMPARRAY sample_data
+; r11d = JDIMENSION start_col
+; r12d = JDIMENSION num_blocks
+; r13 = JBLOCKROW coef_blocks
+; r14 = DCTELEM *divisors
+; r15 = JBLOCKROW dst
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_fdct_islow_row_avx2)
+
+EXTN(jsimd_fdct_islow_row_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 6
+    push        rbx
+
+    test        r12d, r12d
+    jz          near .return
+
+    mov         raxp, JSAMPROW [r10+0*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rbxp, JSAMPROW [r10+1*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rcxp, JSAMPROW [r10+2*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdxp, JSAMPROW [r10+3*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsip, JSAMPROW [r10+4*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdip, JSAMPROW [r10+5*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         r8p, JSAMPROW [r10+6*SIZEOF_JSAMPROW]   ; (JSAMPLE *)
+    mov         r9p, JSAMPROW [r10+7*SIZEOF_JSAMPROW]   ; (JSAMPLE *)
+    mov         r11d, r11d                              ; (JDIMENSION)
+
+.blockloop:
+    ; ---- Load samples (rows 0-3 in the low lanes and rows 4-7 in the high
+    ;      lanes, as expected by the transpose.)
+
+    vmovq       xmm0, XMM_MMWORD [rax+r11*SIZEOF_JSAMPLE]
+    vmovq       xmm1, XMM_MMWORD [rbx+r11*SIZEOF_JSAMPLE]
+    vmovq       xmm2, XMM_MMWORD [rcx+r11*SIZEOF_JSAMPLE]
+    vmovq       xmm3, XMM_MMWORD [rdx+r11*SIZEOF_JSAMPLE]
+    vpinsrq     xmm0, xmm0, XMM_MMWORD [rsi+r11*SIZEOF_JSAMPLE], 1
+    vpinsrq     xmm1, xmm1, XMM_MMWORD [rdi+r11*SIZEOF_JSAMPLE], 1
+    vpinsrq     xmm2, xmm2, XMM_MMWORD [r8+r11*SIZEOF_JSAMPLE], 1
+    vpinsrq     xmm3, xmm3, XMM_MMWORD [r9+r11*SIZEOF_JSAMPLE], 1
+
+    vpmovzxbw   ymm0, xmm0
+    vpmovzxbw   ymm1, xmm1
+    vpmovzxbw   ymm2, xmm2
+    vpmovzxbw   ymm3, xmm3
+    vpsubw      ymm0, ymm0, [rel PW_CENTERJSAMPLE]
+    vpsubw      ymm1, ymm1, [rel PW_CENTERJSAMPLE]
+    vpsubw      ymm2, ymm2, [rel PW_CENTERJSAMPLE]
+    vpsubw      ymm3, ymm3, [rel PW_CENTERJSAMPLE]
+    ; ymm0=(00 01 02 03 04 05 06 07  40 41 42 43 44 45 46 47)
+    ; ymm1=(10 11 12 13 14 15 16 17  50 51 52 53 54 55 56 57)
+    ; ymm2=(20 21 22 23 24 25 26 27  60 61 62 63 64 65 66 67)
+    ; ymm3=(30 31 32 33 34 35 36 37  70 71 72 73 74 75 76 77)
+
+    ; ---- Pass 1: process rows.
+
+    DOTRANSPOSE ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7
+
+    DODCT       ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7, 1
+    ; ymm0=data0_4, ymm1=data3_1, ymm2=data2_6, ymm3=data7_5
+
+    ; ---- Pass 2: process columns.
+
+    vperm2i128  ymm4, ymm1, ymm3, 0x20  ; ymm4=data3_7
+    vperm2i128  ymm1, ymm1, ymm3, 0x31  ; ymm1=data1_5
+
+    DOTRANSPOSE ymm0, ymm1, ymm2, ymm4, ymm3, ymm5, ymm6, ymm7
+
+    DODCT       ymm0, ymm1, ymm2, ymm4, ymm3, ymm5, ymm6, ymm7, 2
+    ; ymm0=data0_4, ymm1=data3_1, ymm2=data2_6, ymm4=data7_5
+
+    vperm2i128 ymm3, ymm0, ymm1, 0x30   ; ymm3=data0_1
+    vperm2i128 ymm5, ymm2, ymm1, 0x20   ; ymm5=data2_3
+    vperm2i128 ymm6, ymm0, ymm4, 0x31   ; ymm6=data4_5
+    vperm2i128 ymm7, ymm2, ymm4, 0x21   ; ymm7=data6_7
+
+    test        r15, r15
+    jz          short .quantize
+    vmovdqu     YMMWORD [YMMBLOCK(0,0,r15,SIZEOF_JCOEF)], ymm3
+    vmovdqu     YMMWORD [YMMBLOCK(2,0,r15,SIZEOF_JCOEF)], ymm5
+    vmovdqu     YMMWORD [YMMBLOCK(4,0,r15,SIZEOF_JCOEF)], ymm6
+    vmovdqu     YMMWORD [YMMBLOCK(6,0,r15,SIZEOF_JCOEF)], ymm7
+    add         r15, DCTSIZE2*SIZEOF_JCOEF
+.quantize:
+
+    ; ---- Quantize.
+
+    DOQUANT     ymm3, ymm0, 0
+    DOQUANT     ymm5, ymm1, 2
+    DOQUANT     ymm6, ymm2, 4
+    DOQUANT     ymm7, ymm4, 6
+
+    vmovdqu     YMMWORD [YMMBLOCK(0,0,r13,SIZEOF_JCOEF)], ymm0
+    vmovdqu     YMMWORD [YMMBLOCK(2,0,r13,SIZEOF_JCOEF)], ymm1
+    vmovdqu     YMMWORD [YMMBLOCK(4,0,r13,SIZEOF_JCOEF)], ymm2
+    vmovdqu     YMMWORD [YMMBLOCK(6,0,r13,SIZEOF_JCOEF)], ymm4
+
+    add         r13, DCTSIZE2*SIZEOF_JCOEF
+    add         r11, byte DCTSIZE
+    dec         r12d
+    jnz         near .blockloop
+
+    vzeroupper
+.return:
+    pop         rbx
+    UNCOLLECT_ARGS 6
+    pop         rbp
+    ret
+
 ; For some reason, the OS X linker does not honor the request to align the
 ; segment unless we do this.
     align       32
@@ -838,6 +838,79 @@ EXTN(jsimd_idct_islow_sse2):
     pop         rbp
     ret
 
+;
+; Perform dequantization and inverse DCT on a block of coefficients whose
+; AC terms are all zero.
+;
+; All 64 output samples are equal.  They are computed exactly as
+; jsimd_idct_islow_sse2() and jsimd_idct_islow_avx2() compute them for such a
+; block: the dequantized DC term is scaled with 16-bit wraparound in pass 1,
+; and the result of pass 2 is saturated to 8 bits before being offset by
+; CENTERJSAMPLE.
+;
+; GLOBAL(void)
+; jsimd_idct_islow_dc_sse2(void *dct_table, JCOEFPTR coef_block,
+;                          JSAMPARRAY output_buf, JDIMENSION output_col)
+;
+
+; r10 = jpeg_component_info *compptr
+; r11 = JCOEFPTR coef_block
+; r12 = JSAMPARRAY output_buf
+; r13d = JDIMENSION output_col
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_idct_islow_dc_sse2)
+
+EXTN(jsimd_idct_islow_dc_sse2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 4
+
+    ; ---- Pass 1: dequantize and scale the DC term.
+
+    movd        xmm0, dword [r11]       ; xmm0=(00 01 -- -- -- -- -- --)
+    movd        xmm1, dword [r10]
+    pmullw      xmm0, xmm1
+    psllw       xmm0, PASS1_BITS        ; xmm0=(in0 -- -- -- -- -- -- --)
+
+    ; ---- Pass 2: in0 is the only nonzero input of each row.
+
+    pxor        xmm1, xmm1
+    punpcklwd   xmm1, xmm0              ; xmm1=tmp0L
+    psrad       xmm1, (16-CONST_BITS)   ; psrad xmm1,16 & pslld xmm1,CONST_BITS
+    paddd       xmm1, [rel PD_DESCALE_P2]
+    psrad       xmm1, DESCALE_P2
+    packssdw    xmm1, xmm1
+    packsswb    xmm1, xmm1
+    paddb       xmm1, [rel PB_CENTERJSAMP]
+
+    punpcklbw   xmm1, xmm1
+    pshuflw     xmm1, xmm1, 0x00        ; xmm1=(00 00 00 00 00 00 00 00 ...)
+
+    mov         eax, r13d
+
+    mov         rdxp, JSAMPROW [r12+0*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsip, JSAMPROW [r12+1*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm1
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm1
+    mov         rdxp, JSAMPROW [r12+2*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsip, JSAMPROW [r12+3*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm1
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm1
+    mov         rdxp, JSAMPROW [r12+4*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsip, JSAMPROW [r12+5*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm1
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm1
+    mov         rdxp, JSAMPROW [r12+6*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsip, JSAMPROW [r12+7*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm1
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm1
+
+    UNCOLLECT_ARGS 4
+    pop         rbp
+    ret
+
 ; For some reason, the OS X linker does not honor the request to align the
 ; segment unless we do this.
     align       32
@@ -0,0 +1,147 @@
+;
+; jquantf.asm - sample data conversion and quantization (64-bit AVX2)
+;
+; Copyright 2009 Pierre Ossman <ossman@cendio.se> for Cendio AB
+; Copyright (C) 2009, 2016, 2024, D. R. Commander.
+; Copyright (C) 2018, Matthias Räncker.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler) or Yasm.
+;
+; The routines in this file process two horizontally adjacent blocks per call.
+; The workspace holds the first block in elements 0-63 and the second block in
+; elements 64-127.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Load data into workspace, applying unsigned->signed conversion
+;
+; GLOBAL(void)
+; jsimd_convsamp_float_avx2(JSAMPARRAY sample_data, JDIMENSION start_col,
+;                           FAST_FLOAT *workspace);
+;
+
+; r10 = JSAMPARRAY sample_data
+; r11d = JDIMENSION start_col
+; r12 = FAST_FLOAT *workspace
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_convsamp_float_avx2)
+
+EXTN(jsimd_convsamp_float_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 3
+    push        rbx
+
+    vpcmpeqd    ymm7, ymm7, ymm7
+    vpslld      ymm7, ymm7, 7           ; ymm7={-CENTERJSAMPLE x 8}
+
+    mov         rsi, r10
+    mov         eax, r11d
+    mov         rdi, r12
+    mov         rcx, DCTSIZE/2
+.convloop:
+    mov         rbxp, JSAMPROW [rsi+0*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdxp, JSAMPROW [rsi+1*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+
+    vpmovzxbd   ymm0, XMM_MMWORD [rbx+rax*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm1, XMM_MMWORD [rbx+rax*SIZEOF_JSAMPLE+DCTSIZE*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm2, XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm3, XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE+DCTSIZE*SIZEOF_JSAMPLE]
+
+    vpaddd      ymm0, ymm0, ymm7
+    vpaddd      ymm1, ymm1, ymm7
+    vpaddd      ymm2, ymm2, ymm7
+    vpaddd      ymm3, ymm3, ymm7
+    vcvtdq2ps   ymm0, ymm0
+    vcvtdq2ps   ymm1, ymm1
+    vcvtdq2ps   ymm2, ymm2
+    vcvtdq2ps   ymm3, ymm3
+
+    vmovups     YMMWORD [YMMBLOCK(0,0,rdi,SIZEOF_FAST_FLOAT)], ymm0
+    vmovups     YMMWORD [YMMBLOCK(DCTSIZE,0,rdi,SIZEOF_FAST_FLOAT)], ymm1
+    vmovups     YMMWORD [YMMBLOCK(1,0,rdi,SIZEOF_FAST_FLOAT)], ymm2
+    vmovups     YMMWORD [YMMBLOCK(DCTSIZE+1,0,rdi,SIZEOF_FAST_FLOAT)], ymm3
+
+    add         rsi, byte 2*SIZEOF_JSAMPROW
+    add         rdi, byte 2*DCTSIZE*SIZEOF_FAST_FLOAT
+    dec         rcx
+    jnz         short .convloop
+
+    vzeroupper
+    pop         rbx
+    UNCOLLECT_ARGS 3
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Quantize/descale the coefficients, and store into coef_block
+;
+; GLOBAL(void)
+; jsimd_quantize_float_avx2(JCOEFPTR coef_block, FAST_FLOAT *divisors,
+;                           FAST_FLOAT *workspace);
+;
+
+; r10 = JCOEFPTR coef_block
+; r11 = FAST_FLOAT *divisors
+; r12 = FAST_FLOAT *workspace
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_quantize_float_avx2)
+
+EXTN(jsimd_quantize_float_avx2):
+    ENDBR64
+    push        rbp
+    mov         rbp, rsp
+    COLLECT_ARGS 3
+
+    mov         rsi, r12
+    mov         rdx, r11
+    mov         rdi, r10
+    mov         rax, DCTSIZE2/16
+.quantloop:
+    vmovups     ymm4, YMMWORD [YMMBLOCK(0,0,rdx,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm5, YMMWORD [YMMBLOCK(1,0,rdx,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm0, ymm4, YMMWORD [YMMBLOCK(0,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm1, ymm5, YMMWORD [YMMBLOCK(1,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm2, ymm4, YMMWORD [YMMBLOCK(DCTSIZE,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm3, ymm5, YMMWORD [YMMBLOCK(DCTSIZE+1,0,rsi,SIZEOF_FAST_FLOAT)]
+
+    vcvtps2dq   ymm0, ymm0
+    vcvtps2dq   ymm1, ymm1
+    vcvtps2dq   ymm2, ymm2
+    vcvtps2dq   ymm3, ymm3
+
+    vpackssdw   ymm0, ymm0, ymm1
+    vpackssdw   ymm2, ymm2, ymm3
+    vpermq      ymm0, ymm0, 0xd8
+    vpermq      ymm2, ymm2, 0xd8
+
+    vmovdqu     YMMWORD [YMMBLOCK(0,0,rdi,SIZEOF_JCOEF)], ymm0
+    vmovdqu     YMMWORD [YMMBLOCK(DCTSIZE,0,rdi,SIZEOF_JCOEF)], ymm2
+
+    add         rsi, byte 16*SIZEOF_FAST_FLOAT
+    add         rdx, byte 16*SIZEOF_FAST_FLOAT
+    add         rdi, byte 16*SIZEOF_JCOEF
+    dec         rax
+    jnz         short .quantloop
+
+    vzeroupper
+    UNCOLLECT_ARGS 3
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -51,10 +51,13 @@ init_simd(void)
 
 #ifndef NO_GETENV
   /* Force different settings through environment variables */
+  /* The floating-point routines require only SSE, which every x86-64 CPU
+   * supports along with SSE2.
+   */
   if (!GETENV_S(env, 2, "JSIMD_FORCESSE2") && !strcmp(env, "1"))
-    simd_support &= JSIMD_SSE2;
+    simd_support &= JSIMD_SSE | JSIMD_SSE2;
   if (!GETENV_S(env, 2, "JSIMD_FORCEAVX2") && !strcmp(env, "1"))
-    simd_support &= JSIMD_AVX2;
+    simd_support &= JSIMD_AVX2 | JSIMD_BMI2;
   if (!GETENV_S(env, 2, "JSIMD_FORCENONE") && !strcmp(env, "1"))
     simd_support = 0;
   if (!GETENV_S(env, 2, "JSIMD_NOHUFFENC") && !strcmp(env, "1"))
@@ -338,6 +341,44 @@ jsimd_can_h2v1_downsample(void)
   return 0;
 }
 
+GLOBAL(int)
+jsimd_can_h2v2_smooth_downsample(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+  if (simd_support & JSIMD_SSE2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_fullsize_smooth_downsample(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+  if (simd_support & JSIMD_SSE2)
+    return 1;
+
+  return 0;
+}
+
 GLOBAL(void)
 jsimd_h2v2_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
                       JSAMPARRAY input_data, JSAMPARRAY output_data)
@@ -357,6 +398,50 @@ jsimd_h2v2_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
                                output_data);
 }
 
+GLOBAL(void)
+jsimd_h2v2_smooth_downsample(j_compress_ptr cinfo,
+                             jpeg_component_info *compptr,
+                             JSAMPARRAY input_data, JSAMPARRAY output_data)
+{
+  if (simd_support == ~0U)
+    init_simd();
+
+  if (simd_support & JSIMD_AVX2)
+    jsimd_h2v2_smooth_downsample_avx2(cinfo->image_width,
+                                      cinfo->max_v_samp_factor,
+                                      cinfo->smoothing_factor,
+                                      compptr->width_in_blocks, input_data,
+                                      output_data);
+  else
+    jsimd_h2v2_smooth_downsample_sse2(cinfo->image_width,
+                                      cinfo->max_v_samp_factor,
+                                      cinfo->smoothing_factor,
+                                      compptr->width_in_blocks, input_data,
+                                      output_data);
+}
+
+GLOBAL(void)
+jsimd_fullsize_smooth_downsample(j_compress_ptr cinfo,
+                                 jpeg_component_info *compptr,
+                                 JSAMPARRAY input_data, JSAMPARRAY output_data)
+{
+  if (simd_support == ~0U)
+    init_simd();
+
+  if (simd_support & JSIMD_AVX2)
+    jsimd_fullsize_smooth_downsample_avx2(cinfo->image_width,
+                                          cinfo->max_v_samp_factor,
+                                          cinfo->smoothing_factor,
+                                          compptr->width_in_blocks,
+                                          input_data, output_data);
+  else
+    jsimd_fullsize_smooth_downsample_sse2(cinfo->image_width,
+                                          cinfo->max_v_samp_factor,
+                                          cinfo->smoothing_factor,
+                                          compptr->width_in_blocks,
+                                          input_data, output_data);
+}
+
 GLOBAL(void)
 jsimd_h2v1_downsample(j_compress_ptr cinfo, jpeg_component_info *compptr,
                       JSAMPARRAY input_data, JSAMPARRAY output_data)
@@ -864,6 +949,175 @@ jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
   jsimd_quantize_float_sse2(coef_block, divisors, workspace);
 }
 
+/*
+ * The _x2 variants operate on two horizontally adjacent blocks at once.  The
+ * workspace holds the first block in elements 0-63 and the second block in
+ * elements 64-127, and coef_block points to two consecutive JBLOCKs.
+ */
+
+GLOBAL(int)
+jsimd_can_convsamp_float_x2(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(FAST_FLOAT) != 4)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_fdct_float_x2(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(FAST_FLOAT) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_fdct_float_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_quantize_float_x2(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(JCOEF) != 2)
+    return 0;
+  if (sizeof(FAST_FLOAT) != 4)
+    return 0;
+
+  if (simd_support & JSIMD_AVX2)
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_convsamp_float_x2(JSAMPARRAY sample_data, JDIMENSION start_col,
+                        FAST_FLOAT *workspace)
+{
+  jsimd_convsamp_float_avx2(sample_data, start_col, workspace);
+}
+
+GLOBAL(void)
+jsimd_fdct_float_x2(FAST_FLOAT *data)
+{
+  jsimd_fdct_float_avx2(data);
+}
+
+GLOBAL(void)
+jsimd_quantize_float_x2(JCOEFPTR coef_block, FAST_FLOAT *divisors,
+                        FAST_FLOAT *workspace)
+{
+  jsimd_quantize_float_avx2(coef_block, divisors, workspace);
+}
+
+GLOBAL(int)
+jsimd_can_fdct_islow_row(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(JDIMENSION) != 4)
+    return 0;
+  if (sizeof(JCOEF) != 2)
+    return 0;
+  if (sizeof(DCTELEM) != 2)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_fdct_islow_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_fdct_islow_row(JSAMPARRAY sample_data, JDIMENSION start_col,
+                     JDIMENSION num_blocks, JBLOCKROW coef_blocks,
+                     DCTELEM *divisors, JBLOCKROW dst)
+{
+  jsimd_fdct_islow_row_avx2(sample_data, start_col, num_blocks, coef_blocks,
+                            divisors, dst);
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(DCTELEM) != 2)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_preprocess_deringing_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_can_preprocess_deringing_float(void)
+{
+  init_simd();
+
+  /* The code is optimised for these values only */
+  if (DCTSIZE != 8)
+    return 0;
+  if (BITS_IN_JSAMPLE != 8)
+    return 0;
+  if (sizeof(FAST_FLOAT) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_preprocess_deringing_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_preprocess_deringing(DCTELEM *data,
+                           const JQUANT_TBL *quantization_table)
+{
+  jsimd_preprocess_deringing_avx2(data, quantization_table);
+}
+
+GLOBAL(void)
+jsimd_preprocess_deringing_float(FAST_FLOAT *data,
+                                 const JQUANT_TBL *quantization_table)
+{
+  jsimd_preprocess_deringing_float_avx2(data, quantization_table);
+}
+
 GLOBAL(int)
 jsimd_can_idct_2x2(void)
 {
@@ -1034,6 +1288,30 @@ jsimd_idct_float(j_decompress_ptr cinfo, jpeg_component_info *compptr,
                         output_col);
 }
 
+GLOBAL(int)
+jsimd_can_idct_islow_dc(void)
+{
+  /* The DC-only routine mimics the arithmetic of both the SSE2 and the AVX2
+   * accurate integer IDCT, so it is available whenever either of them is.
+   */
+  if (!jsimd_can_idct_islow())
+    return 0;
+
+  if ((simd_support & JSIMD_SSE2) && IS_ALIGNED_SSE(jconst_idct_islow_sse2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(void)
+jsimd_idct_islow_dc(j_decompress_ptr cinfo, jpeg_component_info *compptr,
+                    JCOEFPTR coef_block, JSAMPARRAY output_buf,
+                    JDIMENSION output_col)
+{
+  jsimd_idct_islow_dc_sse2(compptr->dct_table, coef_block, output_buf,
+                           output_col);
+}
+
 GLOBAL(int)
 jsimd_can_huff_encode_one_block(void)
 {
@@ -1044,6 +1322,9 @@ jsimd_can_huff_encode_one_block(void)
   if (sizeof(JCOEF) != 2)
     return 0;
 
+  if ((simd_support & JSIMD_AVX2) && (simd_support & JSIMD_BMI2) &&
+      simd_huffman && IS_ALIGNED_AVX(jconst_huff_encode_one_block_avx2))
+    return 1;
   if ((simd_support & JSIMD_SSE2) && simd_huffman &&
       IS_ALIGNED_SSE(jconst_huff_encode_one_block))
     return 1;
@@ -1056,6 +1337,10 @@ jsimd_huff_encode_one_block(void *state, JOCTET *buffer, JCOEFPTR block,
                             int last_dc_val, c_derived_tbl *dctbl,
                             c_derived_tbl *actbl)
 {
+  if ((simd_support & JSIMD_AVX2) && (simd_support & JSIMD_BMI2) &&
+      IS_ALIGNED_AVX(jconst_huff_encode_one_block_avx2))
+    return jsimd_huff_encode_one_block_avx2(state, buffer, block, last_dc_val,
+                                            dctbl, actbl);
   return jsimd_huff_encode_one_block_sse2(state, buffer, block, last_dc_val,
                                           dctbl, actbl);
 }
@@ -1069,6 +1354,9 @@ jsimd_can_encode_mcu_AC_first_prepare(void)
     return 0;
   if (sizeof(JCOEF) != 2)
     return 0;
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_encode_mcu_AC_prepare_avx2))
+    return 1;
   if (simd_support & JSIMD_SSE2)
     return 1;
 
@@ -1080,8 +1368,12 @@ jsimd_encode_mcu_AC_first_prepare(const JCOEF *block,
                                   const int *jpeg_natural_order_start, int Sl,
                                   int Al, UJCOEF *values, size_t *zerobits)
 {
-  jsimd_encode_mcu_AC_first_prepare_sse2(block, jpeg_natural_order_start,
-                                         Sl, Al, values, zerobits);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_encode_mcu_AC_first_prepare_avx2(block, jpeg_natural_order_start,
+                                           Sl, Al, values, zerobits);
+  else
+    jsimd_encode_mcu_AC_first_prepare_sse2(block, jpeg_natural_order_start,
+                                           Sl, Al, values, zerobits);
 }
 
 GLOBAL(int)
@@ -1093,6 +1385,9 @@ jsimd_can_encode_mcu_AC_refine_prepare(void)
     return 0;
   if (sizeof(JCOEF) != 2)
     return 0;
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_encode_mcu_AC_prepare_avx2))
+    return 1;
   if (simd_support & JSIMD_SSE2)
     return 1;
 
@@ -1104,7 +1399,38 @@ jsimd_encode_mcu_AC_refine_prepare(const JCOEF *block,
                                    const int *jpeg_natural_order_start, int Sl,
                                    int Al, UJCOEF *absvalues, size_t *bits)
 {
-  return jsimd_encode_mcu_AC_refine_prepare_sse2(block,
-                                                 jpeg_natural_order_start,
-                                                 Sl, Al, absvalues, bits);
+  if (simd_support & JSIMD_AVX2)
+    return jsimd_encode_mcu_AC_refine_prepare_avx2(block,
+                                                   jpeg_natural_order_start,
+                                                   Sl, Al, absvalues, bits);
+  else
+    return jsimd_encode_mcu_AC_refine_prepare_sse2(block,
+                                                   jpeg_natural_order_start,
+                                                   Sl, Al, absvalues, bits);
+}
+
+GLOBAL(int)
+jsimd_can_trellis_ac_search(void)
+{
+  init_simd();
+
+  if (DCTSIZE != 8)
+    return 0;
+  if (sizeof(float) != 4)
+    return 0;
+
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_trellis_ac_search_avx2))
+    return 1;
+
+  return 0;
+}
+
+GLOBAL(int)
+jsimd_trellis_ac_search(const float *zero_dist, float *cost,
+                        const float *candidate_dist, const float *ac_bits,
+                        int num_pred, int num_candidates)
+{
+  return jsimd_trellis_ac_search_avx2(zero_dist, cost, candidate_dist,
+                                      ac_bits, num_pred, num_candidates);
 }
@@ -51,6 +51,7 @@ EXTN(jpeg_simd_cpu_support):
     xor         rcx, rcx
     cpuid
     mov         rax, rbx                ; rax = Extended feature flags
+    mov         r8, rbx                 ; r8 = Extended feature flags
 
     test        rax, 1<<5               ; bit5:AVX2
     jz          short .return
@@ -73,6 +74,24 @@ EXTN(jpeg_simd_cpu_support):
 
     or          rdi, JSIMD_AVX2
 
+    ; Check for BMI1, BMI2, and LZCNT instruction support
+    test        r8, 1<<3                ; bit3:BMI1
+    jz          short .return
+    test        r8, 1<<8                ; bit8:BMI2
+    jz          short .return
+
+    mov         eax, 0x80000000
+    cpuid
+    cmp         eax, 0x80000001
+    jb          short .return           ; Maximum extended leaf < 80000001H
+
+    mov         eax, 0x80000001
+    cpuid
+    test        rcx, 1<<5               ; bit5:LZCNT
+    jz          short .return
+
+    or          rdi, JSIMD_BMI2
+
 .return:
     mov         rax, rdi
 
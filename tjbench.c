@@ -94,7 +94,9 @@ static int tjErrorLine = -1, tjErrorCode = -1;
 static int stopOnWarning = 0, bottomUp = 0, noRealloc = 1, fastUpsample = 0,
   fastDCT = 0, optimize = 0, progressive = 0, limitScans = 0, maxMemory = 0,
   maxPixels = 0, arithmetic = 0, lossless = 0, restartIntervalBlocks = 0,
-  restartIntervalRows = 0;
+  restartIntervalRows = 0, trellis = 0, trellisDC = 1, trellisSpeed = 7,
+  trellisLoops = 1, optimizeScans = 0, dcScanOpt = 0, overshoot = 0,
+  tune = -1, quantTable = -1, numThreads = 1;
 static int precision = 8, sampleSize, compOnly = 0, decompOnly = 0, doYUV = 0,
   quiet = 0, doTile = 0, pf = TJPF_BGR, yuvAlign = 1, doWrite = 1;
 static char *ext = "ppm";
@@ -210,6 +212,8 @@ static int decomp(unsigned char **jpegBufs, size_t *jpegSizes, void *dstBuf,
     THROW_TJ();
   if (tj3Set(handle, TJPARAM_MAXPIXELS, maxPixels) == -1)
     THROW_TJ();
+  if (tj3Set(handle, TJPARAM_THREADS, numThreads) == -1)
+    THROW_TJ();
 
   if (IS_CROPPED(cr)) {
     if (tj3DecompressHeader(handle, jpegBufs[0], jpegSizes[0]) == -1)
@@ -469,6 +473,26 @@ static int fullTest(tjhandle handle, void *srcBuf, int w, int h, int subsamp,
       THROW_TJ();
     if (tj3Set(handle, TJPARAM_MAXMEMORY, maxMemory) == -1)
       THROW_TJ();
+    if (tj3Set(handle, TJPARAM_TRELLIS, trellis) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_TRELLISDC, trellisDC) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_TRELLISSPEED, trellisSpeed) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_TRELLISLOOPS, trellisLoops) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_OPTIMIZESCANS, optimizeScans) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_DCSCANOPT, dcScanOpt) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_OVERSHOOT, overshoot) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_TUNE, tune) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_QUANTTABLE, quantTable) == -1)
+      THROW_TJ();
+    if (tj3Set(handle, TJPARAM_THREADS, numThreads) == -1)
+      THROW_TJ();
 
     if (doYUV) {
       yuvSize = tj3YUVBufSize(tilew, yuvAlign, tileh, subsamp);
@@ -961,6 +985,19 @@ static void usage(char *progName)
   printf("     -arithmetic is also specified)\n");
   printf("-limitscans = Refuse to decompress or transform progressive JPEG images that\n");
   printf("     have an unreasonably large number of scans\n");
+  printf("-trellis = Use trellis quantization when compressing (implies -optimize)\n");
+  printf("-notrellisdc = Do not apply trellis quantization to DC coefficients\n");
+  printf("-trellisspeed N = Trellis quantization speed level (N = 0-10) [default = 7]\n");
+  printf("-trellisloops N = Number of trellis quantization loops [default = 1]\n");
+  printf("-optimizescans = Choose the progressive scans that yield the smallest JPEG\n");
+  printf("     images when compressing (requires -progressive)\n");
+  printf("-dcscanopt N = DC scan optimization mode (N = 0-2) [default = 0]\n");
+  printf("-overshoot = Use overshoot deringing when compressing\n");
+  printf("-tune M = Tune the quantization tables and trellis quantization for the\n");
+  printf("     specified quality metric (M = psnr, hvs-psnr, ssim, or ms-ssim)\n");
+  printf("-quanttable N = Use the specified predefined quantization table set (N = 0-8)\n");
+  printf("-threads N = Use up to N threads when compressing, and for entropy decoding\n");
+  printf("     when decompressing [default = 1]\n");
   printf("-scale M/N = When decompressing, scale the width/height of the JPEG image by a\n");
   printf("     factor of M/N (M/N = ");
   for (i = 0; i < nsf; i++) {
@@ -1188,7 +1225,53 @@ int main(int argc, char *argv[])
           restartIntervalRows = tempi;
       } else if (!strcasecmp(argv[i], "-stoponwarning"))
         stopOnWarning = 1;
-      else usage(argv[0]);
+      else if (!strcasecmp(argv[i], "-trellis")) {
+        printf("Using trellis quantization\n\n");
+        trellis = 1;
+      } else if (!strcasecmp(argv[i], "-notrellisdc"))
+        trellisDC = 0;
+      else if (!strcasecmp(argv[i], "-trellisspeed") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi < 0 || tempi > 10) usage(argv[0]);
+        trellisSpeed = tempi;
+      } else if (!strcasecmp(argv[i], "-trellisloops") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi < 1) usage(argv[0]);
+        trellisLoops = tempi;
+      } else if (!strcasecmp(argv[i], "-optimizescans")) {
+        printf("Optimizing progressive scans\n\n");
+        optimizeScans = 1;
+      } else if (!strcasecmp(argv[i], "-dcscanopt") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi < 0 || tempi > 2) usage(argv[0]);
+        dcScanOpt = tempi;
+      } else if (!strcasecmp(argv[i], "-overshoot"))
+        overshoot = 1;
+      else if (!strcasecmp(argv[i], "-tune") && i < argc - 1) {
+        i++;
+        if (!strcasecmp(argv[i], "psnr"))
+          tune = TJTUNE_PSNR;
+        else if (!strcasecmp(argv[i], "hvs-psnr"))
+          tune = TJTUNE_HVSPSNR;
+        else if (!strcasecmp(argv[i], "ssim"))
+          tune = TJTUNE_SSIM;
+        else if (!strcasecmp(argv[i], "ms-ssim"))
+          tune = TJTUNE_MSSSIM;
+        else usage(argv[0]);
+      } else if (!strcasecmp(argv[i], "-quanttable") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi < 0 || tempi > 8) usage(argv[0]);
+        quantTable = tempi;
+      } else if (!strcasecmp(argv[i], "-threads") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi < 1) usage(argv[0]);
+        numThreads = tempi;
+      } else usage(argv[0]);
     }
   }
 
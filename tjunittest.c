@@ -825,6 +825,261 @@ bailout:
 }
 
 
+/* Parameter lists for paramTest(): pairs of (parameter, value), terminated by
+   -1 */
+static const int noParams[] = { -1 };
+static const int trellisParams[] = { TJPARAM_TRELLIS, 1, -1 };
+static const int trellisOptParams[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_OPTIMIZE, 1, -1
+};
+static const int trellisNoDCParams[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TRELLISDC, 0, -1
+};
+static const int trellisSpeed0Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TRELLISSPEED, 0, -1
+};
+static const int trellisLoops2Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TRELLISLOOPS, 2, -1
+};
+static const int progParams[] = { TJPARAM_PROGRESSIVE, 1, -1 };
+static const int optScansParams[] = {
+  TJPARAM_PROGRESSIVE, 1, TJPARAM_OPTIMIZESCANS, 1, -1
+};
+static const int dcScanOptParams[] = {
+  TJPARAM_PROGRESSIVE, 1, TJPARAM_OPTIMIZESCANS, 1, TJPARAM_DCSCANOPT, 1, -1
+};
+static const int overshootParams[] = { TJPARAM_OVERSHOOT, 1, -1 };
+static const int quantTable0Params[] = { TJPARAM_QUANTTABLE, 0, -1 };
+static const int quantTable2Params[] = { TJPARAM_QUANTTABLE, 2, -1 };
+static const int tunePSNRParams[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TUNE, TJTUNE_PSNR, -1
+};
+static const int tuneHVSPSNRParams[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TUNE, TJTUNE_HVSPSNR, -1
+};
+static const int tuneSSIMParams[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TUNE, TJTUNE_SSIM, -1
+};
+static const int tuneMSSSIMParams[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TUNE, TJTUNE_MSSSIM, -1
+};
+static const int tuneSSIMTable0Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_TUNE, TJTUNE_SSIM, TJPARAM_QUANTTABLE, 0, -1
+};
+static const int trellisTable0Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_QUANTTABLE, 0, -1
+};
+static const int scansThreads1Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_PROGRESSIVE, 1, TJPARAM_OPTIMIZESCANS, 1,
+  TJPARAM_THREADS, 1, -1
+};
+static const int scansThreads4Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_PROGRESSIVE, 1, TJPARAM_OPTIMIZESCANS, 1,
+  TJPARAM_THREADS, 4, -1
+};
+static const int restartThreads1Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_RESTARTROWS, 1, TJPARAM_THREADS, 1, -1
+};
+static const int restartThreads4Params[] = {
+  TJPARAM_TRELLIS, 1, TJPARAM_RESTARTROWS, 1, TJPARAM_THREADS, 4, -1
+};
+
+static const struct {
+  const char *name;
+  const int *refParams, *testParams;
+  int identical;
+} paramCases[] = {
+  { "TJPARAM_TRELLIS", noParams, trellisParams, 0 },
+  { "TJPARAM_TRELLIS (implies TJPARAM_OPTIMIZE)", trellisOptParams,
+    trellisParams, 1 },
+  { "TJPARAM_TRELLISDC", trellisParams, trellisNoDCParams, 0 },
+  { "TJPARAM_TRELLISSPEED", trellisParams, trellisSpeed0Params, 0 },
+  { "TJPARAM_TRELLISLOOPS", trellisParams, trellisLoops2Params, 0 },
+  { "TJPARAM_OPTIMIZESCANS", progParams, optScansParams, 0 },
+  { "TJPARAM_DCSCANOPT", optScansParams, dcScanOptParams, 0 },
+  { "TJPARAM_OVERSHOOT", noParams, overshootParams, 0 },
+  { "TJPARAM_QUANTTABLE (0 = default)", noParams, quantTable0Params, 1 },
+  { "TJPARAM_QUANTTABLE", noParams, quantTable2Params, 0 },
+  { "TJPARAM_TUNE (PSNR)", trellisParams, tunePSNRParams, 0 },
+  { "TJPARAM_TUNE (PSNR-HVS)", trellisParams, tuneHVSPSNRParams, 0 },
+  { "TJPARAM_TUNE (SSIM)", trellisParams, tuneSSIMParams, 0 },
+  { "TJPARAM_TUNE (MS-SSIM)", trellisParams, tuneMSSSIMParams, 0 },
+  { "TJPARAM_TUNE (PSNR vs. SSIM)", tunePSNRParams, tuneSSIMParams, 0 },
+  { "TJPARAM_TUNE (PSNR-HVS vs. MS-SSIM)", tuneHVSPSNRParams,
+    tuneMSSSIMParams, 0 },
+  { "TJPARAM_TUNE (overridden tables)", trellisTable0Params,
+    tuneSSIMTable0Params, 0 },
+  { "TJPARAM_THREADS (scan optimization)", scansThreads1Params,
+    scansThreads4Params, 1 },
+  { "TJPARAM_THREADS (restart intervals)", restartThreads1Params,
+    restartThreads4Params, 1 }
+};
+
+/* Valid non-default values and out-of-range values of the mozjpeg
+   compression parameters */
+static const struct {
+  int param, defaultValue, value, badValues[2];
+} paramValues[] = {
+  { TJPARAM_TRELLIS, 0, 1, { -1, 2 } },
+  { TJPARAM_TRELLISDC, 1, 0, { -1, 2 } },
+  { TJPARAM_TRELLISSPEED, 7, 3, { -1, 11 } },
+  { TJPARAM_TRELLISLOOPS, 1, 2, { 0, -1 } },
+  { TJPARAM_OPTIMIZESCANS, 0, 1, { -1, 2 } },
+  { TJPARAM_DCSCANOPT, 0, 2, { -1, 3 } },
+  { TJPARAM_OVERSHOOT, 0, 1, { -1, 2 } },
+  { TJPARAM_TUNE, -1, TJTUNE_MSSSIM, { -2, TJ_NUMTUNE } },
+  { TJPARAM_QUANTTABLE, -1, 8, { -2, 9 } },
+  { TJPARAM_THREADS, 1, 4, { 0, -1 } }
+};
+
+#define PARAM_W  96
+#define PARAM_H  80
+
+static unsigned char *paramCompress(const unsigned char *srcBuf,
+                                    const int *params, size_t *jpegSize)
+{
+  tjhandle handle = NULL;
+  unsigned char *jpegBuf = NULL;
+  int i;
+
+  *jpegSize = 0;
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_QUALITY, 95));
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_SUBSAMP, TJSAMP_420));
+  for (i = 0; params[i] >= 0; i += 2)
+    TRY_TJ(handle, tj3Set(handle, params[i], params[i + 1]));
+  TRY_TJ(handle, tj3Compress8(handle, srcBuf, PARAM_W, 0, PARAM_H, TJPF_RGB,
+                              &jpegBuf, jpegSize));
+  tj3Destroy(handle);
+  return jpegBuf;
+
+bailout:
+  tj3Destroy(handle);
+  tj3Free(jpegBuf);
+  return NULL;
+}
+
+static void paramTest(void)
+{
+  unsigned char *srcBuf = NULL, *refBuf = NULL, *testBuf = NULL;
+  unsigned char *dstBuf[2] = { NULL, NULL };
+  size_t refSize, testSize;
+  tjhandle handle = NULL, dhandle = NULL;
+  unsigned int seed = 1;
+  int i, j, row, col, identical;
+
+  printf("mozjpeg parameter test\n");
+
+  /* Gradients with noise, and a region of black lines on white (which
+     overshoot deringing affects) */
+  if ((srcBuf = (unsigned char *)malloc(PARAM_W * PARAM_H * 3)) == NULL)
+    THROW("Memory allocation failure");
+  for (row = 0; row < PARAM_H; row++) {
+    for (col = 0; col < PARAM_W; col++) {
+      unsigned char *pixel = &srcBuf[(row * PARAM_W + col) * 3];
+
+      for (i = 0; i < 3; i++) {
+        int value = (row * 2 + col * (i + 1)) % 224;
+
+        seed = seed * 1103515245 + 12345;
+        value += (seed >> 16) % 32;
+        if (row >= PARAM_H / 2 && col >= PARAM_W / 2)
+          value = (row % 4 == 0 || col % 6 == 0) ? 0 : 255;
+        pixel[i] = (unsigned char)value;
+      }
+    }
+  }
+
+  /* Parameter values */
+  if ((handle = tj3Init(TJINIT_COMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  for (i = 0; i < (int)(sizeof(paramValues) / sizeof(paramValues[0])); i++) {
+    int param = paramValues[i].param;
+
+    printf("Parameter %d values ... ", param);
+    if (tj3Get(handle, param) != paramValues[i].defaultValue)
+      THROW("Incorrect default value");
+    TRY_TJ(handle, tj3Set(handle, param, paramValues[i].value));
+    if (tj3Get(handle, param) != paramValues[i].value)
+      THROW("tj3Get() did not return the value set with tj3Set()");
+    for (j = 0; j < 2; j++) {
+      if (tj3Set(handle, param, paramValues[i].badValues[j]) != -1)
+        THROW("tj3Set() accepted an out-of-range value");
+      if (tj3Get(handle, param) != paramValues[i].value)
+        THROW("tj3Set() changed the value after rejecting it");
+    }
+    printf("Passed.\n");
+  }
+  tj3Destroy(handle);
+
+  /* TJPARAM_THREADS is the only one of these that applies to decompression. */
+  if ((handle = tj3Init(TJINIT_DECOMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  printf("Decompression parameters ... ");
+  if (tj3Set(handle, TJPARAM_TRELLIS, 1) != -1)
+    THROW("tj3Set() accepted a compression parameter");
+  TRY_TJ(handle, tj3Set(handle, TJPARAM_THREADS, 4));
+  if (tj3Get(handle, TJPARAM_THREADS) != 4)
+    THROW("tj3Get() did not return the value set with tj3Set()");
+  printf("Passed.\n");
+  tj3Destroy(handle);  handle = NULL;
+
+  /* Effect of each parameter on the JPEG image.  The JPEG images must also
+     decompress without warnings. */
+  if ((dhandle = tj3Init(TJINIT_DECOMPRESS)) == NULL)
+    THROW_TJ(NULL);
+  if ((dstBuf[0] = (unsigned char *)malloc(PARAM_W * PARAM_H * 3)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < (int)(sizeof(paramCases) / sizeof(paramCases[0])); i++) {
+    printf("%s ... ", paramCases[i].name);
+    if ((refBuf = paramCompress(srcBuf, paramCases[i].refParams,
+                                &refSize)) == NULL ||
+        (testBuf = paramCompress(srcBuf, paramCases[i].testParams,
+                                 &testSize)) == NULL)
+      BAILOUT()
+    identical = (refSize == testSize && !memcmp(refBuf, testBuf, refSize));
+    if (identical && !paramCases[i].identical)
+      THROW("JPEG image did not change");
+    if (!identical && paramCases[i].identical)
+      THROW("JPEG image changed");
+    TRY_TJ(dhandle, tj3Decompress8(dhandle, refBuf, refSize, dstBuf[0], 0,
+                                   TJPF_RGB));
+    TRY_TJ(dhandle, tj3Decompress8(dhandle, testBuf, testSize, dstBuf[0], 0,
+                                   TJPF_RGB));
+    printf("Passed.\n");
+    if (i < (int)(sizeof(paramCases) / sizeof(paramCases[0])) - 1) {
+      tj3Free(refBuf);  refBuf = NULL;
+      tj3Free(testBuf);  testBuf = NULL;
+    }
+  }
+
+  /* Concurrent decompression of the restart intervals in the last JPEG
+     image */
+  printf("TJPARAM_THREADS (decompression) ... ");
+  if ((dstBuf[1] = (unsigned char *)malloc(PARAM_W * PARAM_H * 3)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < 2; i++) {
+    TRY_TJ(dhandle, tj3Set(dhandle, TJPARAM_THREADS, i == 0 ? 1 : 4));
+    TRY_TJ(dhandle, tj3Decompress8(dhandle, testBuf, testSize, dstBuf[i], 0,
+                                   TJPF_RGB));
+  }
+  if (memcmp(dstBuf[0], dstBuf[1], PARAM_W * PARAM_H * 3))
+    THROW("Decompressed image changed");
+  printf("Passed.\n");
+  printf("--------------------\n\n");
+
+bailout:
+  tj3Destroy(handle);
+  tj3Destroy(dhandle);
+  free(srcBuf);
+  free(dstBuf[0]);
+  free(dstBuf[1]);
+  tj3Free(refBuf);
+  tj3Free(testBuf);
+}
+
+
 static void rgb_to_cmyk(int r, int g, int b, int *c, int *m, int *y, int *k)
 {
   double ctmp = 1.0 - ((double)r / (double)maxSample);
@@ -1202,6 +1457,8 @@ int main(int argc, char *argv[])
     doTest(35, 39, _4sampleFormats, 4, TJSAMP_GRAY, "test");
   }
   bufSizeTest();
+  if (precision == 8 && !lossless && !doYUV && !alloc)
+    paramTest();
   if (doYUV) {
     printf("\n--------------------\n\n");
     doTest(48, 48, _onlyRGB, 1, TJSAMP_444, "test_yuv0");
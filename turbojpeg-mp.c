@@ -168,6 +168,7 @@ DLLEXPORT int GET_NAME(tj3Decompress, BITS_IN_JSAMPLE)
     dinfo->progress = NULL;
 
   dinfo->mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
+  jpeg_d_set_int_param(dinfo, JINT_NUM_THREADS, this->numThreads);
 
   if (setjmp(this->jerr.setjmp_buffer)) {
     /* If we get here, the JPEG code has signaled an error. */
@@ -139,6 +139,16 @@ typedef struct _tjinstance {
   tjregion croppingRegion;
   int maxMemory;
   int maxPixels;
+  boolean trellis;
+  boolean trellisDC;
+  int trellisSpeed;
+  int trellisLoops;
+  boolean optimizeScans;
+  int dcScanOpt;
+  boolean overshoot;
+  int tune;
+  int quantTable;
+  int numThreads;
 } tjinstance;
 
 static tjhandle _tjInitCompress(tjinstance *this);
@@ -343,6 +353,51 @@ static void setCompDefaults(tjinstance *this, int pixelFormat)
   this->cinfo.density_unit = (UINT8)this->densityUnits;
   this->cinfo.mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
 
+  /* mozjpeg extensions (jpeg_set_quality() and jpeg_simple_progression()
+     depend on some of these) */
+  switch (this->tune) {
+  case TJTUNE_PSNR:
+    jpeg_c_set_int_param(&this->cinfo, JINT_BASE_QUANT_TBL_IDX, 1);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE1, 9.0);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE2, 0.0);
+    jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_USE_LAMBDA_WEIGHT_TBL, FALSE);
+    break;
+  case TJTUNE_HVSPSNR:
+    jpeg_c_set_int_param(&this->cinfo, JINT_BASE_QUANT_TBL_IDX, 3);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE1, 14.75);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE2, 16.5);
+    jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_USE_LAMBDA_WEIGHT_TBL, TRUE);
+    break;
+  case TJTUNE_SSIM:
+    jpeg_c_set_int_param(&this->cinfo, JINT_BASE_QUANT_TBL_IDX, 1);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE1, 11.5);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE2, 12.75);
+    jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_USE_LAMBDA_WEIGHT_TBL, FALSE);
+    break;
+  case TJTUNE_MSSSIM:
+    jpeg_c_set_int_param(&this->cinfo, JINT_BASE_QUANT_TBL_IDX, 3);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE1, 12.0);
+    jpeg_c_set_float_param(&this->cinfo, JFLOAT_LAMBDA_LOG_SCALE2, 13.0);
+    jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_USE_LAMBDA_WEIGHT_TBL, TRUE);
+    break;
+  }
+  if (this->quantTable >= 0)
+    jpeg_c_set_int_param(&this->cinfo, JINT_BASE_QUANT_TBL_IDX,
+                         this->quantTable);
+  jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_TRELLIS_QUANT, this->trellis);
+  jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_TRELLIS_QUANT_DC,
+                        this->trellisDC);
+  jpeg_c_set_int_param(&this->cinfo, JINT_TRELLIS_SPEED_LEVEL,
+                       this->trellisSpeed);
+  jpeg_c_set_int_param(&this->cinfo, JINT_TRELLIS_NUM_LOOPS,
+                       this->trellisLoops);
+  jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_OPTIMIZE_SCANS,
+                        this->optimizeScans);
+  jpeg_c_set_int_param(&this->cinfo, JINT_DC_SCAN_OPT_MODE, this->dcScanOpt);
+  jpeg_c_set_bool_param(&this->cinfo, JBOOLEAN_OVERSHOOT_DERINGING,
+                        this->overshoot);
+  jpeg_c_set_int_param(&this->cinfo, JINT_NUM_THREADS, this->numThreads);
+
   if (this->lossless) {
 #ifdef C_LOSSLESS_SUPPORTED
     jpeg_enable_lossless(&this->cinfo, this->losslessPSV, this->losslessPt);
@@ -377,8 +432,12 @@ static void setCompDefaults(tjinstance *this, int pixelFormat)
       jpeg_set_colorspace(&this->cinfo, JCS_YCbCr);
   }
 
+  /* Trellis quantization replaces the Huffman tables with tables generated
+   * from the statistics of its own passes, so a Huffman optimization pass is
+   * needed to make the tables cover the final coefficients.
+   */
   if (this->cinfo.data_precision == 8)
-    this->cinfo.optimize_coding = this->optimize;
+    this->cinfo.optimize_coding = this->optimize || this->trellis;
 #ifdef C_PROGRESSIVE_SUPPORTED
   if (this->progressive) jpeg_simple_progression(&this->cinfo);
 #endif
@@ -561,6 +620,12 @@ DLLEXPORT tjhandle tj3Init(int initType)
   this->xDensity = 1;
   this->yDensity = 1;
   this->scalingFactor = TJUNSCALED;
+  this->trellisDC = TRUE;
+  this->trellisSpeed = 7;
+  this->trellisLoops = 1;
+  this->tune = -1;
+  this->quantTable = -1;
+  this->numThreads = 1;
 
   switch (initType) {
   case TJINIT_COMPRESS:  return _tjInitCompress(this);
@@ -790,6 +855,62 @@ DLLEXPORT int tj3Set(tjhandle handle, int param, int value)
   case TJPARAM_MAXPIXELS:
     SET_PARAM(maxPixels, 0, -1);
     break;
+  case TJPARAM_TRELLIS:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_TRELLIS is not applicable to decompression instances.");
+    SET_BOOL_PARAM(trellis);
+    break;
+  case TJPARAM_TRELLISDC:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_TRELLISDC is not applicable to decompression instances.");
+    SET_BOOL_PARAM(trellisDC);
+    break;
+  case TJPARAM_TRELLISSPEED:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_TRELLISSPEED is not applicable to decompression instances.");
+    if (value < 0 || value > 10)
+      THROW("Parameter value out of range");
+    this->trellisSpeed = value;
+    break;
+  case TJPARAM_TRELLISLOOPS:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_TRELLISLOOPS is not applicable to decompression instances.");
+    SET_PARAM(trellisLoops, 1, -1);
+    break;
+  case TJPARAM_OPTIMIZESCANS:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_OPTIMIZESCANS is not applicable to decompression instances.");
+    SET_BOOL_PARAM(optimizeScans);
+    break;
+  case TJPARAM_DCSCANOPT:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_DCSCANOPT is not applicable to decompression instances.");
+    if (value < 0 || value > 2)
+      THROW("Parameter value out of range");
+    this->dcScanOpt = value;
+    break;
+  case TJPARAM_OVERSHOOT:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_OVERSHOOT is not applicable to decompression instances.");
+    SET_BOOL_PARAM(overshoot);
+    break;
+  case TJPARAM_TUNE:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_TUNE is not applicable to decompression instances.");
+    if (value < -1 || value >= TJ_NUMTUNE)
+      THROW("Parameter value out of range");
+    this->tune = value;
+    break;
+  case TJPARAM_QUANTTABLE:
+    if (!(this->init & COMPRESS))
+      THROW("TJPARAM_QUANTTABLE is not applicable to decompression instances.");
+    if (value < -1 || value > 8)
+      THROW("Parameter value out of range");
+    this->quantTable = value;
+    break;
+  case TJPARAM_THREADS:
+    SET_PARAM(numThreads, 1, -1);
+    break;
   default:
     THROW("Invalid parameter");
   }
@@ -856,6 +977,26 @@ DLLEXPORT int tj3Get(tjhandle handle, int param)
     return this->maxMemory;
   case TJPARAM_MAXPIXELS:
     return this->maxPixels;
+  case TJPARAM_TRELLIS:
+    return this->trellis;
+  case TJPARAM_TRELLISDC:
+    return this->trellisDC;
+  case TJPARAM_TRELLISSPEED:
+    return this->trellisSpeed;
+  case TJPARAM_TRELLISLOOPS:
+    return this->trellisLoops;
+  case TJPARAM_OPTIMIZESCANS:
+    return this->optimizeScans;
+  case TJPARAM_DCSCANOPT:
+    return this->dcScanOpt;
+  case TJPARAM_OVERSHOOT:
+    return this->overshoot;
+  case TJPARAM_TUNE:
+    return this->tune;
+  case TJPARAM_QUANTTABLE:
+    return this->quantTable;
+  case TJPARAM_THREADS:
+    return this->numThreads;
   }
 
   return -1;
@@ -2065,6 +2206,7 @@ DLLEXPORT int tj3DecompressToYUVPlanes8(tjhandle handle,
     dinfo->progress = NULL;
 
   dinfo->mem->max_memory_to_use = (long)this->maxMemory * 1048576L;
+  jpeg_d_set_int_param(dinfo, JINT_NUM_THREADS, this->numThreads);
 
   if (setjmp(this->jerr.setjmp_buffer)) {
     /* If we get here, the JPEG code has signaled an error. */
@@ -2164,6 +2306,9 @@ DLLEXPORT int tj3DecompressToYUVPlanes8(tjhandle handle,
           this->scalingFactor.num / this->scalingFactor.denom *
           compptr->v_samp_factor / dinfo->max_v_samp_factor;
         dinfo->idct->inverse_DCT[i] = dinfo->idct->inverse_DCT[0];
+        memcpy(dinfo->idct->sparse_inverse_DCT[i],
+               dinfo->idct->sparse_inverse_DCT[0],
+               sizeof(dinfo->idct->sparse_inverse_DCT[0]));
       }
       crow[i] = row * compptr->v_samp_factor / dinfo->max_v_samp_factor;
       if (usetmpbuf) yuvptr[i] = tmpbuf[i];
@@ -509,6 +509,41 @@ enum TJCS {
 };
 
 
+/**
+ * The number of trellis quantization tunings
+ */
+#define TJ_NUMTUNE  4
+
+/**
+ * Trellis quantization tunings
+ *
+ * Each tuning selects the quantization tables and the rate-distortion
+ * tradeoff (lambda) used by trellis quantization, in order to optimize for a
+ * particular image quality metric.  These match the `-tune-*` options of
+ * cjpeg.
+ *
+ * @see #TJPARAM_TUNE
+ */
+enum TJTUNE {
+  /**
+   * Tune for PSNR
+   */
+  TJTUNE_PSNR,
+  /**
+   * Tune for PSNR-HVS
+   */
+  TJTUNE_HVSPSNR,
+  /**
+   * Tune for SSIM
+   */
+  TJTUNE_SSIM,
+  /**
+   * Tune for MS-SSIM
+   */
+  TJTUNE_MSSSIM
+};
+
+
 /**
  * Parameters
  */
@@ -909,7 +944,130 @@ enum TJPARAM {
    * - maximum number of pixels that the decompression, transform, and image
    * loading functions will process *[default: `0` (no limit)]*
    */
-  TJPARAM_MAXPIXELS
+  TJPARAM_MAXPIXELS,
+  /**
+   * Trellis quantization [lossy compression]
+   *
+   * **Value**
+   * - `0` *[default]* Quantize each DCT coefficient independently.
+   * - `1` For each 8x8 block, use trellis quantization to find the best
+   * tradeoff between the size of the quantized coefficients and the
+   * distortion that they cause.
+   *
+   * Trellis quantization improves compression considerably, but it reduces
+   * compression performance considerably as well.  It implies
+   * #TJPARAM_OPTIMIZE, and it works best when combined with
+   * #TJPARAM_PROGRESSIVE.
+   *
+   * @see #TJPARAM_TRELLISDC, #TJPARAM_TRELLISSPEED, #TJPARAM_TRELLISLOOPS,
+   * #TJPARAM_TUNE
+   */
+  TJPARAM_TRELLIS,
+  /**
+   * Trellis quantization of DC coefficients [lossy compression]
+   *
+   * **Value**
+   * - `0` Apply trellis quantization to AC coefficients only.
+   * - `1` *[default]* Apply trellis quantization to DC coefficients as well.
+   *
+   * This parameter has no effect unless #TJPARAM_TRELLIS is set.
+   */
+  TJPARAM_TRELLISDC,
+  /**
+   * Trellis quantization speed level [lossy compression]
+   *
+   * **Value**
+   * - `0` to `10` Limit the trellis search for blocks with many nonzero
+   * coefficients.  `0` never limits the search (slowest), and higher levels
+   * limit it for more blocks (faster.) *[default: `7`]*
+   *
+   * This parameter has no effect unless #TJPARAM_TRELLIS is set.
+   */
+  TJPARAM_TRELLISSPEED,
+  /**
+   * Number of trellis quantization loops [lossy compression]
+   *
+   * **Value**
+   * - the number of times that each component is trellis-quantized, with
+   * Huffman tables regenerated from the previous loop's output
+   * *[default: `1`]*
+   *
+   * This parameter has no effect unless #TJPARAM_TRELLIS is set.
+   */
+  TJPARAM_TRELLISLOOPS,
+  /**
+   * Progressive scan optimization [lossy compression]
+   *
+   * **Value**
+   * - `0` *[default]* Use a fixed progressive scan script.
+   * - `1` Try a number of candidate scans (successive approximation and
+   * frequency splits), and keep those that yield the smallest JPEG image.
+   *
+   * This parameter has no effect unless #TJPARAM_PROGRESSIVE is set.
+   * Scan optimization improves compression, particularly for small images,
+   * but it reduces compression performance considerably.
+   *
+   * @see #TJPARAM_DCSCANOPT
+   */
+  TJPARAM_OPTIMIZESCANS,
+  /**
+   * DC scan optimization mode [lossy compression]
+   *
+   * **Value**
+   * - `0` *[default]* Use one DC scan for all components.
+   * - `1` Use one DC scan per component.
+   * - `2` Choose between one DC scan for all components and one DC scan for
+   * the first component plus one for the remaining components.
+   *
+   * This parameter has no effect unless #TJPARAM_OPTIMIZESCANS is set.
+   */
+  TJPARAM_DCSCANOPT,
+  /**
+   * Overshoot deringing [lossy compression]
+   *
+   * **Value**
+   * - `0` *[default]* Compress the source image as is.
+   * - `1` Let samples with extreme values (for instance, 0 and 255 with 8-bit
+   * data precision) overshoot before the DCT, which reduces ringing artifacts
+   * around black text or lines on a white background.
+   */
+  TJPARAM_OVERSHOOT,
+  /**
+   * Trellis quantization tuning [lossy compression]
+   *
+   * **Value**
+   * - `-1` *[default]* Use the default quantization tables and the default
+   * tradeoff (same as #TJTUNE_HVSPSNR, except for the quantization tables.)
+   * - One of the @ref TJTUNE "trellis quantization tunings"
+   *
+   * The quantization tables selected by this parameter can be overridden with
+   * #TJPARAM_QUANTTABLE.
+   */
+  TJPARAM_TUNE,
+  /**
+   * Quantization table set [lossy compression]
+   *
+   * **Value**
+   * - `-1` *[default]* Use the quantization tables selected by #TJPARAM_TUNE,
+   * or the tables from the JPEG standard if #TJPARAM_TUNE is `-1`.
+   * - `0` to `8` Use the given predefined quantization table set.  These are
+   * the same as the values of the `-quant-table` option of cjpeg.
+   */
+  TJPARAM_QUANTTABLE,
+  /**
+   * Maximum number of threads [lossy compression, lossy decompression]
+   *
+   * **Value**
+   * - the maximum number of threads used for trellis quantization, for
+   * progressive scan optimization, and for encoding the restart intervals of
+   * baseline JPEG images, or for entropy decoding of single-scan Huffman-coded
+   * sequential JPEG images *[default: `1`]*
+   *
+   * The JPEG or packed-pixel image is the same regardless of the number of
+   * threads.  Concurrent decompression does not occur if #TJPARAM_MAXMEMORY
+   * is set.
+   */
+  TJPARAM_THREADS
 };
 
 